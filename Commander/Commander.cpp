@@ -20,6 +20,7 @@ namespace Plugin {
     static Core::ProxyPoolType<Web::JSONBodyType<Core::JSON::ArrayType<Commander::Data>>> jsonBodyArrayDataFactory(2);
     static Core::ProxyPoolType<Web::JSONBodyType<Commander::Data>> jsonBodySingleDataFactory(2);
     static Core::ProxyPoolType<Web::JSONBodyType<Core::JSON::ArrayType<Commander::Command>>> jsonBodyArrayCommandFactory(2);
+    static Core::ProxyPoolType<Web::JSONBodyType<Commander::Timeline>> jsonBodyTraceFactory(1);
 
     Commander::Commander()
         : _skipURL(0)
@@ -58,7 +59,8 @@ namespace Plugin {
                 Core::ProxyType<Sequencer>::Create(
                     index.Current().Value(),
                     &_commandAdministrator,
-                    _service)));
+                    _service,
+                    config.Depth.Value())));
         }
 
         // On succes return "".
@@ -77,7 +79,18 @@ namespace Plugin {
             Core::ProxyType<Core::IDispatchType<void>> job(Core::proxy_cast<Core::IDispatchType<void>>(index->second));
 
             index->second->Abort();
-            PluginHost::WorkerPool::Instance().Revoke(job);
+
+            if (PluginHost::WorkerPool::Instance().Revoke(job, 2000) == Core::ERROR_NONE) {
+                index->second->Revoked();
+            }
+
+            // Steps of a graph may still be running on the worker pool.
+            if (index->second->Wait(2000) == false) {
+                SYSLOG(Logging::Notification, (_T("Sequencer %s did not stop in time (2S)"), index->first.c_str()));
+            }
+
+            // No step may be left behind on the worker pool once the sequencer is gone.
+            index->second->RevokeSteps();
 
             index++;
         }
@@ -105,6 +118,7 @@ namespace Plugin {
 
     // GET: ../Sequencer/[SequencerName]	; Return [ALL] available sequencers and their current state
     // GET: ../Commands						; Return all possible commmands
+    // GET: ../Trace/SequencerName			; Return the last run of the sequencer in the Chrome Trace Event Format
 
     /* virtual */ Core::ProxyType<Web::Response> Commander::Process(const Web::Request& request)
     {
@@ -153,6 +167,22 @@ namespace Plugin {
                         index++;
                     }
 
+                    response->ErrorCode = Web::STATUS_OK;
+                    response->Message = "OK";
+                    response->Body(Core::proxy_cast<Web::IBody>(data));
+                }
+            } else if (index.Current() == _T("Trace")) {
+
+                if ((index.Next() == false) || (_sequencers.find(index.Current().Text()) == _sequencers.end())) {
+
+                    response->ErrorCode = Web::STATUS_BAD_REQUEST;
+                    response->Message = _T("Missing Sequencer name or not existing sequencer");
+                } else {
+                    Core::ProxyType<Web::JSONBodyType<Commander::Timeline>> data(jsonBodyTraceFactory.Element());
+
+                    data->TraceEvents.Clear();
+                    _sequencers[index.Current().Text()]->Export(*data);
+
                     response->ErrorCode = Web::STATUS_OK;
                     response->Message = "OK";
                     response->Body(Core::proxy_cast<Web::IBody>(data));
@@ -190,6 +220,7 @@ namespace Plugin {
                     response->ErrorCode = Web::STATUS_NO_CONTENT;
                     response->Message = _T("Sequencer was not in a running state");
                 } else if (PluginHost::WorkerPool::Instance().Revoke(job, 2000) == Core::ERROR_NONE) {
+                    sequencer->Revoked();
                     response->ErrorCode = Web::STATUS_OK;
                     response->Message = _T("Sequencer available for next sequence");
                 } else {
@@ -211,10 +242,10 @@ namespace Plugin {
                 if (sequencer->IsActive() == true) {
                     response->ErrorCode = Web::STATUS_TEMPORARY_REDIRECT;
                     response->Message = _T("Sequencer already running");
+                } else if ((sequencer->Load(*(request.Body<Web::JSONBodyType<Core::JSON::ArrayType<Commander::Command>>>())) == 0) || (sequencer->Execute() != Core::ERROR_NONE)) {
+                    response->ErrorCode = Web::STATUS_BAD_REQUEST;
+                    response->Message = _T("Sequence List invalid, unknown commands or steps waiting for unknown steps or each other");
                 } else {
-                    sequencer->Load(*(request.Body<Web::JSONBodyType<Core::JSON::ArrayType<Commander::Command>>>()));
-                    sequencer->Execute();
-
                     PluginHost::WorkerPool::Instance().Submit(job);
 
                     // Attach to response.
@@ -241,6 +272,8 @@ namespace Plugin {
             data.Index = sequencer.Index();
         }
 
+        sequencer.Report(data);
+
         return (data);
     }
 
@@ -2,6 +2,7 @@
 #define __COMMANDER_H
 
 #include "Module.h"
+#include "Commands.h"
 #include <interfaces/ICommand.h>
 
 namespace WPEFramework {
@@ -22,20 +23,24 @@ namespace Plugin {
                 , Item()
                 , Label()
                 , Parameters(false)
+                , After()
             {
                 Add(_T("command"), &Item);
                 Add(_T("label"), &Label);
                 Add(_T("parameters"), &Parameters);
+                Add(_T("after"), &After);
             }
             Command(const Command& copy)
                 : Core::JSON::Container()
                 , Item(copy.Item)
                 , Label(copy.Label)
                 , Parameters(copy.Parameters)
+                , After(copy.After)
             {
                 Add(_T("command"), &Item);
                 Add(_T("label"), &Label);
                 Add(_T("parameters"), &Parameters);
+                Add(_T("after"), &After);
             }
             ~Command()
             {
@@ -46,6 +51,7 @@ namespace Plugin {
                 Item = RHS.Item;
                 Label = RHS.Label;
                 Parameters = RHS.Parameters;
+                After = RHS.After;
 
                 return (*this);
             }
@@ -54,6 +60,217 @@ namespace Plugin {
             Core::JSON::String Item;
             Core::JSON::String Label;
             Core::JSON::String Parameters;
+            // Labels of the steps this step waits for. As soon as one step in a sequence has it, the sequence
+            // is run as a graph: every step starts when the steps it waits for are done, in parallel.
+            Core::JSON::ArrayType<Core::JSON::String> After;
+        };
+
+        class Timing : public Core::JSON::Container {
+        public:
+            Timing()
+                : Core::JSON::Container()
+                , Label()
+                , Command()
+                , Start()
+                , Queued()
+                , Duration()
+                , Wait()
+                , Work()
+                , Result()
+                , Next()
+            {
+                Add(_T("label"), &Label);
+                Add(_T("command"), &Command);
+                Add(_T("start"), &Start);
+                Add(_T("queued"), &Queued);
+                Add(_T("duration"), &Duration);
+                Add(_T("wait"), &Wait);
+                Add(_T("work"), &Work);
+                Add(_T("result"), &Result);
+                Add(_T("next"), &Next);
+            }
+            Timing(const Timing& copy)
+                : Core::JSON::Container()
+                , Label(copy.Label)
+                , Command(copy.Command)
+                , Start(copy.Start)
+                , Queued(copy.Queued)
+                , Duration(copy.Duration)
+                , Wait(copy.Wait)
+                , Work(copy.Work)
+                , Result(copy.Result)
+                , Next(copy.Next)
+            {
+                Add(_T("label"), &Label);
+                Add(_T("command"), &Command);
+                Add(_T("start"), &Start);
+                Add(_T("queued"), &Queued);
+                Add(_T("duration"), &Duration);
+                Add(_T("wait"), &Wait);
+                Add(_T("work"), &Work);
+                Add(_T("result"), &Result);
+                Add(_T("next"), &Next);
+            }
+            ~Timing()
+            {
+            }
+
+            Timing& operator=(const Timing& RHS)
+            {
+                Label = RHS.Label;
+                Command = RHS.Command;
+                Start = RHS.Start;
+                Queued = RHS.Queued;
+                Duration = RHS.Duration;
+                Wait = RHS.Wait;
+                Work = RHS.Work;
+                Result = RHS.Result;
+                Next = RHS.Next;
+
+                return (*this);
+            }
+
+        public:
+            Core::JSON::String Label;
+            Core::JSON::String Command;
+            Core::JSON::DecUInt32 Start; // ms since the start of the sequence
+            Core::JSON::DecUInt32 Queued; // ms between being ready to run and running
+            Core::JSON::DecUInt32 Duration; // ms
+            Core::JSON::DecUInt32 Wait; // ms queued or waiting for a plugin state
+            Core::JSON::DecUInt32 Work; // ms executing
+            Core::JSON::String Result;
+            Core::JSON::String Next; // label of the step that ran next, only in a sequence without "after"
+        };
+
+        // The last run of a sequencer in the Trace Event Format, to be loaded in chrome://tracing or Perfetto.
+        class Timeline : public Core::JSON::Container {
+        public:
+            class Event : public Core::JSON::Container {
+            public:
+                class Arguments : public Core::JSON::Container {
+                public:
+                    Arguments()
+                        : Core::JSON::Container()
+                        , Result()
+                        , Next()
+                    {
+                        Add(_T("result"), &Result);
+                        Add(_T("next"), &Next);
+                    }
+                    Arguments(const Arguments& copy)
+                        : Core::JSON::Container()
+                        , Result(copy.Result)
+                        , Next(copy.Next)
+                    {
+                        Add(_T("result"), &Result);
+                        Add(_T("next"), &Next);
+                    }
+                    ~Arguments()
+                    {
+                    }
+
+                    Arguments& operator=(const Arguments& RHS)
+                    {
+                        Result = RHS.Result;
+                        Next = RHS.Next;
+
+                        return (*this);
+                    }
+
+                public:
+                    Core::JSON::String Result;
+                    Core::JSON::String Next;
+                };
+
+            public:
+                Event()
+                    : Core::JSON::Container()
+                    , Name()
+                    , Category()
+                    , Phase()
+                    , Timestamp()
+                    , Duration()
+                    , Process()
+                    , Thread()
+                    , Args()
+                {
+                    Add(_T("name"), &Name);
+                    Add(_T("cat"), &Category);
+                    Add(_T("ph"), &Phase);
+                    Add(_T("ts"), &Timestamp);
+                    Add(_T("dur"), &Duration);
+                    Add(_T("pid"), &Process);
+                    Add(_T("tid"), &Thread);
+                    Add(_T("args"), &Args);
+                }
+                Event(const Event& copy)
+                    : Core::JSON::Container()
+                    , Name(copy.Name)
+                    , Category(copy.Category)
+                    , Phase(copy.Phase)
+                    , Timestamp(copy.Timestamp)
+                    , Duration(copy.Duration)
+                    , Process(copy.Process)
+                    , Thread(copy.Thread)
+                    , Args(copy.Args)
+                {
+                    Add(_T("name"), &Name);
+                    Add(_T("cat"), &Category);
+                    Add(_T("ph"), &Phase);
+                    Add(_T("ts"), &Timestamp);
+                    Add(_T("dur"), &Duration);
+                    Add(_T("pid"), &Process);
+                    Add(_T("tid"), &Thread);
+                    Add(_T("args"), &Args);
+                }
+                ~Event()
+                {
+                }
+
+                Event& operator=(const Event& RHS)
+                {
+                    Name = RHS.Name;
+                    Category = RHS.Category;
+                    Phase = RHS.Phase;
+                    Timestamp = RHS.Timestamp;
+                    Duration = RHS.Duration;
+                    Process = RHS.Process;
+                    Thread = RHS.Thread;
+                    Args = RHS.Args;
+
+                    return (*this);
+                }
+
+            public:
+                Core::JSON::String Name;
+                Core::JSON::String Category;
+                Core::JSON::String Phase;
+                Core::JSON::DecUInt64 Timestamp; // us
+                Core::JSON::DecUInt64 Duration; // us
+                Core::JSON::DecUInt32 Process;
+                Core::JSON::DecUInt32 Thread;
+                Arguments Args;
+            };
+
+        public:
+            Timeline(const Timeline&) = delete;
+            Timeline& operator=(const Timeline&) = delete;
+
+            Timeline()
+                : Core::JSON::Container()
+                , TraceEvents()
+                , DisplayTimeUnit(_T("ms"))
+            {
+                Add(_T("traceEvents"), &TraceEvents);
+                Add(_T("displayTimeUnit"), &DisplayTimeUnit);
+            }
+            ~Timeline()
+            {
+            }
+
+        public:
+            Core::JSON::ArrayType<Event> TraceEvents;
+            Core::JSON::String DisplayTimeUnit;
         };
 
         class Data : public Core::JSON::Container {
@@ -66,6 +283,9 @@ namespace Plugin {
                 Add(_T("index"), &Index);
                 Add(_T("label"), &Label);
                 Add(_T("command"), &Command);
+                Add(_T("duration"), &Duration);
+                Add(_T("criticalpath"), &CriticalPath);
+                Add(_T("steps"), &Steps);
             }
             Data(const string& name, const state actualState, const uint32_t index, const string& label)
                 : Core::JSON::Container()
@@ -75,6 +295,9 @@ namespace Plugin {
                 Add(_T("index"), &Index);
                 Add(_T("label"), &Label);
                 Add(_T("command"), &Command);
+                Add(_T("duration"), &Duration);
+                Add(_T("criticalpath"), &CriticalPath);
+                Add(_T("steps"), &Steps);
 
                 Sequencer = name;
                 State = actualState;
@@ -88,12 +311,18 @@ namespace Plugin {
                 , Index(copy.Index)
                 , Label(copy.Label)
                 , Command(copy.Command)
+                , Duration(copy.Duration)
+                , CriticalPath(copy.CriticalPath)
+                , Steps(copy.Steps)
             {
                 Add(_T("sequencer"), &Sequencer);
                 Add(_T("state"), &State);
                 Add(_T("index"), &Index);
                 Add(_T("label"), &Label);
                 Add(_T("Command"), &Command);
+                Add(_T("duration"), &Duration);
+                Add(_T("criticalpath"), &CriticalPath);
+                Add(_T("steps"), &Steps);
             }
             ~Data()
             {
@@ -106,6 +335,9 @@ namespace Plugin {
                 Index = RHS.Index;
                 Label = RHS.Label;
                 Command = RHS.Command;
+                Duration = RHS.Duration;
+                CriticalPath = RHS.CriticalPath;
+                Steps = RHS.Steps;
 
                 return (*this);
             }
@@ -116,6 +348,10 @@ namespace Plugin {
             Core::JSON::DecUInt32 Index;
             Core::JSON::String Label;
             Core::JSON::String Command;
+            // Of the last completed run.
+            Core::JSON::DecUInt32 Duration; // ms
+            Core::JSON::ArrayType<Core::JSON::String> CriticalPath; // labels of the steps that determined the duration
+            Core::JSON::ArrayType<Timing> Steps;
         };
 
     private:
@@ -127,8 +363,10 @@ namespace Plugin {
         public:
             Config()
                 : Core::JSON::Container()
+                , Depth(256)
             {
                 Add(_T("sequencers"), &Sequencers);
+                Add(_T("depth"), &Depth);
             }
             ~Config()
             {
@@ -136,6 +374,7 @@ namespace Plugin {
 
         public:
             Core::JSON::ArrayType<Core::JSON::String> Sequencers;
+            Core::JSON::DecUInt16 Depth; // steps of a run kept for its report and trace
         };
         class Administrator {
         private:
@@ -224,8 +463,113 @@ namespace Plugin {
             Sequencer(const Sequencer& copy) = delete;
             Sequencer& operator=(const Sequencer&) = delete;
 
+            // Runs a single step of a graph on the worker pool.
+            class Step : public Core::IDispatchType<void> {
+            private:
+                Step() = delete;
+                Step(const Step&) = delete;
+                Step& operator=(const Step&) = delete;
+
+            public:
+                Step(Sequencer* parent, const uint32_t index)
+                    : _parent(*parent)
+                    , _index(index)
+                {
+                    ASSERT(parent != nullptr);
+                }
+                virtual ~Step()
+                {
+                }
+
+            public:
+                virtual void Dispatch() override
+                {
+                    _parent.Run(_index);
+                }
+
+            private:
+                Sequencer& _parent;
+                const uint32_t _index;
+            };
+
+            class Observer : public PluginHost::IPlugin::INotification {
+            private:
+                Observer() = delete;
+                Observer(const Observer&) = delete;
+                Observer& operator=(const Observer&) = delete;
+
+            public:
+                Observer(Sequencer* parent)
+                    : _parent(*parent)
+                {
+                }
+                ~Observer()
+                {
+                }
+
+            public:
+                virtual void StateChange(PluginHost::IShell* plugin)
+                {
+                    _parent.StateChange(plugin);
+                }
+
+                BEGIN_INTERFACE_MAP(Observer)
+                INTERFACE_ENTRY(PluginHost::IPlugin::INotification)
+                END_INTERFACE_MAP
+
+            private:
+                Sequencer& _parent;
+            };
+
+            class Node {
+            public:
+                Node(const string& command)
+                    : Command(command)
+                    , Predecessors()
+                    , Successors()
+                    , Finished(0)
+                    , Observe(false)
+                    , Callsign()
+                    , Active(false)
+                    , Waiting(false)
+                    , Ready(0)
+                    , Start(0)
+                    , End(0)
+                    , Result()
+                {
+                }
+
+            public:
+                string Command;
+                std::vector<uint32_t> Predecessors;
+                std::vector<uint32_t> Successors;
+                uint32_t Finished; // predecessors that are done
+                // A PluginObserver step, in a graph it is done from the plugin state notifications.
+                bool Observe;
+                string Callsign;
+                bool Active;
+                bool Waiting;
+                uint64_t Ready; // ticks, 0 if it did not get to run
+                uint64_t Start;
+                uint64_t End;
+                string Result;
+            };
+
+            // A step as it was run, a step may run more than once in a sequence with jumps.
+            struct Record {
+                uint32_t Index;
+                uint64_t Ready;
+                uint64_t Start;
+                uint64_t End;
+                string Result;
+                uint32_t Next; // the step that ran after it, ~0 if none or in a graph
+            };
+
         public:
-            Sequencer(const string& name, Administrator* commandFactory, PluginHost::IShell* service)
+#ifdef __WINDOWS__
+#pragma warning(disable : 4355)
+#endif
+            Sequencer(const string& name, Administrator* commandFactory, PluginHost::IShell* service, const uint16_t depth)
                 : _commandFactory(commandFactory)
                 , _adminLock()
                 , _currentIndex(0)
@@ -233,21 +577,45 @@ namespace Plugin {
                 , _name(name)
                 , _service(service)
                 , _sequenceList(5)
+                , _nodes()
+                , _steps()
+                , _records()
+                , _depth(std::max(depth, static_cast<uint16_t>(1)))
+                , _oldest(0)
+                , _recorded(0)
+                , _labels()
+                , _graph(false)
+                , _running(0)
+                , _begin(0)
+                , _states()
+                , _observer(Core::Service<Observer>::Create<Observer>(this))
+                , _idle(true, true)
+                , _report()
+                , _trace()
             {
                 ASSERT(service != nullptr);
 
                 if (_service != nullptr) {
                     _service->AddRef();
+
+                    // Keep track of the plugin states, so a step waiting for one does not need a thread of its own.
+                    _service->Register(_observer);
                 }
             }
+#ifdef __WINDOWS__
+#pragma warning(default : 4355)
+#endif
             ~Sequencer()
             {
                 // Make sure we are not executing anything if we get destructed.
                 Abort();
 
                 if (_service != nullptr) {
+                    _service->Unregister(_observer);
                     _service->Release();
                 }
+
+                _observer->Release();
             }
 
         public:
@@ -295,6 +663,32 @@ namespace Plugin {
 
                 return (result);
             }
+            // The timings of the last completed run.
+            inline void Report(Commander::Data& data) const
+            {
+                _adminLock.Lock();
+
+                data.Duration = _report.Duration;
+                data.CriticalPath = _report.CriticalPath;
+                data.Steps = _report.Steps;
+
+                _adminLock.Unlock();
+            }
+            inline void Export(Commander::Timeline& trace) const
+            {
+                _adminLock.Lock();
+
+                for (const Commander::Timeline::Event& event : _trace) {
+                    trace.TraceEvents.Add(event);
+                }
+
+                _adminLock.Unlock();
+            }
+            // Waits till the running sequence, including the steps it started, is done.
+            inline bool Wait(const uint32_t waitTime) const
+            {
+                return (_idle.Lock(waitTime) == Core::ERROR_NONE);
+            }
             uint32_t Load(const Core::JSON::ArrayType<Command>& commandList)
             {
 
@@ -311,6 +705,13 @@ namespace Plugin {
                         _sequenceList.Clear(0, _sequenceList.Count());
                     }
 
+                    _nodes.clear();
+                    _steps.clear();
+                    _labels.clear();
+                    _graph = false;
+                    _state = Commander::IDLE;
+
+                    std::vector<const Core::JSON::ArrayType<Core::JSON::String>*> dependencies;
                     Core::JSON::ArrayType<Command>::ConstIterator index(commandList.Elements());
 
                     while (index.Next() == true) {
@@ -322,11 +723,25 @@ namespace Plugin {
                         Core::ProxyType<Exchange::ICommand> newCommand(_commandFactory->Create(label, className, parameters));
 
                         if (newCommand.IsValid() == true) {
+                            _labels[label].push_back(_sequenceList.Count());
                             _sequenceList.Add(newCommand);
+                            _nodes.emplace_back(className);
+                            dependencies.push_back(&(index.Current().After));
+
+                            if (className == _T("PluginObserver")) {
+                                Plugin::Command::PluginObserver::Config config;
+                                config.FromString(parameters);
+
+                                _nodes.back().Observe = true;
+                                _nodes.back().Callsign = config.Callsign.Value();
+                                _nodes.back().Active = config.Active.Value();
+                            }
+
+                            _graph = _graph || (index.Current().After.IsSet() == true);
                         }
                     }
 
-                    if (_sequenceList.Count() > 0) {
+                    if ((_sequenceList.Count() > 0) && ((_graph == false) || (Link(dependencies) == true))) {
                         _state = Commander::LOADED;
                         _currentIndex = 0;
                     }
@@ -334,7 +749,7 @@ namespace Plugin {
 
                 _adminLock.Unlock();
 
-                return (_sequenceList.Count());
+                return (_state == Commander::LOADED ? _sequenceList.Count() : 0);
             }
             uint32_t Execute()
             {
@@ -346,6 +761,8 @@ namespace Plugin {
                 if (_state == Commander::LOADED) {
                     result = Core::ERROR_NONE;
                     _state = Commander::RUNNING;
+                    _begin = Core::Time::Now().Ticks();
+                    _idle.ResetEvent();
                 }
 
                 _adminLock.Unlock();
@@ -361,7 +778,24 @@ namespace Plugin {
                 if (_state == Commander::RUNNING) {
                     result = Core::ERROR_NONE;
                     _state = Commander::ABORTING;
-                    _sequenceList[_currentIndex]->Abort();
+
+                    if (_graph == false) {
+                        _sequenceList[_currentIndex]->Abort();
+                    } else if (_running != 0) {
+                        for (uint32_t index = 0; index < _nodes.size(); index++) {
+                            Node& node(_nodes[index]);
+
+                            if (node.Waiting == true) {
+                                Close(index, EMPTY_STRING);
+                            } else if ((node.Start != 0) && (node.End == 0)) {
+                                _sequenceList[index]->Abort();
+                            }
+                        }
+
+                        if (_running == 0) {
+                            Finish();
+                        }
+                    }
                 }
 
                 _adminLock.Unlock();
@@ -369,61 +803,417 @@ namespace Plugin {
                 // Wait for the sequencer to reaach a safe positon..
                 return (result);
             }
+            // The job is off the worker pool. If it never got to run and no step of it is running, nothing
+            // else will finish the sequence.
+            void Revoked()
+            {
+                _adminLock.Lock();
+
+                if ((_state != Commander::IDLE) && (_state != Commander::LOADED) && ((_graph == false) || (_running == 0))) {
+                    Finish();
+                }
+
+                _adminLock.Unlock();
+            }
+            // Takes the steps of a graph off the worker pool, a running step is waited for. The steps refer to
+            // this sequencer, so this must be done before it is destroyed.
+            void RevokeSteps()
+            {
+                for (Core::ProxyType<Core::IDispatchType<void>>& step : _steps) {
+                    PluginHost::WorkerPool::Instance().Revoke(step);
+                }
+            }
 
         private:
             virtual void Dispatch()
             {
                 _adminLock.Lock();
 
-                // See if we still need to take some "next steps"
-                while ((_currentIndex < _sequenceList.Count()) && (_state == Commander::RUNNING)) {
+                _begin = Core::Time::Now().Ticks();
+                Forget();
 
-                    Core::ProxyType<Exchange::ICommand> step(_sequenceList[_currentIndex]);
+                if (_graph == true) {
+                    // The start holds a running count of its own, so nothing finishes the sequence before all steps
+                    // without predecessors got their chance.
+                    _running = 1;
+
+                    if (_state == Commander::RUNNING) {
+                        for (uint32_t index = 0; index < _nodes.size(); index++) {
+                            if ((_nodes[index].Predecessors.empty() == true) && (Ready(index) == true)) {
+                                Completed(index, EMPTY_STRING);
+                            }
+                        }
+                    }
 
-                    _adminLock.Unlock();
+                    if (--_running == 0) {
+                        Finish();
+                    }
+                } else {
+                    // See if we still need to take some "next steps"
+                    while ((_currentIndex < _sequenceList.Count()) && (_state == Commander::RUNNING)) {
 
-                    const string result = step->Execute(_service);
+                        Core::ProxyType<Exchange::ICommand> step(_sequenceList[_currentIndex]);
+                        const uint64_t start(Core::Time::Now().Ticks());
 
-                    _adminLock.Lock();
+                        _adminLock.Unlock();
 
-                    if (result.empty() == true) {
-                        _currentIndex++;
-                    } else {
-                        uint32_t index = _currentIndex + 1;
+                        const string result = step->Execute(_service);
 
-                        // See if we have a forward label, as mentioned from the execute
-                        while ((index < _sequenceList.Count()) && (_sequenceList[index]->Label() != result)) {
-                            index++;
+                        _adminLock.Lock();
+
+                        Record& record(Add({ _currentIndex, start, start, Core::Time::Now().Ticks(), result, static_cast<uint32_t>(~0) }));
+
+                        _currentIndex = (result.empty() == true ? _currentIndex + 1 : Jump(_currentIndex, result));
+
+                        if (_currentIndex < _sequenceList.Count()) {
+                            record.Next = _currentIndex;
                         }
+                    }
 
-                        if (index < _sequenceList.Count()) {
-                            // Seems like we found a next step, set it..
-                            _currentIndex = index;
+                    Finish();
+                }
+
+                _adminLock.Unlock();
+            }
+
+            // The step to continue with if the given step returned a label: the first step with that label after it,
+            // or else the last one before it (or itself). Without such a step, just progress.
+            uint32_t Jump(const uint32_t index, const string& label) const
+            {
+                uint32_t result = index + 1;
+                std::map<string, std::vector<uint32_t>>::const_iterator entry(_labels.find(label));
+
+                if (entry != _labels.end()) {
+                    std::vector<uint32_t>::const_iterator position(std::upper_bound(entry->second.begin(), entry->second.end(), index));
+
+                    result = (position != entry->second.end() ? *position : *(position - 1));
+                }
+
+                return (result);
+            }
+            // Resolves the labels in the "after" lists, fails on an unknown label or a cycle.
+            bool Link(const std::vector<const Core::JSON::ArrayType<Core::JSON::String>*>& dependencies)
+            {
+                bool result = true;
+
+                for (uint32_t index = 0; (index < _nodes.size()) && (result == true); index++) {
+                    Core::JSON::ArrayType<Core::JSON::String>::ConstIterator label(dependencies[index]->Elements());
+
+                    while ((label.Next() == true) && (result == true)) {
+                        std::map<string, std::vector<uint32_t>>::const_iterator predecessor(_labels.find(label.Current().Value()));
+
+                        if ((predecessor == _labels.end()) || (predecessor->second.front() == index)) {
+                            SYSLOG(Logging::ParsingError, (_T("Sequencer %s: step %d waits for an unknown step [%s]."), _name.c_str(), index, label.Current().Value().c_str()));
+                            result = false;
                         } else {
-                            // There are no steps before our current step, so no label found, just progress...
-                            _currentIndex++;
+                            _nodes[index].Predecessors.push_back(predecessor->second.front());
+                            _nodes[predecessor->second.front()].Successors.push_back(index);
+                        }
+                    }
+                }
 
-                            // But let's check if there is a step before us (or we are ourselves :-), we might need to jump to..
-                            index = _currentIndex;
+                if (result == true) {
+                    // Every step must be reachable, otherwise there is a cycle.
+                    std::vector<uint32_t> pending(_nodes.size());
+                    std::list<uint32_t> ready;
+                    uint32_t reached = 0;
 
-                            // Check if we have a step with the given label prior to our current step..
-                            while ((index > 0) && (_sequenceList[index - 1]->Label() != result)) {
-                                index--;
+                    for (uint32_t index = 0; index < _nodes.size(); index++) {
+                        pending[index] = static_cast<uint32_t>(_nodes[index].Predecessors.size());
+                        if (pending[index] == 0) {
+                            ready.push_back(index);
+                        }
+                    }
+                    while (ready.empty() == false) {
+                        for (const uint32_t successor : _nodes[ready.front()].Successors) {
+                            if (--pending[successor] == 0) {
+                                ready.push_back(successor);
                             }
+                        }
+                        ready.pop_front();
+                        reached++;
+                    }
+                    if (reached != _nodes.size()) {
+                        SYSLOG(Logging::ParsingError, (_T("Sequencer %s: the steps wait for each other."), _name.c_str()));
+                        result = false;
+                    }
+                }
 
-                            if (index > 0) {
-                                _currentIndex = (index - 1);
-                            }
+                if (result == true) {
+                    for (uint32_t index = 0; index < _nodes.size(); index++) {
+                        _steps.push_back(Core::ProxyType<Core::IDispatchType<void>>(Core::ProxyType<Step>::Create(this, index)));
+                    }
+                }
+
+                return (result);
+            }
+            // A step of the graph may run, returns true if it is done already (the plugin is in the awaited state).
+            // Must be called with the lock taken.
+            bool Ready(const uint32_t index)
+            {
+                bool result = false;
+                Node& node(_nodes[index]);
+
+                node.Ready = Core::Time::Now().Ticks();
+                _running++;
+
+                if (node.Observe == true) {
+                    std::map<string, PluginHost::IShell::state>::const_iterator known(_states.find(node.Callsign));
+
+                    node.Start = node.Ready;
+
+                    if ((known != _states.end()) && (Reached(node, known->second) == true)) {
+                        node.End = node.Ready;
+                        _running--;
+                        result = true;
+                    } else {
+                        node.Waiting = true;
+                    }
+                } else {
+                    PluginHost::WorkerPool::Instance().Submit(_steps[index]);
+                }
+
+                return (result);
+            }
+            // Must be called with the lock taken.
+            void Close(const uint32_t index, const string& result)
+            {
+                Node& node(_nodes[index]);
+
+                node.Waiting = false;
+                node.End = Core::Time::Now().Ticks();
+                node.Result = result;
+                _running--;
+            }
+            // A step of the graph is done (and closed), start the steps that were waiting for it.
+            // Must be called with the lock taken.
+            void Completed(const uint32_t index, const string& result)
+            {
+                std::list<uint32_t> done({ index });
+
+                _nodes[index].Result = result;
+
+                while ((done.empty() == false) && (_state == Commander::RUNNING)) {
+                    for (const uint32_t successor : _nodes[done.front()].Successors) {
+                        Node& next(_nodes[successor]);
+
+                        if ((++next.Finished == next.Predecessors.size()) && (Ready(successor) == true)) {
+                            done.push_back(successor);
+                        }
+                    }
+                    done.pop_front();
+                }
+
+                if (_running == 0) {
+                    Finish();
+                }
+            }
+            void Run(const uint32_t index)
+            {
+                _adminLock.Lock();
+
+                Core::ProxyType<Exchange::ICommand> step(_sequenceList[index]);
+                const bool execute(_state == Commander::RUNNING);
+
+                _nodes[index].Start = Core::Time::Now().Ticks();
+                _currentIndex = index;
+
+                _adminLock.Unlock();
+
+                const string result(execute == true ? step->Execute(_service) : EMPTY_STRING);
+
+                _adminLock.Lock();
+
+                Close(index, result);
+                Completed(index, result);
+
+                _adminLock.Unlock();
+            }
+            void StateChange(PluginHost::IShell* plugin)
+            {
+                const string callsign(plugin->Callsign());
+                const PluginHost::IShell::state current(plugin->State());
+
+                _adminLock.Lock();
+
+                _states[callsign] = current;
+
+                if ((_graph == true) && (_state == Commander::RUNNING)) {
+                    for (uint32_t index = 0; index < _nodes.size(); index++) {
+                        Node& node(_nodes[index]);
+
+                        if ((node.Waiting == true) && (node.Callsign == callsign) && (Reached(node, current) == true)) {
+                            Close(index, EMPTY_STRING);
+                            _running++; // Completed() may finish the sequence, not before all waiting steps are seen.
+                            Completed(index, EMPTY_STRING);
+                            _running--;
                         }
                     }
+
+                    if ((_running == 0) && (_state != Commander::IDLE)) {
+                        Finish();
+                    }
+                }
+
+                _adminLock.Unlock();
+            }
+            static bool Reached(const Node& node, const PluginHost::IShell::state current)
+            {
+                return (node.Active == true ? (current == PluginHost::IShell::ACTIVATED) : (current == PluginHost::IShell::DEACTIVATED));
+            }
+            // Only the last _depth steps of a run are kept, a sequence that loops would otherwise grow them without
+            // bounds. Once full, the oldest record is overwritten. Must be called with the lock taken.
+            Record& Add(const Record& record)
+            {
+                Record* result;
+
+                if (_records.size() < _depth) {
+                    _records.push_back(record);
+                    result = &(_records.back());
+                } else {
+                    result = &(_records[_oldest]);
+                    *result = record;
+                    _oldest = (_oldest + 1) % _depth;
                 }
 
+                _recorded++;
+
+                return (*result);
+            }
+            // The kept records in the order they were added, 0 is the oldest.
+            inline const Record& Recorded(const uint32_t index) const
+            {
+                return (_records[(_oldest + index) % _records.size()]);
+            }
+            void Forget()
+            {
+                _records.clear();
+                _oldest = 0;
+                _recorded = 0;
+            }
+            // The sequence is done, keep the timings and get ready for the next one.
+            // Must be called with the lock taken.
+            void Finish()
+            {
                 ASSERT((_state == Commander::RUNNING) || (_state == Commander::ABORTING));
+
+                std::vector<uint32_t> path;
+
+                if (_graph == true) {
+                    uint32_t last = static_cast<uint32_t>(~0);
+
+                    for (uint32_t index = 0; index < _nodes.size(); index++) {
+                        if (_nodes[index].Ready != 0) {
+                            Add({ index, _nodes[index].Ready, _nodes[index].Start, _nodes[index].End, _nodes[index].Result, static_cast<uint32_t>(~0) });
+
+                            if ((last == static_cast<uint32_t>(~0)) || (_nodes[index].End > _nodes[last].End)) {
+                                last = index;
+                            }
+                        }
+                    }
+
+                    // Walk back from the step that ended last, along the predecessors that held it up the longest.
+                    while (last != static_cast<uint32_t>(~0)) {
+                        const std::vector<uint32_t>& predecessors(_nodes[last].Predecessors);
+
+                        path.insert(path.begin(), last);
+                        last = static_cast<uint32_t>(~0);
+
+                        for (const uint32_t predecessor : predecessors) {
+                            if ((last == static_cast<uint32_t>(~0)) || (_nodes[predecessor].End > _nodes[last].End)) {
+                                last = predecessor;
+                            }
+                        }
+                    }
+                } else {
+                    for (uint32_t index = 0; index < _records.size(); index++) {
+                        path.push_back(Recorded(index).Index);
+                    }
+                }
+
+                const uint64_t end(Core::Time::Now().Ticks());
+
+                _report.Duration = static_cast<uint32_t>((end - _begin) / 1000);
+                _report.CriticalPath.Clear();
+                _report.Steps.Clear();
+
+                for (const uint32_t index : path) {
+                    _report.CriticalPath.Add(Core::JSON::String(_sequenceList[index]->Label()));
+                }
+
+                // Steps that overlap in time (in a graph) get a lane of their own in the trace.
+                std::vector<uint64_t> lanes;
+
+                _trace.clear();
+
+                for (uint32_t index = 0; index < _records.size(); index++) {
+                    const Record& record(Recorded(index));
+                    Commander::Timing timing;
+                    // A PluginObserver step does nothing but waiting.
+                    const uint64_t waited((record.Start - record.Ready) + (_nodes[record.Index].Observe == true ? (record.End - record.Start) : 0));
+                    const string next(record.Next != static_cast<uint32_t>(~0) ? _sequenceList[record.Next]->Label() : string());
+
+                    timing.Label = _sequenceList[record.Index]->Label();
+                    timing.Command = _nodes[record.Index].Command;
+                    timing.Start = static_cast<uint32_t>((record.Start - _begin) / 1000);
+                    timing.Queued = static_cast<uint32_t>((record.Start - record.Ready) / 1000);
+                    timing.Duration = static_cast<uint32_t>((record.End - record.Start) / 1000);
+                    timing.Wait = static_cast<uint32_t>(waited / 1000);
+                    timing.Work = static_cast<uint32_t>(((record.End - record.Ready) - waited) / 1000);
+                    timing.Result = record.Result;
+                    if (record.Next != static_cast<uint32_t>(~0)) {
+                        timing.Next = next;
+                    }
+
+                    TRACE(Trace::Information, (_T("Sequencer %s: step [%s] %s started at %d ms, took %d ms."), _name.c_str(), timing.Label.Value().c_str(), timing.Command.Value().c_str(), timing.Start.Value(), timing.Duration.Value()));
+
+                    _report.Steps.Add(timing);
+
+                    uint32_t lane = 0;
+                    while ((lane < lanes.size()) && (lanes[lane] > record.Ready)) {
+                        lane++;
+                    }
+                    if (lane == lanes.size()) {
+                        lanes.push_back(0);
+                    }
+                    lanes[lane] = record.End;
+
+                    if (record.Start != record.Ready) {
+                        _trace.emplace_back();
+                        _trace.back().Name = timing.Label.Value();
+                        _trace.back().Category = _T("queued");
+                        _trace.back().Phase = _T("X");
+                        _trace.back().Timestamp = record.Ready - _begin;
+                        _trace.back().Duration = record.Start - record.Ready;
+                        _trace.back().Process = 1;
+                        _trace.back().Thread = lane + 1;
+                    }
+
+                    _trace.emplace_back();
+                    _trace.back().Name = timing.Label.Value();
+                    _trace.back().Category = timing.Command.Value();
+                    _trace.back().Phase = _T("X");
+                    _trace.back().Timestamp = record.Start - _begin;
+                    _trace.back().Duration = record.End - record.Start;
+                    _trace.back().Process = 1;
+                    _trace.back().Thread = lane + 1;
+                    _trace.back().Args.Result = record.Result;
+                    if (record.Next != static_cast<uint32_t>(~0)) {
+                        _trace.back().Args.Next = next;
+                    }
+                }
+
+                SYSLOG(Logging::Notification, (_T("Sequencer %s %s: %d steps in %d ms, %d on the critical path."), _name.c_str(), (_state == Commander::ABORTING ? _T("aborted") : _T("completed")), _recorded, _report.Duration.Value(), static_cast<uint32_t>(path.size())));
+
                 _state = IDLE;
 
                 _sequenceList.Clear(0, _sequenceList.Count());
+                _nodes.clear();
+                _steps.clear();
+                Forget();
+                _labels.clear();
 
-                _adminLock.Unlock();
+                _idle.SetEvent();
             }
 
         private:
@@ -434,6 +1224,21 @@ namespace Plugin {
             string _name;
             PluginHost::IShell* _service;
             Core::ProxyList<Exchange::ICommand> _sequenceList;
+            std::vector<Node> _nodes;
+            std::vector<Core::ProxyType<Core::IDispatchType<void>>> _steps;
+            std::vector<Record> _records; // a ring of at most _depth records, starting at _oldest
+            const uint16_t _depth;
+            uint32_t _oldest;
+            uint32_t _recorded; // steps run, also the ones no longer kept
+            std::map<string, std::vector<uint32_t>> _labels; // the steps with a label, in order
+            bool _graph;
+            uint32_t _running; // steps of the graph that are submitted or waiting
+            uint64_t _begin;
+            std::map<string, PluginHost::IShell::state> _states;
+            Observer* _observer;
+            mutable Core::Event _idle;
+            Commander::Data _report;
+            std::list<Commander::Timeline::Event> _trace;
         };
 
         Commander(const Commander&) = delete;
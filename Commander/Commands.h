@@ -1,3 +1,5 @@
+#pragma once
+
 #include "Module.h"
 
 namespace WPEFramework {
@@ -133,6 +135,8 @@ namespace Plugin {
                 PluginObserver& _parent;
             };
 
+        public:
+            // Also used by the Sequencer, to wait for the same condition without blocking a thread.
             class Config : public Core::JSON::Container {
             private:
                 Config(const Config&) = delete;
@@ -9,12 +9,22 @@ namespace Plugin {
     static Core::ProxyPoolType<Web::JSONBodyType<DHCPServer::Data>> jsonDataFactory(1);
     static Core::ProxyPoolType<Web::JSONBodyType<DHCPServer::Data::Server>> jsonServerDataFactory(1);
 
+    // A journal is compacted once it grew to this many times its size after the last compaction.
+    static constexpr uint64_t CompactFactor = 2;
+
 #ifdef __WINDOWS__
 #pragma warning(disable : 4355)
 #endif
     DHCPServer::DHCPServer()
         : _skipURL(0)
         , _servers()
+        , _journals()
+        , _persistentPath()
+        , _adminLock()
+        , _flushTimer(Core::Thread::DefaultStackSize(), _T("DHCPLeaseFlush"))
+        , _flushPending(false)
+        , _flushInterval(0)
+        , _compactSize(0)
     {
         RegisterAll();
     }
@@ -39,6 +49,8 @@ namespace Plugin {
         Core::JSON::ArrayType<Config::Server>::Iterator index(config.Servers.Elements());
 
         _persistentPath = service->PersistentPath();
+        _flushInterval = config.FlushInterval.Value();
+        _compactSize = static_cast<uint64_t>(config.CompactSize.Value()) * 1024;
 
         Core::Directory directory(_persistentPath.c_str());
         if (directory.CreatePath() == false) {
@@ -78,6 +90,26 @@ namespace Plugin {
             index++;
         }
 
+        _flushTimer.Revoke(FlushHandler(*this));
+
+        _adminLock.Lock();
+        _flushPending = false;
+        _adminLock.Unlock();
+
+        // Leave a compact journal behind, so the next start has a single record per lease to read.
+        index = _servers.begin();
+
+        while (index != _servers.end()) {
+            std::map<const string, LeaseJournal>::iterator journal(_journals.find(index->first));
+
+            if (journal != _journals.end()) {
+                CompactLeases(index->second, journal->second);
+                journal->second.Close();
+            }
+            index++;
+        }
+
+        _journals.clear();
         _servers.clear();
     }
 
@@ -167,63 +199,127 @@ namespace Plugin {
         return result;
     }
 
-    void DHCPServer::SaveLeases(const string& interface, const DHCPServerImplementation& dhcpServer) const
+    void DHCPServer::LoadLeases(const string& interface, DHCPServerImplementation& dhcpServer)
     {
 
         if (_persistentPath.empty() == false) {
-            Core::JSON::ArrayType<Data::Server::Lease> leasesList;
-
-            // Saving to file might take a while, and lifetime of DHCPServerImplementation::Iterator
-            // object must be deterministic and short (<10ms), so we scope it 
-            {
-                DHCPServerImplementation::Iterator leases = dhcpServer.Leases();
-                while(leases.Next() && (leases.IsValid() == true)) {
-                    leasesList.Add().Set(leases.Current());
-                }        
+            auto journal = _journals.emplace(std::piecewise_construct, std::forward_as_tuple(interface), std::forward_as_tuple());
+
+            if ((journal.second == true) && (journal.first->second.Open(_persistentPath + interface + ".journal") == true)) {
+
+                if (journal.first->second.Size() != 0) {
+                    // Only the last record of an address counts.
+                    std::map<uint32_t, DHCPServerImplementation::Lease> leases;
+
+                    uint32_t records = journal.first->second.Replay([&leases](const DHCPServerImplementation::Lease& lease) {
+                        leases.erase(lease.Raw());
+                        leases.emplace(lease.Raw(), lease);
+                    });
+
+                    for (const auto& lease : leases) {
+                        dhcpServer.AddLease(lease.second);
+                    }
+
+                    TRACE(Trace::Information, (_T("Loaded %d leases from %d journal records on interface %s"), static_cast<uint32_t>(leases.size()), records, interface.c_str()));
+                } else {
+                    // No journal yet, take over the leases stored by earlier versions.
+                    Core::File leasesFile(_persistentPath + interface + ".json");
+
+                    if (leasesFile.Open(true) == true) {
+                        Core::JSON::ArrayType<Data::Server::Lease> leases;
+
+                        Core::OptionalType<Core::JSON::Error> error;
+                        leases.IElement::FromFile(leasesFile, error);
+                        if (error.IsSet() == true) {
+                            SYSLOG(Logging::ParsingError, (_T("Parsing failed with %s"), ErrorDisplayMessage(error.Value()).c_str()));
+                        }
+                        leasesFile.Close();
+
+                        auto iterator = leases.Elements();
+                        while ((iterator.Next() == true) && (iterator.IsValid() == true)) {
+                            dhcpServer.AddLease(iterator.Current().Get());
+                        }
+
+                        CompactLeases(dhcpServer, journal.first->second);
+                    }
+                }
             }
+        }
+    }
 
-            Core::File leasesFile(_persistentPath + interface + ".json");
+    // Replaces the journal by one record per lease. The leases are encoded while they are locked, so the journal
+    // size taken at that moment marks exactly which records the snapshot covers, the disk is written without it.
+    void DHCPServer::CompactLeases(const DHCPServerImplementation& dhcpServer, LeaseJournal& journal)
+    {
+        std::vector<uint8_t> snapshot;
+        uint64_t offset;
 
-            if (leasesFile.Create() == true) {
-                leasesList.IElement::ToFile(leasesFile);
-                leasesFile.Close();
-            } else {
-                TRACE_L1("Could not save leases in pemranent storage area.\n");
+        {
+            DHCPServerImplementation::Iterator leases = dhcpServer.Leases();
+
+            offset = journal.Size();
+
+            while ((leases.Next() == true) && (leases.IsValid() == true)) {
+                LeaseJournal::Encode(snapshot, leases.Current());
             }
         }
+
+        if (journal.Compact(snapshot, offset) == false) {
+            TRACE_L1("Could not save leases in permanent storage area.\n");
+        }
     }
 
-    void DHCPServer::LoadLeases(const string& interface, DHCPServerImplementation& dhcpServer) 
+    uint64_t DHCPServer::Timed(const uint64_t /* scheduledTime */)
     {
+        _adminLock.Lock();
+        _flushPending = false;
+        _adminLock.Unlock();
 
-        if (_persistentPath.empty() == false) {
-            Core::File leasesFile(_persistentPath + interface + ".json");
+        std::map<const string, LeaseJournal>::iterator journal(_journals.begin());
 
-            if (leasesFile.Open(true) == true) {
-                Core::JSON::ArrayType<Data::Server::Lease> leases;
+        while (journal != _journals.end()) {
+            journal->second.Sync();
 
-                Core::OptionalType<Core::JSON::Error> error;
-                leases.IElement::FromFile(leasesFile, error);
-                if (error.IsSet() == true) {
-                    SYSLOG(Logging::ParsingError, (_T("Parsing failed with %s"), ErrorDisplayMessage(error.Value()).c_str()));
-                }
-                leasesFile.Close();
+            // Relative to what the leases take after a compaction, a large lease set would otherwise rewrite
+            // the whole journal on every flush.
+            if ((_compactSize != 0) && (journal->second.Size() >= std::max(_compactSize, CompactFactor * journal->second.Compacted()))) {
+                std::map<const string, DHCPServerImplementation>::const_iterator server(_servers.find(journal->first));
 
-                auto iterator = leases.Elements();
-                while ((iterator.Next() == true) && (iterator.IsValid() == true)) {
-                    dhcpServer.AddLease(iterator.Current().Get());
+                if (server != _servers.end()) {
+                    CompactLeases(server->second, journal->second);
                 }
-            } 
+            }
+            journal++;
         }
+
+        // Rescheduled by the next lease change.
+        return (0);
     }
 
+    // Called with the leases locked, so the records of an interface are appended in the order the leases changed.
     void DHCPServer::OnNewIPRequest(const string& interface, const DHCPServerImplementation::Lease* lease) 
     {
-        TRACE(Trace::Information, ("DHCP server granted address %s on interface %s", lease->Address().HostAddress().c_str(), interface.c_str()));
+        if (lease->IsExpired() == true) {
+            TRACE(Trace::Information, ("DHCP server released address %s on interface %s", lease->Address().HostAddress().c_str(), interface.c_str()));
+        } else {
+            TRACE(Trace::Information, ("DHCP server granted address %s on interface %s", lease->Address().HostAddress().c_str(), interface.c_str()));
+        }
+
+        auto journal = _journals.find(interface);
+
+        if ((journal != _journals.end()) && (journal->second.Append(*lease) == true)) {
+            // On disk within one flush interval, together with all other changes in that interval.
+            _adminLock.Lock();
+
+            if (_flushPending == false) {
+                Core::Time nextFlush(Core::Time::Now());
+
+                nextFlush.Add(_flushInterval);
+                _flushPending = true;
+                _flushTimer.Schedule(nextFlush.Ticks(), FlushHandler(*this));
+            }
 
-        auto dhcpServer = _servers.find(interface);
-        if (dhcpServer != _servers.end()) {
-            SaveLeases(interface, dhcpServer->second);
+            _adminLock.Unlock();
         }
     }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DHCPServerImplementation.h"
+#include "LeaseJournal.h"
 #include <interfaces/json/JsonData_DHCPServer.h>
 #include "Module.h"
 
@@ -210,10 +211,14 @@ namespace Plugin {
                 , Name()
                 , DNS()
                 , Servers()
+                , FlushInterval(1000)
+                , CompactSize(256)
             {
                 Add(_T("name"), &Name);
                 Add(_T("dns"), &DNS);
                 Add(_T("servers"), &Servers);
+                Add(_T("flushinterval"), &FlushInterval);
+                Add(_T("compactsize"), &CompactSize);
             }
             ~Config()
             {
@@ -223,6 +228,48 @@ namespace Plugin {
             Core::JSON::String Name;
             Core::JSON::String DNS;
             Core::JSON::ArrayType<Server> Servers;
+            Core::JSON::DecUInt32 FlushInterval; // ms
+            Core::JSON::DecUInt32 CompactSize; // KB
+        };
+
+        class FlushHandler {
+        public:
+            FlushHandler()
+                : _parent(nullptr)
+            {
+            }
+            FlushHandler(DHCPServer& parent)
+                : _parent(&parent)
+            {
+            }
+            FlushHandler(const FlushHandler& copy)
+                : _parent(copy._parent)
+            {
+            }
+            ~FlushHandler()
+            {
+            }
+
+            FlushHandler& operator=(const FlushHandler& RHS)
+            {
+                _parent = RHS._parent;
+                return (*this);
+            }
+            bool operator==(const FlushHandler& RHS) const
+            {
+                return (_parent == RHS._parent);
+            }
+
+        public:
+            uint64_t Timed(const uint64_t scheduledTime)
+            {
+                ASSERT(_parent != nullptr);
+
+                return (_parent->Timed(scheduledTime));
+            }
+
+        private:
+            DHCPServer* _parent;
         };
 
     private:
@@ -261,15 +308,22 @@ namespace Plugin {
 
         // Lease permanent storage
         // -------------------------------------------------------------------------------------------------------
-        void SaveLeases(const string& interface, const DHCPServerImplementation& dhcpServer) const;
         void LoadLeases(const string& interface, DHCPServerImplementation& dhcpServer);
+        void CompactLeases(const DHCPServerImplementation& dhcpServer, LeaseJournal& journal);
+        uint64_t Timed(const uint64_t scheduledTime);
 
         // Callbacks
         void OnNewIPRequest(const string& interface, const DHCPServerImplementation::Lease* lease);
     private:
         uint16_t _skipURL;
         std::map<const string, DHCPServerImplementation> _servers;
+        std::map<const string, LeaseJournal> _journals;
         std::string _persistentPath;
+        Core::CriticalSection _adminLock;
+        Core::TimerType<FlushHandler> _flushTimer;
+        bool _flushPending;
+        uint32_t _flushInterval;
+        uint64_t _compactSize;
     };
 
 } // namespace Plugin
@@ -27,31 +27,38 @@ namespace Plugin {
             if ((result == Core::ERROR_NONE) && (SocketDatagram::Broadcast(true) == false)) {
                 result = Core::ERROR_BAD_REQUEST;
             } else {
-                _server = static_cast<const Core::NodeId::SocketInfo&>(selectedNode).IPV4Socket.sin_addr.s_addr;
-
-                // Now lets define the under and upper marker of the dhcp server address pool.
-                uint32_t mask = (0xFFFFFFFF >> selectedNode.Mask());
-                uint32_t address = ntohl(_server);
-
-                _minAddress = ((address & (~mask)) + (_poolStart & mask));
-                _maxAddress = ((address & (~mask)) + ((_poolStart + _poolSize) & mask));
-                _nextFreeIp = _minAddress;
-
-                if (_router != static_cast<uint32_t>(~0)) {
-                    if (_router == 0) {
-                        _router = address;
-                    } else {
-                        _router = ((address & (~mask)) + (_router & mask));
-                    }
-                }
-                if (_dns == static_cast<uint32_t>(~0)) {
-                    _dns = address;
-                }
+                Configure(selectedNode);
             }
         }
 
         return (result);
     }
+    void DHCPServerImplementation::Configure(const Core::IPNode& node)
+    {
+        _server = static_cast<const Core::NodeId::SocketInfo&>(node).IPV4Socket.sin_addr.s_addr;
+
+        // Now lets define the under and upper marker of the dhcp server address pool.
+        uint32_t mask = (0xFFFFFFFF >> node.Mask());
+        uint32_t address = ntohl(_server);
+
+        _minAddress = ((address & (~mask)) + (_poolStart & mask));
+        _maxAddress = ((address & (~mask)) + ((_poolStart + _poolSize) & mask));
+
+        _leases.Lock();
+        _leases.Pool(_minAddress, _maxAddress);
+        _leases.Unlock();
+
+        if (_router != static_cast<uint32_t>(~0)) {
+            if (_router == 0) {
+                _router = address;
+            } else {
+                _router = ((address & (~mask)) + (_router & mask));
+            }
+        }
+        if (_dns == static_cast<uint32_t>(~0)) {
+            _dns = address;
+        }
+    }
     uint32_t DHCPServerImplementation::Close()
     {
         return (SocketDatagram::Close(Core::infinite));
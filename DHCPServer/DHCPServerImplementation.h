@@ -2,6 +2,8 @@
 #define __DHCPSERVERIMPLEMENTATION_H__
 
 #include "Module.h"
+#include <queue>
+#include <unordered_map>
 
 namespace WPEFramework {
 
@@ -421,14 +423,43 @@ namespace Plugin {
             uint32_t _preferred;
             classifications _classification;
         };
+        // All leases, indexed by address and by client identifier. The addresses of the pool are tracked in a
+        // bitmap, so a free one is found without looking at the leases, and a min-heap on expiration hands out
+        // the lease that expired first once the pool is exhausted.
         class LeaseList : public std::list<Lease> {
         private:
             LeaseList(const LeaseList&) = delete;
             LeaseList& operator=(const LeaseList&) = delete;
 
+            struct IdentifierHash {
+                size_t operator()(const Identifier& id) const
+                {
+                    const uint8_t* data = id.Id();
+                    size_t hash = 2166136261u;
+
+                    for (uint8_t index = 0; index < id.Length(); index++) {
+                        hash = (hash ^ data[index]) * 16777619u;
+                    }
+
+                    return (hash);
+                }
+            };
+
+            // Expiration time and address of a lease. An entry is outdated if the lease got another expiration
+            // time since, it is dropped when it reaches the top.
+            typedef std::pair<uint64_t, uint32_t> Expiry;
+            typedef std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry>> ExpiryHeap;
+
         public:
             LeaseList()
                 : std::list<Lease>()
+                , _addresses()
+                , _ids()
+                , _expirations()
+                , _pool()
+                , _poolBegin(0)
+                , _poolSize(0)
+                , _poolHint(0)
             {
             }
             ~LeaseList()
@@ -453,8 +484,151 @@ namespace Plugin {
                 _adminLock.Unlock();
             }
 
+            // NOTE:
+            // All methods below need to be executed within the lock.
+            inline Lease* Find(const uint32_t address)
+            {
+                std::unordered_map<uint32_t, Lease*>::iterator index(_addresses.find(address));
+
+                return (index != _addresses.end() ? index->second : nullptr);
+            }
+            inline Lease* Find(const Identifier& id)
+            {
+                std::unordered_map<Identifier, Lease*, IdentifierHash>::iterator index(_ids.find(id));
+
+                return (index != _ids.end() ? index->second : nullptr);
+            }
+            Lease* Create(const Identifier& id, const uint32_t address, const uint64_t expiration)
+            {
+                push_back(Lease(id, address, expiration));
+
+                Lease* result = &(back());
+
+                // Like a search through the list would, the first lease for an address or identifier wins.
+                _addresses.emplace(address, result);
+                _ids.emplace(id, result);
+                _expirations.push(Expiry(expiration, address));
+                Mark(address);
+
+                return (result);
+            }
+            void Assign(Lease* lease, const Identifier& id)
+            {
+                std::unordered_map<Identifier, Lease*, IdentifierHash>::iterator index(_ids.find(lease->Id()));
+
+                if ((index != _ids.end()) && (index->second == lease)) {
+                    _ids.erase(index);
+                }
+
+                lease->Update(id);
+                _ids.emplace(id, lease);
+            }
+            void Expiration(Lease* lease, const uint64_t expiration)
+            {
+                lease->Expiration(expiration);
+                _expirations.push(Expiry(expiration, lease->Raw()));
+
+                // Every change leaves an outdated entry behind, do not let them pile up.
+                if (_expirations.size() > ((2 * size()) + 64)) {
+                    Rebuild();
+                }
+            }
+            // The lease within the pool that expired first, if it expired before the given time. Leases outside
+            // the pool (made for an earlier pool) are never handed out again.
+            Lease* Expired(const uint64_t time)
+            {
+                Lease* result = nullptr;
+
+                while ((result == nullptr) && (_expirations.empty() == false) && (_expirations.top().first < time)) {
+                    Lease* lease = Find(_expirations.top().second);
+
+                    if ((lease != nullptr) && (lease->Expiration() == _expirations.top().first) && (InPool(lease->Raw()) == true)) {
+                        result = lease;
+                    } else {
+                        _expirations.pop();
+                    }
+                }
+
+                return (result);
+            }
+            // The pool of addresses handed out, begin and end included.
+            void Pool(const uint32_t begin, const uint32_t end)
+            {
+                _poolBegin = begin;
+                _poolSize = (end >= begin ? (end - begin + 1) : 0);
+                _poolHint = 0;
+                _pool.assign((_poolSize + 63) / 64, 0);
+
+                if ((_poolSize % 64) != 0) {
+                    // The bits beyond the end of the pool are never free.
+                    _pool.back() = ~((static_cast<uint64_t>(1) << (_poolSize % 64)) - 1);
+                }
+
+                for (const Lease& entry : *this) {
+                    Mark(entry.Raw());
+                }
+
+                // Expired() drops what is outside the pool, start over with all leases for the new one.
+                Rebuild();
+            }
+            // An address of the pool no lease was ever created for.
+            bool Free(uint32_t& address)
+            {
+                // Leases are never removed, so all words before the hint stay full.
+                while ((_poolHint < _pool.size()) && (_pool[_poolHint] == static_cast<uint64_t>(~0))) {
+                    _poolHint++;
+                }
+
+                if (_poolHint < _pool.size()) {
+                    const uint64_t word = _pool[_poolHint];
+                    uint8_t bit = 0;
+
+                    while ((word & (static_cast<uint64_t>(1) << bit)) != 0) {
+                        bit++;
+                    }
+
+                    address = _poolBegin + (_poolHint * 64) + bit;
+                }
+
+                return (_poolHint < _pool.size());
+            }
+
+        private:
+            inline bool InPool(const uint32_t address) const
+            {
+                return ((address >= _poolBegin) && ((address - _poolBegin) < _poolSize));
+            }
+            inline void Mark(const uint32_t address)
+            {
+                if (InPool(address) == true) {
+                    const uint32_t offset = address - _poolBegin;
+                    _pool[offset / 64] |= (static_cast<uint64_t>(1) << (offset % 64));
+                }
+            }
+            // One entry per lease, with its current expiration time.
+            void Rebuild()
+            {
+                std::vector<Expiry> entries;
+                entries.reserve(size());
+
+                for (const Lease& entry : *this) {
+                    if (Find(entry.Raw()) == &entry) {
+                        entries.push_back(Expiry(entry.Expiration(), entry.Raw()));
+                    }
+                }
+
+                _expirations = ExpiryHeap(std::greater<Expiry>(), std::move(entries));
+            }
+
         private:
             mutable Core::CriticalSection _adminLock;
+            std::unordered_map<uint32_t, Lease*> _addresses;
+            std::unordered_map<Identifier, Lease*, IdentifierHash> _ids;
+            ExpiryHeap _expirations;
+            std::vector<uint64_t> _pool;
+            uint32_t _poolBegin;
+            uint32_t _poolSize;
+            uint32_t _poolHint;
         };
 
         class Response {
@@ -659,7 +833,6 @@ namespace Plugin {
             , _poolSize(poolSize)
             , _minAddress(0)
             , _maxAddress(0)
-            , _nextFreeIp(0)
             , _server(0)
             , _router(router)
             , _dns(~0)
@@ -708,7 +881,7 @@ namespace Plugin {
         inline void AddLease(const Lease& lease)
         {
             _leases.Lock();
-            _leases.push_back(lease);
+            _leases.Create(lease.Id(), lease.Raw(), lease.Expiration());
             _leases.Unlock();
         }
 
@@ -725,47 +898,23 @@ namespace Plugin {
         uint32_t Close();
 
     private:
-        // NOTE:
-        // The next three methods, Find,Find and Create need to be executed within the lock.
-        inline Lease* Find(const uint32_t address)
-        {
-            LeaseList::iterator index(_leases.begin());
-            while ((index != _leases.end()) && (index->Raw() != address)) {
-                index++;
-            }
-
-            return (index != _leases.end() ? &(*index) : nullptr);
-        }
-        inline Lease* Find(const Identifier& id)
-        {
-            LeaseList::iterator index(_leases.begin());
-            while ((index != _leases.end()) && (index->Id() != id)) {
-                index++;
-            }
-
-            return (index != _leases.end() ? &(*index) : nullptr);
-        }
-        inline Lease* Create(const Identifier& id, const uint32_t address)
-        {
-            _leases.push_back(Lease(id, address));
-            return &(_leases.back());
-        }
         void Discover(Response& response, const ScratchPad& scratchPad)
         {
             _leases.Lock();
-            Lease* result = Find(scratchPad.Id());
+            Lease* result = _leases.Find(scratchPad.Id());
+            const uint64_t now = Core::Time::Now().Ticks();
 
             // RFC 2131 section 4.3.1
             if ((result == nullptr) && (scratchPad.RequestedIP() != 0)) {
                 // Make sure the preferred IP address is within the pool, otherwise offer a correct one anyway
                 if ((scratchPad.RequestedIP() >= _minAddress) && (scratchPad.RequestedIP() <= _maxAddress)) {
-                    result = Find(scratchPad.RequestedIP());
+                    result = _leases.Find(scratchPad.RequestedIP());
 
                     if (result == nullptr) {
                         // Ip address has not been taken yet, time to "assign" it to this client.
-                        result = Create(scratchPad.Id(), scratchPad.RequestedIP());
+                        result = _leases.Create(scratchPad.Id(), scratchPad.RequestedIP(), 0);
                     } else if (result->IsExpired() == true) {
-                        result->Update(scratchPad.Id());
+                        _leases.Assign(result, scratchPad.Id());
                     } else {
                         // IP address is taken
                         result = nullptr;
@@ -776,23 +925,14 @@ namespace Plugin {
             if (result == nullptr) {
                 // First look in previously unallocated IP slots
                 uint32_t ip;
-                for (ip = _nextFreeIp; ip <= _maxAddress; ip++) {
-                    if (Find(ip) == nullptr) {
-                        result = Create(scratchPad.Id(), ip);
-                        _nextFreeIp = (ip + 1);
-                        break;
-                    }
-                }
+                if (_leases.Free(ip) == true) {
+                    result = _leases.Create(scratchPad.Id(), ip, 0);
+                } else {
+                    // Still not found a free IP slot, attempt picking up the one that expired first
+                    result = _leases.Expired(now);
 
-                if (result == nullptr) {
-                    // Still not found a free IP slot, attempt picking up one of the expired ones
-                    for (ip = _minAddress; ip <= _maxAddress ; ip++) {
-                        Lease* lease = Find(ip);
-                        if ((lease != nullptr) && (lease->IsExpired() == true)) {
-                            result = lease;
-                            result->Update(scratchPad.Id());
-                            break;
-                        }
+                    if (result != nullptr) {
+                        _leases.Assign(result, scratchPad.Id());
                     }
                 }
             }
@@ -800,11 +940,11 @@ namespace Plugin {
             if (result == nullptr) {
                 TRACE(Flow, (string(_T("Looks like we ran out of IP addresses!!"))));
             } else {
-                if (result->IsExpired()) {
+                if (result->Expiration() < now) {
                     // Temporarily lock out the offered IP address until the client actually requests it
                     Core::Time timeout = Core::Time::Now();
                     timeout.Add(60 /* sec */ * 1000);
-                    result->Expiration(timeout.Ticks());
+                    _leases.Expiration(result, timeout.Ticks());
                 }
 
                 response.Offer(result->Raw());
@@ -818,7 +958,7 @@ namespace Plugin {
             _leases.Lock();
 
             // RFC 2131 section 4.3.2 Determine requested IP address
-            Lease* result = Find(scratchPad.Id());
+            Lease* result = _leases.Find(scratchPad.Id());
             uint32_t serverId = scratchPad.ServerIdentifier();
             uint32_t requested = scratchPad.RequestedIP();
             
@@ -829,16 +969,31 @@ namespace Plugin {
                 Core::Time leaseExp = Core::Time::Now();
                 leaseExp.Add(DefaultLeaseTime * (60 /* min */ * 60 * 1000));
                 response.LeaseTime(DefaultLeaseTime);
-                result->Expiration(leaseExp.Ticks());
+                _leases.Expiration(result, leaseExp.Ticks());
                 _ipRequestCallback(_interfaceName, result);
             } else {
                 if (result != nullptr) {
-                    result->Expiration(0); // Invalidate
+                    _leases.Expiration(result, 0); // Invalidate
+                    _ipRequestCallback(_interfaceName, result);
                 }
             }
 
             _leases.Unlock();
         }
+        void Release(const ScratchPad& scratchPad, const uint32_t address)
+        {
+            _leases.Lock();
+
+            // RFC 2131 section 4.3.4, the address is free again, but remembered for this client.
+            Lease* result = _leases.Find(scratchPad.Id());
+
+            if ((result != nullptr) && (result->Raw() == address) && (result->IsExpired() == false)) {
+                _leases.Expiration(result, 0);
+                _ipRequestCallback(_interfaceName, result);
+            }
+
+            _leases.Unlock();
+        }
         void Submit(const Core::ProxyType<Response> entry)
         {
             _responses.push_back(entry);
@@ -847,6 +1002,11 @@ namespace Plugin {
                 SocketDatagram::Trigger();
             }
         }
+
+    protected:
+        // Derives the pool, the router and the DNS server from the address and mask of the interface.
+        void Configure(const Core::IPNode& node);
+
         // Signal a state change, Opened, Closed or Accepted
         virtual void StateChange()
         {
@@ -905,9 +1065,10 @@ namespace Plugin {
                         Request(*response, scratchPad);
                         break;
                     case CLASSIFICATION_DECLINE:
-                        // Fall-through
+                        // UNSUPPORTED: Mark address as unusable
+                        break;
                     case CLASSIFICATION_RELEASE:
-                        // UNSUPPORTED: Mark address as unused
+                        Release(scratchPad, ntohl(message->ciaddr.s_addr));
                         break;
                     case CLASSIFICATION_INFORM:
                         // Unsupported DHCP message type - fail silently
@@ -937,7 +1098,6 @@ namespace Plugin {
         uint32_t _poolSize;
         uint32_t _minAddress;
         uint32_t _maxAddress;
-        uint32_t _nextFreeIp;
         uint32_t _server;
         uint32_t _router;
         uint32_t _dns;
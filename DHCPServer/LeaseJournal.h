@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Module.h"
+#include "DHCPServerImplementation.h"
+#include "../helpers/RecordLog.h"
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Binary log of the lease grants, renewals and releases of one interface. Every record holds the complete
+    // state of a single lease, the last record for an address is the one that counts. Records are appended as
+    // leases change and are forced to disk by Sync(); Compact() replaces the log by one record per lease.
+    // The records are kept in a RecordLog, see there for what happens to one cut short by a crash.
+    //
+    // record : address (4 bytes) - expiration (8 bytes) - id length (1 byte) - id
+    class LeaseJournal : public RecordLog {
+    private:
+        LeaseJournal(const LeaseJournal&) = delete;
+        LeaseJournal& operator=(const LeaseJournal&) = delete;
+
+        static constexpr uint32_t LeaseSize = 13;
+
+    public:
+        LeaseJournal()
+            : RecordLog(_T("lease journal"))
+        {
+        }
+        ~LeaseJournal()
+        {
+        }
+
+    public:
+        // Calls action(lease) for every complete record, in the order they were written.
+        template <typename ACTION>
+        uint32_t Replay(ACTION&& action)
+        {
+            uint32_t count = 0;
+
+            RecordLog::Replay([&](const uint8_t record[], const uint32_t length) -> bool {
+                uint32_t address;
+                uint64_t expiration;
+
+                bool result = ((length >= LeaseSize) && (record[12] == (length - LeaseSize)));
+
+                if (result == true) {
+                    ::memcpy(&address, &record[0], sizeof(address));
+                    ::memcpy(&expiration, &record[4], sizeof(expiration));
+
+                    action(DHCPServerImplementation::Lease(DHCPServerImplementation::Identifier(&record[LeaseSize], record[12]), address, expiration));
+                    count++;
+                }
+
+                return (result);
+            });
+
+            return (count);
+        }
+        bool Append(const DHCPServerImplementation::Lease& lease)
+        {
+            std::vector<uint8_t> record;
+
+            Encode(record, lease);
+
+            return (RecordLog::Append(record));
+        }
+
+        static void Encode(std::vector<uint8_t>& buffer, const DHCPServerImplementation::Lease& lease)
+        {
+            const size_t offset = Begin(buffer);
+            const uint32_t address = lease.Raw();
+            const uint64_t expiration = lease.Expiration();
+
+            buffer.resize(offset + HeaderSize + LeaseSize + lease.Id().Length());
+
+            uint8_t* record = &(buffer[offset + HeaderSize]);
+
+            ::memcpy(&record[0], &address, sizeof(address));
+            ::memcpy(&record[4], &expiration, sizeof(expiration));
+            record[12] = lease.Id().Length();
+            ::memcpy(&record[LeaseSize], lease.Id().Id(), lease.Id().Length());
+
+            Seal(buffer, offset);
+        }
+    };
+}
+}
@@ -0,0 +1,246 @@
+// Floods the DHCP server with DISCOVER/REQUEST pairs, as a crowd of clients would, to measure the lease allocation.
+// The frames are handed to the request handling of the server directly, the replies are taken from its send queue,
+// so no socket is involved and the numbers leave out the network stack. Two rounds are measured:
+// - fill: every address of the pool is handed out to a new client, the free addresses are found in the pool;
+// - reuse: all clients release their lease, a new client for every address then gets the lease that expired first.
+
+#include "../Module.h"
+#include "../DHCPServerImplementation.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace WPEFramework;
+
+namespace {
+
+    // RFC 2131 section 2, the fixed part of a frame, including the magic cookie.
+    static constexpr uint16_t HeaderSize = 240;
+    static constexpr uint16_t CiaddrOffset = 12;
+    static constexpr uint16_t YiaddrOffset = 16;
+    static constexpr uint16_t ChaddrOffset = 28;
+    static constexpr uint16_t CookieOffset = 236;
+    static constexpr uint8_t MagicCookie[] = { 99, 130, 83, 99 };
+
+    // RFC 2132, the options used.
+    static constexpr uint8_t OptionRequestedAddress = 50;
+    static constexpr uint8_t OptionMessageType = 53;
+    static constexpr uint8_t OptionServerIdentifier = 54;
+    static constexpr uint8_t OptionEnd = 255;
+
+    static constexpr uint8_t MessageDiscover = 1;
+    static constexpr uint8_t MessageOffer = 2;
+    static constexpr uint8_t MessageRequest = 3;
+    static constexpr uint8_t MessageAcknowledge = 5;
+    static constexpr uint8_t MessageRelease = 7;
+
+    static constexpr uint32_t MaxFrameSize = 1024;
+
+    class Server : public Plugin::DHCPServerImplementation {
+    private:
+        Server() = delete;
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+    public:
+        // A pool of all host addresses of a 10.0.0.0 network with the given prefix.
+        Server(const uint8_t prefix)
+            : Plugin::DHCPServerImplementation(_T("Benchmark"), _T("benchmark"), 1, (static_cast<uint32_t>(1) << (32 - prefix)) - 3, ~0, Core::NodeId(), [](const string&, Lease*) {})
+        {
+            Configure(Core::IPNode(Core::NodeId(_T("10.0.0.1")), prefix));
+        }
+        ~Server()
+        {
+        }
+
+    public:
+        // Hands a request to the server, returns the message type of the reply, 0 if there is none.
+        uint8_t Exchange(uint8_t request[], const uint16_t length, uint8_t reply[])
+        {
+            ReceiveData(request, length);
+
+            return ((SendData(reply, MaxFrameSize) > (HeaderSize + 2)) ? reply[HeaderSize + 2] : 0);
+        }
+    };
+
+    class Client {
+    private:
+        Client() = delete;
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+    public:
+        Client(Server& server)
+            : _server(server)
+            , _serverId()
+            , _addresses()
+        {
+            ::memset(_serverId, 0, sizeof(_serverId));
+        }
+        ~Client()
+        {
+        }
+
+    public:
+        // DISCOVER and REQUEST for a new client, returns true if the server acknowledged the address it offered.
+        bool Lease(const uint32_t client)
+        {
+            uint8_t frame[MaxFrameSize];
+            uint8_t reply[MaxFrameSize];
+            uint16_t length = Header(frame, client);
+            bool result = false;
+
+            length = Option(frame, length, OptionMessageType, &MessageDiscover, 1);
+            frame[length++] = OptionEnd;
+
+            if (_server.Exchange(frame, length, reply) == MessageOffer) {
+                const uint8_t* address = &(reply[YiaddrOffset]);
+
+                // The server identifier follows the message type in the options of the reply.
+                ::memcpy(_serverId, &(reply[HeaderSize + 5]), sizeof(_serverId));
+
+                length = Header(frame, client);
+                length = Option(frame, length, OptionMessageType, &MessageRequest, 1);
+                length = Option(frame, length, OptionRequestedAddress, address, 4);
+                length = Option(frame, length, OptionServerIdentifier, _serverId, sizeof(_serverId));
+                frame[length++] = OptionEnd;
+
+                result = (_server.Exchange(frame, length, reply) == MessageAcknowledge);
+
+                if (result == true) {
+                    uint32_t value;
+                    ::memcpy(&value, address, sizeof(value));
+                    _addresses.push_back(std::make_pair(client, ntohl(value)));
+                }
+            }
+
+            return (result);
+        }
+        // RELEASE of all leases acknowledged so far.
+        void Release()
+        {
+            uint8_t frame[MaxFrameSize];
+            uint8_t reply[MaxFrameSize];
+
+            for (const std::pair<uint32_t, uint32_t>& entry : _addresses) {
+                uint16_t length = Header(frame, entry.first);
+                const uint32_t address = htonl(entry.second);
+
+                ::memcpy(&(frame[CiaddrOffset]), &address, sizeof(address));
+                length = Option(frame, length, OptionMessageType, &MessageRelease, 1);
+                length = Option(frame, length, OptionServerIdentifier, _serverId, sizeof(_serverId));
+                frame[length++] = OptionEnd;
+
+                _server.Exchange(frame, length, reply);
+            }
+
+            _addresses.clear();
+        }
+
+    private:
+        static uint16_t Header(uint8_t frame[], const uint32_t client)
+        {
+            ::memset(frame, 0, HeaderSize);
+
+            frame[0] = 1; // BOOTREQUEST
+            frame[1] = 1; // Ethernet
+            frame[2] = 6;
+            ::memcpy(&(frame[4]), &client, sizeof(client));
+
+            // The client is identified by its hardware address.
+            frame[ChaddrOffset] = 0x02;
+            ::memcpy(&(frame[ChaddrOffset + 2]), &client, sizeof(client));
+            ::memcpy(&(frame[CookieOffset]), MagicCookie, sizeof(MagicCookie));
+
+            return (HeaderSize);
+        }
+        static uint16_t Option(uint8_t frame[], const uint16_t offset, const uint8_t option, const uint8_t value[], const uint8_t length)
+        {
+            frame[offset] = option;
+            frame[offset + 1] = length;
+            ::memcpy(&(frame[offset + 2]), value, length);
+
+            return (offset + 2 + length);
+        }
+
+    private:
+        Server& _server;
+        uint8_t _serverId[4];
+        std::vector<std::pair<uint32_t, uint32_t>> _addresses;
+    };
+
+    // Leases an address for count new clients, numbered from first, returns the nanoseconds per client or a
+    // negative value if the server did not hand out an address to one of them.
+    double Flood(Client& client, const uint32_t first, const uint32_t count)
+    {
+        double result = 0.0;
+        uint32_t index = 0;
+
+        const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+        while ((index < count) && (client.Lease(first + index) == true)) {
+            index++;
+        }
+
+        const std::chrono::steady_clock::time_point end(std::chrono::steady_clock::now());
+
+        if (index != count) {
+            fprintf(stderr, "No address for client %d of %d\n", index + 1, count);
+            result = -1.0;
+        } else {
+            result = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) / count;
+        }
+
+        return (result);
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    static constexpr uint8_t Runs = 3;
+
+    const uint8_t prefix = (argc > 1 ? static_cast<uint8_t>(std::atoi(argv[1])) : 16);
+
+    if ((prefix < 8) || (prefix > 30)) {
+        fprintf(stderr, "Usage: %s [prefix length, 8..30, default 16]\n", argv[0]);
+        return (1);
+    }
+
+    const uint32_t addresses = (static_cast<uint32_t>(1) << (32 - prefix)) - 2;
+    double fill = 0.0;
+    double reuse = 0.0;
+
+    printf("Pool of %d addresses (/%d)\n", addresses, prefix);
+
+    // The best of a few runs, every run on a fresh server, so a busy machine does not skew the numbers.
+    for (uint8_t run = 0; (run < Runs) && (fill >= 0.0) && (reuse >= 0.0); run++) {
+        Server server(prefix);
+        Client client(server);
+
+        const double filled = Flood(client, 0, addresses);
+
+        if (filled >= 0.0) {
+            client.Release();
+        }
+
+        const double reused = (filled >= 0.0 ? Flood(client, addresses, addresses) : -1.0);
+
+        if ((filled < 0.0) || (reused < 0.0)) {
+            fill = -1.0;
+        } else {
+            fill = ((run == 0) || (filled < fill) ? filled : fill);
+            reuse = ((run == 0) || (reused < reuse) ? reused : reuse);
+        }
+    }
+
+    if ((fill >= 0.0) && (reuse >= 0.0)) {
+        printf("   round   ns/client (DISCOVER+REQUEST)   ms/pool\n");
+        printf("    fill %30.1f %9.1f\n", fill, (fill * addresses) / 1000000.0);
+        printf("   reuse %30.1f %9.1f\n", reuse, (reuse * addresses) / 1000000.0);
+    }
+
+    Core::Singleton::Dispose();
+
+    return (((fill >= 0.0) && (reuse >= 0.0)) ? 0 : 1);
+}
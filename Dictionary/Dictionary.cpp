@@ -22,12 +22,50 @@ namespace Plugin {
         return ((value.empty() == false) && (value.find_first_of(Dictionary::NameSpaceDelimiter, 0) == static_cast<size_t>(~0)));
     }
 
+    // Replace the file as a whole, a crash half way leaves the previous version in place.
+    static bool StoreFile(const string& fileName, const string& content)
+    {
+        const string tempName(fileName + _T(".tmp"));
+        int descriptor = ::open(tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        bool result = (descriptor != -1);
+
+        if (result == true) {
+            uint32_t written = 0;
+
+            while ((result == true) && (written < content.length())) {
+                ssize_t size = ::write(descriptor, &(content.c_str()[written]), content.length() - written);
+
+                if (size > 0) {
+                    written += static_cast<uint32_t>(size);
+                } else if ((size == -1) && (errno != EINTR)) {
+                    result = false;
+                }
+            }
+
+            result = result && (::fdatasync(descriptor) == 0);
+
+            ::close(descriptor);
+
+            result = result && (::rename(tempName.c_str(), fileName.c_str()) == 0);
+
+            if (result == false) {
+                ::unlink(tempName.c_str());
+            }
+        }
+
+        if (result == false) {
+            TRACE_L1("Could not store the dictionary in %s, error: %d", fileName.c_str(), errno);
+        }
+
+        return (result);
+    }
+
     bool Dictionary::CreateInternalDictionary(const string& currentSpace, const NameSpace& current)
     {
         bool correctStructure(true);
         Core::JSON::ArrayType<NameSpace::Entry>::ConstIterator keyIndex(current.Dictionary.Elements());
         Core::JSON::ArrayType<NameSpace>::ConstIterator spaceIndex(current.Spaces.Elements());
-        std::list<RuntimeEntry>* currentList = NULL;
+        KeyList* currentList = NULL;
 
         // Fill in the keys from this name space...
         while ((correctStructure == true) && (keyIndex.Next() == true)) {
@@ -42,7 +80,7 @@ namespace Plugin {
                     ASSERT(currentList != NULL);
                 }
 
-                currentList->push_back(RuntimeEntry(key, keyIndex.Current().Value.Value(), keyIndex.Current().Type.Value()));
+                currentList->Set(key, keyIndex.Current().Value.Value(), keyIndex.Current().Type.Value());
             }
         }
 
@@ -55,19 +93,45 @@ namespace Plugin {
         return (correctStructure);
     }
 
-    void Dictionary::CreateExternalDictionary(const string& currentSpace, NameSpace& current) const
+    /* static */ bool Dictionary::CreateChanges(const string& currentSpace, const NameSpace& current, Journal::Changes& changes)
+    {
+        bool correctStructure(true);
+        Core::JSON::ArrayType<NameSpace::Entry>::ConstIterator keyIndex(current.Dictionary.Elements());
+        Core::JSON::ArrayType<NameSpace>::ConstIterator spaceIndex(current.Spaces.Elements());
+
+        while ((correctStructure == true) && (keyIndex.Next() == true)) {
+            const string& key(keyIndex.Current().Key.Value());
+
+            correctStructure = IsValidName(key);
+
+            if (correctStructure == true) {
+                changes.emplace_back(currentSpace, key, keyIndex.Current().Value.Value());
+            }
+        }
+
+        while ((correctStructure == true) && (spaceIndex.Next() == true)) {
+            string nameSpace(spaceIndex.Current().Name.Value());
+            correctStructure = IsValidName(nameSpace);
+            correctStructure = correctStructure && CreateChanges(currentSpace + NameSpaceDelimiter + nameSpace, spaceIndex.Current(), changes);
+        }
+
+        return (correctStructure);
+    }
+
+    /* static */ void Dictionary::CreateExternalDictionary(const DictionaryMap& source, const string& currentSpace, NameSpace& current)
     {
-        Core::TextFragment requiredSpace(currentSpace);
-        DictionaryMap::const_iterator index(_dictionary.begin());
+        DictionaryMap::const_iterator index(source.begin());
+
+        while (index != source.end()) {
+            const string& name(index->first);
 
-        while (index != _dictionary.end()) {
-            // Vallidate if the given path does include this namespace..
-            if ((currentSpace.empty() == true) || (requiredSpace.EqualText(index->first.c_str(), 0, requiredSpace.Length(), true) == true)) {
-                // Seems like we need to report this space, build it up
-                NameSpace& blockToFill(current[index->first]);
+            // Vallidate if the given path does include this namespace, it is the namespace itself or nested in it..
+            if ((currentSpace.empty() == true) || ((name.compare(0, currentSpace.length(), currentSpace) == 0) && ((name.length() == currentSpace.length()) || (name[currentSpace.length()] == NameSpaceDelimiter)))) {
+                // Seems like we need to report this space, build it up, relative to the requested space.
+                NameSpace& blockToFill(current[name.substr(currentSpace.length())]);
 
                 // No we got the namespace bloc, fill in the keys..
-                const std::list<RuntimeEntry>& keyList(index->second);
+                const std::list<RuntimeEntry>& keyList(index->second.Entries());
                 std::list<RuntimeEntry>::const_iterator keyIndex(keyList.begin());
 
                 while (keyIndex != keyList.end()) {
@@ -90,7 +154,10 @@ namespace Plugin {
     {
         _config.FromString(service->ConfigLine());
 
-        Core::File dictionaryFile(service->PersistentPath() + _config.Storage.Value());
+        _storage = service->PersistentPath() + _config.Storage.Value();
+        _compactSize = static_cast<uint64_t>(_config.CompactSize.Value()) * 1024;
+
+        Core::File dictionaryFile(_storage);
 
         if (dictionaryFile.Open(true) == true) {
             NameSpace dictionary;
@@ -102,6 +169,17 @@ namespace Plugin {
             CreateInternalDictionary(EMPTY_STRING, dictionary);
         }
 
+        // The storage file is a snapshot, whatever changed after it was written is in the journal.
+        if ((Core::Directory(service->PersistentPath().c_str()).CreatePath() == false) || (_journal.Open(_storage + _T(".journal")) == false)) {
+            SYSLOG(Logging::Startup, (_T("Dictionary has no journal, changes are lost on a crash")));
+        } else {
+            uint32_t changes = _journal.Replay([this](const string& nameSpace, const string& key, const string& value) {
+                _dictionary[nameSpace].Set(key, value, VOLATILE);
+            });
+
+            TRACE_L1("Dictionary replayed %d changes from the journal", changes);
+        }
+
         _skipURL = static_cast<uint8_t>(service->WebPrefix().length());
 
         // On succes return a name as a Callsign to be used in the URL, after the "service"prefix
@@ -110,13 +188,45 @@ namespace Plugin {
 
     /* virtual */ void Dictionary::Deinitialize(PluginHost::IShell* service)
     {
+        _syncTimer.Revoke(SyncHandler(*this));
 
-        Core::File dictionaryFile(service->PersistentPath() + _config.Storage.Value());
+        _adminLock.Lock();
+        _syncPending = false;
+        _adminLock.Unlock();
 
-        if (dictionaryFile.Open(true) == true) {
+        // Fold the journal into the storage file, so the next start does not have to replay it.
+        if (_journal.IsOpen() == true) {
+            Compact();
+            _journal.Close();
+        } else {
             NameSpace dictionary;
-            CreateExternalDictionary(EMPTY_STRING, dictionary);
-            dictionary.IElement::ToFile(dictionaryFile);
+            string content;
+
+            CreateExternalDictionary(_dictionary, EMPTY_STRING, dictionary);
+            dictionary.ToString(content);
+            StoreFile(_storage, content);
+        }
+
+        _dictionary.clear();
+
+        _adminLock.Lock();
+
+        ObserverMap observers;
+        observers.swap(_observers);
+
+        _adminLock.Unlock();
+
+        // Sinks that did not unregister, stop delivering to them.
+        ObserverMap::iterator index(observers.begin());
+
+        while (index != observers.end()) {
+            std::list<Observer*>::iterator observer(index->second.begin());
+
+            while (observer != index->second.end()) {
+                delete *observer;
+                observer++;
+            }
+            index++;
         }
     }
 
@@ -133,7 +243,9 @@ namespace Plugin {
     }
 
     // <GET> ../[namespace/]{Key}
+    // <GET> ../[namespace/][?Keys={Key},{Key},...]
     // <PUT> ../[namespace/]{Key}?Type=[persistent|volatile|closure]
+    // <PUT> ../[namespace/] with a namespace document as body, all keys in it are set as one transaction.
     /* virtual */ Core::ProxyType<Web::Response> Dictionary::Process(const Web::Request& request)
     {
         ASSERT(_skipURL <= request.Path.length());
@@ -152,14 +264,38 @@ namespace Plugin {
         string key = index.Current().Text();
 
         while (index.Next() == true) {
-            if (nameSpace.empty() == true) {
+            if ((nameSpace.empty() == true) || (nameSpace[nameSpace.length() - 1] != NameSpaceDelimiter)) {
                 nameSpace += NameSpaceDelimiter;
             }
             nameSpace += key;
             key = index.Current().Text();
         }
 
-        if (request.Verb == Web::Request::HTTP_GET) {
+        if ((request.Verb == Web::Request::HTTP_GET) && (key.empty() == true)) {
+            // All keys of a namespace, or a selection of them, in one go.
+            Core::ProxyType<Web::JSONBodyType<Dictionary::NameSpace>> response(jsonBodyDataFactory.Element());
+            Core::TextSegmentIterator queryIterator(Core::TextFragment(request.Query), true, '=');
+
+            response->Clear();
+
+            if ((queryIterator.Next() == true) && (queryIterator.Current() == _T("Keys")) && (queryIterator.Next() == true)) {
+                Core::TextSegmentIterator keyIterator(queryIterator.Current(), false, ',');
+                std::list<string> keys;
+
+                while (keyIterator.Next() == true) {
+                    keys.push_back(keyIterator.Current().Text());
+                }
+
+                Get(nameSpace, keys, *response);
+            } else {
+                Get(nameSpace, *response);
+            }
+
+            result->Body(Core::proxy_cast<Web::IBody>(response));
+            result->ContentType = Web::MIMETypes::MIME_JSON;
+            result->ErrorCode = Web::STATUS_OK;
+            result->Message = _T("OK");
+        } else if (request.Verb == Web::Request::HTTP_GET) {
             string value;
             Core::ProxyType<Web::TextBody> valueBody(textBodyDataFactory.Element());
 
@@ -185,6 +321,18 @@ namespace Plugin {
 
             result->ErrorCode = Web::STATUS_OK;
             result->Message = _T("OK");
+        } else if ((request.Verb == Web::Request::HTTP_POST) && (request.HasBody() == true)) {
+            Core::ProxyType<const Web::TextBody> document(request.Body<Web::TextBody>());
+            Core::OptionalType<Core::JSON::Error> error;
+            NameSpace changes;
+
+            if ((document.IsValid() == true) && (changes.IElement::FromString(string(*document), error) == true) && (error.IsSet() == false) && (Set(nameSpace, changes) == true)) {
+                result->ErrorCode = Web::STATUS_OK;
+                result->Message = _T("OK");
+            } else {
+                result->ErrorCode = Web::STATUS_BAD_REQUEST;
+                result->Message = _T("Invalid namespace document.");
+            }
         } else {
             result->ErrorCode = Web::STATUS_BAD_REQUEST;
             result->Message = _T("Bad request.");
@@ -202,16 +350,11 @@ namespace Plugin {
         DictionaryMap::const_iterator index(_dictionary.find(nameSpace));
 
         if (index != _dictionary.end()) {
-            const std::list<RuntimeEntry>& container(index->second);
-            std::list<RuntimeEntry>::const_iterator listIndex(container.begin());
+            const RuntimeEntry* entry = index->second.Find(key);
 
-            while ((listIndex != container.end()) && (listIndex->Key() != key)) {
-                listIndex++;
-            }
-
-            if (listIndex != container.end()) {
+            if (entry != nullptr) {
                 result = true;
-                value = listIndex->Value();
+                value = entry->Value();
             }
         }
 
@@ -234,7 +377,7 @@ namespace Plugin {
         if (index != _dictionary.end()) {
             Core::ProxyType<Iterator> entries(iterators.Element());
 
-            entries->Load(InternalIterator(index->second));
+            entries->Load(InternalIterator(index->second.Entries()));
 
             result = &(*entries);
             result->AddRef();
@@ -254,35 +397,165 @@ namespace Plugin {
 
         _adminLock.Lock();
 
-        std::list<RuntimeEntry>& container(_dictionary[nameSpace]);
-        std::list<RuntimeEntry>::iterator listIndex(container.begin());
+        result = _dictionary[nameSpace].Set(key, value, VOLATILE);
+
+        if (result == true) {
+            if (_journal.Append(nameSpace, key, value) == true) {
+                ScheduleSync();
+            }
+
+            ObserverMap::const_iterator index(_observers.find(nameSpace));
+
+            // Right, we updated, queue the modification, it is sent out from the worker pool.
+            if (index != _observers.end()) {
+                std::list<Observer*>::const_iterator observer(index->second.begin());
 
-        while ((listIndex != container.end()) && (listIndex->Key() != key)) {
-            listIndex++;
+                while (observer != index->second.end()) {
+                    (*observer)->Enqueue(key, value);
+                    observer++;
+                }
+            }
         }
 
-        if (listIndex == container.end()) {
-            result = true;
-            container.push_back(RuntimeEntry(key, value, VOLATILE));
-        } else if (listIndex->Value() != value) {
-            result = true;
-            listIndex->Value(value);
+        _adminLock.Unlock();
+
+        return (result);
+    }
+
+    void Dictionary::Get(const string& nameSpace, NameSpace& result) const
+    {
+        _adminLock.Lock();
+
+        CreateExternalDictionary(_dictionary, nameSpace, result);
+
+        _adminLock.Unlock();
+    }
+
+    void Dictionary::Get(const string& nameSpace, const std::list<string>& keys, NameSpace& result) const
+    {
+        _adminLock.Lock();
+
+        DictionaryMap::const_iterator index(_dictionary.find(nameSpace));
+
+        if (index != _dictionary.end()) {
+            std::list<string>::const_iterator key(keys.begin());
+
+            while (key != keys.end()) {
+                const RuntimeEntry* entry = index->second.Find(*key);
+
+                if (entry != nullptr) {
+                    NameSpace::Entry& element(result.Dictionary.Add(NameSpace::Entry()));
+                    element.Key = entry->Key();
+                    element.Value = entry->Value();
+                }
+                key++;
+            }
         }
 
+        _adminLock.Unlock();
+    }
+
+    bool Dictionary::Set(const string& nameSpace, const NameSpace& changes)
+    {
+        Journal::Changes requested;
+        bool result = CreateChanges(nameSpace, changes, requested);
+
         if (result == true) {
-            ObserverMap::iterator index(_observers.begin());
+            Journal::Changes applied;
+            std::map<string, Observer::Changes> notifications;
+
+            _adminLock.Lock();
+
+            Journal::Changes::const_iterator index(requested.begin());
 
-            // Right, we updated send out the modification !!!
-            while (index != _observers.end()) {
-                if (index->first == nameSpace) {
-                    index->second->Modified(nameSpace, key, value);
+            while (index != requested.end()) {
+                if (_dictionary[index->NameSpace].Set(index->Key, index->Value, VOLATILE) == true) {
+                    applied.push_back(*index);
+
+                    if (_observers.find(index->NameSpace) != _observers.end()) {
+                        notifications[index->NameSpace].emplace_back(index->Key, index->Value);
+                    }
                 }
                 index++;
             }
+
+            if ((applied.empty() == false) && (_journal.Append(applied) == true)) {
+                ScheduleSync();
+            }
+
+            // Every observer gets all changes of its namespace as one batch.
+            std::map<string, Observer::Changes>::const_iterator notification(notifications.begin());
+
+            while (notification != notifications.end()) {
+                const std::list<Observer*>& observers(_observers[notification->first]);
+                std::list<Observer*>::const_iterator observer(observers.begin());
+
+                while (observer != observers.end()) {
+                    (*observer)->Enqueue(notification->second);
+                    observer++;
+                }
+                notification++;
+            }
+
+            _adminLock.Unlock();
+        }
+
+        return (result);
+    }
+
+    // The change is on its way to disk, the sync timer makes sure it arrives, together with all changes that
+    // follow within the sync time.
+    void Dictionary::ScheduleSync()
+    {
+        if (_syncPending == false) {
+            Core::Time nextSync(Core::Time::Now());
+
+            nextSync.Add(_config.SyncTime.Value());
+            _syncPending = true;
+            _syncTimer.Schedule(nextSync.Ticks(), SyncHandler(*this));
         }
+    }
+
+    uint64_t Dictionary::Timed(const uint64_t /* scheduledTime */)
+    {
+        _adminLock.Lock();
+        _syncPending = false;
+        _adminLock.Unlock();
+
+        _journal.Sync();
+
+        if ((_compactSize != 0) && (_journal.Size() >= _compactSize)) {
+            Compact();
+        }
+
+        // Rescheduled by the next change.
+        return (0);
+    }
+
+    // Write the current state as the new storage file and drop the part of the journal it covers. The state is
+    // copied under the lock, the (slow) writing is done without it, so changes can continue to come in.
+    bool Dictionary::Compact()
+    {
+        NameSpace dictionary;
+        string content;
+
+        _compactLock.Lock();
+        _adminLock.Lock();
+
+        DictionaryMap current(_dictionary);
+        uint64_t offset = _journal.Size();
 
         _adminLock.Unlock();
 
+        CreateExternalDictionary(current, EMPTY_STRING, dictionary);
+        dictionary.ToString(content);
+
+        bool result = (StoreFile(_storage, content) == true) && (_journal.Compact(offset) == true);
+
+        _compactLock.Unlock();
+
+        TRACE_L1("Dictionary compacted %d bytes of journal: %s", static_cast<uint32_t>(offset), result == true ? _T("succeeded") : _T("failed"));
+
         return (result);
     }
 
@@ -290,42 +563,55 @@ namespace Plugin {
     {
         _adminLock.Lock();
 
+        std::list<Observer*>& observers(_observers[nameSpace]);
+
 #ifdef __DEBUG__
-        ObserverMap::iterator index(_observers.begin());
+        std::list<Observer*>::const_iterator index(observers.begin());
 
         // DO NOT REGISTER THE SAME NOTIFICATION SINK ON THE SAME NAMESPACE MORE THAN ONCE. !!!!!!
-        while (index != _observers.end()) {
-            ASSERT((index->second != sink) || (nameSpace != index->first));
+        while (index != observers.end()) {
+            ASSERT((*index)->Sink() != sink);
 
             index++;
         }
 #endif
 
-        _observers.push_back(std::pair<string, struct Exchange::IDictionary::INotification*>(nameSpace, sink));
+        observers.push_back(new Observer(nameSpace, sink, _config.NotificationQueue.Value()));
 
         _adminLock.Unlock();
     }
 
     /* virtual */ void Dictionary::Unregister(const string& nameSpace, struct Exchange::IDictionary::INotification* sink)
     {
-        bool found = false;
+        Observer* found = nullptr;
 
         _adminLock.Lock();
 
-        ObserverMap::iterator index(_observers.begin());
+        ObserverMap::iterator index(_observers.find(nameSpace));
 
-        while ((found == false) && (index != _observers.end())) {
-            found = ((index->second == sink) && (nameSpace == index->first));
-            if (found == false) {
-                index++;
+        if (index != _observers.end()) {
+            std::list<Observer*>::iterator observer(index->second.begin());
+
+            while ((observer != index->second.end()) && ((*observer)->Sink() != sink)) {
+                observer++;
             }
-        }
 
-        if (index != _observers.end()) {
-            _observers.erase(index);
+            if (observer != index->second.end()) {
+                found = *observer;
+                index->second.erase(observer);
+
+                if (index->second.empty() == true) {
+                    _observers.erase(index);
+                }
+            }
         }
 
         _adminLock.Unlock();
+
+        // Outside the lock, a delivery that is in progress has to finish first.
+        if (found != nullptr) {
+            delete found;
+        }
     }
 }
 }
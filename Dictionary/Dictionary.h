@@ -1,9 +1,12 @@
 #ifndef __DICTIONARY_H
 #define __DICTIONARY_H
 
+#include "Journal.h"
 #include "Module.h"
 #include <interfaces/IDictionary.h>
 
+#include <unordered_map>
+
 namespace WPEFramework {
 namespace Plugin {
 
@@ -82,8 +85,269 @@ namespace Plugin {
             bool _dirty;
         };
 
-        typedef std::map<const string, std::list<RuntimeEntry>> DictionaryMap;
-        typedef std::list<std::pair<const string, struct Exchange::IDictionary::INotification*>> ObserverMap;
+        // The keys of a namespace, in the order they were added, which is the order they are iterated and stored
+        // in. The hash index finds a key without walking the list.
+        class KeyList {
+        private:
+            KeyList& operator=(const KeyList&) = delete;
+
+        public:
+            KeyList()
+                : _entries()
+                , _index()
+            {
+            }
+            KeyList(const KeyList& copy)
+                : _entries(copy._entries)
+                , _index()
+            {
+                std::list<RuntimeEntry>::iterator index(_entries.begin());
+
+                _index.reserve(_entries.size());
+
+                while (index != _entries.end()) {
+                    _index.emplace(index->Key(), index);
+                    index++;
+                }
+            }
+            ~KeyList()
+            {
+            }
+
+        public:
+            inline const std::list<RuntimeEntry>& Entries() const
+            {
+                return (_entries);
+            }
+            const RuntimeEntry* Find(const string& key) const
+            {
+                std::unordered_map<string, std::list<RuntimeEntry>::iterator>::const_iterator index(_index.find(key));
+
+                return (index != _index.end() ? &(*(index->second)) : nullptr);
+            }
+            // Returns true if the key is new or its value changed.
+            bool Set(const string& key, const string& value, const enumType type)
+            {
+                bool result = false;
+                std::unordered_map<string, std::list<RuntimeEntry>::iterator>::iterator index(_index.find(key));
+
+                if (index == _index.end()) {
+                    result = true;
+                    _entries.push_back(RuntimeEntry(key, value, type));
+                    _index.emplace(key, std::prev(_entries.end()));
+                } else if (index->second->Value() != value) {
+                    result = true;
+                    index->second->Value(value);
+                }
+
+                return (result);
+            }
+
+        private:
+            std::list<RuntimeEntry> _entries;
+            std::unordered_map<string, std::list<RuntimeEntry>::iterator> _index;
+        };
+
+        // A sink registered on one namespace. Changes are queued and handed to the sink from the worker pool,
+        // outside of the dictionary lock, so a slow sink (often a proxy to another process) only delays its own
+        // notifications. A key that changes again before it was reported is reported once, with its latest
+        // value, in the place of its latest change. All changes queued up are delivered in one go.
+        class Observer {
+        private:
+            Observer() = delete;
+            Observer(const Observer&) = delete;
+            Observer& operator=(const Observer&) = delete;
+
+            class Job : public Core::IDispatchType<void> {
+            public:
+                Job() = delete;
+                Job(const Job&) = delete;
+                Job& operator=(const Job&) = delete;
+
+            public:
+                Job(Observer* parent)
+                    : _parent(*parent)
+                {
+                    ASSERT(parent != nullptr);
+                }
+                ~Job() override
+                {
+                }
+                void Dispatch() override
+                {
+                    _parent.Dispatch();
+                }
+
+            private:
+                Observer& _parent;
+            };
+
+            // A queued change remembers the Enqueue it came with, so a transaction can be dropped as a whole.
+            struct Pending {
+                string Key;
+                string Value;
+                uint32_t Transaction;
+            };
+
+            typedef std::list<Pending> PendingList;
+
+        public:
+            typedef std::list<std::pair<string, string>> Changes;
+
+        public:
+            // limit: the number of different keys that can be waiting for the sink, if more change the oldest
+            // transactions are dropped. A transaction is never dropped in part, so a single transaction bigger
+            // than the limit is still queued.
+            Observer(const string& nameSpace, Exchange::IDictionary::INotification* sink, const uint16_t limit)
+                : _adminLock()
+                , _nameSpace(nameSpace)
+                , _sink(sink)
+                , _limit(limit == 0 ? 1 : limit)
+                , _changes()
+                , _index()
+                , _transaction(0)
+                , _scheduled(false)
+                , _closed(false)
+                , _dropped(0)
+                , _job(Core::ProxyType<Job>::Create(this))
+            {
+                _sink->AddRef();
+            }
+            ~Observer()
+            {
+                _adminLock.Lock();
+                _closed = true;
+                _adminLock.Unlock();
+
+                PluginHost::WorkerPool::Instance().Revoke(_job);
+
+                _sink->Release();
+            }
+
+        public:
+            inline const Exchange::IDictionary::INotification* Sink() const
+            {
+                return (_sink);
+            }
+            inline uint32_t Dropped() const
+            {
+                return (_dropped);
+            }
+            void Enqueue(const string& key, const string& value)
+            {
+                _adminLock.Lock();
+
+                _transaction++;
+
+                Reserve(1);
+                Queue(key, value);
+                Schedule();
+
+                _adminLock.Unlock();
+            }
+            // The changes are queued as a whole, a delivery never holds part of them.
+            void Enqueue(const Changes& changes)
+            {
+                _adminLock.Lock();
+
+                _transaction++;
+
+                Reserve(static_cast<uint32_t>(changes.size()));
+
+                Changes::const_iterator index(changes.begin());
+
+                while (index != changes.end()) {
+                    Queue(index->first, index->second);
+                    index++;
+                }
+
+                Schedule();
+
+                _adminLock.Unlock();
+            }
+
+        private:
+            // Drops the oldest transactions until the new changes fit. The changes of a transaction are queued one
+            // after the other, and a key that changes again moves to the back, so a transaction is a run at the front.
+            void Reserve(const uint32_t needed)
+            {
+                while ((_changes.empty() == false) && ((_changes.size() + needed) > _limit)) {
+                    const uint32_t transaction = _changes.front().Transaction;
+
+                    while ((_changes.empty() == false) && (_changes.front().Transaction == transaction)) {
+                        _index.erase(_changes.front().Key);
+                        _changes.pop_front();
+                        _dropped++;
+                    }
+
+                    TRACE_L1("Dictionary observer on [%s] is not keeping up, dropped %d changes", _nameSpace.c_str(), _dropped);
+                }
+            }
+            void Queue(const string& key, const string& value)
+            {
+                std::unordered_map<string, PendingList::iterator>::iterator index(_index.find(key));
+
+                if (index != _index.end()) {
+                    _changes.erase(index->second);
+                    _index.erase(index);
+                }
+
+                _changes.push_back({ key, value, _transaction });
+                _index.emplace(key, std::prev(_changes.end()));
+            }
+            void Schedule()
+            {
+                if ((_scheduled == false) && (_closed == false)) {
+                    _scheduled = true;
+                    PluginHost::WorkerPool::Instance().Submit(_job);
+                }
+            }
+            void Dispatch()
+            {
+                PendingList changes;
+
+                _adminLock.Lock();
+
+                changes.swap(_changes);
+                _index.clear();
+
+                _adminLock.Unlock();
+
+                PendingList::const_iterator index(changes.begin());
+
+                while (index != changes.end()) {
+                    _sink->Modified(_nameSpace, index->Key, index->Value);
+                    index++;
+                }
+
+                // Only one delivery at a time, so the sink sees the changes in the order they were made.
+                _adminLock.Lock();
+
+                if ((_changes.empty() == false) && (_closed == false)) {
+                    PluginHost::WorkerPool::Instance().Submit(_job);
+                } else {
+                    _scheduled = false;
+                }
+
+                _adminLock.Unlock();
+            }
+
+        private:
+            Core::CriticalSection _adminLock;
+            const string _nameSpace;
+            Exchange::IDictionary::INotification* _sink;
+            const uint16_t _limit;
+            PendingList _changes;
+            std::unordered_map<string, PendingList::iterator> _index;
+            uint32_t _transaction;
+            bool _scheduled;
+            bool _closed;
+            uint32_t _dropped;
+            Core::ProxyType<Core::IDispatchType<void>> _job;
+        };
+
+        typedef std::unordered_map<string, KeyList> DictionaryMap;
+        typedef std::unordered_map<string, std::list<Observer*>> ObserverMap;
         typedef Core::IteratorType<const std::list<RuntimeEntry>, const RuntimeEntry&, std::list<RuntimeEntry>::const_iterator> InternalIterator;
 
     public:
@@ -309,9 +573,15 @@ namespace Plugin {
                 : Core::JSON::Container()
                 , Storage(_T("dictionary.json"))
                 , LingerTime(10)
+                , SyncTime(100)
+                , CompactSize(1024)
+                , NotificationQueue(256)
             { // Time in minutes.
                 Add(_T("storage"), &Storage);
                 Add(_T("lingertime"), &LingerTime);
+                Add(_T("synctime"), &SyncTime);
+                Add(_T("compactsize"), &CompactSize);
+                Add(_T("notificationqueue"), &NotificationQueue);
             }
             ~Config()
             {
@@ -320,16 +590,72 @@ namespace Plugin {
         public:
             Core::JSON::String Storage;
             Core::JSON::DecUInt16 LingerTime;
+            Core::JSON::DecUInt16 SyncTime; // Time in milliseconds changes may wait to be forced to disk.
+            Core::JSON::DecUInt32 CompactSize; // Journal size in KB at which it is folded into the storage file.
+            Core::JSON::DecUInt16 NotificationQueue; // Changed keys that can wait for a single observer.
+        };
+
+        class SyncHandler {
+        public:
+            SyncHandler()
+                : _parent(nullptr)
+            {
+            }
+            SyncHandler(Dictionary& parent)
+                : _parent(&parent)
+            {
+            }
+            SyncHandler(const SyncHandler& copy)
+                : _parent(copy._parent)
+            {
+            }
+            ~SyncHandler()
+            {
+            }
+
+            SyncHandler& operator=(const SyncHandler& RHS)
+            {
+                _parent = RHS._parent;
+                return (*this);
+            }
+            bool operator==(const SyncHandler& RHS) const
+            {
+                return (_parent == RHS._parent);
+            }
+
+        public:
+            uint64_t Timed(const uint64_t scheduledTime)
+            {
+                ASSERT(_parent != nullptr);
+
+                return (_parent->Timed(scheduledTime));
+            }
+
+        private:
+            Dictionary* _parent;
         };
 
     public:
+#ifdef __WINDOWS__
+#pragma warning(disable : 4355)
+#endif
         Dictionary()
             : _adminLock()
             , _skipURL(0)
             , _config()
             , _dictionary()
+            , _observers()
+            , _storage()
+            , _journal()
+            , _syncTimer(Core::Thread::DefaultStackSize(), _T("DictionarySync"))
+            , _syncPending(false)
+            , _compactSize(0)
+            , _compactLock()
         {
         }
+#ifdef __WINDOWS__
+#pragma warning(default : 4355)
+#endif
         virtual ~Dictionary()
         {
         }
@@ -387,9 +713,26 @@ namespace Plugin {
         virtual void Register(const string& nameSpace, struct Exchange::IDictionary::INotification* sink);
         virtual void Unregister(const string& nameSpace, struct Exchange::IDictionary::INotification* sink);
 
+        //  Bulk access
+        // -------------------------------------------------------------------------------------------------------
+        // Collects the keys of a namespace, and of all namespaces nested in it, in one go. The namespaces in
+        // the result are relative to the given one.
+        void Get(const string& nameSpace, NameSpace& result) const;
+
+        // Only the given keys of a namespace, keys that do not exist are left out.
+        void Get(const string& nameSpace, const std::list<string>& keys, NameSpace& result) const;
+
+        // Applies all keys in the changes (namespaces relative to the given one) as one transaction. Nobody,
+        // observers included, sees part of it. If any of the names is invalid, nothing is applied.
+        bool Set(const string& nameSpace, const NameSpace& changes);
+
     private:
         bool CreateInternalDictionary(const string& currentSpace, const NameSpace& data);
-        void CreateExternalDictionary(const string& currentSpace, NameSpace& data) const;
+        static void CreateExternalDictionary(const DictionaryMap& source, const string& currentSpace, NameSpace& data);
+        static bool CreateChanges(const string& currentSpace, const NameSpace& data, Journal::Changes& changes);
+        void ScheduleSync();
+        uint64_t Timed(const uint64_t scheduledTime);
+        bool Compact();
 
     private:
         mutable Core::CriticalSection _adminLock;
@@ -397,6 +740,12 @@ namespace Plugin {
         Config _config;
         DictionaryMap _dictionary;
         ObserverMap _observers;
+        string _storage;
+        Journal _journal;
+        Core::TimerType<SyncHandler> _syncTimer;
+        bool _syncPending;
+        uint64_t _compactSize;
+        Core::CriticalSection _compactLock;
     };
 }
 }
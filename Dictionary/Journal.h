@@ -0,0 +1,186 @@
+#pragma once
+
+#include "Module.h"
+#include "../helpers/RecordLog.h"
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Append only log of all changes made to the dictionary since the last snapshot. Records are written as
+    // they come in, forcing them to disk is left to Sync(), so a batch of changes costs a single fdatasync.
+    // The records are kept in a RecordLog, one that was not written completely (power loss) is dropped with
+    // anything after it when the log is replayed. A record holds all changes of one transaction, so a
+    // transaction is replayed completely or not at all.
+    //
+    // record : change - change - ...
+    // change : namespace length (2 bytes) - key length (2 bytes) - value length (4 bytes) - namespace - key - value
+    class Journal : public RecordLog {
+    private:
+        Journal(const Journal&) = delete;
+        Journal& operator=(const Journal&) = delete;
+
+        static constexpr uint32_t ChangeSize = 8;
+        static constexpr uint32_t MaxRecordSize = 16 * 1024 * 1024;
+
+    public:
+        class Change {
+        public:
+            Change() = delete;
+            Change& operator=(const Change&) = delete;
+
+            Change(const string& nameSpace, const string& key, const string& value)
+                : NameSpace(nameSpace)
+                , Key(key)
+                , Value(value)
+            {
+            }
+            Change(const Change& copy)
+                : NameSpace(copy.NameSpace)
+                , Key(copy.Key)
+                , Value(copy.Value)
+            {
+            }
+            ~Change()
+            {
+            }
+
+        public:
+            const string NameSpace;
+            const string Key;
+            const string Value;
+        };
+
+        typedef std::list<Change> Changes;
+
+    public:
+        Journal()
+            : RecordLog(_T("dictionary journal"))
+        {
+        }
+        ~Journal()
+        {
+        }
+
+    public:
+        // Calls action(nameSpace, key, value) for every change in a complete record, in the order they were written.
+        template <typename ACTION>
+        uint32_t Replay(ACTION&& action)
+        {
+            uint32_t count = 0;
+
+            RecordLog::Replay([&](const uint8_t record[], const uint32_t length) -> bool {
+                Changes changes;
+
+                bool result = Decode(record, length, changes);
+
+                if (result == true) {
+                    Changes::const_iterator index(changes.begin());
+
+                    while (index != changes.end()) {
+                        action(index->NameSpace, index->Key, index->Value);
+                        index++;
+                        count++;
+                    }
+                }
+
+                return (result);
+            });
+
+            return (count);
+        }
+        bool Append(const string& nameSpace, const string& key, const string& value)
+        {
+            std::vector<uint8_t> record;
+            const size_t offset = Begin(record);
+
+            bool result = Encode(record, nameSpace, key, value);
+
+            if (result == true) {
+                Seal(record, offset);
+                result = RecordLog::Append(record);
+            }
+
+            return (result);
+        }
+        // All changes end up in one record, they are replayed together or not at all.
+        bool Append(const Changes& changes)
+        {
+            std::vector<uint8_t> record;
+            const size_t offset = Begin(record);
+            bool result = true;
+            Changes::const_iterator index(changes.begin());
+
+            while ((result == true) && (index != changes.end())) {
+                result = Encode(record, index->NameSpace, index->Key, index->Value);
+                index++;
+            }
+
+            if (result == true) {
+                Seal(record, offset);
+                result = RecordLog::Append(record);
+            }
+
+            return (result);
+        }
+        // A snapshot holding all changes up to offset is safely stored, only keep what came after it.
+        bool Compact(const uint64_t offset)
+        {
+            return (RecordLog::Compact(std::vector<uint8_t>(), offset));
+        }
+
+    private:
+        static bool Encode(std::vector<uint8_t>& record, const string& nameSpace, const string& key, const string& value)
+        {
+            bool result = false;
+            size_t offset = record.size();
+            size_t size = offset + ChangeSize + nameSpace.length() + key.length() + value.length();
+
+            if ((nameSpace.length() <= 0xFFFF) && (key.length() <= 0xFFFF) && (size <= (HeaderSize + MaxRecordSize))) {
+                uint16_t nameSpaceLength = static_cast<uint16_t>(nameSpace.length());
+                uint16_t keyLength = static_cast<uint16_t>(key.length());
+                uint32_t valueLength = static_cast<uint32_t>(value.length());
+
+                record.resize(size);
+
+                ::memcpy(&record[offset], &nameSpaceLength, sizeof(nameSpaceLength));
+                ::memcpy(&record[offset + 2], &keyLength, sizeof(keyLength));
+                ::memcpy(&record[offset + 4], &valueLength, sizeof(valueLength));
+                offset += ChangeSize;
+                ::memcpy(&record[offset], nameSpace.c_str(), nameSpaceLength);
+                ::memcpy(&record[offset + nameSpaceLength], key.c_str(), keyLength);
+                ::memcpy(&record[offset + nameSpaceLength + keyLength], value.c_str(), valueLength);
+
+                result = true;
+            }
+
+            return (result);
+        }
+        static bool Decode(const uint8_t data[], const uint32_t length, Changes& changes)
+        {
+            uint32_t offset = 0;
+
+            while ((offset + ChangeSize) <= length) {
+                uint16_t nameSpaceLength, keyLength;
+                uint32_t valueLength;
+
+                ::memcpy(&nameSpaceLength, &data[offset], sizeof(nameSpaceLength));
+                ::memcpy(&keyLength, &data[offset + 2], sizeof(keyLength));
+                ::memcpy(&valueLength, &data[offset + 4], sizeof(valueLength));
+                offset += ChangeSize;
+
+                if ((static_cast<uint64_t>(nameSpaceLength) + keyLength + valueLength) > (length - offset)) {
+                    break;
+                }
+
+                const char* text = reinterpret_cast<const char*>(&data[offset]);
+
+                changes.emplace_back(string(text, nameSpaceLength), string(&text[nameSpaceLength], keyLength), string(&text[nameSpaceLength + keyLength], valueLength));
+
+                offset += nameSpaceLength + keyLength + valueLength;
+            }
+
+            return (offset == length);
+        }
+    };
+}
+}
@@ -10,8 +10,24 @@ namespace Plugin {
         Config config;
         config.FromString(service->ConfigLine());
 
+        uint64_t inode = 0;
+        uint64_t offset = 0;
+
+        if (config.Framed.Value() == true) {
+            string storage;
+
+            if (Core::Directory(service->PersistentPath().c_str()).CreatePath() == true) {
+                storage = service->PersistentPath() + _T("position");
+            }
+            if ((config.Compress.Value() == true) && (Transfer::Frame::CanCompress() == false)) {
+                TRACE_L1(_T("No LZ4 support, the frames are sent uncompressed"));
+            }
+
+            _logOutput.Framed(config.Compress.Value(), storage, inode, offset);
+        }
+
         _logOutput.SetDestination(config.Destination.Binding.Value(), config.Destination.Port.Value());
-        _observer.Register(config.FilePath.Value(), &_fileUpdate, config.FullFile.Value());
+        _observer.Register(config.FilePath.Value(), &_fileUpdate, config.FullFile.Value(), inode, offset);
 
         return string();
     }
@@ -19,6 +35,7 @@ namespace Plugin {
     void FileTransfer::Deinitialize(PluginHost::IShell* service)
     {
         _observer.Unregister();
+        _logOutput.Store();
     }
 
     string FileTransfer::Information() const
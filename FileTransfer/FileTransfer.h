@@ -1,9 +1,11 @@
 #pragma once
 #include <sys/inotify.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <atomic>
 #include <unordered_map>
-#include <iostream>
-#include <fstream>
 #include "../FileTransfer/Module.h"
+#include "Frame.h"
 
 namespace WPEFramework {
 namespace Core {
@@ -89,11 +91,14 @@ namespace Core {
             {
                 return (_notifyFd != -1);
             }
-            bool Register(ICallback *callback, const string &filename)
+            // Returns true if the file is watched, false if it could not be (e.g. it does not exist (yet)).
+            bool Register(ICallback *callback, const string &filename, const uint32_t events = IN_MODIFY | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF)
             {
                 ASSERT(_notifyFd != -1);
                 ASSERT(callback != nullptr);
 
+                bool result = true;
+
                 _adminLock.Lock();
 
                 Files::iterator index = _files.find(filename);
@@ -105,7 +110,8 @@ namespace Core {
                 }
                 else
                 {
-                    int fileFd = inotify_add_watch(_notifyFd, filename.c_str(), IN_CLOSE_WRITE);
+                    int fileFd = inotify_add_watch(_notifyFd, filename.c_str(), events);
+                    result = (fileFd >= 0);
                     if (fileFd >= 0) {
                         _files.emplace(std::piecewise_construct,
                                        std::forward_as_tuple(filename),
@@ -123,7 +129,7 @@ namespace Core {
 
                 _adminLock.Unlock();
 
-                return (IsValid());
+                return (result);
             }
             void Unregister(ICallback *callback, const string &filename)
             {
@@ -169,20 +175,27 @@ namespace Core {
             void Handle(const uint16_t events) override
             {
                 if ((events & POLLIN) != 0) {
-                    uint8_t eventBuffer[(sizeof(struct inotify_event) + NAME_MAX + 1)];
+                    // A busy file gives many events, read as many as fit in one go.
+                    alignas(struct inotify_event) uint8_t eventBuffer[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
                     int length;
                     do
                     {
                         length = ::read(_notifyFd, eventBuffer, sizeof(eventBuffer));
                         if (length > 0) {
-                            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(eventBuffer);
+                            int offset = 0;
 
                             _adminLock.Lock();
 
-                            // Check if we have this entry..
-                            Observers::iterator loop = _observers.find(event->wd);
-                            if (loop != _observers.end()) {
-                                loop->second.Notify();
+                            while (offset < length) {
+                                const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(&(eventBuffer[offset]));
+
+                                // Check if we have this entry..
+                                Observers::iterator loop = _observers.find(event->wd);
+                                if (loop != _observers.end()) {
+                                    loop->second.Notify();
+                                }
+
+                                offset += sizeof(struct inotify_event) + event->len;
                             }
 
                             _adminLock.Unlock();
@@ -201,8 +214,13 @@ namespace Core {
 
 namespace Plugin
 {
+    // Follows a (log) file: keeps it open and reads what is appended in large blocks, handing over complete
+    // lines only. A rotated file (another inode at the path) is read till its end before the new one is
+    // followed from its start, a truncated file is followed from its start.
     class FileObserver {
         private:
+            static constexpr uint32_t BLOCK_SIZE = 64 * 1024;
+
             class Sink : public Core::FileSystemMonitor::ICallback, public Core::IDispatch {
                 public:
                     Sink() = delete;
@@ -231,7 +249,10 @@ namespace Plugin
             struct ICallback
             {
                 virtual ~ICallback() {}
-                virtual void NewLine(const string &) = 0;
+                // One or more lines, each terminated by a '\n', except for the last part of a line that
+                // did not fit in a block or that was still unterminated when the file was rotated. The
+                // text was read at the given offset from the file with the given inode.
+                virtual void NewLines(const uint64_t inode, const uint64_t offset, const char text[], const uint32_t length) = 0;
             };
 
         public:
@@ -242,6 +263,13 @@ namespace Plugin
                 , _callback(nullptr)
                 , _position(0)
                 , _path()
+                , _directory()
+                , _descriptor(-1)
+                , _inode(0)
+                , _watching(false)
+                , _pending(false)
+                , _buffer(BLOCK_SIZE)
+                , _used(0)
             {
             }
             ~FileObserver()
@@ -255,84 +283,223 @@ namespace Plugin
             }
 
         public:
-            void Register(const string &entry, ICallback *callback, bool fullFile = false)
+            // With an inode, continue at the offset in that file, or at the start of the file if it was
+            // rotated meanwhile. Without, start at the end or, for the full file, at its start.
+            void Register(const string &entry, ICallback *callback, bool fullFile = false, const uint64_t inode = 0, const uint64_t offset = 0)
             {
-                ASSERT((_callback == nullptr) && (callback != nullptr));
-
-                if (fullFile == false) {
-                    _position = GetCurrentPosition(entry);
-                } else {
-                    _position = 0;
-                }
+                Attach(entry, callback, fullFile, inode, offset);
 
-                _path = entry;
-                _callback = callback;
-                Core::FileSystemMonitor::Instance().Register(&(*_job), _path);
+                // The directory tells us when a rotated file is created again.
+                Core::FileSystemMonitor::Instance().Register(&(*_job), _directory, IN_CREATE | IN_MOVED_TO);
+                Watch();
             }
             void Unregister()
             {
                 ASSERT(_callback != nullptr);
 
                 // First make sure the dispatcher Job will longer be fired
-                Core::FileSystemMonitor::Instance().Unregister(&(*_job), _path);
+                if (_watching == true) {
+                    Core::FileSystemMonitor::Instance().Unregister(&(*_job), _path);
+                    _watching = false;
+                }
+                Core::FileSystemMonitor::Instance().Unregister(&(*_job), _directory);
 
                 // Potentially the Job might still be waiting, let’s kill it
                 PluginHost::WorkerPool::Instance().Revoke(Core::proxy_cast<Core::IDispatchType<void> >(_job));
 
+                Detach();
+            }
+
+        protected:
+            // Register and Unregister without the file system monitor: nothing is read until Dispatch is called.
+            void Attach(const string &entry, ICallback *callback, bool fullFile = false, const uint64_t inode = 0, const uint64_t offset = 0)
+            {
+                ASSERT((_callback == nullptr) && (callback != nullptr));
+
+                size_t slash = entry.rfind('/');
+
+                _path = entry;
+                _directory = (slash == string::npos ? string(_T(".")) : (slash == 0 ? string(_T("/")) : entry.substr(0, slash)));
+                _callback = callback;
+
+                Open((fullFile == false) && (inode == 0));
+
+                if ((inode != 0) && (_descriptor != -1)) {
+                    struct stat info;
+
+                    _position = (((inode == _inode) && (::fstat(_descriptor, &info) == 0) && (offset <= static_cast<uint64_t>(info.st_size))) ? offset : 0);
+                }
+            }
+            void Detach()
+            {
+                ASSERT(_callback != nullptr);
+
+                Close();
+
                 _path = EMPTY_STRING;
+                _directory = EMPTY_STRING;
                 _position = 0;
+                _used = 0;
+                _pending = false;
                 _callback = nullptr;
             }
 
         private:
-            long int GetCurrentPosition(const string &filePath) const
+            void Open(const bool atEnd)
             {
-                long int pos = 0;
-                std::ifstream file(filePath.c_str());
-                if (file) {
-                    file.seekg(0, file.end);
-                    pos = file.tellg();
+                _descriptor = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+                _position = 0;
+                _inode = 0;
+                _used = 0;
+
+                if (_descriptor != -1) {
+                    struct stat info;
+
+                    if (::fstat(_descriptor, &info) == 0) {
+                        _inode = info.st_ino;
+                        if (atEnd == true) {
+                            _position = info.st_size;
+                        }
+                    }
                 }
-                return pos;
             }
-            void Dispatch()
+            void Close()
             {
-                std::ifstream file(_path);
-                if (file) {
-                    file.seekg(_position, file.beg);
-                    std::string str;
-                    while ((std::getline(file, str)) && (str.size() > 0)) {
+                if (_descriptor != -1) {
+                    ::close(_descriptor);
+                    _descriptor = -1;
+                }
+            }
+            void Watch()
+            {
+                // A watch is on an inode, so after a rotation it has to be placed on the new file.
+                if (_watching == true) {
+                    Core::FileSystemMonitor::Instance().Unregister(&(*_job), _path);
+                }
+                _watching = Core::FileSystemMonitor::Instance().Register(&(*_job), _path);
+            }
+            void Read()
+            {
+                ssize_t size;
+
+                while ((size = ::pread(_descriptor, &(_buffer[_used]), _buffer.size() - _used, _position)) > 0) {
+                    uint32_t end = _used + static_cast<uint32_t>(size);
+
+                    _position += size;
+                    _used = end;
+
+                    // Hand over up to the last complete line, keep the start of the next one.
+                    while ((end > 0) && (_buffer[end - 1] != '\n')) {
+                        end--;
+                    }
+                    if ((end == 0) && (_used == _buffer.size())) {
+                        // This line does not fit our buffer, pass it on in parts.
+                        end = _used;
+                    }
+                    if (end != 0) {
                         ASSERT(_callback != nullptr);
-                        _callback->NewLine(str);
+                        _callback->NewLines(_inode, _position - _used, _buffer.data(), end);
+
+                        _used -= end;
+                        ::memmove(_buffer.data(), &(_buffer[end]), _used);
                     }
                 }
-                _position = GetCurrentPosition(_path);
             }
+
+        protected:
+            // Reads what was appended, after a rotation or a truncation from the start of the file.
+            void Dispatch()
+            {
+                struct stat info;
+
+                _pending = false;
+
+                if (_descriptor == -1) {
+                    // The file did not exist (yet), if it does now, follow it from the start.
+                    Open(false);
+                    if (_descriptor != -1) {
+                        Watch();
+                    }
+                } else if ((::stat(_path.c_str(), &info) == 0) && (info.st_ino != _inode)) {
+                    // Rotated, what was still written to the old file comes first.
+                    Read();
+                    if (_used != 0) {
+                        _callback->NewLines(_inode, _position - _used, _buffer.data(), _used);
+                    }
+                    Close();
+                    Open(false);
+                    Watch();
+                }
+
+                if (_descriptor != -1) {
+                    if ((::fstat(_descriptor, &info) == 0) && (static_cast<uint64_t>(info.st_size) < _position)) {
+                        // Truncated, start all over.
+                        _position = 0;
+                        _used = 0;
+                    }
+                    Read();
+                }
+            }
+
+        private:
             void Updated()
             {
-                PluginHost::WorkerPool::Instance().Submit(Core::proxy_cast<Core::IDispatchType<void> >(_job));
+                // One read catches up with any number of changes, so no need to queue more than one.
+                if (_pending.exchange(true) == false) {
+                    PluginHost::WorkerPool::Instance().Submit(Core::proxy_cast<Core::IDispatchType<void> >(_job));
+                }
             }
 
         private:
             const Core::ProxyType<Sink> _job;
             ICallback *_callback;
-            long int _position;
+            uint64_t _position;
             string _path;
+            string _directory;
+            int _descriptor;
+            ino_t _inode;
+            bool _watching;
+            std::atomic<bool> _pending;
+            std::vector<char> _buffer;
+            uint32_t _used;
         };
 
     class FileTransfer : public PluginHost::IPlugin {
-        private:
+        protected:
 
             static constexpr uint16_t MAX_BUFFER_LENGHT = 1024;
             static constexpr uint16_t TIMEOUT_MS = 0;
+            // Sent data is only removed from the front of the send queue once it is at least this large.
+            static constexpr uint32_t MAX_SEND_QUEUE_SLACK = 64 * 1024;
+            // In the framed mode, the position sent last is stored at most this often (in ticks).
+            static constexpr uint64_t STORE_INTERVAL = 1000 * 1000;
 
+            // Sends the lines as text, or in the framed mode, the file as is, in numbered and possibly
+            // compressed frames (see Frame.h), remembering how far it got so it can resume after a restart.
             class TextChannel : public Core::SocketDatagram
             {
+                private:
+                    // A piece of the send queue that is a contiguous part of a file.
+                    struct Run {
+                        uint64_t Inode;
+                        uint64_t Offset;
+                        uint32_t Length;
+                    };
+
                 public:
                     TextChannel()
                         : Core::SocketDatagram(false, Core::NodeId().Origin(), Core::NodeId(), MAX_BUFFER_LENGHT, 0)
                         , _sendQueue()
                         , _offset(0)
+                        , _framed(false)
+                        , _compress(false)
+                        , _session(0)
+                        , _sequence(0)
+                        , _runs()
+                        , _store(-1)
+                        , _stored(0)
+                        , _sentInode(0)
+                        , _sentOffset(0)
                     {
                     }
                     virtual ~TextChannel()
@@ -340,6 +507,10 @@ namespace Plugin
                         _sendQueue.clear();
                         _offset = 0;
                         Close(Core::infinite);
+
+                        if (_store != -1) {
+                            ::close(_store);
+                        }
                     }
 
                     void SetDestination(const string& binding, const uint16_t &port)
@@ -351,12 +522,76 @@ namespace Plugin
                         Open(TIMEOUT_MS);
                     }
 
-                    void NewLine(const string& text)
+                    // Switches to the framed mode. The position sent last is kept in the storage file, if there
+                    // is one, returns true if it held a position to resume from.
+                    bool Framed(const bool compress, const string& storage, uint64_t& inode, uint64_t& offset)
+                    {
+                        bool result = false;
+
+                        _adminLock.Lock();
+
+                        _framed = true;
+                        _compress = compress && Transfer::Frame::CanCompress();
+                        _session = static_cast<uint32_t>(Core::Time::Now().Ticks());
+                        _sequence = 0;
+
+                        if ((storage.empty() == false) && ((_store = ::open(storage.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)) != -1)) {
+                            uint64_t position[2];
+
+                            if ((::pread(_store, position, sizeof(position), 0) == sizeof(position)) && (position[0] != 0)) {
+                                _sentInode = inode = position[0];
+                                _sentOffset = offset = position[1];
+                                result = true;
+                            }
+                        }
+
+                        _adminLock.Unlock();
+
+                        return (result);
+                    }
+                    void Store()
+                    {
+                        _adminLock.Lock();
+
+                        Save();
+
+                        _adminLock.Unlock();
+                    }
+
+                    // Queues the lines, as text each followed by the terminator (empty lines are skipped), or as
+                    // is in the framed mode.
+                    void NewLines(const uint64_t inode, const uint64_t offset, const char text[], const uint32_t length)
                     {
                         _adminLock.Lock();
 
-                        _sendQueue.emplace_back(text);
-                        bool trigger = (_sendQueue.size() == 1);
+                        bool trigger = (_offset == _sendQueue.size());
+
+                        if (_framed == false) {
+                            const char* line = text;
+                            const char* end = &(text[length]);
+
+                            while (line < end) {
+                                const char* next = static_cast<const char*>(::memchr(line, '\n', end - line));
+                                const char* stop = (next != nullptr ? next : end);
+
+                                if (stop != line) {
+                                    _sendQueue.append(line, stop - line);
+                                    _sendQueue.append(_terminator.Marker(), _terminator.SizeOf());
+                                }
+
+                                line = (next != nullptr ? next + 1 : end);
+                            }
+                        } else if (length != 0) {
+                            _sendQueue.append(text, length);
+
+                            if ((_runs.empty() == false) && (_runs.back().Inode == inode) && ((_runs.back().Offset + _runs.back().Length) == offset)) {
+                                _runs.back().Length += length;
+                            } else {
+                                _runs.push_back({ inode, offset, length });
+                            }
+                        }
+
+                        trigger = trigger && (_offset != _sendQueue.size());
 
                         _adminLock.Unlock();
 
@@ -365,7 +600,7 @@ namespace Plugin
                             Trigger();
                         }
                     }
-                private:
+                protected:
                     // Methods to extract and insert data into the socket buffers
                     uint16_t SendData(uint8_t *dataFrame, const uint16_t maxSendSize) override
                     {
@@ -373,39 +608,17 @@ namespace Plugin
 
                         _adminLock.Lock();
 
-                        if (_offset == static_cast<uint32_t>(~0)) {
-                            // We are done with this entry it has been sent!!! discard it.
-                            _sendQueue.pop_front();
-                            _offset = 0;
-                        }
-
-                        if (_sendQueue.size() > 0) {
-                            const string& sendObject = _sendQueue.front();
-
-                            // Do we still need to send data from the text..
-                            if (_offset < (sendObject.size() * sizeof(TCHAR))) {
-                                result = (((sendObject.size() * sizeof(TCHAR)) - _offset) > maxSendSize ? maxSendSize : ((sendObject.size() * sizeof(TCHAR)) - _offset));
+                        if (_offset < _sendQueue.size()) {
+                            result = (_framed == false ? SendLines(dataFrame, maxSendSize) : SendFrame(dataFrame, maxSendSize));
 
-                                _offset += SendCharacters(dataFrame, &(sendObject.c_str()[(_offset / sizeof(TCHAR))]), (_offset % sizeof(TCHAR)), result);
+                            if (_offset == _sendQueue.size()) {
+                                // All sent, start over, keeping the memory we have.
+                                _sendQueue.clear();
+                                _offset = 0;
+                            } else if ((_offset >= MAX_SEND_QUEUE_SLACK) && (_offset > (_sendQueue.size() / 2))) {
+                                _sendQueue.erase(0, _offset);
+                                _offset = 0;
                             }
-
-                            // See if we can write the closing marker
-                            if ((maxSendSize != result) && (_offset >= (sendObject.size() * sizeof(TCHAR))) && (_offset < ((sendObject.size() + (_terminator.SizeOf())) * sizeof(TCHAR)))) {
-                                uint8_t markerSize = (static_cast<uint8_t>(_terminator.SizeOf()) * sizeof(TCHAR));
-                                uint8_t markerOffset = ((sendObject.size() * sizeof(TCHAR)) - _offset);
-                                uint16_t size = ((markerSize - markerOffset) > (maxSendSize - result) ? (maxSendSize - result) : (markerSize - markerOffset));
-
-                                _offset += SendCharacters(&(dataFrame[result]), &(_terminator.Marker()[(markerOffset / sizeof(TCHAR))]), (markerOffset % sizeof(TCHAR)), size);
-                                result += size;
-
-                                if ((size + markerOffset) == markerSize) {
-                                    // Report as completed on the next run
-                                    _offset = static_cast<uint32_t>(~0);
-                                }
-                            }
-
-                            // If we went through this entry we must have processed something....
-                            ASSERT(result != 0);
                         }
 
                         _adminLock.Unlock();
@@ -422,19 +635,109 @@ namespace Plugin
                     {
                     }
 
-                    uint16_t SendCharacters(uint8_t *dataFrame, const TCHAR stream[], const uint8_t delta, const uint16_t total)
+                private:
+                    uint16_t SendLines(uint8_t *dataFrame, const uint16_t maxSendSize)
                     {
-                        ASSERT(delta == 0);
-                        // Copying from an aligned position..
-                        ::memcpy(dataFrame, stream, total);
-                        return (total);
+                        const char* start = &(_sendQueue[_offset]);
+                        const uint32_t available = static_cast<uint32_t>(_sendQueue.size()) - _offset;
+                        uint16_t result;
+
+                        if (available <= maxSendSize) {
+                            result = static_cast<uint16_t>(available);
+                        } else {
+                            // As many complete lines as fit in the datagram, only a line that does
+                            // not fit on its own is split.
+                            const uint16_t markerSize = static_cast<uint16_t>(_terminator.SizeOf() * sizeof(TCHAR));
+
+                            result = maxSendSize;
+                            while ((result >= markerSize) && (::memcmp(&(start[result - markerSize]), _terminator.Marker(), markerSize) != 0)) {
+                                result--;
+                            }
+                            if (result < markerSize) {
+                                result = maxSendSize;
+                            }
+                        }
+
+                        ::memcpy(dataFrame, start, result);
+                        _offset += result;
+
+                        return (result);
+                    }
+                    uint16_t SendFrame(uint8_t *dataFrame, const uint16_t maxSendSize)
+                    {
+                        ASSERT((_runs.empty() == false) && (maxSendSize > Transfer::Frame::HEADER_SIZE));
+
+                        Run& run(_runs.front());
+                        const uint8_t* start = reinterpret_cast<const uint8_t*>(&(_sendQueue[_offset]));
+                        const uint16_t capacity = maxSendSize - Transfer::Frame::HEADER_SIZE;
+                        Transfer::Frame frame;
+                        uint32_t consumed = 0;
+                        uint16_t size = 0;
+
+                        if (_compress == true) {
+                            size = Transfer::Frame::Compress(start, run.Length, &(dataFrame[Transfer::Frame::HEADER_SIZE]), capacity, consumed);
+                        }
+
+                        if (size != 0) {
+                            frame.Flags = Transfer::Frame::COMPRESSED;
+                        } else {
+                            consumed = std::min(run.Length, static_cast<uint32_t>(capacity));
+                            size = static_cast<uint16_t>(consumed);
+                            ::memcpy(&(dataFrame[Transfer::Frame::HEADER_SIZE]), start, consumed);
+                        }
+
+                        frame.Session = _session;
+                        frame.Sequence = _sequence++;
+                        frame.Inode = run.Inode;
+                        frame.Offset = run.Offset;
+                        frame.Length = static_cast<uint16_t>(consumed);
+                        frame.Serialize(dataFrame);
+
+                        _offset += consumed;
+                        run.Offset += consumed;
+                        run.Length -= consumed;
+
+                        _sentInode = run.Inode;
+                        _sentOffset = run.Offset;
+
+                        if (run.Length == 0) {
+                            _runs.pop_front();
+                        }
+
+                        // Saving the position costs a write, do it once in a while, a restart may send a bit twice.
+                        const uint64_t now = Core::Time::Now().Ticks();
+                        if (now >= (_stored + STORE_INTERVAL)) {
+                            Save();
+                            _stored = now;
+                        }
+
+                        return (Transfer::Frame::HEADER_SIZE + size);
+                    }
+                    void Save()
+                    {
+                        if ((_store != -1) && (_sentInode != 0)) {
+                            const uint64_t position[2] = { _sentInode, _sentOffset };
+
+                            if (::pwrite(_store, position, sizeof(position), 0) != sizeof(position)) {
+                                TRACE_L1(_T("Could not store the position, error: %d"), errno);
+                            }
+                        }
                     }
 
                 private:
                     Core::CriticalSection _adminLock;
-                    std::list<string> _sendQueue;
-                    uint32_t _offset;
+                    string _sendQueue; // lines, each followed by the terminator, or in the framed mode, the runs
+                    uint32_t _offset; // of the first byte in the queue that is not sent yet
                     Core::TerminatorCarriageReturn _terminator;
+                    bool _framed;
+                    bool _compress;
+                    uint32_t _session;
+                    uint32_t _sequence;
+                    std::list<Run> _runs;
+                    int _store;
+                    uint64_t _stored; // ticks
+                    uint64_t _sentInode;
+                    uint64_t _sentOffset;
             };
 
             class OnChangeFile: public FileObserver::ICallback
@@ -452,11 +755,11 @@ namespace Plugin
                     OnChangeFile(const OnChangeFile &) = delete;
                     OnChangeFile &operator=(const OnChangeFile &) = delete;
 
-                    void NewLine(const string &text) override
+                    void NewLines(const uint64_t inode, const uint64_t offset, const char text[], const uint32_t length) override
                     {
                         _adminLock.Lock();
 
-                        _parent.NewLine(text);
+                        _parent.NewLines(inode, offset, text, length);
 
                         _adminLock.Unlock();
                     }
@@ -503,10 +806,12 @@ namespace Plugin
 
                 public:
                     Config()
-                        : FilePath(_T("/var/log/messages")), FullFile(false), Destination()
+                        : FilePath(_T("/var/log/messages")), FullFile(false), Framed(false), Compress(true), Destination()
                     {
                         Add(_T("filepath"), &FilePath);
                         Add(_T("fullfile"), &FullFile);
+                        Add(_T("framed"), &Framed);
+                        Add(_T("compress"), &Compress);
                         Add(_T("destination"), &Destination);
                     }
                     ~Config() override {}
@@ -514,6 +819,8 @@ namespace Plugin
                 public:
                     Core::JSON::String FilePath;
                     Core::JSON::Boolean FullFile;
+                    Core::JSON::Boolean Framed; // numbered, resumable frames, see Frame.h
+                    Core::JSON::Boolean Compress; // the frames, if LZ4 is available
                     NetworkNode Destination;
             };
 
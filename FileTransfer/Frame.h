@@ -0,0 +1,139 @@
+#pragma once
+
+#ifdef LZ4_ENABLED
+#include <lz4.h>
+#endif
+
+namespace WPEFramework {
+namespace Transfer {
+
+    // A datagram of the framed mode of the FileTransfer plugin: this header followed by a piece of the file,
+    // LZ4 compressed if the header says so. Frames are numbered within a session (a run of the plugin) so a
+    // receiver can see loss and reordering. The inode and offset say where the piece comes from, so after a
+    // restart a receiver can drop what it already got. All fields are in network byte order.
+    class Frame {
+    public:
+        static constexpr uint16_t MAGIC = 0xF71E;
+        static constexpr uint8_t VERSION = 1;
+        static constexpr uint16_t HEADER_SIZE = 30;
+
+        enum flags : uint8_t {
+            COMPRESSED = 0x01
+        };
+
+    public:
+        Frame()
+            : Flags(0)
+            , Session(0)
+            , Sequence(0)
+            , Inode(0)
+            , Offset(0)
+            , Length(0)
+        {
+        }
+        ~Frame()
+        {
+        }
+
+    public:
+        static constexpr bool CanCompress()
+        {
+#ifdef LZ4_ENABLED
+            return (true);
+#else
+            return (false);
+#endif
+        }
+        void Serialize(uint8_t buffer[]) const
+        {
+            Write(&(buffer[0]), MAGIC, 2);
+            buffer[2] = VERSION;
+            buffer[3] = Flags;
+            Write(&(buffer[4]), Session, 4);
+            Write(&(buffer[8]), Sequence, 4);
+            Write(&(buffer[12]), Inode, 8);
+            Write(&(buffer[20]), Offset, 8);
+            Write(&(buffer[28]), Length, 2);
+        }
+        bool Deserialize(const uint8_t buffer[], const uint16_t size)
+        {
+            bool result = ((size >= HEADER_SIZE) && (Read(&(buffer[0]), 2) == MAGIC) && (buffer[2] == VERSION));
+
+            if (result == true) {
+                Flags = buffer[3];
+                Session = static_cast<uint32_t>(Read(&(buffer[4]), 4));
+                Sequence = static_cast<uint32_t>(Read(&(buffer[8]), 4));
+                Inode = Read(&(buffer[12]), 8);
+                Offset = Read(&(buffer[20]), 8);
+                Length = static_cast<uint16_t>(Read(&(buffer[28]), 2));
+            }
+
+            return (result);
+        }
+        // Compresses as much of the source as fits in the destination. Returns the size of the compressed data,
+        // consumed tells how much of the source it holds. Returns 0 if compressing does not pay off.
+        static uint16_t Compress(const uint8_t source[], const uint32_t length, uint8_t destination[], const uint16_t capacity, uint32_t& consumed)
+        {
+            uint16_t result = 0;
+
+            consumed = 0;
+
+#ifdef LZ4_ENABLED
+            int size = static_cast<int>(std::min(length, static_cast<uint32_t>(0xFFFF)));
+            int written = ::LZ4_compress_destSize(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(destination), &size, capacity);
+
+            // It pays off as soon as the compressed data is smaller than the input it holds.
+            if ((written > 0) && (written < size)) {
+                result = static_cast<uint16_t>(written);
+                consumed = static_cast<uint32_t>(size);
+            }
+#else
+            DEBUG_VARIABLE(source);
+            DEBUG_VARIABLE(length);
+            DEBUG_VARIABLE(destination);
+            DEBUG_VARIABLE(capacity);
+#endif
+
+            return (result);
+        }
+        static bool Decompress(const uint8_t source[], const uint16_t length, uint8_t destination[], const uint16_t size)
+        {
+#ifdef LZ4_ENABLED
+            return (::LZ4_decompress_safe(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(destination), length, size) == size);
+#else
+            DEBUG_VARIABLE(source);
+            DEBUG_VARIABLE(length);
+            DEBUG_VARIABLE(destination);
+            DEBUG_VARIABLE(size);
+            return (false);
+#endif
+        }
+
+    private:
+        static void Write(uint8_t buffer[], const uint64_t value, const uint8_t size)
+        {
+            for (uint8_t index = 0; index < size; index++) {
+                buffer[index] = static_cast<uint8_t>(value >> (8 * (size - 1 - index)));
+            }
+        }
+        static uint64_t Read(const uint8_t buffer[], const uint8_t size)
+        {
+            uint64_t result = 0;
+
+            for (uint8_t index = 0; index < size; index++) {
+                result = (result << 8) | buffer[index];
+            }
+
+            return (result);
+        }
+
+    public:
+        uint8_t Flags;
+        uint32_t Session;
+        uint32_t Sequence;
+        uint64_t Inode;
+        uint64_t Offset; // in the file, of the first byte in the frame
+        uint16_t Length; // of the data in the frame, uncompressed
+    };
+}
+}
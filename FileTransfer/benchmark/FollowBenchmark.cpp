@@ -0,0 +1,342 @@
+// Measures how fast FileTransfer gets the lines of a followed file into datagrams: FileObserver reads the file in
+// blocks and hands the complete lines to the TextChannel, which packs as many of them in a datagram as fit. As a
+// reference, the file is also sent the way it was before: read with std::getline into a list of strings, one line
+// (and its terminator) per datagram. The framed mode (see Frame.h) is measured as well, with and without LZ4 if
+// the benchmark is built with it, to see what the frame headers add and what compressing saves on the wire.
+// Both read a file that is in the page cache from the start and fill the datagrams as soon as there are lines, so
+// the queue stays short, as it does when the socket keeps up. No socket is involved: the send calls, one per
+// datagram, come on top of the numbers, so the datagram count tells what they would add.
+
+#include "../Module.h"
+#include "../FileTransfer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <list>
+#include <unistd.h>
+
+using namespace WPEFramework;
+
+namespace {
+
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr uint32_t LineLength = 98; // Without the newline, about a syslog line.
+    static constexpr uint8_t Runs = 3;
+
+    // Reaches the channel of the plugin and the datagram size it is opened with.
+    class Access : public Plugin::FileTransfer {
+    public:
+        static constexpr uint16_t DatagramSize = MAX_BUFFER_LENGHT;
+
+        class Channel : public TextChannel {
+        private:
+            Channel(const Channel&) = delete;
+            Channel& operator=(const Channel&) = delete;
+
+        public:
+            Channel()
+                : TextChannel()
+            {
+            }
+            ~Channel()
+            {
+            }
+
+        public:
+            // Fills a datagram like the socket would before sending it, 0 if nothing is queued.
+            uint16_t Fill(uint8_t dataFrame[], const uint16_t maxSendSize)
+            {
+                return (SendData(dataFrame, maxSendSize));
+            }
+        };
+    };
+
+    // Reads the file once, from its start, as the plugin does when the file changed.
+    class Follower : public Plugin::FileObserver {
+    private:
+        Follower(const Follower&) = delete;
+        Follower& operator=(const Follower&) = delete;
+
+    public:
+        Follower()
+            : Plugin::FileObserver()
+        {
+        }
+        ~Follower()
+        {
+        }
+
+    public:
+        void Follow(const string& path, ICallback* callback)
+        {
+            Attach(path, callback, true);
+            Dispatch();
+            Detach();
+        }
+    };
+
+    class Result {
+    public:
+        Result()
+            : Seconds(0.0)
+            , CPU(0.0)
+            , Lines(0)
+            , Datagrams(0)
+            , Bytes(0)
+            , Payload(0)
+            , Contiguous(true)
+        {
+        }
+
+    public:
+        double Seconds;
+        double CPU; // seconds
+        uint64_t Lines;
+        uint64_t Datagrams;
+        uint64_t Bytes; // on the wire, with the frame headers
+        uint64_t Payload; // of the file the frames hold
+        bool Contiguous; // every frame continues where the one before stopped
+    };
+
+    // Hands the lines to the channel and sends what it queued.
+    class Sender : public Plugin::FileObserver::ICallback {
+    private:
+        Sender(const Sender&) = delete;
+        Sender& operator=(const Sender&) = delete;
+
+    public:
+        Sender(Access::Channel& channel, const bool framed, Result& result)
+            : _channel(channel)
+            , _framed(framed)
+            , _result(result)
+        {
+        }
+        ~Sender() override
+        {
+        }
+
+    public:
+        void NewLines(const uint64_t inode, const uint64_t offset, const char text[], const uint32_t length) override
+        {
+            uint8_t frame[Access::DatagramSize];
+            uint16_t size;
+
+            _result.Lines += static_cast<uint64_t>(std::count(text, &(text[length]), '\n'));
+
+            _channel.NewLines(inode, offset, text, length);
+
+            while ((size = _channel.Fill(frame, sizeof(frame))) != 0) {
+                Transfer::Frame header;
+
+                _result.Datagrams++;
+                _result.Bytes += size;
+
+                if ((_framed == true) && (header.Deserialize(frame, size) == true)) {
+                    _result.Contiguous = _result.Contiguous && (header.Offset == _result.Payload);
+                    _result.Payload += header.Length;
+                }
+            }
+        }
+
+    private:
+        Access::Channel& _channel;
+        const bool _framed;
+        Result& _result;
+    };
+
+    double CPUTime()
+    {
+        struct timespec now;
+        ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+        return (static_cast<double>(now.tv_sec) + (static_cast<double>(now.tv_nsec) / 1000000000.0));
+    }
+
+    template <typename ACTION>
+    Result Measure(ACTION&& action)
+    {
+        Result best;
+
+        for (uint8_t run = 0; run < Runs; run++) {
+            Result result;
+            const double cpu = CPUTime();
+            const Clock::time_point start(Clock::now());
+
+            action(result);
+
+            result.Seconds = std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start).count();
+            result.CPU = CPUTime() - cpu;
+
+            if ((run == 0) || (result.Seconds < best.Seconds)) {
+                best = result;
+            }
+        }
+
+        return (best);
+    }
+
+    void Reference(const string& path, Result& result)
+    {
+        Core::TerminatorCarriageReturn terminator;
+        std::ifstream file(path);
+        std::list<string> queue;
+        std::string line;
+        uint8_t frame[Access::DatagramSize];
+
+        while ((std::getline(file, line)) && (line.size() > 0)) {
+            queue.emplace_back(line);
+            result.Lines++;
+
+            // One line a datagram, a line that does not fit goes in parts.
+            while (queue.empty() == false) {
+                const string& text(queue.front());
+                const uint32_t total = static_cast<uint32_t>(text.size() + terminator.SizeOf());
+                uint32_t offset = 0;
+
+                while (offset < total) {
+                    uint16_t size = 0;
+
+                    if (offset < text.size()) {
+                        size = static_cast<uint16_t>(std::min(text.size() - offset, sizeof(frame)));
+                        ::memcpy(frame, &(text[offset]), size);
+                        offset += size;
+                    }
+                    if ((offset >= text.size()) && (size < sizeof(frame))) {
+                        const uint32_t marker = static_cast<uint32_t>(offset - text.size());
+                        const uint16_t part = static_cast<uint16_t>(std::min(static_cast<size_t>(terminator.SizeOf() - marker), sizeof(frame) - size));
+
+                        ::memcpy(&(frame[size]), &(terminator.Marker()[marker]), part);
+                        size += part;
+                        offset += part;
+                    }
+
+                    result.Datagrams++;
+                    result.Bytes += size;
+                }
+
+                queue.pop_front();
+            }
+        }
+    }
+
+    void Current(const string& path, const bool framed, const bool compress, Result& result)
+    {
+        Access::Channel channel;
+        Sender sender(channel, framed, result);
+        Follower follower;
+
+        if (framed == true) {
+            uint64_t inode;
+            uint64_t offset;
+
+            // No storage, nothing to resume from.
+            channel.Framed(compress, EMPTY_STRING, inode, offset);
+        }
+
+        follower.Follow(path, &sender);
+    }
+
+    static const char* Daemons[] = { "sshd", "dnsmasq", "WPEFramework", "kernel", "systemd", "dropbear", "crond", "ntpd" };
+    static const char* Words[] = { "connection", "from", "accepted", "closed", "session", "opened", "for", "user", "root",
+        "timeout", "retry", "service", "started", "stopped", "port", "address", "request", "completed", "failed", "with",
+        "error", "cache", "miss", "lease", "renewed", "interface", "eth0", "wlan0", "link", "up", "down", "plugin" };
+
+    // Syslog like lines: a time stamp, a daemon and its pid, words and numbers picked by a fixed sequence, so the
+    // text compresses about as well as a real log does, and every run gets the same file.
+    bool Write(const string& fileName, const uint32_t lines)
+    {
+        Core::File file(fileName, false);
+        bool result = (file.Create() == true);
+        uint32_t random = 1;
+        string block;
+
+        for (uint32_t index = 0; (index < lines) && (result == true); index++) {
+            const uint32_t second = 5 * 3600 + 12 * 60 + (index / 200);
+            const uint32_t daemon = (index * 7) % (sizeof(Daemons) / sizeof(Daemons[0]));
+            char line[LineLength + 32];
+            int length = ::snprintf(line, sizeof(line), "Oct 17 %02d:%02d:%02d device %s[%d]: ", (second / 3600) % 24, (second / 60) % 60, second % 60, Daemons[daemon], 400 + (daemon * 37));
+
+            while (length < static_cast<int>(LineLength)) {
+                random = (random * 1103515245) + 12345;
+
+                if (((random >> 16) % 5) == 0) {
+                    length += ::snprintf(&(line[length]), sizeof(line) - length, "%u ", (random >> 8) % 65536);
+                } else {
+                    length += ::snprintf(&(line[length]), sizeof(line) - length, "%s ", Words[(random >> 16) % (sizeof(Words) / sizeof(Words[0]))]);
+                }
+            }
+
+            block.append(line, LineLength);
+            block += '\n';
+
+            if ((block.size() >= (1024 * 1024)) || ((index + 1) == lines)) {
+                result = (file.Write(reinterpret_cast<const uint8_t*>(block.c_str()), static_cast<uint32_t>(block.size())) == block.size());
+                block.clear();
+            }
+        }
+
+        file.Close();
+
+        return (result);
+    }
+
+    void Report(const char name[], const Result& result, const uint64_t size)
+    {
+        printf("   %-10s %12.2f %10.3f %12.2f %12llu %12.1f\n", name, (static_cast<double>(result.Lines) / result.Seconds) / 1000000.0, result.CPU,
+            (result.CPU * 1000.0) / (static_cast<double>(size) / (1024 * 1024)), static_cast<unsigned long long>(result.Datagrams),
+            static_cast<double>(result.Bytes) / (1024 * 1024));
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    const uint32_t lines = (argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 2000000);
+    const string fileName(Core::Directory::Normalize(P_tmpdir) + _T("filetransfer.") + Core::NumberType<uint32_t>(::getpid()).Text() + _T(".log"));
+    bool intact = false;
+
+    if (lines == 0) {
+        fprintf(stderr, "Usage: %s [number of lines, default 2000000]\n", argv[0]);
+    } else if (Write(fileName, lines) == false) {
+        fprintf(stderr, "Could not write %s\n", fileName.c_str());
+    } else {
+        const uint64_t size = static_cast<uint64_t>(lines) * (LineLength + 1);
+
+        printf("%d lines of %d bytes (%.1f MiB), %d byte datagrams, best of %d runs\n", lines, LineLength + 1, static_cast<double>(size) / (1024 * 1024), Access::DatagramSize, Runs);
+        printf("   %-10s %12s %10s %12s %12s %12s\n", "path", "M lines/s", "CPU s", "CPU ms/MiB", "datagrams", "MiB on wire");
+
+        const Result old = Measure([&](Result& result) { Reference(fileName, result); });
+        Report("getline", old, size);
+
+        const Result current = Measure([&](Result& result) { Current(fileName, false, false, result); });
+        Report("blocks", current, size);
+
+        const Result framed = Measure([&](Result& result) { Current(fileName, true, false, result); });
+        Report("framed", framed, size);
+
+        // The text paths send the same stream, only cut in other datagrams, the frames hold all of the file.
+        intact = (old.Lines == lines) && (current.Lines == lines) && (old.Bytes == current.Bytes) && (framed.Payload == size) && (framed.Contiguous == true);
+
+        if (Transfer::Frame::CanCompress() == false) {
+            printf("   %-10s not built with LZ4\n", "framed+lz4");
+        } else {
+            const Result compressed = Measure([&](Result& result) { Current(fileName, true, true, result); });
+            Report("framed+lz4", compressed, size);
+
+            intact = intact && (compressed.Payload == size) && (compressed.Contiguous == true);
+        }
+
+        if (intact == false) {
+            fprintf(stderr, "The paths did not send the same lines\n");
+        }
+    }
+
+    ::unlink(fileName.c_str());
+
+    Core::Singleton::Dispose();
+
+    return (intact == true ? 0 : 1);
+}
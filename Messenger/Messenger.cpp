@@ -1,5 +1,6 @@
 #include "Module.h"
 #include "Messenger.h"
+#include "RoomImpl.h"
 #include "cryptalgo/Hash.h"
 
 namespace WPEFramework {
@@ -24,6 +25,17 @@ namespace Plugin {
         _roomAdmin = service->Root<Exchange::IRoomAdministrator>(_connectionId, 2000, _T("RoomMaintainer"));
         ASSERT(_roomAdmin != nullptr);
 
+        // The room administrator interface has no means to configure it, nor to replay the history or hold back
+        // senders, so only if it runs in our process these are available, otherwise the defaults are used.
+        _maintainer = dynamic_cast<RoomMaintainer*>(_roomAdmin);
+
+        if (_maintainer != nullptr) {
+            Config config;
+            config.FromString(service->ConfigLine());
+
+            _maintainer->Configure(config.MailboxSize.Value(), config.Overflow.Value(), config.HistorySize.Value(), config.HistoryBytes.Value(), config.HighWater.Value());
+        }
+
         _roomAdmin->Register(this);
 
         return { };
@@ -43,6 +55,7 @@ namespace Plugin {
         _roomAdmin->Unregister(this);
         _rooms.clear();
 
+        _maintainer = nullptr;
         _roomAdmin->Release();
         _roomAdmin = nullptr;
 
@@ -52,7 +65,7 @@ namespace Plugin {
 
     // Web request handlers
 
-    string Messenger::JoinRoom(const string& roomName, const string& userName)
+    string Messenger::JoinRoom(const string& roomName, const string& userName, const uint64_t since)
     {
         bool result = false;
 
@@ -62,7 +75,8 @@ namespace Plugin {
         ASSERT(sink != nullptr);
 
         if (sink != nullptr) {
-            Exchange::IRoomAdministrator::IRoom* room = _roomAdmin->Join(roomName, userName, sink);
+            Exchange::IRoomAdministrator::IRoom* room = (_maintainer != nullptr ? _maintainer->Join(roomName, userName, sink, since)
+                                                                                : _roomAdmin->Join(roomName, userName, sink));
 
             // Note: Join() can return nullptr if the user has already joined the room.
             if (room != nullptr) {
@@ -113,37 +127,46 @@ namespace Plugin {
 
     bool Messenger::LeaveRoom(const string& roomId)
     {
-        bool result = false;
+        Exchange::IRoomAdministrator::IRoom* room = nullptr;
 
         _adminLock.Lock();
 
         auto it(_roomIds.find(roomId));
 
         if (it != _roomIds.end()) {
-            // Exit the room.
-            (*it).second->Release();
+            room = (*it).second;
             // Invalidate the room ID.
             _roomIds.erase(it);
-            result = true;
         }
 
         _adminLock.Unlock();
 
-        return result;
+        // Exit the room. Not under the lock, leaving waits for a delivery to this user that is in progress.
+        if (room != nullptr) {
+            room->Release();
+        }
+
+        return (room != nullptr);
     }
 
-    bool Messenger::SendMessage(const string& roomId, const string& message)
+    uint32_t Messenger::SendMessage(const string& roomId, const string& message)
     {
-        bool result = false;
+        uint32_t result = Core::ERROR_UNKNOWN_KEY;
 
         _adminLock.Lock();
 
         auto it(_roomIds.find(roomId));
 
         if (it != _roomIds.end()) {
-            // Send the message to the room.
-            (*it).second->SendMessage(message);
-            result = true;
+            // Send the message to the room, only a room in our process can tell the sender to back off.
+            RoomImpl* room = (_maintainer != nullptr ? dynamic_cast<RoomImpl*>((*it).second) : nullptr);
+
+            if (room == nullptr) {
+                (*it).second->SendMessage(message);
+                result = Core::ERROR_NONE;
+            } else {
+                result = room->Send(message);
+            }
         }
 
         _adminLock.Unlock();
@@ -151,6 +174,30 @@ namespace Plugin {
         return result;
     }
 
+    void Messenger::DisconnectedHandler(const string& roomId)
+    {
+        Exchange::IRoomAdministrator::IRoom* room = nullptr;
+
+        _adminLock.Lock();
+
+        auto it(_roomIds.find(roomId));
+
+        if (it != _roomIds.end()) {
+            room = (*it).second;
+            // Invalidate the room ID, the user is not in the room anymore.
+            _roomIds.erase(it);
+        }
+
+        _adminLock.Unlock();
+
+        // This is reported from a delivery to this user, exiting the room waits for that delivery to complete.
+        if (room != nullptr) {
+            TRACE(Trace::Information, (_T("Room ID '%s' is invalidated, the user was disconnected"), roomId.c_str()));
+
+            PluginHost::WorkerPool::Instance().Submit(Core::proxy_cast<Core::IDispatch>(Core::ProxyType<Eviction>::Create(room)));
+        }
+    }
+
     // Helpers
 
     string Messenger::GenerateRoomId(const string& roomName, const string& userName)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Module.h"
+#include "RoomMaintainer.h"
 #include <interfaces/IMessenger.h>
 #include <interfaces/json/JsonData_Messenger.h>
 #include <map>
@@ -14,6 +15,155 @@ namespace Plugin {
     class Messenger : public PluginHost::IPlugin
                     , public Exchange::IRoomAdministrator::INotification
                     , public PluginHost::JSONRPCSupportsEventStatus {
+    private:
+        // Exits a room the user was disconnected from, on behalf of the user.
+        class Eviction : public Core::IDispatch {
+        public:
+            Eviction() = delete;
+            Eviction(const Eviction&) = delete;
+            Eviction& operator=(const Eviction&) = delete;
+
+            Eviction(Exchange::IRoomAdministrator::IRoom* room)
+                : _room(room)
+            {
+                ASSERT(room != nullptr);
+            }
+            ~Eviction() override
+            {
+                if (_room != nullptr) {
+                    _room->Release();
+                }
+            }
+
+            void Dispatch() override
+            {
+                _room->Release();
+                _room = nullptr;
+            }
+
+        private:
+            Exchange::IRoomAdministrator::IRoom* _room;
+        };
+
+        class Config : public Core::JSON::Container {
+        public:
+            Config(const Config&) = delete;
+            Config& operator=(const Config&) = delete;
+
+            Config()
+                : Core::JSON::Container()
+                , MailboxSize(64)
+                , Overflow(RoomMaintainer::DROP_OLDEST)
+                , HistorySize(100)
+                , HistoryBytes(64 * 1024)
+                , HighWater(0)
+            {
+                Add(_T("mailboxsize"), &MailboxSize);
+                Add(_T("overflow"), &Overflow);
+                Add(_T("historysize"), &HistorySize);
+                Add(_T("historybytes"), &HistoryBytes);
+                Add(_T("highwater"), &HighWater);
+            }
+            ~Config()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt16 MailboxSize;
+            Core::JSON::EnumType<RoomMaintainer::overflow> Overflow;
+            Core::JSON::DecUInt16 HistorySize;
+            Core::JSON::DecUInt32 HistoryBytes;
+            Core::JSON::DecUInt16 HighWater;
+        };
+
+        // The generated join parameters, plus the sequence number of the last message seen.
+        class JoinParams : public JsonData::Messenger::JoinParamsData {
+        public:
+            JoinParams(const JoinParams&) = delete;
+            JoinParams& operator=(const JoinParams&) = delete;
+
+            JoinParams()
+                : JsonData::Messenger::JoinParamsData()
+                , Since(0)
+            {
+                Add(_T("since"), &Since);
+            }
+            ~JoinParams()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt64 Since;
+        };
+
+        // The generated message parameters, plus the sequence number of the message.
+        class MessageParams : public JsonData::Messenger::MessageParamsData {
+        public:
+            MessageParams(const MessageParams&) = delete;
+            MessageParams& operator=(const MessageParams&) = delete;
+
+            MessageParams()
+                : JsonData::Messenger::MessageParamsData()
+                , Sequence(0)
+            {
+                Add(_T("sequence"), &Sequence);
+            }
+            ~MessageParams()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt64 Sequence;
+        };
+
+        // The counters of a room, see RoomMaintainer::Statistics.
+        class RoomData : public Core::JSON::Container {
+        public:
+            RoomData& operator=(const RoomData&) = delete;
+
+            RoomData()
+                : Core::JSON::Container()
+            {
+                Init();
+            }
+            RoomData(const RoomData& copy)
+                : Core::JSON::Container()
+                , Room(copy.Room)
+                , Users(copy.Users)
+                , Messages(copy.Messages)
+                , Delivered(copy.Delivered)
+                , Dropped(copy.Dropped)
+                , Disconnected(copy.Disconnected)
+                , Refused(copy.Refused)
+            {
+                Init();
+            }
+            ~RoomData()
+            {
+            }
+
+        private:
+            void Init()
+            {
+                Add(_T("room"), &Room);
+                Add(_T("users"), &Users);
+                Add(_T("messages"), &Messages);
+                Add(_T("delivered"), &Delivered);
+                Add(_T("dropped"), &Dropped);
+                Add(_T("disconnected"), &Disconnected);
+                Add(_T("refused"), &Refused);
+            }
+
+        public:
+            Core::JSON::String Room;
+            Core::JSON::DecUInt32 Users;
+            Core::JSON::DecUInt32 Messages;
+            Core::JSON::DecUInt32 Delivered;
+            Core::JSON::DecUInt32 Dropped;
+            Core::JSON::DecUInt32 Disconnected;
+            Core::JSON::DecUInt32 Refused;
+        };
+
     public:
         Messenger(const Messenger&) = delete;
         Messenger& operator=(const Messenger&) = delete;
@@ -22,6 +172,7 @@ namespace Plugin {
             : _connectionId(0)
             , _service(nullptr)
             , _roomAdmin(nullptr)
+            , _maintainer(nullptr)
             , _roomIds()
             , _adminLock()
         {
@@ -39,7 +190,8 @@ namespace Plugin {
         virtual string Information() const override  { return { }; }
 
         // Notification handling
-        class MsgNotification : public Exchange::IRoomAdministrator::IRoom::IMsgNotification {
+        class MsgNotification : public Exchange::IRoomAdministrator::IRoom::IMsgNotification
+                              , public RoomMaintainer::ISequencedNotification {
         public:
             MsgNotification(const MsgNotification&) = delete;
             MsgNotification& operator=(const MsgNotification&) = delete;
@@ -53,7 +205,20 @@ namespace Plugin {
             virtual void Message(const string& senderName, const string& message) override
             {
                 ASSERT(_messenger != nullptr);
-                _messenger->MessageHandler(_roomId, senderName, message);
+                _messenger->MessageHandler(_roomId, senderName, message, 0);
+            }
+
+            // RoomMaintainer::ISequencedNotification methods
+            virtual void Message(const uint64_t sequence, const string& senderName, const string& message) override
+            {
+                ASSERT(_messenger != nullptr);
+                _messenger->MessageHandler(_roomId, senderName, message, sequence);
+            }
+
+            virtual void Disconnected() override
+            {
+                ASSERT(_messenger != nullptr);
+                _messenger->DisconnectedHandler(_roomId);
             }
 
             // QueryInterface implementation
@@ -108,9 +273,9 @@ namespace Plugin {
             INTERFACE_AGGREGATE(Exchange::IRoomAdministrator, _roomAdmin)
         END_INTERFACE_MAP
 
-        string JoinRoom(const string& roomId, const string& userName);
+        string JoinRoom(const string& roomId, const string& userName, const uint64_t since = RoomMaintainer::NoHistory);
         bool LeaveRoom(const string& roomId);
-        bool SendMessage(const string& roomId, const string& message);
+        uint32_t SendMessage(const string& roomId, const string& message);
 
         void UserJoinedHandler(const string& roomId, const string& userName)
         {
@@ -122,11 +287,15 @@ namespace Plugin {
             event_userupdate(roomId, userName, JsonData::Messenger::UserupdateParamsData::ActionType::LEFT);
         }
 
-        void MessageHandler(const string& roomId, const string& senderName, const string& message)
+        void MessageHandler(const string& roomId, const string& senderName, const string& message, const uint64_t sequence)
         {
-            event_message(roomId, senderName, message);
+            event_message(roomId, senderName, message, sequence);
         }
 
+        // The user did not keep up with the messages and was taken out of the room. Like every user leaving, it
+        // was reported with a userupdate event already, its room ID is no longer valid.
+        void DisconnectedHandler(const string& roomId);
+
         // IMessenger::INotification methods
         void Created(const string& roomName) override
         {
@@ -155,16 +324,18 @@ namespace Plugin {
         // JSON-RPC
         void RegisterAll();
         void UnregisterAll();
-        uint32_t endpoint_join(const JsonData::Messenger::JoinParamsData& params, JsonData::Messenger::JoinResultInfo& response);
+        uint32_t endpoint_join(const JoinParams& params, JsonData::Messenger::JoinResultInfo& response);
         uint32_t endpoint_leave(const JsonData::Messenger::JoinResultInfo& params);
         uint32_t endpoint_send(const JsonData::Messenger::SendParamsData& params);
+        uint32_t get_rooms(Core::JSON::ArrayType<RoomData>& response) const;
         void event_roomupdate(const string& room, const JsonData::Messenger::RoomupdateParamsData::ActionType& action);
         void event_userupdate(const string& id, const string& user, const JsonData::Messenger::UserupdateParamsData::ActionType& action);
-        void event_message(const string& id, const string& user, const string& message);
+        void event_message(const string& id, const string& user, const string& message, const uint64_t sequence);
 
         uint32_t _connectionId;
         PluginHost::IShell* _service;
         Exchange::IRoomAdministrator* _roomAdmin;
+        RoomMaintainer* _maintainer; // only if the room administrator runs in our process
         std::map<string, Exchange::IRoomAdministrator::IRoom*> _roomIds;
         std::set<string> _rooms;
         mutable Core::CriticalSection _adminLock;
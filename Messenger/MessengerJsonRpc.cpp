@@ -28,13 +28,15 @@ namespace Plugin {
             SubscribeUserUpdate(roomId, status == Status::registered);
         });
 
-        Register<JoinParamsData,JoinResultInfo>(_T("join"), &Messenger::endpoint_join, this);
+        Register<JoinParams,JoinResultInfo>(_T("join"), &Messenger::endpoint_join, this);
         Register<JoinResultInfo,void>(_T("leave"), &Messenger::endpoint_leave, this);
         Register<SendParamsData,void>(_T("send"), &Messenger::endpoint_send, this);
+        Property<Core::JSON::ArrayType<RoomData>>(_T("rooms"), &Messenger::get_rooms, nullptr, this);
     }
 
     void Messenger::UnregisterAll()
     {
+        Unregister(_T("rooms"));
         Unregister(_T("send"));
         Unregister(_T("leave"));
         Unregister(_T("join"));
@@ -50,14 +52,15 @@ namespace Plugin {
     //  - ERROR_NONE: Success
     //  - ERROR_ILLEGAL_STATE: User name is already taken (i.e. the user has already joined the room)
     //  - ERROR_BAD_REQUEST: User name or room name was invalid
-    uint32_t Messenger::endpoint_join(const JoinParamsData& params, JoinResultInfo& response)
+    // Messages in the room history that came after the optional 'since' sequence number are replayed first.
+    uint32_t Messenger::endpoint_join(const JoinParams& params, JoinResultInfo& response)
     {
         uint32_t result = Core::ERROR_BAD_REQUEST;
         const string& user = params.User.Value();
         const string& room = params.Room.Value();
 
         if (!user.empty() && !room.empty()) {
-            string roomId = JoinRoom(room, user);
+            string roomId = JoinRoom(room, user, (params.Since.IsSet() == true ? params.Since.Value() : RoomMaintainer::NoHistory));
             if (!roomId.empty()) {
                 response.Roomid = roomId;
                 result = Core::ERROR_NONE;
@@ -87,14 +90,45 @@ namespace Plugin {
     // Return codes:
     //  - ERROR_NONE: Success
     //  - ERROR_UNKNOWN_KEY: The given room ID was invalid
+    //  - ERROR_UNAVAILABLE: The message was not sent, the slowest user in the room is too far behind; try again later
+    //  - ERROR_ILLEGAL_STATE: The user was disconnected from the room for not keeping up with the messages; join again
     uint32_t Messenger::endpoint_send(const SendParamsData& params)
     {
         const string& roomid = params.Roomid.Value();
         const string& message = params.Message.Value();
 
-        bool result = SendMessage(roomid, message);
+        return SendMessage(roomid, message);
+    }
 
-        return result? Core::ERROR_NONE : Core::ERROR_UNKNOWN_KEY;
+    // Property: rooms - The counters of the rooms that exist
+    // Return codes:
+    //  - ERROR_NONE: Success
+    //  - ERROR_UNAVAILABLE: The room administrator runs out of process, its counters can not be read
+    uint32_t Messenger::get_rooms(Core::JSON::ArrayType<RoomData>& response) const
+    {
+        uint32_t result = Core::ERROR_UNAVAILABLE;
+
+        if (_maintainer != nullptr) {
+            std::list<RoomMaintainer::Statistics> rooms;
+
+            _maintainer->Rooms(rooms);
+
+            for (auto const& room : rooms) {
+                RoomData& entry(response.Add());
+
+                entry.Room = room.Room;
+                entry.Users = room.Users;
+                entry.Messages = room.Messages;
+                entry.Delivered = room.Delivered;
+                entry.Dropped = room.Dropped;
+                entry.Disconnected = room.Disconnected;
+                entry.Refused = room.Refused;
+            }
+
+            result = Core::ERROR_NONE;
+        }
+
+        return result;
     }
 
     // Notifies about room status updates.
@@ -121,12 +155,16 @@ namespace Plugin {
     }
 
     // Notifies about new messages in a room.
-    void Messenger::event_message(const string& id, const string& user, const string& message)
+    void Messenger::event_message(const string& id, const string& user, const string& message, const uint64_t sequence)
     {
-        MessageParamsData params;
+        MessageParams params;
         params.User = user;
         params.Message = message;
 
+        if (sequence != 0) {
+            params.Sequence = sequence;
+        }
+
         Notify(_T("message"), params, [&](const string& designator) -> bool {
             const string designator_id = designator.substr(0, designator.find('.'));
             return (id == designator_id);
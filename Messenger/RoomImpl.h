@@ -14,22 +14,19 @@ namespace Plugin {
         RoomImpl(const RoomImpl&) = delete;
         RoomImpl& operator=(const RoomImpl&) = delete;
 
-        RoomImpl(RoomMaintainer* admin, const string& roomId, const string& userId, IMsgNotification* messageSink)
-            : _roomId(roomId)
+        RoomImpl(RoomMaintainer* admin, const std::shared_ptr<RoomMaintainer::Room>& room, const string& userId, IMsgNotification* messageSink)
+            : _roomId(room->Id)
             , _userId(userId)
             , _roomAdmin(admin)
+            , _room(room)
             , _callback(nullptr)
-            , _messageSink(messageSink)
+            , _mailbox(Core::ProxyType<RoomMaintainer::Mailbox>::Create(admin, room, userId, messageSink))
             , _adminLock()
         {
             ASSERT(admin != nullptr);
 
             _roomAdmin->AddRef();
 
-            if (_messageSink) {
-                _messageSink->AddRef();
-            }
-
             if (userId.size() == 0) {
                 TRACE(Trace::Warning, (_T("Created a user with empty userId")));
             }
@@ -44,9 +41,9 @@ namespace Plugin {
             // Release the callback if necessary.
             SetCallback(nullptr);
 
-            if (_messageSink) {
-                _messageSink->Release();
-            }
+            // Messages still queued for this user are dropped, the mailbox lets go of the message sink. Once this
+            // returns, no delivery to this user is running or pending anymore.
+            _mailbox->Shutdown();
 
             _roomAdmin->Release();
         }
@@ -54,10 +51,8 @@ namespace Plugin {
         // IRoom methods
         virtual void SendMessage(const string& message) override
         {
-            ASSERT(_roomAdmin != nullptr);
-            _roomAdmin->Send(message, this);
-
-            // Note: the message will be echoed back to the sending user.
+            // The interface has no way to tell the message was refused, in-process users can use Send().
+            Send(message);
         }
 
         virtual void SetCallback(ICallback *callback) override
@@ -88,6 +83,16 @@ namespace Plugin {
         }
 
         // RoomImpl methods
+        // Returns ERROR_UNAVAILABLE if the room holds the sender back, as its slowest user is too far behind, or
+        // ERROR_ILLEGAL_STATE if this user was taken out of the room.
+        uint32_t Send(const string& message)
+        {
+            ASSERT(_roomAdmin != nullptr);
+
+            // Note: the message will be echoed back to the sending user.
+            return (_roomAdmin->Send(message, this));
+        }
+
         void UserJoined(const string& userId)
         {
             TRACE(Trace::Information, (_T("User '%s': Notified that '%s' joined room '%s'"),
@@ -116,15 +121,10 @@ namespace Plugin {
             _adminLock.Unlock();
         }
 
-        void MessageReceived(const string& userId, const string& message)
-        {
-            if (_messageSink != nullptr) {
-                _messageSink->Message(userId, message);
-            }
-        }
-
         const string& UserId() const { return _userId; }
         const string& RoomId() const { return _roomId; }
+        const std::shared_ptr<RoomMaintainer::Room>& Room() const { return _room; }
+        const Core::ProxyType<RoomMaintainer::Mailbox>& Mailbox() const { return _mailbox; }
 
         // QueryInterface implementation
         BEGIN_INTERFACE_MAP(RoomImpl)
@@ -135,8 +135,9 @@ namespace Plugin {
         string _roomId;
         string _userId;
         RoomMaintainer* _roomAdmin;
+        std::shared_ptr<RoomMaintainer::Room> _room;
         Exchange::IRoomAdministrator::IRoom::ICallback* _callback;
-        Exchange::IRoomAdministrator::IRoom::IMsgNotification* _messageSink;
+        Core::ProxyType<RoomMaintainer::Mailbox> _mailbox;
         mutable Core::CriticalSection _adminLock;
     };
 
@@ -4,12 +4,161 @@
 
 namespace WPEFramework {
 
+ENUM_CONVERSION_BEGIN(Plugin::RoomMaintainer::overflow)
+
+    { Plugin::RoomMaintainer::DROP_OLDEST, _TXT("dropoldest") },
+    { Plugin::RoomMaintainer::DISCONNECT, _TXT("disconnect") },
+
+    ENUM_CONVERSION_END(Plugin::RoomMaintainer::overflow);
+
 namespace Plugin {
 
     SERVICE_REGISTRATION(RoomMaintainer, 1, 0);
 
+    bool RoomMaintainer::Mailbox::Post(const MessagePtr& message, const uint16_t size, const overflow policy)
+    {
+        bool result = true;
+
+        _adminLock.Lock();
+
+        // Broadcast-only users (no message sink) and users that left do not get any messages.
+        if ((_closed == false) && (_disconnect == false) && (_messageSink != nullptr)) {
+            if (_messages.size() >= size) {
+                result = false;
+
+                if (policy == DISCONNECT) {
+                    // This user is not keeping up, the job takes it out of the room.
+                    _disconnect = true;
+                    _messages.clear();
+                } else {
+                    _messages.pop_front();
+                    _messages.push_back(message);
+                }
+            } else {
+                _messages.push_back(message);
+            }
+
+            if (_scheduled == false) {
+                _scheduled = true;
+                PluginHost::WorkerPool::Instance().Submit(Core::ProxyType<Core::IDispatch>(*this));
+            }
+        }
+
+        _adminLock.Unlock();
+
+        return (result);
+    }
+
+    void RoomMaintainer::Mailbox::Close()
+    {
+        IRoom::IMsgNotification* sink = nullptr;
+
+        _adminLock.Lock();
+
+        _closed = true;
+        _messages.clear();
+        sink = _messageSink;
+        _messageSink = nullptr;
+
+        _adminLock.Unlock();
+
+        if (sink != nullptr) {
+            sink->Release();
+        }
+    }
+
+    void RoomMaintainer::Mailbox::Shutdown()
+    {
+        Close();
+
+        PluginHost::WorkerPool::Instance().Revoke(Core::ProxyType<Core::IDispatch>(*this));
+    }
+
+    void RoomMaintainer::Mailbox::Dispatch()
+    {
+        std::list<MessagePtr> messages;
+        IRoom::IMsgNotification* sink = nullptr;
+        ISequencedNotification* sequenced = nullptr;
+        bool disconnect = false;
+
+        _adminLock.Lock();
+
+        messages.swap(_messages);
+
+        if (_closed == false) {
+            disconnect = _disconnect;
+
+            if (_messageSink != nullptr) {
+                sink = _messageSink;
+                sequenced = _sequenced;
+                sink->AddRef();
+            }
+        }
+
+        _adminLock.Unlock();
+
+        if (disconnect == true) {
+            _roomAdmin->Disconnect(_roomId, this);
+            Close();
+
+            // Only a sink in our process can be told, the interface has no means for it.
+            if (sink != nullptr) {
+                if (sequenced != nullptr) {
+                    sequenced->Disconnected();
+                }
+
+                sink->Release();
+            }
+        } else if (sink != nullptr) {
+            // No lock is held here, this may well be a call into another process.
+            for (auto const& message : messages) {
+                if (sequenced != nullptr) {
+                    sequenced->Message(message->Sequence, message->SenderId, message->Text);
+                } else {
+                    sink->Message(message->SenderId, message->Text);
+                }
+
+                _delivered = message->Sequence;
+            }
+
+            sink->Release();
+
+            std::shared_ptr<Room> room(_room.lock());
+
+            if (room) {
+                room->Delivered += static_cast<uint32_t>(messages.size());
+            }
+        }
+
+        // Only one delivery at a time, so the messages arrive in the order they were sent.
+        _adminLock.Lock();
+
+        if ((_closed == false) && ((_messages.empty() == false) || (_disconnect == true))) {
+            PluginHost::WorkerPool::Instance().Submit(Core::ProxyType<Core::IDispatch>(*this));
+        } else {
+            _scheduled = false;
+        }
+
+        _adminLock.Unlock();
+    }
+
+    void RoomMaintainer::Configure(const uint16_t mailboxSize, const overflow policy, const uint16_t historySize, const uint32_t historyBytes, const uint16_t highWater)
+    {
+        _mailboxSize = (mailboxSize == 0 ? 1 : mailboxSize);
+        _overflow = policy;
+        _historySize = historySize;
+        _historyBytes = historyBytes;
+        _highWater = highWater;
+    }
+
     /* virtual */ Exchange::IRoomAdministrator::IRoom* RoomMaintainer::Join(const string& roomId, const string& userId,
                                                                             Exchange::IRoomAdministrator::IRoom::IMsgNotification* messageSink)
+    {
+        return (Join(roomId, userId, messageSink, NoHistory));
+    }
+
+    Exchange::IRoomAdministrator::IRoom* RoomMaintainer::Join(const string& roomId, const string& userId,
+                                                              Exchange::IRoomAdministrator::IRoom::IMsgNotification* messageSink, const uint64_t since)
     {
         // Note: Nullptr message sink is allowed (e.g. for broadcast-only users).
 
@@ -21,8 +170,12 @@ namespace Plugin {
 
         if (it == _roomMap.end()) {
             // Room not found, so create one, already emplacing the first user.
-            newRoomUser = Core::Service<RoomImpl>::Create<RoomImpl>(this, roomId, userId, messageSink);
-            it = _roomMap.emplace(roomId, std::list<RoomImpl*>({newRoomUser})).first;
+            std::shared_ptr<Room> room(std::make_shared<Room>(roomId));
+
+            newRoomUser = Core::Service<RoomImpl>::Create<RoomImpl>(this, room, userId, messageSink);
+            room->Users.push_back(newRoomUser);
+            Admit(room, newRoomUser, since);
+            _roomMap.emplace(roomId, room);
 
             TRACE(Trace::Information, (_T("Room Maintainer: Room '%s' created"), roomId.c_str()));
             if (roomId.size() == 0) {
@@ -36,10 +189,11 @@ namespace Plugin {
         }
         else {
             // Room already created; try to add another user.
-            std::list<RoomImpl*>& users = (*it).second;
+            std::shared_ptr<Room>& room = (*it).second;
+            std::list<RoomImpl*>& users = room->Users;
 
             if (std::find_if(users.begin(), users.end(), [&userId](const RoomImpl* user) { return (user->UserId() == userId);}) == users.end()) {
-                newRoomUser = Core::Service<RoomImpl>::Create<RoomImpl>(this, roomId, userId, messageSink);
+                newRoomUser = Core::Service<RoomImpl>::Create<RoomImpl>(this, room, userId, messageSink);
 
                 // Notify the room about a joining user.
                 // No point in sending the notification to the joining user as it cannot have its callback registered yet.
@@ -48,6 +202,7 @@ namespace Plugin {
                 }
 
                 users.push_back(newRoomUser);
+                Admit(room, newRoomUser, since);
             }
             else {
                 TRACE(Trace::Error, (_T("Room Maintainer: User '%s' has already joined room '%s'"),
@@ -66,80 +221,207 @@ namespace Plugin {
         return newRoomUser;
     }
 
+    void RoomMaintainer::Admit(const std::shared_ptr<Room>& room, RoomImpl* roomUser, const uint64_t since)
+    {
+        const Core::ProxyType<Mailbox>& mailbox(roomUser->Mailbox());
+
+        // With the room locked, every message is either in the history replayed here or sent after the new
+        // membership is published, none is missed and none is delivered twice.
+        room->Lock.Lock();
+
+        auto index(std::find_if(room->History.begin(), room->History.end(), [since](const MessagePtr& message) { return (message->Sequence > since); }));
+
+        mailbox->Start(index != room->History.end() ? ((*index)->Sequence - 1) : room->Sequence);
+
+        // The history always fits, whatever the mailbox size.
+        const uint16_t size = std::max(static_cast<uint16_t>(_mailboxSize), static_cast<uint16_t>(room->History.size()));
+
+        while (index != room->History.end()) {
+            mailbox->Post(*index, size, DROP_OLDEST);
+            index++;
+        }
+
+        // Senders pick up the new membership with the next message they send.
+        std::shared_ptr<Members> members(std::make_shared<Members>(*(room->Snapshot())));
+        members->push_back(mailbox);
+        room->Publish(members);
+
+        room->Lock.Unlock();
+    }
+
     void RoomMaintainer::Exit(const RoomImpl* roomUser)
     {
         ASSERT(roomUser != nullptr);
 
         _adminLock.Lock();
 
+        // The user is not in the room anymore, if it was disconnected for not keeping up with the messages.
         auto it(_roomMap.find(roomUser->RoomId()));
-        ASSERT(it != _roomMap.end());
 
         if (it != _roomMap.end()) {
-            std::list<RoomImpl*>& users = (*it).second;
+            std::list<RoomImpl*>& users = (*it).second->Users;
 
             auto uit(std::find(users.begin(), users.end(), roomUser));
-            ASSERT(uit != users.end());
 
             if (uit != users.end()) {
-                TRACE(Trace::Information, (_T("Room Maintainer: User '%s' is leaving room '%s'"),
-                        roomUser->UserId().c_str(), roomUser->RoomId().c_str()));
+                Leave((*it).second, uit);
+            }
+        }
 
-                // Notify the room members about a leaving user.
-                for (auto& user : users) {
-                    user->UserLeft(roomUser->UserId());
-                }
+        _adminLock.Unlock();
+    }
 
-                users.erase(uit);
+    void RoomMaintainer::Disconnect(const string& roomId, const Mailbox* mailbox)
+    {
+        ASSERT(mailbox != nullptr);
 
-                // Was it the last user?
-                if (users.size() == 0) {
-                    _roomMap.erase(it);
+        _adminLock.Lock();
 
-                    TRACE(Trace::Information, (_T("Room Maintainer: Room '%s' has been destroyed"), roomUser->RoomId().c_str()));
+        auto it(_roomMap.find(roomId));
 
-                    // Notify the observers about the destruction of this room.
-                    for (auto& observer : _observers) {
-                        observer->Destroyed(roomUser->RoomId());
-                    }
-                }
+        if (it != _roomMap.end()) {
+            std::list<RoomImpl*>& users = (*it).second->Users;
+
+            auto uit(std::find_if(users.begin(), users.end(), [mailbox](const RoomImpl* user) { return (&(*(user->Mailbox())) == mailbox);}));
+
+            if (uit != users.end()) {
+                TRACE(Trace::Warning, (_T("Room Maintainer: User '%s' is not keeping up with room '%s', disconnected"),
+                        mailbox->UserId().c_str(), roomId.c_str()));
+
+                (*it).second->Disconnected++;
+
+                Leave((*it).second, uit);
             }
         }
 
         _adminLock.Unlock();
     }
 
+    void RoomMaintainer::Leave(std::shared_ptr<Room> room, std::list<RoomImpl*>::iterator user)
+    {
+        const RoomImpl* roomUser = *user;
+        std::list<RoomImpl*>& users = room->Users;
+
+        TRACE(Trace::Information, (_T("Room Maintainer: User '%s' is leaving room '%s'"),
+                roomUser->UserId().c_str(), roomUser->RoomId().c_str()));
+
+        // Notify the room members about a leaving user.
+        for (auto& member : users) {
+            member->UserLeft(roomUser->UserId());
+        }
+
+        users.erase(user);
+
+        std::shared_ptr<Members> members(std::make_shared<Members>());
+
+        for (auto const& member : *(room->Snapshot())) {
+            if (&(*member) != &(*(roomUser->Mailbox()))) {
+                members->push_back(member);
+            }
+        }
+
+        room->Publish(members);
+
+        // Senders may still have the previous membership at hand, make sure they do not reach this user anymore.
+        roomUser->Mailbox()->Close();
+
+        // Was it the last user?
+        if (users.size() == 0) {
+            _roomMap.erase(room->Id);
+
+            TRACE(Trace::Information, (_T("Room Maintainer: Room '%s' has been destroyed (messages: %u, delivered: %u, dropped: %u, disconnected: %u, refused: %u)"),
+                    room->Id.c_str(), room->Messages.load(), room->Delivered.load(), room->Dropped.load(), room->Disconnected.load(), room->Refused.load()));
+
+            // Notify the observers about the destruction of this room.
+            for (auto& observer : _observers) {
+                observer->Destroyed(room->Id);
+            }
+        }
+    }
+
     void RoomMaintainer::Notify(RoomImpl* roomUser)
     {
         ASSERT(roomUser != nullptr);
 
         _adminLock.Lock();
 
-        auto it = _roomMap.find(roomUser->RoomId());
-        ASSERT(it != _roomMap.end());
-
-        if (it != _roomMap.end()) {
-            for (auto& user : (*it).second) {
-                roomUser->UserJoined(user->UserId());
-            }
+        for (auto& user : roomUser->Room()->Users) {
+            roomUser->UserJoined(user->UserId());
         }
 
         _adminLock.Unlock();
     }
 
-    void RoomMaintainer::Send(const string& message, RoomImpl* roomUser)
+    uint32_t RoomMaintainer::Send(const string& message, RoomImpl* roomUser)
     {
         ASSERT(roomUser != nullptr);
 
-        _adminLock.Lock();
+        // The administration lock is not needed, the membership is an immutable snapshot and every mailbox takes
+        // care of itself. The room lock keeps the messages in order, in the history and in every mailbox.
+        const std::shared_ptr<Room>& room(roomUser->Room());
+        const uint16_t size = _mailboxSize;
+        const overflow policy = _overflow;
+        const uint16_t highWater = _highWater;
+        const uint16_t historySize = _historySize;
+        const uint32_t historyBytes = _historyBytes;
+        uint32_t result = Core::ERROR_NONE;
+
+        room->Lock.Lock();
+
+        std::shared_ptr<const Members> members(room->Snapshot());
+
+        // A user that was taken out of the room for not keeping up still holds on to it, until it leaves.
+        if (roomUser->Mailbox()->IsClosed() == true) {
+            result = Core::ERROR_ILLEGAL_STATE;
+        } else if (highWater != 0) {
+            // Rather than queuing without bounds or dropping, hold the sender back until the slowest user caught up.
+            for (auto const& member : *members) {
+                if (member->Lag(room->Sequence) >= highWater) {
+                    result = Core::ERROR_UNAVAILABLE;
+                    break;
+                }
+            }
+        }
 
-        auto it(_roomMap.find(roomUser->RoomId()));
-        ASSERT(it != _roomMap.end());
+        if (result == Core::ERROR_UNAVAILABLE) {
+            room->Refused++;
+        } else if (result == Core::ERROR_NONE) {
+            MessagePtr entry(std::make_shared<const Message>(++(room->Sequence), roomUser->UserId(), message));
 
-        if (it != _roomMap.end()) {
-            for (RoomImpl* user : (*it).second) {
-                user->MessageReceived(roomUser->UserId(), message);
+            room->Messages++;
+
+            if (historySize != 0) {
+                room->History.push_back(entry);
+                room->HistoryBytes += entry->Size();
+
+                // Keep at least the last message, even if it is larger than the byte limit.
+                while ((room->History.size() > historySize) || ((room->HistoryBytes > historyBytes) && (room->History.size() > 1))) {
+                    room->HistoryBytes -= room->History.front()->Size();
+                    room->History.pop_front();
+                }
             }
+
+            for (auto const& member : *members) {
+                if (member->Post(entry, size, policy) == false) {
+                    room->Dropped++;
+                }
+            }
+        }
+
+        room->Lock.Unlock();
+
+        return (result);
+    }
+
+    void RoomMaintainer::Rooms(std::list<Statistics>& rooms) const
+    {
+        _adminLock.Lock();
+
+        for (auto const& entry : _roomMap) {
+            const Room& room(*(entry.second));
+
+            rooms.push_back({ room.Id, static_cast<uint32_t>(room.Users.size()), room.Messages.load(), room.Delivered.load(),
+                room.Dropped.load(), room.Disconnected.load(), room.Refused.load() });
         }
 
         _adminLock.Unlock();
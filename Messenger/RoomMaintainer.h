@@ -2,6 +2,9 @@
 
 #include "Module.h"
 #include <interfaces/IMessenger.h>
+#include <atomic>
+#include <deque>
+#include <memory>
 
 namespace WPEFramework {
 
@@ -10,6 +13,216 @@ namespace Plugin {
     class RoomImpl;
 
     class RoomMaintainer : public Exchange::IRoomAdministrator {
+    public:
+        enum overflow {
+            DROP_OLDEST,
+            DISCONNECT
+        };
+
+        // Sinks living in the same process may implement this next to IMsgNotification, to learn the sequence
+        // number of every message, e.g. to replay what was missed when joining again, and to learn the user was
+        // taken out of the room, as it did not keep up with the messages.
+        struct ISequencedNotification {
+            virtual ~ISequencedNotification() {}
+            virtual void Message(const uint64_t sequence, const string& senderName, const string& message) = 0;
+            virtual void Disconnected() = 0;
+        };
+
+        // A message as it is kept in the history and in the mailboxes. It is shared by all of them, a message
+        // is never copied per user.
+        class Message {
+        public:
+            Message() = delete;
+            Message(const Message&) = delete;
+            Message& operator=(const Message&) = delete;
+
+            Message(const uint64_t sequence, const string& senderId, const string& text)
+                : Sequence(sequence)
+                , SenderId(senderId)
+                , Text(text)
+            {
+            }
+            ~Message()
+            {
+            }
+
+            uint32_t Size() const
+            {
+                return (static_cast<uint32_t>(SenderId.length() + Text.length()));
+            }
+
+        public:
+            const uint64_t Sequence;
+            const string SenderId;
+            const string Text;
+        };
+
+        typedef std::shared_ptr<const Message> MessagePtr;
+
+        // Join() without a sequence number: nothing from the history is replayed.
+        static constexpr uint64_t NoHistory = ~static_cast<uint64_t>(0);
+
+        // Messages for a single user. They are queued by the sender and handed to the user's message sink from
+        // the worker pool, so a slow (remote) user only delays its own messages. The mailbox is the job that is
+        // submitted, the worker pool keeps it alive while it is pending.
+        class Room;
+
+        class Mailbox : public Core::IDispatch {
+        public:
+            Mailbox() = delete;
+            Mailbox(const Mailbox&) = delete;
+            Mailbox& operator=(const Mailbox&) = delete;
+
+            Mailbox(RoomMaintainer* admin, const std::shared_ptr<Room>& room, const string& userId, IRoom::IMsgNotification* messageSink)
+                : _adminLock()
+                , _roomAdmin(admin)
+                , _room(room)
+                , _roomId(room->Id)
+                , _userId(userId)
+                , _messageSink(messageSink)
+                , _sequenced(dynamic_cast<ISequencedNotification*>(messageSink))
+                , _messages()
+                , _delivered(0)
+                , _scheduled(false)
+                , _closed(false)
+                , _disconnect(false)
+            {
+                ASSERT(admin != nullptr);
+
+                _roomAdmin->AddRef();
+
+                if (_messageSink != nullptr) {
+                    _messageSink->AddRef();
+                }
+            }
+            ~Mailbox() override
+            {
+                Close();
+
+                _roomAdmin->Release();
+            }
+
+            const string& UserId() const { return _userId; }
+
+            // Returns false if the message did not fit, the oldest message was dropped or the user is disconnected.
+            bool Post(const MessagePtr& message, const uint16_t size, const overflow policy);
+
+            // The user left or was taken out of the room, it can not send to it anymore.
+            bool IsClosed() const
+            {
+                _adminLock.Lock();
+                bool result = ((_closed == true) || (_disconnect == true));
+                _adminLock.Unlock();
+
+                return (result);
+            }
+
+            // The messages this user still has to get, up to (and including) the given sequence number.
+            uint64_t Lag(const uint64_t sequence) const
+            {
+                _adminLock.Lock();
+                uint64_t result = (((_closed == true) || (_disconnect == true) || (_messageSink == nullptr) || (sequence <= _delivered)) ? 0 : (sequence - _delivered));
+                _adminLock.Unlock();
+
+                return (result);
+            }
+            // Everything up to (and including) the given sequence number is not for this user.
+            void Start(const uint64_t sequence)
+            {
+                _delivered = sequence;
+            }
+
+            // No messages are delivered anymore, pending ones are dropped.
+            void Close();
+            // As Close, but the mailbox is also taken out of the worker pool and a delivery that is in progress is
+            // waited for. Not to be called from a delivery or with the maintainer locked, a delivery may need it.
+            void Shutdown();
+
+            void Dispatch() override;
+
+        private:
+            mutable Core::CriticalSection _adminLock;
+            RoomMaintainer* _roomAdmin;
+            std::weak_ptr<Room> _room;
+            const string _roomId;
+            const string _userId;
+            IRoom::IMsgNotification* _messageSink;
+            ISequencedNotification* _sequenced;
+            std::list<MessagePtr> _messages;
+            std::atomic<uint64_t> _delivered;
+            bool _scheduled;
+            bool _closed;
+            bool _disconnect;
+        };
+
+        typedef std::vector<Core::ProxyType<Mailbox>> Members;
+
+        // A room as seen by its senders: an immutable snapshot of the members, replaced as a whole whenever
+        // somebody joins or leaves, so sending a message does not need the administration lock. The room lock
+        // only orders the messages of this room: numbering, history and handing them to the mailboxes.
+        class Room {
+        public:
+            Room() = delete;
+            Room(const Room&) = delete;
+            Room& operator=(const Room&) = delete;
+
+            Room(const string& roomId)
+                : Id(roomId)
+                , Users()
+                , Lock()
+                , Sequence(0)
+                , History()
+                , HistoryBytes(0)
+                , Messages(0)
+                , Delivered(0)
+                , Dropped(0)
+                , Disconnected(0)
+                , Refused(0)
+                , _members(std::make_shared<const Members>())
+            {
+            }
+            ~Room()
+            {
+            }
+
+            std::shared_ptr<const Members> Snapshot() const
+            {
+                return (std::atomic_load(&_members));
+            }
+            void Publish(const std::shared_ptr<const Members>& members)
+            {
+                std::atomic_store(&_members, members);
+            }
+
+        public:
+            const string Id;
+            std::list<RoomImpl*> Users; // only used with the administration lock taken
+            Core::CriticalSection Lock;
+            uint64_t Sequence; // last message sent, only used with the room lock taken
+            std::deque<MessagePtr> History; // only used with the room lock taken
+            uint32_t HistoryBytes; // only used with the room lock taken
+            std::atomic<uint32_t> Messages;
+            std::atomic<uint32_t> Delivered;
+            std::atomic<uint32_t> Dropped;
+            std::atomic<uint32_t> Disconnected;
+            std::atomic<uint32_t> Refused;
+
+        private:
+            std::shared_ptr<const Members> _members;
+        };
+
+    public:
+        // The counters of a room, since it was created.
+        struct Statistics {
+            string Room;
+            uint32_t Users;
+            uint32_t Messages; // accepted from the senders
+            uint32_t Delivered; // handed to the users
+            uint32_t Dropped; // lost to a full mailbox
+            uint32_t Disconnected; // users taken out of the room for a full mailbox
+            uint32_t Refused; // refused as the slowest user was too far behind
+        };
+
     public:
         RoomMaintainer(const RoomMaintainer&) = delete;
         RoomMaintainer& operator=(const RoomMaintainer&) = delete;
@@ -18,6 +231,11 @@ namespace Plugin {
             : _observers()
             , _roomMap()
             , _adminLock()
+            , _mailboxSize(64)
+            , _overflow(DROP_OLDEST)
+            , _historySize(100)
+            , _historyBytes(64 * 1024)
+            , _highWater(0)
         { /* empty */}
 
         // IRoomAdministrator methods
@@ -26,19 +244,36 @@ namespace Plugin {
         virtual void Unregister(const INotification* sink) override;
 
         // RoomMaintainer methods
+        // A high water mark of 0 means senders are never held back.
+        void Configure(const uint16_t mailboxSize, const overflow policy, const uint16_t historySize, const uint32_t historyBytes, const uint16_t highWater);
+        // Replays the messages in the history that came after the given sequence number, before any new message.
+        IRoom* Join(const string& roomId, const string& userId, IRoom::IMsgNotification* messageSink, const uint64_t since);
         void Exit(const RoomImpl* roomUser);
-        void Send(const string& message, RoomImpl* roomUser);
+        // Returns ERROR_UNAVAILABLE if the message was refused, as the slowest user in the room is too far behind,
+        // or ERROR_ILLEGAL_STATE if the sender was taken out of the room.
+        uint32_t Send(const string& message, RoomImpl* roomUser);
         void Notify(RoomImpl* roomUser);
+        void Disconnect(const string& roomId, const Mailbox* mailbox);
+        void Rooms(std::list<Statistics>& rooms) const;
 
         // QueryInterface implementation
         BEGIN_INTERFACE_MAP(RoomMaintainer)
             INTERFACE_ENTRY(Exchange::IRoomAdministrator)
         END_INTERFACE_MAP
 
+    private:
+        void Admit(const std::shared_ptr<Room>& room, RoomImpl* roomUser, const uint64_t since);
+        void Leave(std::shared_ptr<Room> room, std::list<RoomImpl*>::iterator user);
+
     private:
         std::list<INotification*> _observers;
-        std::map<string, std::list<RoomImpl*>> _roomMap;
+        std::map<string, std::shared_ptr<Room>> _roomMap;
         mutable Core::CriticalSection _adminLock;
+        std::atomic<uint16_t> _mailboxSize;
+        std::atomic<overflow> _overflow;
+        std::atomic<uint16_t> _historySize;
+        std::atomic<uint32_t> _historyBytes;
+        std::atomic<uint16_t> _highWater;
     };
 
 } // namespace Plugin
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "Module.h"
+
+#include <array>
+#include <limits>
+#include <map>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // The resident memory of a plugin over the last 24 hours, one value per minute (the average of the
+    // measurements in that minute). A slot only holds the difference with the previous value, in KB, so the
+    // history takes 2 bytes per minute. A difference that does not fit (over 32 MB in a minute) escapes to the
+    // full value, kept aside for as long as its slot is in the history. Minutes without a measurement are kept
+    // as a gap.
+    // From the minutes since the plugin was last activated, a least squares fit tells how fast it grows.
+    class MemoryHistory {
+    public:
+        static constexpr uint16_t Slots = 24 * 60;
+        static constexpr uint64_t Resolution = 60ULL * 1000 * 1000; // in ticks (us)
+        static constexpr int16_t NoSample = std::numeric_limits<int16_t>::min();
+        static constexpr int16_t Absolute = NoSample + 1; // the value of this slot is kept aside
+        static constexpr uint16_t MinimumSamples = 30; // before a trend is trusted
+
+    public:
+        MemoryHistory()
+            : _deltas()
+            , _absolutes()
+            , _base(0)
+            , _last(0)
+            , _head(0)
+            , _length(0)
+            , _since(0)
+            , _minute(0)
+            , _sum(0)
+            , _count(0)
+            , _slope(0.0)
+        {
+        }
+        MemoryHistory(const MemoryHistory&) = default;
+        MemoryHistory& operator=(const MemoryHistory&) = default;
+        ~MemoryHistory()
+        {
+        }
+
+    public:
+        inline uint16_t Length() const
+        {
+            return (_length);
+        }
+        // Growth in KB per minute, 0 if there are not enough measurements yet.
+        inline double Slope() const
+        {
+            return (_slope);
+        }
+        // Minutes until the limit (in KB) is reached at the current trend, 0 if it is not growing towards it.
+        uint32_t Breach(const uint64_t limit) const
+        {
+            uint32_t result = 0;
+
+            if ((_slope > 0.0) && (_last < limit)) {
+                const double minutes = static_cast<double>(limit - _last) / _slope;
+
+                result = (minutes >= std::numeric_limits<uint32_t>::max() ? std::numeric_limits<uint32_t>::max() : static_cast<uint32_t>(minutes) + 1);
+            }
+
+            return (result);
+        }
+        // The plugin was (re)started, the trend only looks at what comes after this.
+        inline void Mark()
+        {
+            _since = 0;
+            _slope = 0.0;
+        }
+        // Adds a measurement in KB at the given time (in ticks). Returns true if a minute was completed, and
+        // with that the trend updated.
+        bool Add(const uint64_t time, const uint64_t value)
+        {
+            const uint64_t minute = time / Resolution;
+            bool completed = false;
+
+            if ((_count != 0) && (minute > _minute)) {
+                const uint64_t average = _sum / _count;
+                uint64_t gaps = std::min(minute - _minute - 1, static_cast<uint64_t>(Slots));
+
+                Push(average);
+                _last = average;
+
+                while (gaps-- != 0) {
+                    Store(NoSample);
+                }
+
+                _sum = 0;
+                _count = 0;
+                completed = true;
+
+                Regress();
+            }
+
+            if ((_count == 0) || (minute == _minute)) {
+                _minute = minute;
+                _sum += value;
+                _count++;
+            }
+
+            return (completed);
+        }
+        // Calls action(value) for all minutes from the oldest to the most recent one, value is 0 for a gap.
+        template <typename ACTION>
+        void Values(ACTION&& action) const
+        {
+            uint64_t value = _base;
+
+            for (uint16_t index = 0; index < _length; index++) {
+                action(Value(index, value) == true ? value : 0);
+            }
+        }
+
+    private:
+        // The value of the minute at index (0 is the oldest) follows from the value of the minute before it.
+        // Returns false for a gap, the value is left as it is then.
+        bool Value(const uint16_t index, uint64_t& value) const
+        {
+            const uint16_t position = (_head + index) % Slots;
+            const int16_t delta = _deltas[position];
+
+            if (delta == Absolute) {
+                value = _absolutes.find(position)->second;
+            } else if (delta != NoSample) {
+                value += delta;
+            }
+
+            return (delta != NoSample);
+        }
+        void Push(const uint64_t value)
+        {
+            const int64_t delta = static_cast<int64_t>(value) - static_cast<int64_t>(_last);
+
+            if ((delta > Absolute) && (delta <= std::numeric_limits<int16_t>::max())) {
+                Store(static_cast<int16_t>(delta));
+            } else {
+                _absolutes[Store(Absolute)] = value;
+            }
+        }
+        // Returns the position the slot got.
+        uint16_t Store(const int16_t delta)
+        {
+            uint16_t position;
+
+            if (_length == Slots) {
+                // The oldest minute falls out, its value becomes the base of the next one.
+                const int16_t oldest = _deltas[_head];
+
+                if (oldest == Absolute) {
+                    std::map<uint16_t, uint64_t>::iterator entry(_absolutes.find(_head));
+
+                    _base = entry->second;
+                    _absolutes.erase(entry);
+                } else if (oldest != NoSample) {
+                    _base += oldest;
+                }
+
+                position = _head;
+                _head = (_head + 1) % Slots;
+            } else {
+                position = (_head + _length) % Slots;
+                _length++;
+            }
+
+            _deltas[position] = delta;
+
+            if (_since < Slots) {
+                _since++;
+            }
+
+            return (position);
+        }
+        void Regress()
+        {
+            const uint16_t start = _length - std::min(_since, _length);
+            double sumX = 0.0, sumY = 0.0, sumXY = 0.0, sumXX = 0.0;
+            uint32_t samples = 0;
+            uint64_t value = _base;
+
+            for (uint16_t index = 0; index < _length; index++) {
+                if ((Value(index, value) == true) && (index >= start)) {
+                    const double x = index - start;
+                    const double y = static_cast<double>(value);
+
+                    sumX += x;
+                    sumY += y;
+                    sumXY += x * y;
+                    sumXX += x * x;
+                    samples++;
+                }
+            }
+
+            const double divisor = (samples * sumXX) - (sumX * sumX);
+
+            _slope = ((samples >= MinimumSamples) && (divisor > 0.0) ? ((samples * sumXY) - (sumX * sumY)) / divisor : 0.0);
+        }
+
+    private:
+        std::array<int16_t, Slots> _deltas;
+        std::map<uint16_t, uint64_t> _absolutes; // by position, the values of the slots marked Absolute
+        uint64_t _base; // value before the oldest minute
+        uint64_t _last; // value of the most recent minute with a measurement
+        uint16_t _head;
+        uint16_t _length;
+        uint16_t _since; // minutes since Mark()
+        uint64_t _minute; // the minute being measured
+        uint64_t _sum;
+        uint32_t _count;
+        double _slope;
+    };
+}
+}
@@ -2,8 +2,11 @@
 #define __MONITOR_H
 
 #include "Module.h"
+#include "MemoryHistory.h"
+#include "ProcessObserver.h"
 #include <interfaces/IMemory.h>
 #include <interfaces/json/JsonData_Monitor.h>
+#include <atomic>
 #include <limits>
 #include <string>
 
@@ -100,6 +103,13 @@ namespace Plugin {
                 _shared.Set(memInterface->Shared());
                 _process.Set(memInterface->Processes());
             }
+            void Measure(const ProcessObserver::Sample& sample)
+            {
+                _resident.Set(sample.Resident);
+                _allocated.Set(sample.Allocated);
+                _shared.Set(sample.Shared);
+                _process.Set(sample.Processes);
+            }
             void Operational(const bool operational)
             {
                 _operational = operational;
@@ -431,8 +441,13 @@ namespace Plugin {
         public:
             Config()
                 : Core::JSON::Container()
+                , Observables()
+                , Direct(false)
+                , Horizon(4 * 60)
             {
                 Add(_T("observables"), &Observables);
+                Add(_T("direct"), &Direct);
+                Add(_T("horizon"), &Horizon);
             }
             ~Config()
             {
@@ -440,8 +455,60 @@ namespace Plugin {
 
         public:
             Core::JSON::ArrayType<Entry> Observables;
+            Core::JSON::Boolean Direct;
+            Core::JSON::DecUInt16 Horizon; // minutes
+        };
+
+    public:
+        class HistoryParams : public Core::JSON::Container {
+        public:
+            HistoryParams(const HistoryParams&) = delete;
+            HistoryParams& operator=(const HistoryParams&) = delete;
+
+            HistoryParams()
+                : Core::JSON::Container()
+                , Callsign()
+            {
+                Add(_T("callsign"), &Callsign);
+            }
+            ~HistoryParams()
+            {
+            }
+
+        public:
+            Core::JSON::String Callsign;
+        };
+
+        class HistoryData : public Core::JSON::Container {
+        public:
+            HistoryData(const HistoryData&) = delete;
+            HistoryData& operator=(const HistoryData&) = delete;
+
+            HistoryData()
+                : Core::JSON::Container()
+                , Resolution(MemoryHistory::Resolution / (1000 * 1000))
+                , Resident()
+                , Slope()
+                , Breach()
+            {
+                Add(_T("resolution"), &Resolution);
+                Add(_T("resident"), &Resident);
+                Add(_T("slope"), &Slope);
+                Add(_T("breach"), &Breach);
+            }
+            ~HistoryData()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt16 Resolution; // seconds per value
+            Core::JSON::ArrayType<Core::JSON::DecUInt64> Resident; // KB, oldest first, 0 if not measured
+            Core::JSON::DecSInt64 Slope; // KB per hour
+            Core::JSON::DecUInt32 Breach; // minutes until the memory limit is reached, 0 if not projected
         };
 
+    private:
+
         class MonitorObjects : public PluginHost::IPlugin::INotification {
         private:
             MonitorObjects(const MonitorObjects&) = delete;
@@ -474,6 +541,32 @@ namespace Plugin {
                 MonitorObjects& _parent;
             };
 
+            class WakeJob : public Core::IDispatchType<void> {
+            private:
+                WakeJob() = delete;
+                WakeJob(const WakeJob& copy) = delete;
+                WakeJob& operator=(const WakeJob& RHS) = delete;
+
+            public:
+                WakeJob(MonitorObjects* parent)
+                    : _parent(*parent)
+                {
+                    ASSERT(parent != nullptr);
+                }
+                virtual ~WakeJob()
+                {
+                }
+
+            public:
+                virtual void Dispatch() override
+                {
+                    _parent.Woken();
+                }
+
+            private:
+                MonitorObjects& _parent;
+            };
+
             class MonitorObject {
             public:
                 MonitorObject() = delete;
@@ -482,7 +575,8 @@ namespace Plugin {
                 enum evaluation {
                     SUCCESFULL = 0x00,
                     NOT_OPERATIONAL = 0x01,
-                    EXCEEDED_MEMORY = 0x02
+                    EXCEEDED_MEMORY = 0x02,
+                    PROJECTED_BREACH = 0x04
                 };
 
                 typedef struct {
@@ -500,7 +594,8 @@ namespace Plugin {
                     const uint16_t operationalRestartWindow,
                     const uint8_t operationalRestartLimit,
                     const uint16_t memoryRestartWindow,
-                    const uint8_t memoryRestartLimit)
+                    const uint8_t memoryRestartLimit,
+                    const uint16_t horizon)
                     : _operationalInterval(operationalInterval)
                     , _memoryInterval(memoryInterval)
                     , _memoryThreshold(memoryThreshold * 1024)
@@ -518,13 +613,22 @@ namespace Plugin {
                     , _measurement()
                     , _operationalEvaluate(actOnOperational)
                     , _source(nullptr)
+                    , _pid(0)
+                    , _watch(nullptr)
+                    , _exited(false)
+                    , _history()
+                    , _horizon(horizon)
+                    , _projected(false)
                 {
                     ASSERT((_operationalInterval != 0) || (_memoryInterval != 0));
 
-                    if ((_operationalInterval != 0) && (_memoryInterval != 0)) {
-                        _interval = gcd(_operationalInterval, _memoryInterval);
+                    // With a limit, the memory is measured up to 4 times as often when it gets close to it (see Cadence()).
+                    const uint32_t memoryInterval((_memoryThreshold != 0) && ((_memoryInterval % 4) == 0) ? (_memoryInterval / 4) : _memoryInterval);
+
+                    if ((_operationalInterval != 0) && (memoryInterval != 0)) {
+                        _interval = gcd(_operationalInterval, memoryInterval);
                     } else {
-                        _interval = (_operationalInterval == 0 ? _memoryInterval : _operationalInterval);
+                        _interval = (_operationalInterval == 0 ? memoryInterval : _operationalInterval);
                     }
                 }
                 MonitorObject(const MonitorObject& copy)
@@ -545,14 +649,25 @@ namespace Plugin {
                     , _measurement(copy._measurement)
                     , _operationalEvaluate(copy._operationalEvaluate)
                     , _source(copy._source)
+                    , _pid(copy._pid)
+                    , _watch(nullptr)
+                    , _exited(copy._exited.load())
+                    , _history(copy._history)
+                    , _horizon(copy._horizon)
+                    , _projected(copy._projected)
                     , _interval(copy._interval)
                 {
+                    // The watch belongs to the object in the map, it is only created once the object is in there.
+                    ASSERT(copy._watch == nullptr);
+
                     if (_source != nullptr) {
                         _source->AddRef();
                     }
                 }
                 ~MonitorObject()
                 {
+                    Detach();
+
                     if (_source != nullptr) {
                         _source->Release();
                         _source = nullptr;
@@ -642,6 +757,15 @@ namespace Plugin {
                 {
                     return (_nextSlot);
                 }
+                inline const MemoryHistory& History() const
+                {
+                    return (_history);
+                }
+                // Minutes until the memory limit is reached at the current trend, 0 if that is not in sight.
+                inline uint32_t Breach() const
+                {
+                    return (_memoryThreshold != 0 ? _history.Breach(_memoryThreshold / 1024) : 0);
+                }
                 inline void Reset()
                 {
                     _measurement.Reset();
@@ -664,17 +788,59 @@ namespace Plugin {
                         _source->AddRef();
                     }
 
-                    _measurement.Operational(_source != nullptr);
+                    _measurement.Operational((_source != nullptr) || (_pid != 0));
+                }
+                // The plugin (re)started, an earlier trend says nothing about this run.
+                inline void Activated()
+                {
+                    _history.Mark();
+                    _projected = false;
+                }
+                // Observe the process hosting the plugin directly: its exit is reported by exited() the moment it
+                // happens, its memory is read from /proc.
+                inline void Attach(const pid_t pid, const std::function<void()>& exited)
+                {
+                    Detach();
+
+                    _pid = pid;
+                    _exited = false;
+                    _watch = new ProcessObserver::Watch(pid, [this, exited]() { _exited = true; exited(); });
+                    _measurement.Operational(true);
+                }
+                inline void Detach()
+                {
+                    if (_watch != nullptr) {
+                        delete _watch;
+                        _watch = nullptr;
+                    }
+                    _pid = 0;
+                }
+                inline bool HasExited() const
+                {
+                    return (_exited);
+                }
+                // Picks up an exit of the observed process that was signalled in between the time slots.
+                inline uint32_t Exit()
+                {
+                    uint32_t status(SUCCESFULL);
+
+                    if ((_exited.exchange(false) == true) && (_operationalInterval != 0)) {
+                        _measurement.Operational(false);
+                        status = NOT_OPERATIONAL;
+                        TRACE_L1("Process %d exited. %d", _pid, __LINE__);
+                    }
+                    return (status);
                 }
-                inline uint32_t Evaluate()
+                inline uint32_t Evaluate(ProcessObserver& observer, const uint64_t now)
                 {
                     uint32_t status(SUCCESFULL);
-                    if (_source != nullptr) {
-                        _operationalSlots -= _interval;
-                        _memorySlots -= _interval;
+                    if ((_source != nullptr) || (_pid != 0)) {
+                        // Saturate, a slot count that is not a multiple of the interval must not wrap.
+                        _operationalSlots = (_operationalSlots > _interval ? _operationalSlots - _interval : 0);
+                        _memorySlots = (_memorySlots > _interval ? _memorySlots - _interval : 0);
 
                         if ((_operationalInterval != 0) && (_operationalSlots == 0)) {
-                            bool operational = _source->IsOperational();
+                            bool operational = (_source != nullptr ? _source->IsOperational() : (_exited == false));
                             _measurement.Operational(operational);
                             if (operational == false) {
                                 status |= NOT_OPERATIONAL;
@@ -683,18 +849,61 @@ namespace Plugin {
                             _operationalSlots = _operationalInterval;
                         }
                         if ((_memoryInterval != 0) && (_memorySlots == 0)) {
-                            _measurement.Measure(_source);
+                            ProcessObserver::Sample sample;
+
+                            if ((_pid != 0) && (observer.Measure(_pid, sample) == true)) {
+                                _measurement.Measure(sample);
+                            } else if (_source != nullptr) {
+                                _measurement.Measure(_source);
+                            }
 
                             if ((_memoryThreshold != 0) && (_measurement.Resident().Last() > _memoryThreshold)) {
                                 status |= EXCEEDED_MEMORY;
                                 TRACE_L1("Status MetaData Exceeded. %d", __LINE__);
                             }
-                            _memorySlots = _memoryInterval;
+                            if ((_history.Add(now, _measurement.Resident().Last() / 1024) == true) && (_memoryThreshold != 0) && (_horizon != 0)) {
+                                // Report a projected breach once, until the trend changes again.
+                                const uint32_t breach(Breach());
+                                const bool projected((breach != 0) && (breach <= _horizon));
+
+                                if ((projected == true) && (_projected == false)) {
+                                    status |= PROJECTED_BREACH;
+                                    TRACE_L1("Status MetaData limit reached in %d minutes. %d", breach, __LINE__);
+                                }
+                                _projected = projected;
+                            }
+                            _memorySlots = Cadence();
                         }
                     }
                     return (status);
                 }
 
+            private:
+                // The closer the resident memory gets to the limit, the more often it is measured. Only
+                // with the same divisibility the interval was calculated with in the constructor and
+                // always rounded down to a multiple of that interval, so the slots count down to 0.
+                inline uint32_t Cadence() const
+                {
+                    uint32_t result(_memoryInterval);
+
+                    if ((_memoryThreshold != 0) && ((_memoryInterval % 4) == 0) && (_interval <= (_memoryInterval / 4))) {
+                        const uint64_t level((_measurement.Resident().Last() * 100) / _memoryThreshold);
+
+                        if (level >= 90) {
+                            result = _memoryInterval / 4;
+                        } else if (level >= 75) {
+                            result = _memoryInterval / 2;
+                        }
+
+                        result -= (result % _interval);
+
+                        if (result == 0) {
+                            result = _interval;
+                        }
+                    }
+                    return (result);
+                }
+
             private:
                 const uint32_t _operationalInterval; //!< Interval (s) to check the monitored processes
                 const uint32_t _memoryInterval; //!<  Interval (s) for a memory measurement.
@@ -713,6 +922,12 @@ namespace Plugin {
                 MetaData _measurement;
                 bool _operationalEvaluate;
                 Exchange::IMemory* _source;
+                pid_t _pid; //!< The process hosting the plugin, if observed directly.
+                ProcessObserver::Watch* _watch;
+                std::atomic<bool> _exited;
+                MemoryHistory _history;
+                uint16_t _horizon; //!< Minutes ahead a memory limit breach is reported.
+                bool _projected;
                 uint32_t _interval; //!< The lowest possible interval to check both memory and processes.
             };
 
@@ -724,8 +939,12 @@ namespace Plugin {
                 : _adminLock()
                 , _monitor()
                 , _job(Core::ProxyType<Job>::Create(this))
+                , _wakeJob(Core::ProxyType<WakeJob>::Create(this))
+                , _woken(false)
                 , _service(nullptr)
                 , _parent(*parent)
+                , _observer()
+                , _direct(false)
             {
             }
 #ifdef __WINDOWS__
@@ -758,12 +977,13 @@ namespace Plugin {
                         memoryRestartInterval);
                 }
             }
-            inline void Open(PluginHost::IShell* service, Core::JSON::ArrayType<Config::Entry>::Iterator& index)
+            inline void Open(PluginHost::IShell* service, Core::JSON::ArrayType<Config::Entry>::Iterator& index, const bool direct, const uint16_t horizon)
             {
                 ASSERT((service != nullptr) && (_service == nullptr));
 
                 uint64_t baseTime = Core::Time::Now().Ticks();
 
+                _direct = direct;
                 _service = service;
                 _service->AddRef();
 
@@ -801,7 +1021,8 @@ namespace Plugin {
 								operationalWindow, 
 								operationalLimit, 
 								memoryWindow, 
-								memoryLimit)));
+								memoryLimit,
+								horizon)));
                     }
                 }
 
@@ -813,7 +1034,17 @@ namespace Plugin {
             {
                 ASSERT(_service != nullptr);
 
+                // No exits can be signalled anymore once the watches are gone, so nothing submits the job again.
+                _adminLock.Lock();
+                for (auto& element : _monitor) {
+                    element.second.Detach();
+                }
+                _adminLock.Unlock();
+
+                // A wake up submits the probe, so it goes first.
+                PluginHost::WorkerPool::Instance().Revoke(_wakeJob);
                 PluginHost::WorkerPool::Instance().Revoke(_job);
+                _woken = false;
 
                 _adminLock.Lock();
                 _monitor.clear();
@@ -836,11 +1067,22 @@ namespace Plugin {
                         // Get the MetaData interface
                         Exchange::IMemory* memory = service->QueryInterface<Exchange::IMemory>();
 
+                        index->second.Activated();
+
+                        if (_direct == true) {
+                            pid_t pid = ProcessObserver::Host(index->first);
+
+                            if (pid != 0) {
+                                index->second.Attach(pid, [this]() { Wake(); });
+                            }
+                        }
+
                         if (memory != nullptr) {
                             index->second.Set(memory);
                             memory->Release();
                         }
                     } else if (currentState == PluginHost::IShell::DEACTIVATION) {
+                        index->second.Detach();
                         index->second.Set(nullptr);
                     } else if ((currentState == PluginHost::IShell::DEACTIVATED) && (index->second.HasRestartAllowed() == true) && ((service->Reason() == PluginHost::IShell::MEMORY_EXCEEDED) || (service->Reason() == PluginHost::IShell::FAILURE))) {
                         if (index->second.RegisterRestart(service->Reason()) == false) {
@@ -939,6 +1181,28 @@ namespace Plugin {
                 _adminLock.Unlock();
             }
 
+            bool History(const string& name, HistoryData& result)
+            {
+                bool found = false;
+
+                _adminLock.Lock();
+
+                std::map<string, MonitorObject>::iterator index(_monitor.find(name));
+
+                if (index != _monitor.end()) {
+                    const MemoryHistory& history(index->second.History());
+
+                    history.Values([&result](const uint64_t value) { result.Resident.Add(Core::JSON::DecUInt64(value)); });
+                    result.Slope = static_cast<int64_t>(history.Slope() * 60);
+                    result.Breach = index->second.Breach();
+                    found = true;
+                }
+
+                _adminLock.Unlock();
+
+                return (found);
+            }
+
             bool Reset(const string& name, Monitor::MetaData& result)
             {
                 bool found = false;
@@ -981,6 +1245,23 @@ namespace Plugin {
             END_INTERFACE_MAP
 
         private:
+            // An observed process exited, evaluate right away instead of waiting for the next time slot. This runs
+            // on the thread that watches the processes, which should not wait for a probe in progress, so moving
+            // the probe forward is left to the wake job.
+            void Wake()
+            {
+                if (_woken.exchange(true) == false) {
+                    PluginHost::WorkerPool::Instance().Submit(_wakeJob);
+                }
+            }
+            void Woken()
+            {
+                // Cleared first, an exit signalled from here on gets a wake up of its own.
+                _woken = false;
+
+                PluginHost::WorkerPool::Instance().Revoke(_job);
+                PluginHost::WorkerPool::Instance().Submit(_job);
+            }
             // Probe can be run in an unlocked state as the destruction of the observer list
             // is always done if the thread that calls the Probe is blocked (paused)
             void Probe()
@@ -994,8 +1275,20 @@ namespace Plugin {
                 while (index != _monitor.end()) {
                     MonitorObject& info(index->second);
 
-                    if (info.TimeSlot() <= scheduledTime) {
-                        uint32_t value(info.Evaluate());
+                    const bool due(info.TimeSlot() <= scheduledTime);
+
+                    if ((due == true) || (info.HasExited() == true)) {
+                        uint32_t value((due == true ? info.Evaluate(_observer, scheduledTime) : static_cast<uint32_t>(MonitorObject::SUCCESFULL)) | info.Exit());
+
+                        if ((value & MonitorObject::PROJECTED_BREACH) != 0) {
+                            const string reason("Memory limit reached in " + std::to_string(info.Breach()) + " minutes");
+                            const string message("{\"callsign\": \"" + index->first + "\", \"action\": \"ProjectedBreach\", \"reason\": \"" + reason + "\" }");
+                            TRACE(Trace::Information, (_T("Memory of %s grows, %s."), index->first.c_str(), reason.c_str()));
+
+                            _service->Notify(message);
+
+                            _parent.event_action(index->first, "ProjectedBreach", reason);
+                        }
 
                         if ((value & (MonitorObject::NOT_OPERATIONAL | MonitorObject::EXCEEDED_MEMORY)) != 0) {
                             PluginHost::IShell* plugin(_service->QueryInterfaceByCallsign<PluginHost::IShell>(index->first));
@@ -1015,7 +1308,9 @@ namespace Plugin {
                                 plugin->Release();
                             }
                         }
-                        info.Retrigger(scheduledTime);
+                        if (due == true) {
+                            info.Retrigger(scheduledTime);
+                        }
                     }
 
                     if (info.TimeSlot() < nextSlot) {
@@ -1048,8 +1343,12 @@ namespace Plugin {
             Core::CriticalSection _adminLock;
             std::map<string, MonitorObject> _monitor;
             Core::ProxyType<Core::IDispatchType<void>> _job;
+            Core::ProxyType<Core::IDispatchType<void>> _wakeJob;
+            std::atomic<bool> _woken;
             PluginHost::IShell* _service;
             Monitor& _parent;
+            ProcessObserver _observer; //!< Only used by Probe, it reuses its buffers for all the observed processes.
+            bool _direct;
         };
 
     public:
@@ -1125,6 +1424,7 @@ namespace Plugin {
         void UnregisterAll();
         uint32_t endpoint_restartlimits(const JsonData::Monitor::RestartlimitsParamsData& params);
         uint32_t endpoint_resetstats(const JsonData::Monitor::ResetstatsParamsData& params, JsonData::Monitor::InfoInfo& response);
+        uint32_t endpoint_history(const HistoryParams& params, HistoryData& response);
         uint32_t get_status(const string& index, Core::JSON::ArrayType<JsonData::Monitor::InfoInfo>& response) const;
         void event_action(const string& callsign, const string& action, const string& reason);
     };
@@ -15,11 +15,13 @@ namespace Plugin {
     {
         Register<RestartlimitsParamsData,void>(_T("restartlimits"), &Monitor::endpoint_restartlimits, this);
         Register<ResetstatsParamsData,InfoInfo>(_T("resetstats"), &Monitor::endpoint_resetstats, this);
+        Register<HistoryParams,HistoryData>(_T("history"), &Monitor::endpoint_history, this);
         Property<Core::JSON::ArrayType<InfoInfo>>(_T("status"), &Monitor::get_status, nullptr, this);
     }
 
     void Monitor::UnregisterAll()
     {
+        Unregister(_T("history"));
         Unregister(_T("resetstats"));
         Unregister(_T("restartlimits"));
         Unregister(_T("status"));
@@ -57,6 +59,15 @@ namespace Plugin {
         return Core::ERROR_NONE;
     }
 
+    // Method: history - The resident memory of a plugin watched by the Monitor over the last 24 hours, and its trend
+    // Return codes:
+    //  - ERROR_NONE: Success
+    //  - ERROR_UNKNOWN_KEY: The plugin is not watched by the Monitor
+    uint32_t Monitor::endpoint_history(const HistoryParams& params, HistoryData& response)
+    {
+        return (_monitor->History(params.Callsign.Value(), response) == true ? Core::ERROR_NONE : Core::ERROR_UNKNOWN_KEY);
+    }
+
     // Property: status - The memory and process statistics either for a single plugin or all plugins watched by the Monitor
     // Return codes:
     //  - ERROR_NONE: Success
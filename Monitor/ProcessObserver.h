@@ -0,0 +1,247 @@
+#pragma once
+
+#include "Module.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <functional>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__NR_pidfd_open) && !defined(SYS_pidfd_open)
+#define SYS_pidfd_open __NR_pidfd_open
+#endif
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Looks at the processes of out-of-process plugins straight through /proc, instead of asking the plugin
+    // (over COM-RPC) to read /proc for us.
+    class ProcessObserver {
+    public:
+        struct Sample {
+            uint64_t Resident; // bytes
+            uint64_t Allocated; // bytes, anonymous memory, resident or swapped out
+            uint64_t Shared; // bytes
+            uint8_t Processes;
+        };
+
+        // Signals the exit of a process the moment it happens, using a pidfd that becomes readable on exit.
+        class Watch : public Core::IResource {
+        private:
+            Watch() = delete;
+            Watch(const Watch&) = delete;
+            Watch& operator=(const Watch&) = delete;
+
+        public:
+            Watch(const pid_t pid, const std::function<void()>& exited)
+                : _descriptor(-1)
+                , _signalled(false)
+                , _exited(exited)
+            {
+#ifdef SYS_pidfd_open
+                _descriptor = static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#endif
+                if (_descriptor == -1) {
+                    TRACE_L1("No pidfd for process %d, error: %d", pid, errno);
+                } else {
+                    Core::ResourceMonitor::Instance().Register(*this);
+                }
+            }
+            virtual ~Watch()
+            {
+                if (_descriptor != -1) {
+                    Core::ResourceMonitor::Instance().Unregister(*this);
+                    ::close(_descriptor);
+                    _descriptor = -1;
+                }
+            }
+
+        public:
+            inline bool IsValid() const
+            {
+                return (_descriptor != -1);
+            }
+            virtual Core::IResource::handle Descriptor() const override
+            {
+                return (_descriptor);
+            }
+            virtual uint16_t Events() override
+            {
+                // A pidfd stays readable once the process is gone, report the exit only once.
+                return (_signalled == false ? POLLIN : 0);
+            }
+            virtual void Handle(const uint16_t events) override
+            {
+                if (((events & POLLIN) != 0) && (_signalled == false)) {
+                    _signalled = true;
+                    _exited();
+                }
+            }
+
+        private:
+            int _descriptor;
+            bool _signalled;
+            std::function<void()> _exited;
+        };
+
+    public:
+        ProcessObserver(const ProcessObserver&) = delete;
+        ProcessObserver& operator=(const ProcessObserver&) = delete;
+
+        ProcessObserver()
+            : _buffer()
+            , _children()
+        {
+        }
+        ~ProcessObserver()
+        {
+        }
+
+    public:
+        // The process hosting an out-of-process plugin is a child of ours, started with "-C <callsign>".
+        // Returns 0 if there is none, e.g. if the plugin runs in our process.
+        static pid_t Host(const string& callsign)
+        {
+            pid_t result = 0;
+            DIR* directory = ::opendir("/proc");
+
+            if (directory != nullptr) {
+                const pid_t self = ::getpid();
+                string content;
+                struct dirent* entry;
+
+                while ((result == 0) && ((entry = ::readdir(directory)) != nullptr)) {
+                    const pid_t pid = static_cast<pid_t>(::atoi(entry->d_name));
+
+                    if ((pid > 0) && (Parent(pid, content) == self) && (Read(string("/proc/") + entry->d_name + "/cmdline", content) == true)) {
+                        // The arguments are separated by a '\0'.
+                        const string option(string("\0-C\0", 4) + callsign + '\0');
+
+                        if ((string('\0' + content + '\0').find(option) != string::npos)) {
+                            result = pid;
+                        }
+                    }
+                }
+
+                ::closedir(directory);
+            }
+
+            return (result);
+        }
+
+        // The memory of the process and all of its descendants, from one read of smaps_rollup per process.
+        bool Measure(const pid_t pid, Sample& sample)
+        {
+            std::list<pid_t> pending({ pid });
+
+            sample.Resident = 0;
+            sample.Allocated = 0;
+            sample.Shared = 0;
+            sample.Processes = 0;
+
+            while (pending.empty() == false) {
+                const pid_t current = pending.front();
+                const string base(string("/proc/") + Core::NumberType<pid_t>(current).Text());
+
+                pending.pop_front();
+
+                if (Read(base + "/smaps_rollup", _buffer) == true) {
+                    uint64_t sharedClean = 0, sharedDirty = 0, rss = 0, anonymous = 0, swap = 0;
+
+                    Value(_buffer, "Rss:", rss);
+                    Value(_buffer, "Shared_Clean:", sharedClean);
+                    Value(_buffer, "Shared_Dirty:", sharedDirty);
+                    Value(_buffer, "Anonymous:", anonymous);
+                    Value(_buffer, "Swap:", swap);
+
+                    sample.Resident += rss * 1024;
+                    sample.Shared += (sharedClean + sharedDirty) * 1024;
+                    sample.Allocated += (anonymous + swap) * 1024;
+                    sample.Processes++;
+
+                    Children(base, pending);
+                }
+            }
+
+            return (sample.Processes != 0);
+        }
+
+    private:
+        static pid_t Parent(const pid_t pid, string& content)
+        {
+            pid_t result = 0;
+
+            if (Read(string("/proc/") + Core::NumberType<pid_t>(pid).Text() + "/stat", content) == true) {
+                // The name of the process is between braces and may hold spaces, the parent follows the state.
+                size_t index = content.rfind(')');
+
+                if ((index != string::npos) && ((index + 4) < content.length())) {
+                    result = static_cast<pid_t>(::atoi(&(content.c_str()[index + 4])));
+                }
+            }
+
+            return (result);
+        }
+        void Children(const string& base, std::list<pid_t>& pending)
+        {
+            DIR* directory = ::opendir((base + "/task").c_str());
+
+            if (directory != nullptr) {
+                struct dirent* entry;
+
+                while ((entry = ::readdir(directory)) != nullptr) {
+                    if ((entry->d_name[0] != '.') && (Read(base + "/task/" + entry->d_name + "/children", _children) == true)) {
+                        const char* text = _children.c_str();
+
+                        while (*text != '\0') {
+                            char* end;
+                            long child = ::strtol(text, &end, 10);
+
+                            if (end == text) {
+                                break;
+                            }
+
+                            pending.push_back(static_cast<pid_t>(child));
+                            text = end;
+                        }
+                    }
+                }
+
+                ::closedir(directory);
+            }
+        }
+        static void Value(const string& content, const char label[], uint64_t& value)
+        {
+            size_t index = content.find(label);
+
+            if (index != string::npos) {
+                value = ::strtoull(&(content.c_str()[index + ::strlen(label)]), nullptr, 10);
+            }
+        }
+        static bool Read(const string& fileName, string& content)
+        {
+            int descriptor = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+
+            content.clear();
+
+            if (descriptor != -1) {
+                char buffer[1024];
+                ssize_t size;
+
+                while ((size = ::read(descriptor, buffer, sizeof(buffer))) > 0) {
+                    content.append(buffer, size);
+                }
+
+                ::close(descriptor);
+            }
+
+            return (descriptor != -1);
+        }
+
+    private:
+        string _buffer;
+        string _children;
+    };
+}
+}
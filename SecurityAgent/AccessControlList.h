@@ -3,6 +3,7 @@
 #include "Module.h"
 
 #include <regex>
+#include <unordered_map>
 
 namespace WPEFramework {
 namespace Plugin {
@@ -143,20 +144,109 @@ namespace Plugin {
 
     public:
         class Filter {
+        private:
+            // All prefixes of one list in a character trie, a method is checked in a single walk over its name,
+            // whatever the number of prefixes.
+            class PrefixTree {
+            private:
+                PrefixTree(const PrefixTree&) = delete;
+                PrefixTree& operator=(const PrefixTree&) = delete;
+
+                class Node {
+                public:
+                    Node()
+                        : Children()
+                        , Terminal(false)
+                    {
+                    }
+
+                public:
+                    std::vector<std::pair<TCHAR, uint32_t>> Children;
+                    bool Terminal;
+                };
+
+            public:
+                PrefixTree()
+                    : _nodes(1)
+                {
+                }
+                ~PrefixTree()
+                {
+                }
+
+            public:
+                inline bool IsEmpty() const
+                {
+                    return ((_nodes.size() == 1) && (_nodes[0].Terminal == false));
+                }
+                void Add(const string& prefix)
+                {
+                    uint32_t current = 0;
+
+                    for (const TCHAR character : prefix) {
+                        uint32_t next = Child(current, character);
+
+                        if (next == 0) {
+                            next = static_cast<uint32_t>(_nodes.size());
+                            _nodes[current].Children.emplace_back(character, next);
+                            _nodes.emplace_back();
+                        }
+                        current = next;
+                    }
+
+                    _nodes[current].Terminal = true;
+                }
+                // Is one of the prefixes a prefix of the given text.
+                bool Matches(const string& text) const
+                {
+                    uint32_t current = 0;
+                    string::const_iterator index(text.begin());
+
+                    while ((_nodes[current].Terminal == false) && (index != text.end()) && ((current = Child(current, *index)) != 0)) {
+                        index++;
+                    }
+
+                    return (_nodes[current].Terminal);
+                }
+
+            private:
+                // The root is never a child, so 0 tells there is no such child.
+                uint32_t Child(const uint32_t node, const TCHAR character) const
+                {
+                    uint32_t result = 0;
+                    std::vector<std::pair<TCHAR, uint32_t>>::const_iterator index(_nodes[node].Children.begin());
+
+                    while ((index != _nodes[node].Children.end()) && (index->first != character)) {
+                        index++;
+                    }
+                    if (index != _nodes[node].Children.end()) {
+                        result = index->second;
+                    }
+
+                    return (result);
+                }
+
+            private:
+                std::vector<Node> _nodes;
+            };
+
         public:
             Filter() = delete;
             Filter(const Filter&) = delete;
             Filter& operator=(const Filter&) = delete;
 
             Filter(const JSONACL::Config& filter)
+                : _allowSet(filter.Allow.IsSet())
+                , _allow()
+                , _block()
             {
                 Core::JSON::ArrayType<Core::JSON::String>::ConstIterator index(filter.Allow.Elements());
                 while (index.Next() == true) {
-                    _allow.emplace_back(index.Current().Value());
+                    _allow.Add(index.Current().Value());
                 }
                 index = (filter.Block.Elements());
                 while (index.Next() == true) {
-                    _block.emplace_back(index.Current().Value());
+                    _block.Add(index.Current().Value());
                 }
             }
             ~Filter()
@@ -166,31 +256,177 @@ namespace Plugin {
         public:
             bool Allowed(const string& method) const
             {
-                bool allowed = false;
-                if (_allowSet) {
-                    std::list<string>::const_iterator index(_allow.begin());
-                    while ((index != _allow.end()) && (allowed == false)) {
-                        allowed = strncmp(index->c_str(), method.c_str(), index->length()) == 0;
+                return (_allowSet == true ? _allow.Matches(method) : (_block.Matches(method) == false));
+            }
+
+        private:
+            bool _allowSet;
+            PrefixTree _allow;
+            PrefixTree _block;
+        };
+
+    private:
+        // A URL pattern, compiled once when the list is loaded. Patterns without any special character are
+        // plain text searches, others are only handed to the regex engine if their literal start is present.
+        class Expression {
+        public:
+            Expression() = delete;
+            Expression& operator=(const Expression&) = delete;
+
+            Expression(const string& pattern, const Filter& filter)
+                : _literal()
+                , _anchored(false)
+                , _plain(false)
+                , _expression()
+                , _filter(filter)
+            {
+                static const TCHAR special[] = _T("\\^$.|?*+()[]{}");
+
+                size_t index = ((pattern.empty() == false) && (pattern[0] == '^') ? 1 : 0);
+
+                _anchored = (index == 1);
+
+                // Collect the literal text the pattern starts with, escaped punctuation (\., \/) is literal too.
+                while (index < pattern.length()) {
+                    if ((pattern[index] == '\\') && ((index + 1) < pattern.length()) && (::isalnum(pattern[index + 1]) == 0)) {
+                        _literal += pattern[index + 1];
+                        index += 2;
+                    } else if (::strchr(special, pattern[index]) == nullptr) {
+                        _literal += pattern[index];
                         index++;
+                    } else {
+                        break;
                     }
+                }
+
+                _plain = (index == pattern.length());
+
+                if (pattern.find('|', index) != string::npos) {
+                    // With alternatives there is no literal every match starts with.
+                    _literal.clear();
+                } else if ((_literal.empty() == false) && ((pattern[index] == '?') || (pattern[index] == '*') || (pattern[index] == '{'))) {
+                    // A quantifier applies to the last literal character, that one is not required.
+                    _literal.erase(_literal.length() - 1);
+                }
+
+                if (_plain == false) {
+                    _expression = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+                }
+            }
+            Expression(const Expression& copy)
+                : _literal(copy._literal)
+                , _anchored(copy._anchored)
+                , _plain(copy._plain)
+                , _expression(copy._expression)
+                , _filter(copy._filter)
+            {
+            }
+            ~Expression()
+            {
+            }
+
+        public:
+            inline const Filter& Selected() const
+            {
+                return (_filter);
+            }
+            bool Matches(const string& URL) const
+            {
+                bool result;
+
+                if (_anchored == true) {
+                    result = (URL.compare(0, _literal.length(), _literal) == 0);
                 } else {
-                    allowed = true;
-                    std::list<string>::const_iterator index(_block.begin());
-                    while ((index != _block.end()) && (allowed == true)) {
-                        allowed = strncmp(index->c_str(), method.c_str(), index->length()) != 0;
-                        index++;
+                    result = (URL.find(_literal) != string::npos);
+                }
+
+                if ((result == true) && (_plain == false)) {
+                    result = std::regex_search(URL, _expression);
+                }
+
+                return (result);
+            }
+
+        private:
+            string _literal;
+            bool _anchored;
+            bool _plain;
+            std::regex _expression;
+            const Filter& _filter;
+        };
+
+        // The origins seen are few and repeat a lot, remember the outcome for the most recent ones.
+        class Resolved {
+        private:
+            Resolved() = delete;
+            Resolved(const Resolved&) = delete;
+            Resolved& operator=(const Resolved&) = delete;
+
+            typedef std::list<std::pair<string, const Filter*>> Entries;
+
+        public:
+            Resolved(const uint16_t size)
+                : _adminLock()
+                , _size(size)
+                , _entries()
+                , _index()
+            {
+            }
+            ~Resolved()
+            {
+            }
+
+        public:
+            bool Find(const string& URL, const Filter*& filter)
+            {
+                _adminLock.Lock();
+
+                std::unordered_map<string, Entries::iterator>::iterator index(_index.find(URL));
+                bool result = (index != _index.end());
+
+                if (result == true) {
+                    _entries.splice(_entries.begin(), _entries, index->second);
+                    filter = index->second->second;
+                }
+
+                _adminLock.Unlock();
+
+                return (result);
+            }
+            void Insert(const string& URL, const Filter* filter)
+            {
+                _adminLock.Lock();
+
+                if (_index.find(URL) == _index.end()) {
+                    if (_entries.size() >= _size) {
+                        _index.erase(_entries.back().first);
+                        _entries.pop_back();
                     }
+                    _entries.emplace_front(URL, filter);
+                    _index.emplace(URL, _entries.begin());
                 }
-                return (allowed);
+
+                _adminLock.Unlock();
+            }
+            void Clear()
+            {
+                _adminLock.Lock();
+                _index.clear();
+                _entries.clear();
+                _adminLock.Unlock();
             }
 
         private:
-            bool _allowSet;
-            std::list<string> _allow;
-            std::list<string> _block;
+            Core::CriticalSection _adminLock;
+            const uint16_t _size;
+            Entries _entries;
+            std::unordered_map<string, Entries::iterator> _index;
         };
 
-        using URLList = std::list<std::pair<string, Filter&>>;
+        static constexpr uint16_t ResolvedSize = 64;
+
+    public:
+        using URLList = std::list<Expression>;
         using Iterator = Core::IteratorType<const std::list<string>, const string&, std::list<string>::const_iterator>;
 
     public:
@@ -202,6 +438,7 @@ namespace Plugin {
             , _filterMap()
             , _unusedRoles()
             , _undefinedURLS()
+            , _resolved(ResolvedSize)
         {
         }
         ~AccessControlList()
@@ -223,23 +460,23 @@ namespace Plugin {
             _filterMap.clear();
             _unusedRoles.clear();
             _undefinedURLS.clear();
+            _resolved.Clear();
         }
         const Filter* FilterMapFromURL(const string& URL) const
         {
             const Filter* result = nullptr;
-            std::smatch matchList;
-            URLList::const_iterator index = _urlMap.begin();
 
-            while ((index != _urlMap.end()) && (result == nullptr)) {
-                // regex_search() for searching the regex pattern
-                // 'r' in the string 's'. 'm' is flag for determining
-                // matching behavior.
-                std::regex expression(index->first.c_str());
+            if (_resolved.Find(URL, result) == false) {
+                URLList::const_iterator index = _urlMap.begin();
 
-                if (std::regex_search(URL, matchList, expression) == true) {
-                    result = &(index->second);
+                while ((index != _urlMap.end()) && (result == nullptr)) {
+                    if (index->Matches(URL) == true) {
+                        result = &(index->Selected());
+                    }
+                    index++;
                 }
-                index++;
+
+                _resolved.Insert(URL, result);
             }
 
             return (result);
@@ -253,6 +490,7 @@ namespace Plugin {
                 SYSLOG(Logging::ParsingError, (_T("Parsing failed with %s"), ErrorDisplayMessage(error.Value()).c_str()));
             }
             _unusedRoles.clear();
+            _resolved.Clear();
 
             JSONACL::Roles::Iterator rolesIndex = controlList.ACL.Elements();
 
@@ -282,10 +520,13 @@ namespace Plugin {
                         _undefinedURLS.push_front(role);
                     }
                 } else {
-                    Filter& entry(selectedFilter->second);
+                    const string& URL(index.Current().URL.Value());
 
-                    _urlMap.emplace_back(std::pair<string, Filter&>(
-                        index.Current().URL.Value(), entry));
+                    try {
+                        _urlMap.emplace_back(URL, selectedFilter->second);
+                    } catch (const std::regex_error& error) {
+                        SYSLOG(Logging::ParsingError, (_T("URL expression %s is invalid: %s"), URL.c_str(), error.what()));
+                    }
 
                     std::list<string>::iterator found = std::find(_unusedRoles.begin(), _unusedRoles.end(), role);
 
@@ -302,6 +543,7 @@ namespace Plugin {
         std::map<string, Filter> _filterMap;
         std::list<string> _unusedRoles;
         std::list<string> _undefinedURLS;
+        mutable Resolved _resolved;
     };
 }
 }
@@ -39,12 +39,13 @@ namespace Plugin {
     };
 
     SecurityAgent::SecurityAgent()
+        : _acl()
+        , _skipURL(0)
+        , _tokens()
     {
         RegisterAll();
 
-        for (uint8_t index = 0; index < sizeof(_secretKey); index++) {
-            Crypto::Random(_secretKey[index]);
-        }
+        Rotate();
     }
 
     /* virtual */ SecurityAgent::~SecurityAgent()
@@ -59,6 +60,7 @@ namespace Plugin {
         string version = service->Version();
 
         _skipURL = static_cast<uint8_t>(service->WebPrefix().length());
+        _tokens.Configure(config.Tokens.Size.Value(), config.Tokens.Lifetime.Value());
         Core::File aclFile(service->PersistentPath() + config.ACL.Value(), true);
 
         if (aclFile.Exists() == false) {
@@ -108,13 +110,38 @@ namespace Plugin {
             subSystem->Set(PluginHost::ISubSystem::NOT_SECURITY, nullptr);
             subSystem->Release();
         }
+        // The cached contexts refer to the access control list.
+        _tokens.Clear();
         _acl.Clear();
     }
 
     /* virtual */ string SecurityAgent::Information() const
     {
-        // No additional info to report.
-        return (string());
+        TokenCache::Statistics statistics;
+        CacheInfo info;
+        string result;
+
+        _tokens.Snapshot(statistics);
+
+        info.Entries = statistics.Entries;
+        info.Hits = statistics.Hits;
+        info.Misses = statistics.Misses;
+        info.HitLatency = statistics.HitLatency;
+        info.MissLatency = statistics.MissLatency;
+
+        info.ToString(result);
+
+        return (result);
+    }
+
+    void SecurityAgent::Rotate()
+    {
+        for (uint8_t index = 0; index < sizeof(_secretKey); index++) {
+            Crypto::Random(_secretKey[index]);
+        }
+
+        // Tokens signed with the previous key are no longer valid.
+        _tokens.Clear();
     }
 
     /* virtual */ uint32_t SecurityAgent::CreateToken(const uint16_t length, const uint8_t buffer[], string& token)
@@ -127,23 +154,39 @@ namespace Plugin {
 
     /* virtual */ PluginHost::ISecurity* SecurityAgent::Officer(const string& token)
     {
-        PluginHost::ISecurity* result = nullptr;
+        uint64_t start = Core::Time::Now().Ticks();
+        const string key(TokenCache::Key(token));
+        PluginHost::ISecurity* result = _tokens.Find(key);
 
-        Web::JSONWebToken webToken(Web::JSONWebToken::SHA256, sizeof(_secretKey), _secretKey);
-        uint16_t load = webToken.PayloadLength(token);
+        if (result != nullptr) {
+            _tokens.Measure(true, static_cast<uint32_t>(Core::Time::Now().Ticks() - start));
+        } else {
+            Web::JSONWebToken webToken(Web::JSONWebToken::SHA256, sizeof(_secretKey), _secretKey);
+            uint16_t load = webToken.PayloadLength(token);
 
-        // Validate the token
-        if (load != static_cast<uint16_t>(~0)) {
-            // It is potentially a valid token, extract the payload.
-            uint8_t* payload = reinterpret_cast<uint8_t*>(ALLOCA(load));
+            // Validate the token
+            if (load != static_cast<uint16_t>(~0)) {
+                // It is potentially a valid token, extract the payload.
+                uint8_t* payload = reinterpret_cast<uint8_t*>(ALLOCA(load));
 
-            load = webToken.Decode(token, load, payload);
+                load = webToken.Decode(token, load, payload);
 
-            if (load != static_cast<uint16_t>(~0)) {
-                // Seems like we extracted a valid payload, time to create an security context
-                result = Core::Service<SecurityContext>::Create<SecurityContext>(&_acl, load, payload);
+                if (load != static_cast<uint16_t>(~0)) {
+                    // Seems like we extracted a valid payload, time to create an security context
+                    SecurityContext* context = Core::Service<SecurityContext>::Create<SecurityContext>(&_acl, load, payload);
+
+                    if (context->IsExpired() == true) {
+                        context->Release();
+                    } else {
+                        _tokens.Insert(key, context, context->Expiry());
+                        result = context;
+                    }
+                }
             }
+
+            _tokens.Measure(false, static_cast<uint32_t>(Core::Time::Now().Ticks() - start));
         }
+
         return (result);
     }
 
@@ -187,27 +230,17 @@ namespace Plugin {
                 result->Message = _T("Missing token");
 
                 if (request.WebToken.IsSet()) {
-                    Web::JSONWebToken webToken(Web::JSONWebToken::SHA256, sizeof(_secretKey), _secretKey);
-                    const string& token = request.WebToken.Value().Token();
-                    uint16_t load = webToken.PayloadLength(token);
-
-                    // Validate the token
-                    if (load != static_cast<uint16_t>(~0)) {
-                        // It is potentially a valid token, extract the payload.
-                        uint8_t* payload = reinterpret_cast<uint8_t*>(ALLOCA(load));
-
-                        load = webToken.Decode(token, load, payload);
-
-                        if (load == static_cast<uint16_t>(~0)) {
-                            result->ErrorCode = Web::STATUS_FORBIDDEN;
-                            result->Message = _T("Invalid token");
-                        } else {
-                            result->ErrorCode = Web::STATUS_OK;
-                            result->Message = _T("Valid token");
-                            TRACE(Trace::Information, (_T("Token contents: %s"), reinterpret_cast<const TCHAR*>(payload)));
-                        }
+                    PluginHost::ISecurity* officer = Officer(request.WebToken.Value().Token());
+
+                    if (officer == nullptr) {
+                        result->ErrorCode = Web::STATUS_FORBIDDEN;
+                        result->Message = _T("Invalid token");
+                    } else {
+                        result->ErrorCode = Web::STATUS_OK;
+                        result->Message = _T("Valid token");
+                        TRACE(Trace::Information, (_T("Token contents: %s"), static_cast<const SecurityContext*>(officer)->Payload().c_str()));
+                        officer->Release();
                     }
-                
 				}
             }
         }
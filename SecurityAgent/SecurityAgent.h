@@ -3,6 +3,7 @@
 #include "Module.h"
 #include <interfaces/json/JsonData_SecurityAgent.h>
 #include "AccessControlList.h"
+#include "TokenCache.h"
 
 
 namespace WPEFramework {
@@ -18,13 +19,38 @@ namespace Plugin {
             Config(const Config&) = delete;
             Config& operator=(const Config&) = delete;
 
+        public:
+            class Cache : public Core::JSON::Container {
+            private:
+                Cache(const Cache&) = delete;
+                Cache& operator=(const Cache&) = delete;
+
+            public:
+                Cache()
+                    : Core::JSON::Container()
+                    , Size(128)
+                    , Lifetime(3600)
+                {
+                    Add(_T("size"), &Size);
+                    Add(_T("lifetime"), &Lifetime);
+                }
+                ~Cache()
+                {
+                }
+
+            public:
+                Core::JSON::DecUInt16 Size; // Number of validated tokens remembered, 0 disables the cache
+                Core::JSON::DecUInt32 Lifetime; // Seconds a validated token is remembered at most
+            };
+
         public:
             Config()
                 : Core::JSON::Container()
                 , ACL(_T("acl.json"))
-
+                , Tokens()
             {
                 Add(_T("acl"), &ACL);
+                Add(_T("tokencache"), &Tokens);
             }
             ~Config()
             {
@@ -32,6 +58,39 @@ namespace Plugin {
 
         public:
             Core::JSON::String ACL;
+            Cache Tokens;
+        };
+
+        class CacheInfo : public Core::JSON::Container {
+        private:
+            CacheInfo(const CacheInfo&) = delete;
+            CacheInfo& operator=(const CacheInfo&) = delete;
+
+        public:
+            CacheInfo()
+                : Core::JSON::Container()
+                , Entries(0)
+                , Hits(0)
+                , Misses(0)
+                , HitLatency(0)
+                , MissLatency(0)
+            {
+                Add(_T("entries"), &Entries);
+                Add(_T("hits"), &Hits);
+                Add(_T("misses"), &Misses);
+                Add(_T("hitlatency"), &HitLatency);
+                Add(_T("misslatency"), &MissLatency);
+            }
+            ~CacheInfo()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt32 Entries;
+            Core::JSON::DecUInt32 Hits;
+            Core::JSON::DecUInt32 Misses;
+            Core::JSON::DecUInt32 HitLatency; // 99th percentile of the validations found in the cache, in us
+            Core::JSON::DecUInt32 MissLatency; // 99th percentile of the validations that checked the token, in us
         };
 
     public:
@@ -86,10 +145,13 @@ namespace Plugin {
         uint32_t endpoint_validate(const JsonData::SecurityAgent::CreatetokenResultInfo& params, JsonData::SecurityAgent::ValidateResultData& response);
 
 
+        void Rotate();
+
     private:
         uint8_t _secretKey[Crypto::SHA256::Length];
         AccessControlList _acl;
         uint8_t _skipURL;
+        TokenCache _tokens;
     };
 
 } // namespace Plugin
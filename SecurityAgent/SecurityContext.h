@@ -18,10 +18,12 @@ namespace Plugin {
                 , URL()
                 , User()
                 , Hash()
+                , Expiry()
             {
                 Add(_T("url"), &URL);
                 Add(_T("user"), &User);
                 Add(_T("hash"), &Hash);
+                Add(_T("exp"), &Expiry);
             }
             ~Payload()
             {
@@ -31,6 +33,7 @@ namespace Plugin {
             Core::JSON::String URL;
             Core::JSON::String User;
             Core::JSON::String Hash;
+            Core::JSON::DecUInt64 Expiry; // Seconds since the epoch, as the JWT "exp" claim
         };
 
     public:
@@ -41,6 +44,22 @@ namespace Plugin {
         SecurityContext(const AccessControlList* acl, const uint16_t length, const uint8_t payload[]);
         virtual ~SecurityContext();
 
+        //! Moment, in ticks, after which the token carrying this context is no longer valid, 0 if it never expires.
+        inline uint64_t Expiry() const
+        {
+            return (_context.Expiry.IsSet() == true ? (_context.Expiry.Value() * Core::Time::TicksPerMillisecond * 1000) : 0);
+        }
+        inline bool IsExpired() const
+        {
+            return ((_context.Expiry.IsSet() == true) && (Expiry() <= Core::Time::Now().Ticks()));
+        }
+        inline string Payload() const
+        {
+            string result;
+            _context.ToString(result);
+            return (result);
+        }
+
         //! Allow a request to be checked before it is offered for processing.
         virtual bool Allowed(const Web::Request& request) const;
 
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "Module.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Remembers the security contexts of tokens that were validated before. The same token is presented on
+    // every request of a client, so checking the signature and parsing the payload once is enough. Tokens are
+    // looked up by their SHA256 digest, so the cache does not hold the tokens themselves. An entry is kept
+    // until the token expires ("exp") or its lifetime is over, whatever comes first. The least recently used
+    // entry makes room if the cache is full.
+    class TokenCache {
+    private:
+        TokenCache(const TokenCache&) = delete;
+        TokenCache& operator=(const TokenCache&) = delete;
+
+        typedef std::list<string> Order;
+
+        class Entry {
+        public:
+            Entry() = delete;
+            Entry& operator=(const Entry&) = delete;
+
+            Entry(PluginHost::ISecurity* context, const uint64_t expiry, const Order::iterator& position)
+                : Context(context)
+                , Expiry(expiry)
+                , Position(position)
+            {
+            }
+            Entry(const Entry& copy)
+                : Context(copy.Context)
+                , Expiry(copy.Expiry)
+                , Position(copy.Position)
+            {
+            }
+            ~Entry()
+            {
+            }
+
+        public:
+            PluginHost::ISecurity* Context;
+            const uint64_t Expiry;
+            Order::iterator Position;
+        };
+
+        typedef std::unordered_map<string, Entry> Entries;
+
+        // The latest validation times, in microseconds, to report a percentile on.
+        class Latencies {
+        private:
+            Latencies(const Latencies&) = delete;
+            Latencies& operator=(const Latencies&) = delete;
+
+            static constexpr uint16_t Samples = 512;
+
+        public:
+            Latencies()
+                : _samples()
+                , _next(0)
+            {
+                _samples.reserve(Samples);
+            }
+            ~Latencies()
+            {
+            }
+
+        public:
+            void Add(const uint32_t duration)
+            {
+                if (_samples.size() < Samples) {
+                    _samples.push_back(duration);
+                } else {
+                    _samples[_next] = duration;
+                }
+                _next = (_next + 1) % Samples;
+            }
+            uint32_t Percentile(const uint8_t percentage) const
+            {
+                uint32_t result = 0;
+
+                if (_samples.empty() == false) {
+                    std::vector<uint32_t> sorted(_samples);
+                    std::vector<uint32_t>::iterator selected(sorted.begin() + ((sorted.size() - 1) * percentage) / 100);
+
+                    std::nth_element(sorted.begin(), selected, sorted.end());
+                    result = *selected;
+                }
+
+                return (result);
+            }
+
+        private:
+            std::vector<uint32_t> _samples;
+            uint16_t _next;
+        };
+
+    public:
+        class Statistics {
+        public:
+            Statistics()
+                : Entries(0)
+                , Hits(0)
+                , Misses(0)
+                , HitLatency(0)
+                , MissLatency(0)
+            {
+            }
+
+        public:
+            uint32_t Entries;
+            uint32_t Hits;
+            uint32_t Misses;
+            uint32_t HitLatency; // 99th percentile, in microseconds
+            uint32_t MissLatency; // 99th percentile, in microseconds
+        };
+
+    public:
+        TokenCache()
+            : _adminLock()
+            , _size(0)
+            , _lifetime(0)
+            , _order()
+            , _entries()
+            , _hits(0)
+            , _misses(0)
+            , _hitLatency()
+            , _missLatency()
+        {
+        }
+        ~TokenCache()
+        {
+            Clear();
+        }
+
+    public:
+        // size: number of tokens remembered, 0 disables the cache
+        // lifetime: seconds a token is remembered at most
+        void Configure(const uint16_t size, const uint32_t lifetime)
+        {
+            _adminLock.Lock();
+
+            _size = size;
+            _lifetime = static_cast<uint64_t>(lifetime) * Core::Time::TicksPerMillisecond * 1000;
+
+            while (_order.size() > _size) {
+                Remove(_entries.find(_order.back()));
+            }
+
+            _adminLock.Unlock();
+        }
+        static string Key(const string& token)
+        {
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(token.c_str());
+            size_t length = token.length();
+            Crypto::SHA256 digest;
+
+            // The digest takes less than 64 KiB at a time, a longer token is fed in parts so all of it counts.
+            while (length > 0) {
+                const uint16_t part = static_cast<uint16_t>(std::min(length, static_cast<size_t>(0xFFFF)));
+
+                digest.Input(data, part);
+                data += part;
+                length -= part;
+            }
+
+            return (string(reinterpret_cast<const char*>(digest.Result()), digest.Length));
+        }
+        // Returns the context, with a reference taken for the caller, or nullptr if the token is not known (anymore).
+        PluginHost::ISecurity* Find(const string& key)
+        {
+            PluginHost::ISecurity* result = nullptr;
+
+            _adminLock.Lock();
+
+            Entries::iterator index(_entries.find(key));
+
+            if (index != _entries.end()) {
+                if (index->second.Expiry <= Core::Time::Now().Ticks()) {
+                    Remove(index);
+                } else {
+                    _order.splice(_order.begin(), _order, index->second.Position);
+                    result = index->second.Context;
+                    result->AddRef();
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        // expiry: moment the token expires, in ticks, 0 if the token does not tell.
+        void Insert(const string& key, PluginHost::ISecurity* context, const uint64_t expiry)
+        {
+            _adminLock.Lock();
+
+            if ((_size != 0) && (_entries.find(key) == _entries.end())) {
+                uint64_t until = Core::Time::Now().Ticks() + _lifetime;
+
+                if ((expiry != 0) && (expiry < until)) {
+                    until = expiry;
+                }
+
+                if (_order.size() >= _size) {
+                    Remove(_entries.find(_order.back()));
+                }
+
+                _order.push_front(key);
+                _entries.emplace(std::piecewise_construct,
+                    std::forward_as_tuple(key),
+                    std::forward_as_tuple(context, until, _order.begin()));
+
+                context->AddRef();
+            }
+
+            _adminLock.Unlock();
+        }
+        // Must be called whenever the key the tokens are signed with changes, none of the entries is valid anymore.
+        void Clear()
+        {
+            _adminLock.Lock();
+
+            while (_order.empty() == false) {
+                Remove(_entries.find(_order.back()));
+            }
+
+            _adminLock.Unlock();
+        }
+        void Measure(const bool hit, const uint32_t duration)
+        {
+            _adminLock.Lock();
+
+            if (hit == true) {
+                _hits++;
+                _hitLatency.Add(duration);
+            } else {
+                _misses++;
+                _missLatency.Add(duration);
+            }
+
+            _adminLock.Unlock();
+        }
+        void Snapshot(Statistics& statistics) const
+        {
+            _adminLock.Lock();
+
+            statistics.Entries = static_cast<uint32_t>(_entries.size());
+            statistics.Hits = _hits;
+            statistics.Misses = _misses;
+            statistics.HitLatency = _hitLatency.Percentile(99);
+            statistics.MissLatency = _missLatency.Percentile(99);
+
+            _adminLock.Unlock();
+        }
+
+    private:
+        void Remove(const Entries::iterator& index)
+        {
+            ASSERT(index != _entries.end());
+
+            index->second.Context->Release();
+            _order.erase(index->second.Position);
+            _entries.erase(index);
+        }
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        uint16_t _size;
+        uint64_t _lifetime;
+        Order _order;
+        Entries _entries;
+        uint32_t _hits;
+        uint32_t _misses;
+        Latencies _hitLatency;
+        Latencies _missLatency;
+    };
+}
+}
@@ -0,0 +1,209 @@
+// Measures what the SecurityAgent does for a token: resolve the origin URL of the token to the filter of its role
+// (AccessControlList::FilterMapFromURL(), when a SecurityContext is created) and check a JSON-RPC call against that
+// filter (SecurityContext::Allowed()). The ACL is written the way a device ships it: a few fixed origins (localhost,
+// loopback, file) and a list of partner domains, each as an anchored expression, followed by a catch-all.
+// As a reference, the URL is also resolved the way it was done before the expressions were compiled at load time:
+// compile every expression again on each lookup, until one matches.
+
+#include "../Module.h"
+#include "../AccessControlList.h"
+#include "../SecurityContext.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace WPEFramework;
+
+namespace {
+
+    typedef std::chrono::steady_clock Clock;
+
+    class Group {
+    public:
+        string URL;
+        string Role;
+    };
+
+    static const TCHAR* Callsigns[] = { _T("DeviceInfo"), _T("Controller"), _T("WebKitBrowser"), _T("Tracing"), _T("Messenger"), _T("Netflix") };
+
+    string Escape(const string& text)
+    {
+        string result;
+
+        for (const TCHAR character : text) {
+            if ((character == '\\') || (character == '"')) {
+                result += '\\';
+            }
+            result += character;
+        }
+
+        return (result);
+    }
+
+    std::vector<Group> Groups(const uint32_t partners)
+    {
+        std::vector<Group> result;
+
+        result.push_back({ _T("^https?://localhost(:[0-9]+)?(/.*)?$"), _T("local") });
+        result.push_back({ _T("^https?://127\\.0\\.0\\.1(:[0-9]+)?(/.*)?$"), _T("local") });
+        result.push_back({ _T("^https?://\\[::1\\](:[0-9]+)?(/.*)?$"), _T("local") });
+        result.push_back({ _T("^file://"), _T("local") });
+
+        for (uint32_t index = 0; index < partners; index++) {
+            result.push_back({ _T("^https?://([a-z0-9-]+\\.)*partner") + Core::NumberType<uint32_t>(index).Text() + _T("\\.example\\.com(:[0-9]+)?(/.*)?$"), _T("partner") });
+        }
+
+        result.push_back({ _T(".*"), _T("default") });
+
+        return (result);
+    }
+
+    bool Write(const string& fileName, const std::vector<Group>& groups)
+    {
+        string text(_T("{\n  \"assign\": [\n"));
+
+        for (size_t index = 0; index < groups.size(); index++) {
+            text += _T("    { \"url\": \"") + Escape(groups[index].URL) + _T("\", \"role\": \"") + groups[index].Role + ((index + 1) == groups.size() ? _T("\" }\n") : _T("\" },\n"));
+        }
+
+        text += _T("  ],\n  \"roles\": {\n");
+        text += _T("    \"local\": { \"thunder\": { \"block\": [ \"Tracing\" ] } },\n");
+        text += _T("    \"partner\": { \"thunder\": { \"allow\": [ \"DeviceInfo\", \"DisplayInfo\", \"WebKitBrowser\", \"Netflix\", \"Messenger\" ] } },\n");
+        text += _T("    \"default\": { \"thunder\": { \"allow\": [ \"DeviceInfo\" ] } }\n");
+        text += _T("  }\n}\n");
+
+        Core::File file(fileName, false);
+        bool result = (file.Create() == true);
+
+        if (result == true) {
+            result = (file.Write(reinterpret_cast<const uint8_t*>(text.c_str()), static_cast<uint32_t>(text.length())) == text.length());
+            file.Close();
+        }
+
+        return (result);
+    }
+
+    // Origins as tokens carry them: mostly partner pages, some local ones and some unknown.
+    std::vector<string> Origins(const uint32_t count, const uint32_t partners)
+    {
+        std::vector<string> result;
+
+        for (uint32_t index = 0; index < count; index++) {
+            const uint32_t kind = index % 10;
+
+            if (kind == 0) {
+                result.push_back(_T("http://localhost:") + Core::NumberType<uint32_t>(8000 + (index % 1000)).Text() + _T("/index.html"));
+            } else if (kind == 1) {
+                result.push_back(_T("https://www.unknown") + Core::NumberType<uint32_t>(index).Text() + _T(".org/app"));
+            } else {
+                result.push_back(_T("https://app") + Core::NumberType<uint32_t>(index).Text() + _T(".partner") + Core::NumberType<uint32_t>(index % partners).Text() + _T(".example.com/ui/main.html"));
+            }
+        }
+
+        return (result);
+    }
+
+    volatile uintptr_t sink;
+
+    template <typename ACTION>
+    double Measure(const uint32_t iterations, ACTION&& action)
+    {
+        const Clock::time_point start(Clock::now());
+
+        for (uint32_t index = 0; index < iterations; index++) {
+            action(index);
+        }
+
+        return (static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()) / iterations);
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    const uint32_t partners = (argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 100);
+    const uint32_t iterations = 100000;
+
+    if (partners == 0) {
+        fprintf(stderr, "Usage: %s [number of partner domains, default 100]\n", argv[0]);
+        return (1);
+    }
+
+    const std::vector<Group> groups(Groups(partners));
+    const std::vector<string> origins(Origins(1000, partners));
+    const string fileName(Core::Directory::Normalize(P_tmpdir) + _T("acl.") + Core::NumberType<uint32_t>(::getpid()).Text() + _T(".json"));
+
+    Plugin::AccessControlList acl;
+    bool loaded = false;
+
+    if (Write(fileName, groups) == true) {
+        Core::File file(fileName, true);
+
+        if (file.Open(true) == true) {
+            loaded = (acl.Load(file) == Core::ERROR_NONE);
+        }
+    }
+
+    ::unlink(fileName.c_str());
+
+    if (loaded == false) {
+        fprintf(stderr, "Could not load the ACL\n");
+    } else {
+        std::vector<Core::ProxyType<Core::JSONRPC::Message>> messages;
+
+        for (const TCHAR* callsign : Callsigns) {
+            Core::ProxyType<Core::JSONRPC::Message> message(Core::ProxyType<Core::JSONRPC::Message>::Create());
+            message->Designator = string(callsign) + _T(".1.status");
+            messages.push_back(message);
+        }
+
+        printf("ACL of %d expressions, %d distinct origins\n", static_cast<uint32_t>(groups.size()), static_cast<uint32_t>(origins.size()));
+        printf("   operation                                        ns/call\n");
+
+        // The origins outnumber the entries of the cache of resolved URLs, so every lookup misses it.
+        const double compiled = Measure(iterations, [&](const uint32_t index) {
+            sink = reinterpret_cast<uintptr_t>(acl.FilterMapFromURL(origins[index % origins.size()]));
+        });
+        printf("   resolve, compiled at load                 %13.1f\n", compiled);
+
+        const double cached = Measure(iterations, [&](const uint32_t) {
+            sink = reinterpret_cast<uintptr_t>(acl.FilterMapFromURL(origins[0]));
+        });
+        printf("   resolve, cached                           %13.1f\n", cached);
+
+        // Compiling is slow, fewer rounds do.
+        const double reference = Measure(iterations / 100, [&](const uint32_t index) {
+            const string& URL(origins[index % origins.size()]);
+            std::vector<Group>::const_iterator group(groups.begin());
+
+            while ((group != groups.end()) && (std::regex_search(URL, std::regex(group->URL)) == false)) {
+                group++;
+            }
+
+            sink = static_cast<uintptr_t>(group - groups.begin());
+        });
+        printf("   resolve, compiled on every lookup         %13.1f\n", reference);
+
+        std::vector<PluginHost::ISecurity*> contexts;
+
+        for (const string& origin : origins) {
+            const string payload(_T("{\"url\":\"") + origin + _T("\"}"));
+
+            contexts.push_back(Core::Service<Plugin::SecurityContext>::Create<PluginHost::ISecurity>(&acl, static_cast<uint16_t>(payload.length()), reinterpret_cast<const uint8_t*>(payload.c_str())));
+        }
+
+        const double allowed = Measure(iterations, [&](const uint32_t index) {
+            sink = contexts[index % contexts.size()]->Allowed(*(messages[index % messages.size()]));
+        });
+        printf("   SecurityContext::Allowed(JSON-RPC)        %13.1f\n", allowed);
+
+        for (PluginHost::ISecurity* context : contexts) {
+            context->Release();
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (loaded == true ? 0 : 1);
+}
@@ -1,4 +1,5 @@
 #include "NTPClient.h"
+#include <limits>
 #include <stdio.h>
 
 namespace WPEFramework {
@@ -6,6 +7,19 @@ namespace Plugin {
 
     constexpr uint32_t WaitForResponse = 2000;
 
+    // All servers are asked at once, and again every BurstInterval until they gave Burst samples, but no server
+    // is asked more than twice that often.
+    constexpr uint8_t Burst = 4;
+    constexpr uint32_t BurstInterval = 500;
+
+    // Servers with a root distance beyond MaxDistance are no candidates (RFC 5905 MAXDIST). Outliers are removed
+    // from the survivors, but never below MinSurvivors of them (NMIN).
+    constexpr double MaxDistance = 1.5;
+    constexpr uint8_t MinSurvivors = 3;
+
+    // Our own clock counts in microseconds.
+    constexpr double Precision = 1.0 / NTPClient::MicroSeconds;
+
 #ifdef __WINDOWS__
 #pragma warning(disable : 4355)
 #endif
@@ -15,9 +29,11 @@ namespace Plugin {
         , _packet()
         , _syncedTimestamp()
         , _state(INITIAL)
-        , _fired(true)
         , _WaitForNetwork(5000) // Wait for 5 Seconds for a new attempt
         , _retryAttempts(5)
+        , _servers()
+        , _peers()
+        , _source()
         , _activity(Core::ProxyType<Activity>::Create(this))
         , _clients()
     {
@@ -63,8 +79,6 @@ namespace Plugin {
                 _servers.push_back(hostname);
             }
         }
-
-        _serverIndex = ServerIterator(_servers);
     }
 
     /* virtual */ uint32_t NTPClient::Synchronize()
@@ -75,7 +89,7 @@ namespace Plugin {
 
         _adminLock.Lock();
 
-        if ((_state == INITIAL) || (_state == SUCCESS) || ((_state == FAILED) && (_serverIndex.IsValid() == false))) {
+        if ((_state == INITIAL) || (_state == SUCCESS) || (_state == FAILED)) {
             result = Core::ERROR_NONE;
             _state = SENDREQUEST;
             PluginHost::WorkerPool::Instance().Submit(_activity);
@@ -114,7 +128,7 @@ namespace Plugin {
 
     /* virtual */ string NTPClient::Source() const
     {
-        return (_serverIndex.IsValid() == true ? string(_T("NTP://")) + (*_serverIndex) + '/' : _T("NTP:///"));
+        return (_source.empty() == false ? string(_T("NTP://")) + _source + '/' : _T("NTP:///"));
     }
 
     /* virtual */ void NTPClient::Register(Exchange::ITimeSync::INotification* notification)
@@ -152,17 +166,30 @@ namespace Plugin {
 
         _adminLock.Lock();
 
-        if (_fired == false) {
+        std::vector<Peer>::iterator index(_peers.begin());
+
+        while ((index != _peers.end()) && (index->Queued == false)) {
+            index++;
+        }
+
+        if (index != _peers.end()) {
 
-            _fired = true;
+            const Core::Time now(Core::Time::Now());
+
+            index->Queued = false;
+            index->Sent++;
+            index->Origin = now.Ticks();
+
+            // The socket is not tied to a server, address this request to the one it is for.
+            RemoteNode(index->Node);
 
             DataFrame newFrame(dataFrame, maxSendSize);
             DataFrame::Writer writer(newFrame, 0);
-            _packet.TransmitTimestamp(NTPPacket::Timestamp(Core::Time::Now()));
+            _packet.TransmitTimestamp(NTPPacket::Timestamp(now));
             _packet.Serialize(writer);
 
             result = newFrame.Size();
-            TRACE_L1("Timesync: Send data: %d bytes", result);
+            TRACE_L1("Timesync: Send data: %d bytes to %s", result, index->Name.c_str());
         }
 
         _adminLock.Unlock();
@@ -170,14 +197,9 @@ namespace Plugin {
         return result;
     }
 
-    inline static uint64_t SecondsToTicks(double seconds)
-    {
-        return static_cast<uint64_t>(seconds * NTPClient::MicroSeconds);
-    }
-
     /* virtual */ uint16_t NTPClient::ReceiveData(uint8_t* dataFrame, const uint16_t receivedSize)
     {
-        double received = static_cast<double>(Core::Time::Now().Ticks() / MicroSeconds);
+        const uint64_t arrival = Core::Time::Now().Ticks();
 
         TRACE_L1("Timesync: Received data: %d bytes", receivedSize);
 
@@ -193,49 +215,48 @@ namespace Plugin {
 // packet.DisplayPacket();
 #endif
 
-            double receivedServerTS = packet.ReceiveTimestamp().TimeSeconds();
-            double sentServerTS = packet.TransmitTimestamp().TimeSeconds();
-            double sentTS = packet.OriginalTimestamp().TimeSeconds();
-
-            double diffRequest = receivedServerTS - sentTS;
-            double diffResponse = sentServerTS - received;
-            double offset = (diffRequest + diffResponse) / 2;
+            const Core::NodeId& source(ReceivedNode());
+            std::vector<Peer>::iterator index(_peers.begin());
 
-#ifdef __DEBUG__
-            double elapsedServer = sentServerTS - receivedServerTS;
-            double elapsedTotal = received - sentTS;
-            double roundTrip = elapsedTotal - elapsedServer;
-#endif
-
-            TRACE_L1("Request time diff  = %lf", diffRequest);
-            TRACE_L1("Response time diff = %lf", diffResponse);
-            TRACE_L1("Offset time        = %lf", offset);
-
-#ifdef __DEBUG__
-            TRACE_L1("Server elapsed time = %lf", elapsedServer);
-            TRACE_L1("Total elapsed time  = %lf", elapsedTotal);
-            TRACE_L1("Round trip time     = %lf", roundTrip);
-#endif
-            TRACE(Trace::Information, (_T("TimeSync: Request time diff   = %lf s"), diffRequest));
-            TRACE(Trace::Information, (_T("TimeSync: Response time diff  = %lf s"), diffResponse));
-            TRACE(Trace::Information, (_T("TimeSync: Offset time         = %lf s"), offset));
-
-            uint64_t receivedTicks = SecondsToTicks(received);
-            TRACE(Trace::Information, (_T("TimeSync: Current time: %s"), Core::Time(receivedTicks).ToRFC1123(false).c_str()));
-            _syncedTimestamp = Core::Time(receivedTicks + SecondsToTicks(offset));
-            TRACE(Trace::Information, (_T("TimeSync: New time:     %s"), _syncedTimestamp.ToRFC1123(false).c_str()));
-
-            _state = SUCCESS;
-
-            // We don't need the socket anymore, so close it
-            TRACE_L1("TimeSync: %s", "Closing socket, no longer needed");
-            Close(0);
+            while ((index != _peers.end()) && (!(index->Node == source))) {
+                index++;
+            }
 
-            // Lets remove the watchdog subject, we do not want to wait anymore, we got an answer.
-            PluginHost::WorkerPool::Instance().Revoke(_activity);
+            if (index == _peers.end()) {
+                TRACE_L1("Timesync: Dropped an answer from %s, not a server we asked", source.HostAddress().c_str());
+            } else if ((index->Origin == 0) || (Core::Time(packet.OriginalTimestamp()).Ticks() != index->Origin)) {
+                TRACE_L1("Timesync: Dropped an answer from %s, a duplicate or not to our last request", index->Name.c_str());
+            } else if ((packet.NTPMode() != 4) || (packet.Stratum() == 0) || (packet.Stratum() > 15) || (packet.LeapIndicator() == 0x03)) {
+                // Not synchronized itself, or a kiss-o'-death: leave this server alone for now.
+                TRACE(Trace::Warning, (_T("TimeSync: NTP Server [%s] refused or is not synchronized, stratum %d"), index->Name.c_str(), packet.Stratum()));
 
-            // Schedule it again to broadcast the successfull update of the time.
-            PluginHost::WorkerPool::Instance().Submit(_activity);
+                index->Origin = 0;
+                index->Sent = 2 * Burst;
+            } else {
+                // T1 and T4 are ours, T2 and T3 are the server's, see RFC 5905 section 8.
+                const double T1 = static_cast<double>(index->Origin) / MicroSeconds;
+                const double T2 = packet.ReceiveTimestamp().TimeSeconds();
+                const double T3 = packet.TransmitTimestamp().TimeSeconds();
+                const double T4 = static_cast<double>(arrival) / MicroSeconds;
+
+                const double offset = ((T2 - T1) + (T3 - T4)) / 2;
+                const double delay = std::max((T4 - T1) - (T3 - T2), Precision);
+                const double dispersion = std::ldexp(1.0, static_cast<int8_t>(packet.Precision())) + Precision + (Peer::Tolerance * (T4 - T1));
+
+                index->Origin = 0;
+                index->Stratum = packet.Stratum();
+                index->RootDelay = packet.RootDelay() / 65536.0;
+                index->RootDispersion = packet.RootDispersion() / 65536.0;
+                index->Add(offset, delay, dispersion, T4);
+
+                TRACE(Trace::Information, (_T("TimeSync: NTP Server [%s] offset %lf s, delay %lf s"), index->Name.c_str(), offset, delay));
+
+                if (IsSettled() == true) {
+                    // No need to wait for the next round, there is enough to select the time from.
+                    PluginHost::WorkerPool::Instance().Revoke(_activity);
+                    PluginHost::WorkerPool::Instance().Submit(_activity);
+                }
+            }
         }
 
         _adminLock.Unlock();
@@ -264,52 +285,228 @@ namespace Plugin {
             Close(1000);
         }
 
-        if (true == IsClosed() && (_serverIndex.Count() > 0)) {
+        _peers.clear();
+
+        std::vector<string>::const_iterator index(_servers.begin());
+
+        while (index != _servers.end()) {
+
+            Core::NodeId remote(index->c_str(), Core::NodeId::TYPE_IPV4);
 
-            uint32_t lastonetried = _serverIndex.Index();
+            if (remote.IsValid() == true) {
+                _peers.emplace_back(*index, remote);
+            } else {
+                TRACE(Trace::Warning, (_T("Could not resolve NTP Server [%s]"), index->c_str()));
+            }
 
-            do {
+            index++;
+        }
 
-                // next server
-                if( _serverIndex.Index() >= _serverIndex.Count() ) {
-                    _serverIndex.Reset(0);
+        if ((true == IsClosed()) && (_peers.empty() == false)) {
+
+            // One socket for all servers, each request is addressed to its server when it is sent.
+            RemoteNode(_peers.front().Node);
+            LocalNode(_peers.front().Node.AnyInterface());
+
+            // UDP should open by definition directly...
+            uint32_t status = Open(100);
+
+            if ((status == Core::ERROR_NONE) || (status == Core::ERROR_INPROGRESS)) {
+
+                std::vector<Peer>::iterator peer(_peers.begin());
+
+                while (peer != _peers.end()) {
+                    TRACE(Trace::Information, (_T("Trying NTP Server: [%s]"), peer->Name.c_str()));
+                    peer->Queued = true;
+                    peer++;
                 }
-                _serverIndex.Next();
-                ASSERT(_serverIndex.IsValid());
 
-                TRACE(Trace::Information, (_T("Trying NTP Server: [%s]"), (*_serverIndex).c_str()));
+                activated = true;
+                Trigger();
+            } else {
+                TRACE(Trace::Warning, (_T("Could not open a socket for the NTP Servers")));
+            }
+        }
 
-                // Set the socket to send to the remote
-                Core::NodeId remote((*_serverIndex).c_str(), Core::NodeId::TYPE_IPV4);
+        return (activated);
+    }
 
-                if (remote.IsValid() == true) {
-                    // Set the remote endpoint for the socket to the selected NTP server
-                    RemoteNode(remote);
-                    LocalNode(remote.AnyInterface());
+    bool NTPClient::IsSettled()
+    {
+        // Most servers filled their burst, or there is no server left to wait for. Or sooner, if all servers
+        // answered and all agree: there is nothing to filter out then.
+        const double now = static_cast<double>(Core::Time::Now().Ticks()) / MicroSeconds;
+        double low = std::numeric_limits<double>::lowest();
+        double high = std::numeric_limits<double>::max();
+        uint32_t complete = 0;
+        bool waiting = false;
+        bool answered = true;
+
+        std::vector<Peer>::iterator index(_peers.begin());
+
+        while (index != _peers.end()) {
+            if (index->Samples() >= Burst) {
+                complete++;
+            } else if (index->Sent < (2 * Burst)) {
+                waiting = true;
+            }
 
-                    // UDP should open by definition directly...
-                    uint32_t status = Open(100);
+            if (index->Samples() == 0) {
+                answered = false;
+            } else {
+                index->Evaluate(now);
+                low = std::max(low, index->Offset() - index->Distance());
+                high = std::min(high, index->Offset() + index->Distance());
+            }
+            index++;
+        }
 
-                    if ((status == Core::ERROR_NONE) || (status == Core::ERROR_INPROGRESS)) {
+        return (((2 * complete) > _peers.size()) || (waiting == false) || ((answered == true) && (low <= high)));
+    }
 
-                        activated = true;
-                        _fired = false;
-                        Trigger();
+    // Selects the offset to apply from what the servers told, as in RFC 5905 section 11.2: the intersection
+    // (Marzullo) algorithm to reject the falsetickers, the cluster algorithm to drop outliers from the
+    // truechimers and a combination of the offsets of the survivors, weighted by their root distance.
+    bool NTPClient::Select(double& offset)
+    {
+        struct Endpoint {
+            double Value;
+            int8_t Type;
+        };
+
+        const double now = static_cast<double>(Core::Time::Now().Ticks()) / MicroSeconds;
+
+        std::vector<Peer*> candidates;
+        std::vector<Endpoint> endpoints;
+        std::vector<Peer>::iterator index(_peers.begin());
+
+        while (index != _peers.end()) {
+            if (index->Samples() > 0) {
+                index->Evaluate(now);
+
+                if (index->Distance() < MaxDistance) {
+                    candidates.push_back(&(*index));
+                    endpoints.push_back({ index->Offset() - index->Distance(), -1 });
+                    endpoints.push_back({ index->Offset(), 0 });
+                    endpoints.push_back({ index->Offset() + index->Distance(), +1 });
+                } else {
+                    TRACE(Trace::Warning, (_T("TimeSync: NTP Server [%s] is too far off, distance %lf s"), index->Name.c_str(), index->Distance()));
+                }
+            }
+            index++;
+        }
+
+        std::sort(endpoints.begin(), endpoints.end(), [](const Endpoint& lhs, const Endpoint& rhs) {
+            return ((lhs.Value < rhs.Value) || ((lhs.Value == rhs.Value) && (lhs.Type < rhs.Type)));
+        });
+
+        // Find the interval that all but allow of the candidates agree on, allowing one more falseticker each
+        // time, but less than half of them.
+        const uint32_t count = static_cast<uint32_t>(candidates.size());
+        double low = std::numeric_limits<double>::max();
+        double high = std::numeric_limits<double>::lowest();
+        bool found = false;
+
+        for (uint32_t allow = 0; (found == false) && ((2 * allow) < count); allow++) {
+            uint32_t midpoints = 0;
+            int32_t chime = 0;
+
+            low = std::numeric_limits<double>::max();
+            high = std::numeric_limits<double>::lowest();
+
+            for (uint32_t loop = 0; loop < endpoints.size(); loop++) {
+                chime -= endpoints[loop].Type;
+                if (chime >= static_cast<int32_t>(count - allow)) {
+                    low = endpoints[loop].Value;
+                    break;
+                }
+                if (endpoints[loop].Type == 0) {
+                    midpoints++;
+                }
+            }
+
+            chime = 0;
+
+            for (uint32_t loop = static_cast<uint32_t>(endpoints.size()); loop > 0; loop--) {
+                chime += endpoints[loop - 1].Type;
+                if (chime >= static_cast<int32_t>(count - allow)) {
+                    high = endpoints[loop - 1].Value;
+                    break;
+                }
+                if (endpoints[loop - 1].Type == 0) {
+                    midpoints++;
+                }
+            }
+
+            found = ((midpoints <= allow) && (low < high));
+        }
+
+        if (found == false) {
+            TRACE(Trace::Error, (_T("TimeSync: No majority of the %d NTP Servers agrees on the time"), count));
+        } else {
+            std::vector<Peer*> survivors;
+            std::vector<Peer*>::iterator candidate(candidates.begin());
+
+            while (candidate != candidates.end()) {
+                if (((*candidate)->Offset() >= low) && ((*candidate)->Offset() <= high)) {
+                    survivors.push_back(*candidate);
+                } else {
+                    TRACE(Trace::Warning, (_T("TimeSync: NTP Server [%s] is a falseticker, offset %lf s"), (*candidate)->Name.c_str(), (*candidate)->Offset()));
+                }
+                candidate++;
+            }
+
+            std::sort(survivors.begin(), survivors.end(), [](const Peer* lhs, const Peer* rhs) {
+                return (((lhs->Stratum * MaxDistance) + lhs->Distance()) < ((rhs->Stratum * MaxDistance) + rhs->Distance()));
+            });
+
+            // Drop the survivor that is furthest from the others, as long as that spread is larger than the
+            // jitter of the best of them.
+            while (survivors.size() > MinSurvivors) {
+                double worst = 0;
+                double best = std::numeric_limits<double>::max();
+                uint32_t outlier = 0;
+
+                for (uint32_t i = 0; i < survivors.size(); i++) {
+                    double spread = 0;
+
+                    for (uint32_t j = 0; j < survivors.size(); j++) {
+                        spread += (survivors[i]->Offset() - survivors[j]->Offset()) * (survivors[i]->Offset() - survivors[j]->Offset());
                     }
-                    else {
-                        TRACE(Trace::Warning, (_T("Could not open connection to NTP Server [%s]"), (*_serverIndex).c_str()));
+
+                    spread = std::sqrt(spread / (survivors.size() - 1));
+
+                    if (spread > worst) {
+                        worst = spread;
+                        outlier = i;
                     }
+
+                    best = std::min(best, survivors[i]->Jitter());
                 }
-                else {
-                    TRACE(Trace::Warning, (_T("Could not resolve NTP Server [%s]"), (*_serverIndex).c_str()));
+
+                if (worst <= best) {
+                    break;
                 }
+
+                TRACE_L1("Timesync: Dropped %s from the cluster, %lf s apart", survivors[outlier]->Name.c_str(), worst);
+                survivors.erase(survivors.begin() + outlier);
             }
-            while ((activated == false) && ( ((lastonetried != 0) && (lastonetried != _serverIndex.Index())) ||
-                                             ((lastonetried == 0) && (_serverIndex.Index() != _serverIndex.Count())) 
-                                           ) );
+
+            double weighted = 0;
+            double weights = 0;
+
+            for (uint32_t loop = 0; loop < survivors.size(); loop++) {
+                weighted += survivors[loop]->Offset() / survivors[loop]->Distance();
+                weights += 1.0 / survivors[loop]->Distance();
+            }
+
+            offset = weighted / weights;
+            _source = survivors.front()->Name;
+
+            TRACE(Trace::Information, (_T("TimeSync: %d of %d NTP Servers agree, offset %lf s, best is [%s]"), static_cast<uint32_t>(survivors.size()), count, offset, _source.c_str()));
         }
 
-        return (activated);
+        return (found);
     }
 
     void NTPClient::Update()
@@ -338,30 +535,76 @@ namespace Plugin {
 
         switch (_state) {
         case SENDREQUEST: {
-            // This case means that nothing has started yet, let reset the list of servers and start at the beginning...
-            _serverIndex.Reset(0);
+            // This case means that nothing has started yet, reset the attempts and ask all servers...
             _state = INPROGRESS;
             _currentAttempt = _retryAttempts;
         }
         case INPROGRESS: {
-            // If we end up here in this state, it means that the package was send but no response was received,
-            // or a response was received but is was not properly formatted...
-            // Lets move to the next server in the list, see if that one responds correctly, if we tried all servers let's
-            // start at the first one again, this time it might work
-            if (FireRequest() == true) {
-              result = WaitForResponse;
-            } else {
-                if (_currentAttempt-- != 0) {
+            if (IsClosed() == true) {
+                // Nothing in flight, open up and ask all servers.
+                if (FireRequest() == true) {
+                    result = BurstInterval;
+                } else if (_currentAttempt-- != 0) {
 
                     // Looks like there is no network connectivity, Just sleep and retry later
                     result = _WaitForNetwork;
                 } else {
 
-                    // Looks like there is no valid server anymore that we could use. There where servers
-                    // that did resolve correctly, so it is not a network connectivity problem.
+                    // Looks like there is no valid server anymore that we could use.
                     _state = FAILED;
 
                     // Report the failure. Always report back when we are finished.
+                    Update();
+                }
+            } else if (IsSettled() == false) {
+                // Ask those that answered for their next sample, and those that did not answer in time again.
+                const uint64_t now = Core::Time::Now().Ticks();
+                bool queued = false;
+
+                std::vector<Peer>::iterator index(_peers.begin());
+
+                while (index != _peers.end()) {
+                    if ((index->Origin != 0) && ((now - index->Origin) >= (static_cast<uint64_t>(WaitForResponse) * MilliSeconds))) {
+                        TRACE(Trace::Warning, (_T("No answer from NTP Server [%s]"), index->Name.c_str()));
+                        index->Origin = 0;
+                    }
+                    if ((index->Origin == 0) && (index->Samples() < Burst) && (index->Sent < (2 * Burst))) {
+                        index->Queued = true;
+                        queued = true;
+                    }
+                    index++;
+                }
+
+                if (queued == true) {
+                    Trigger();
+                }
+
+                result = BurstInterval;
+            } else {
+                double offset = 0;
+
+                // We don't need the socket anymore, so close it
+                TRACE_L1("TimeSync: %s", "Closing socket, no longer needed");
+                Close(0);
+
+                if (Select(offset) == true) {
+                    const uint64_t now = Core::Time::Now().Ticks();
+
+                    TRACE(Trace::Information, (_T("TimeSync: Current time: %s"), Core::Time(now).ToRFC1123(false).c_str()));
+                    _syncedTimestamp = Core::Time(static_cast<uint64_t>(static_cast<int64_t>(now) + static_cast<int64_t>(offset * MicroSeconds)));
+                    TRACE(Trace::Information, (_T("TimeSync: New time:     %s"), _syncedTimestamp.ToRFC1123(false).c_str()));
+
+                    _state = SUCCESS;
+
+                    // Broadcast the successfull update of the time.
+                    Update();
+                } else if (_currentAttempt-- != 0) {
+
+                    // No answers, or no answers to agree on. Retry later, the next round might be better.
+                    result = _WaitForNetwork;
+                } else {
+                    _state = FAILED;
+
                     Update();
                 }
             }
@@ -374,7 +617,7 @@ namespace Plugin {
         }
         default:
             // New state, probably needs some action???
-       ASSERT(false);
+            ASSERT(false);
         }
 
         _adminLock.Unlock();
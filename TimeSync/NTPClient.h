@@ -4,6 +4,8 @@
 #include "Module.h"
 #include <interfaces/ITimeSync.h>
 
+#include <cmath>
+
 namespace WPEFramework {
 namespace Plugin {
 
@@ -16,8 +18,6 @@ namespace Plugin {
         using SourceIterator = Core::JSON::ArrayType<Core::JSON::String>::Iterator;
 
     private:
-        using ServerList = std::vector<string>;
-        using ServerIterator = Core::IteratorType<const ServerList, const string&, ServerList::const_iterator>;
         using DataFrame = Core::FrameType<0>;
 
         // This enum tracks the state for actions begin performed. As the Worker() method is re-entered,
@@ -309,6 +309,132 @@ namespace Plugin {
                 // bit (NTP time)
         };
 
+        // A configured server, with the last samples it gave, run through the RFC 5905 clock filter: of the
+        // last Stages samples the one with the lowest round trip delay is the most likely to be accurate.
+        class Peer {
+        public:
+            static constexpr uint8_t Stages = 8;
+
+            // Frequency tolerance (PHI), in s/s, and the dispersion of an empty stage (MAXDISP), in s.
+            static constexpr double Tolerance = 15e-6;
+            static constexpr double MaxDispersion = 16.0;
+
+        private:
+            struct Sample {
+                double Offset;
+                double Delay;
+                double Dispersion;
+                double Time;
+            };
+
+        public:
+            Peer(const string& name, const Core::NodeId& node)
+                : Name(name)
+                , Node(node)
+                , Origin(0)
+                , Queued(false)
+                , Sent(0)
+                , Stratum(0)
+                , RootDelay(0)
+                , RootDispersion(0)
+                , _samples()
+                , _next(0)
+                , _count(0)
+                , _offset(0)
+                , _delay(0)
+                , _dispersion(MaxDispersion)
+                , _jitter(0)
+            {
+            }
+            ~Peer()
+            {
+            }
+
+        public:
+            inline uint8_t Samples() const
+            {
+                return (_count);
+            }
+            inline double Offset() const
+            {
+                return (_offset);
+            }
+            inline double Jitter() const
+            {
+                return (_jitter);
+            }
+            // The root distance (lambda): the maximum error of the offset of this peer, up to the reference clock.
+            inline double Distance() const
+            {
+                return (std::max(0.005 /* MINDISP */, RootDelay + _delay) / 2 + RootDispersion + _dispersion + _jitter);
+            }
+
+            void Add(const double offset, const double delay, const double dispersion, const double time)
+            {
+                _samples[_next].Offset = offset;
+                _samples[_next].Delay = delay;
+                _samples[_next].Dispersion = dispersion;
+                _samples[_next].Time = time;
+
+                _next = (_next + 1) % Stages;
+
+                if (_count < Stages) {
+                    _count++;
+                }
+            }
+
+            // Take the sample with the lowest delay, weigh the dispersion of the samples, the least delayed first,
+            // and take the spread of the offsets around the chosen one as the jitter. Unlike RFC 5905, stages not
+            // filled yet do not count as MaxDispersion: a synchronization only fills a few of them.
+            void Evaluate(const double now)
+            {
+                uint8_t order[Stages];
+
+                for (uint8_t index = 0; index < _count; index++) {
+                    order[index] = index;
+                }
+                std::sort(&order[0], &order[_count], [this](const uint8_t lhs, const uint8_t rhs) { return (_samples[lhs].Delay < _samples[rhs].Delay); });
+
+                _offset = _samples[order[0]].Offset;
+                _delay = _samples[order[0]].Delay;
+                _dispersion = 0;
+                _jitter = 0;
+
+                for (uint8_t index = 0; index < _count; index++) {
+                    const Sample& sample(_samples[order[index]]);
+                    double dispersion = sample.Dispersion + (Tolerance * (now - sample.Time));
+
+                    if (dispersion > MaxDispersion) {
+                        dispersion = MaxDispersion;
+                    }
+
+                    _dispersion += dispersion / (2 << index);
+                    _jitter += (sample.Offset - _offset) * (sample.Offset - _offset);
+                }
+
+                _jitter = (_count > 1 ? std::sqrt(_jitter / (_count - 1)) : 0);
+            }
+
+        public:
+            string Name;
+            Core::NodeId Node;
+            uint64_t Origin; // Our transmit time of the request in flight, in ticks, 0 if none.
+            bool Queued;
+            uint8_t Sent;
+            uint8_t Stratum;
+            double RootDelay;
+            double RootDispersion;
+
+        private:
+            Sample _samples[Stages];
+            uint8_t _next;
+            uint8_t _count;
+            double _offset;
+            double _delay;
+            double _dispersion;
+            double _jitter;
+        };
+
         class Activity : public Core::IDispatchType<void> {
         private:
             Activity() = delete;
@@ -375,18 +501,20 @@ namespace Plugin {
         void Update();
         void Dispatch();
         bool FireRequest();
+        bool Select(double& offset);
+        bool IsSettled();
 
     private:
         Core::CriticalSection _adminLock;
         NTPPacket _packet;
         Core::Time _syncedTimestamp;
         state _state;
-        bool _fired;
         uint32_t _WaitForNetwork;
         uint32_t _retryAttempts;
         uint32_t _currentAttempt;
-        ServerList _servers;
-        ServerIterator _serverIndex;
+        std::vector<string> _servers;
+        std::vector<Peer> _peers;
+        string _source;
         Core::ProxyType<Core::IDispatchType<void>> _activity;
         std::list<Exchange::ITimeSync::INotification*> _clients;
     };
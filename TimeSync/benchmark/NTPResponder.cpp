@@ -0,0 +1,81 @@
+// Runs stand-in NTP servers on the loopback interface until interrupted, for a TimeSync under test configured with
+// sources like ntp://127.0.0.1:12301. Every server is given as port[:min-max[:offset[:dead]]], with the one way
+// delay range and the error of its clock in milliseconds, e.g. 12301:5-20 12302:5-20:3000 12303:5-20:0:dead
+
+#include "Responder.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+    volatile std::sig_atomic_t interrupted = 0;
+
+    void Interrupt(int)
+    {
+        interrupted = 1;
+    }
+
+    bool Parse(const char text[], TimeSyncBenchmark::Responder::Behaviour& behaviour)
+    {
+        unsigned int port = 0;
+        unsigned int minimum = 0;
+        unsigned int maximum = 0;
+        int offset = 0;
+        char state[8] = {};
+
+        const int fields = ::sscanf(text, "%u:%u-%u:%d:%7s", &port, &minimum, &maximum, &offset, state);
+
+        behaviour.Port = static_cast<uint16_t>(port);
+        behaviour.MinDelay = (fields >= 3 ? minimum : 0);
+        behaviour.MaxDelay = (fields >= 3 ? maximum : 0);
+        behaviour.Offset = (fields >= 4 ? offset : 0);
+        behaviour.Dead = ((fields == 5) && (::strcmp(state, "dead") == 0));
+
+        return ((fields >= 1) && (fields != 2) && (port != 0) && (port <= 0xFFFF) && (minimum <= maximum) && ((fields < 5) || (behaviour.Dead == true)));
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    std::vector<std::unique_ptr<TimeSyncBenchmark::Responder>> servers;
+    bool valid = (argc > 1);
+
+    for (int index = 1; (index < argc) && (valid == true); index++) {
+        TimeSyncBenchmark::Responder::Behaviour behaviour;
+
+        if (Parse(argv[index], behaviour) == false) {
+            fprintf(stderr, "Invalid server: %s\n", argv[index]);
+            valid = false;
+        } else {
+            servers.emplace_back(new TimeSyncBenchmark::Responder(behaviour));
+
+            if (servers.back()->Start() == false) {
+                fprintf(stderr, "Could not bind 127.0.0.1:%d\n", behaviour.Port);
+                valid = false;
+            } else {
+                printf("ntp://127.0.0.1:%d  delay %d-%d ms, offset %d ms%s\n", behaviour.Port, behaviour.MinDelay, behaviour.MaxDelay, behaviour.Offset, (behaviour.Dead == true ? ", dead" : ""));
+            }
+        }
+    }
+
+    if (valid == false) {
+        fprintf(stderr, "Usage: %s port[:min-max[:offset[:dead]]] ...\n", argv[0]);
+    } else {
+        std::signal(SIGINT, Interrupt);
+        std::signal(SIGTERM, Interrupt);
+
+        while (interrupted == 0) {
+            ::pause();
+        }
+
+        for (const std::unique_ptr<TimeSyncBenchmark::Responder>& server : servers) {
+            printf("127.0.0.1:%d answered %d requests\n", server->Port(), server->Answered());
+        }
+    }
+
+    return (valid == true ? 0 : 1);
+}
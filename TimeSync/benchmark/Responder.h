@@ -0,0 +1,175 @@
+#pragma once
+
+// A stand-in NTP server on the loopback interface, that answers like a real one would, but with the delay and the
+// clock error asked for. Only uses the sockets and threads of the system, so it can also run on its own (see
+// NTPResponder.cpp) to give a device under test servers to synchronize with.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace TimeSyncBenchmark {
+
+    class Responder {
+    private:
+        Responder() = delete;
+        Responder(const Responder&) = delete;
+        Responder& operator=(const Responder&) = delete;
+
+        static constexpr uint16_t PacketSize = 48;
+
+        // Seconds from the NTP epoch (1900) to the UNIX epoch (1970).
+        static constexpr uint64_t NTPToUNIXSeconds = 2208988800ULL;
+
+    public:
+        class Behaviour {
+        public:
+            uint16_t Port;
+            uint32_t MinDelay; // ms, one way
+            uint32_t MaxDelay; // ms, one way
+            int32_t Offset; // ms the clock of this server is off
+            bool Dead; // Never answers
+        };
+
+    public:
+        Responder(const Behaviour& behaviour)
+            : _behaviour(behaviour)
+            , _socket(-1)
+            , _running(false)
+            , _answered(0)
+            , _thread()
+        {
+        }
+        ~Responder()
+        {
+            Stop();
+        }
+
+    public:
+        inline uint16_t Port() const
+        {
+            return (_behaviour.Port);
+        }
+        inline uint32_t Answered() const
+        {
+            return (_answered.load());
+        }
+        bool Start()
+        {
+            struct sockaddr_in address;
+
+            ::memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_port = htons(_behaviour.Port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            _socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+            bool result = ((_socket != -1) && (::bind(_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0));
+
+            if (result == true) {
+                _running = true;
+                _thread = std::thread([this]() { Serve(); });
+            } else if (_socket != -1) {
+                ::close(_socket);
+                _socket = -1;
+            }
+
+            return (result);
+        }
+        void Stop()
+        {
+            if (_running.exchange(false) == true) {
+                _thread.join();
+            }
+            if (_socket != -1) {
+                ::close(_socket);
+                _socket = -1;
+            }
+        }
+
+    private:
+        // The clock of this server, NTP format: seconds since 1900 and fraction of a second in 32 bits each.
+        void Now(uint8_t timestamp[]) const
+        {
+            struct timeval now;
+            ::gettimeofday(&now, nullptr);
+
+            const int64_t microseconds = (static_cast<int64_t>(now.tv_sec) * 1000000) + now.tv_usec + (static_cast<int64_t>(_behaviour.Offset) * 1000);
+            const uint32_t seconds = static_cast<uint32_t>((microseconds / 1000000) + NTPToUNIXSeconds);
+            const uint32_t fraction = static_cast<uint32_t>(((microseconds % 1000000) << 32) / 1000000);
+
+            Put(&(timestamp[0]), seconds);
+            Put(&(timestamp[4]), fraction);
+        }
+        static void Put(uint8_t buffer[], const uint32_t value)
+        {
+            buffer[0] = static_cast<uint8_t>(value >> 24);
+            buffer[1] = static_cast<uint8_t>(value >> 16);
+            buffer[2] = static_cast<uint8_t>(value >> 8);
+            buffer[3] = static_cast<uint8_t>(value);
+        }
+        void Serve()
+        {
+            std::mt19937 generator(_behaviour.Port);
+            std::uniform_int_distribution<uint32_t> delay(_behaviour.MinDelay, _behaviour.MaxDelay);
+
+            while (_running == true) {
+                struct pollfd slot = { _socket, POLLIN, 0 };
+
+                if (::poll(&slot, 1, 100) == 1) {
+                    uint8_t request[PacketSize];
+                    struct sockaddr_in client;
+                    socklen_t length = sizeof(client);
+
+                    const ssize_t size = ::recvfrom(_socket, request, sizeof(request), 0, reinterpret_cast<struct sockaddr*>(&client), &length);
+
+                    // Only client requests (mode 3) of the proper size.
+                    if ((_behaviour.Dead == false) && (size == PacketSize) && ((request[0] & 0x07) == 3)) {
+                        uint8_t reply[PacketSize];
+
+                        // On its way to the server..
+                        std::this_thread::sleep_for(std::chrono::milliseconds(delay(generator)));
+
+                        ::memset(reply, 0, sizeof(reply));
+                        reply[0] = (0 << 6) | (4 << 3) | 4; // No leap second warning, version 4, server
+                        reply[1] = 2; // Stratum, synchronized to a primary server
+                        reply[2] = request[2]; // Poll
+                        reply[3] = static_cast<uint8_t>(-20); // Precision, about a microsecond
+                        Put(&(reply[4]), 0x00000042); // Root delay, about 1 ms
+                        Put(&(reply[8]), 0x00000042); // Root dispersion, about 1 ms
+                        Put(&(reply[12]), INADDR_LOOPBACK); // Reference
+                        Now(&(reply[32])); // Receive
+                        ::memcpy(&(reply[16]), &(reply[32]), 8); // Reference time
+                        ::memcpy(&(reply[24]), &(request[40]), 8); // Origin, the transmit time of the client
+                        Now(&(reply[40])); // Transmit
+
+                        // ..and back.
+                        std::this_thread::sleep_for(std::chrono::milliseconds(delay(generator)));
+
+                        if (::sendto(_socket, reply, sizeof(reply), 0, reinterpret_cast<struct sockaddr*>(&client), length) == PacketSize) {
+                            _answered++;
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+        const Behaviour _behaviour;
+        int _socket;
+        std::atomic<bool> _running;
+        std::atomic<uint32_t> _answered;
+        std::thread _thread;
+    };
+}
@@ -0,0 +1,220 @@
+// Measures how fast and how accurate the NTPClient of TimeSync synchronizes, against stand-in NTP servers on the
+// loopback interface (see Responder.h). The servers that are not told otherwise run on the clock of this host, so
+// the offset the client should find is 0: the time it reports, minus the time of this host at that moment, is its
+// error. Every case runs a fresh client a few times and reports the median time from Synchronize() to the
+// Completed() notification, and the median error. A case with a majority of wrong servers should not sync at all.
+// The client does not set the clock of the host, TimeSync does that, so this can run on any machine.
+
+#include "../Module.h"
+#include "../NTPClient.h"
+#include "Responder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace WPEFramework;
+
+namespace {
+
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr uint16_t BasePort = 12301;
+    static constexpr uint8_t Runs = 5;
+
+    // The worker pool the plugin host provides, the client does all of its work on it.
+    class WorkerPool : public PluginHost::WorkerPool {
+    private:
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+    public:
+        WorkerPool()
+            : PluginHost::WorkerPool(2, 0, 16)
+        {
+            Run();
+        }
+        ~WorkerPool()
+        {
+            Stop();
+        }
+    };
+
+    class Notification : public Exchange::ITimeSync::INotification {
+    private:
+        Notification(const Notification&) = delete;
+        Notification& operator=(const Notification&) = delete;
+
+    public:
+        Notification()
+            : _completed(false, true)
+            , _moment(0)
+        {
+        }
+        ~Notification()
+        {
+        }
+
+    public:
+        virtual void Completed() override
+        {
+            _moment = Core::Time::Now().Ticks();
+            _completed.SetEvent();
+        }
+        // The time of this host when the client reported, 0 if it did not within the time given.
+        uint64_t Wait(const uint32_t milliseconds)
+        {
+            return (_completed.Lock(milliseconds) == Core::ERROR_NONE ? _moment : 0);
+        }
+
+        BEGIN_INTERFACE_MAP(Notification)
+        INTERFACE_ENTRY(Exchange::ITimeSync::INotification)
+        END_INTERFACE_MAP
+
+    private:
+        Core::Event _completed;
+        uint64_t _moment;
+    };
+
+    class Case {
+    public:
+        const char* Name;
+        std::vector<TimeSyncBenchmark::Responder::Behaviour> Servers;
+    };
+
+    std::vector<Case> Cases()
+    {
+        // Four servers, 5-20 ms one way, unless the case says otherwise.
+        std::vector<Case> result;
+        const TimeSyncBenchmark::Responder::Behaviour good[] = {
+            { BasePort + 0, 5, 20, 0, false }, { BasePort + 1, 5, 20, 0, false }, { BasePort + 2, 5, 20, 0, false }, { BasePort + 3, 5, 20, 0, false }
+        };
+
+        result.push_back({ "all good", std::vector<TimeSyncBenchmark::Responder::Behaviour>(std::begin(good), std::end(good)) });
+
+        result.push_back(result.front());
+        result.back().Name = "first server dead";
+        result.back().Servers[0].Dead = true;
+
+        result.push_back(result.front());
+        result.back().Name = "first server 3 s off";
+        result.back().Servers[0].Offset = 3000;
+
+        result.push_back(result.front());
+        result.back().Name = "first server 400 ms one way";
+        result.back().Servers[0].MinDelay = 400;
+        result.back().Servers[0].MaxDelay = 400;
+
+        result.push_back(result.front());
+        result.back().Name = "two of four 2.8 s off";
+        result.back().Servers[0].Offset = 2800;
+        result.back().Servers[1].Offset = 2800;
+
+        return (result);
+    }
+
+    // Synchronizes a fresh client once. Returns false if the client did not report back at all, sets error to a
+    // negative value if it reported that it could not determine the time.
+    bool Synchronize(const Case& test, double& duration, double& error)
+    {
+        Core::JSON::ArrayType<Core::JSON::String> sources;
+
+        for (const TimeSyncBenchmark::Responder::Behaviour& server : test.Servers) {
+            sources.Add() = _T("ntp://127.0.0.1:") + Core::NumberType<uint16_t>(server.Port).Text();
+        }
+
+        Core::Sink<Notification> sink;
+        Plugin::NTPClient* client = Core::Service<Plugin::NTPClient>::Create<Plugin::NTPClient>();
+        Plugin::NTPClient::SourceIterator index(sources.Elements());
+
+        // Retry once, a second later, as the plugin would.
+        client->Initialize(index, 1, 1);
+        client->Register(&sink);
+
+        const Clock::time_point start(Clock::now());
+
+        client->Synchronize();
+
+        const uint64_t moment = sink.Wait(30000);
+
+        duration = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()) / 1000.0;
+
+        if (moment != 0) {
+            const uint64_t synced = client->SyncTime();
+
+            error = (synced == 0 ? -1.0 : std::abs(static_cast<double>(static_cast<int64_t>(synced - moment))) / 1000.0);
+        }
+
+        client->Unregister(&sink);
+        client->Release();
+
+        return (moment != 0);
+    }
+
+    double Median(std::vector<double>& values)
+    {
+        std::sort(values.begin(), values.end());
+        return (values.empty() == false ? values[values.size() / 2] : 0.0);
+    }
+}
+
+int main(int /* argc */, const char* /* argv */[])
+{
+    bool completed = true;
+
+    {
+        WorkerPool workerPool;
+
+        printf("   case                            synced   first sync ms   error ms\n");
+
+        for (const Case& test : Cases()) {
+            std::vector<std::unique_ptr<TimeSyncBenchmark::Responder>> servers;
+            std::vector<double> durations;
+            std::vector<double> errors;
+            bool started = true;
+
+            for (const TimeSyncBenchmark::Responder::Behaviour& behaviour : test.Servers) {
+                servers.emplace_back(new TimeSyncBenchmark::Responder(behaviour));
+                started = started && servers.back()->Start();
+            }
+
+            for (uint8_t run = 0; (run < Runs) && (started == true) && (completed == true); run++) {
+                double duration = 0;
+                double error = 0;
+
+                completed = Synchronize(test, duration, error);
+
+                if ((completed == true) && (error >= 0.0)) {
+                    durations.push_back(duration);
+                    errors.push_back(error);
+                }
+            }
+
+            if (started == false) {
+                fprintf(stderr, "Could not start the servers on 127.0.0.1:%d and up\n", BasePort);
+                completed = false;
+            } else if (completed == false) {
+                fprintf(stderr, "%s: the client did not report back\n", test.Name);
+            } else {
+                const uint32_t synced = static_cast<uint32_t>(durations.size());
+
+                if (synced == 0) {
+                    printf("   %-30s %3d/%d %15s %10s\n", test.Name, synced, Runs, "-", "-");
+                } else {
+                    printf("   %-30s %3d/%d %15.1f %10.2f\n", test.Name, synced, Runs, Median(durations), Median(errors));
+                }
+            }
+
+            if (completed == false) {
+                break;
+            }
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (completed == true ? 0 : 1);
+}
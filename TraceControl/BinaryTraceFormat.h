@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace WPEFramework {
+
+namespace TraceFile {
+
+    // Layout of the binary trace files written by the BinaryTraceOutput and read by the TraceDecoder.
+    // All numbers are stored in the byte order of the device that produced the file.
+    //
+    // header  : magic (8 bytes) - version (2 bytes) - reserved (6 bytes)
+    // records : tag (1 byte) - tag specific data
+    //
+    // STRING  : id (2 bytes) - length (2 bytes) - characters (length bytes, not terminated)
+    // TRACE   : clock ticks (8 bytes) - line number (4 bytes) - file/module/category/className string ids (4 x 2 bytes)
+    //           - length (2 bytes) - information (length bytes, not terminated)
+    // END     : Remainder of the file is unused. Files are preallocated with zeros, so this tag is implicit.
+    //
+    // A string is always announced before the first trace that references it. Every file starts with an empty
+    // string table, so each file in a rotation set can be decoded on its own.
+
+    static constexpr char Magic[] = { 'W', 'P', 'E', 'T', 'R', 'A', 'C', 'E' };
+    static constexpr uint16_t Version = 1;
+    static constexpr uint32_t HeaderSize = sizeof(Magic) + 2 + 6;
+
+    enum tag : uint8_t {
+        END = 0,
+        STRING = 1,
+        TRACE = 2
+    };
+
+    static constexpr uint32_t StringHeaderSize = 1 /* tag */ + 2 /* id */ + 2 /* length */;
+    static constexpr uint32_t TraceHeaderSize = 1 /* tag */ + 8 /* clock */ + 4 /* line */ + (4 * 2) /* strings */ + 2 /* length */;
+}
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "Module.h"
+#include "BinaryTraceFormat.h"
+
+#include <fcntl.h>
+#include <initializer_list>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Writes the traces, as they are, into a memory mapped file. No formatting is done at all, strings that
+    // repeat (file, module, category and class names) are interned and only written once per file. Once a
+    // file is full, it is rotated: <name> -> <name>.1 -> ... -> <name>.<files - 1>.
+    // Use the TraceDecoder to turn these files back into readable text.
+    class BinaryTraceOutput : public Trace::ITraceMedia {
+    private:
+        BinaryTraceOutput() = delete;
+        BinaryTraceOutput(const BinaryTraceOutput&) = delete;
+        BinaryTraceOutput& operator=(const BinaryTraceOutput&) = delete;
+
+        static constexpr uint16_t NoString = static_cast<uint16_t>(~0);
+
+    public:
+        BinaryTraceOutput(const string& fileName, const uint32_t fileSize, const uint8_t files)
+            : _fileName(fileName)
+            , _fileSize(fileSize < (64 * 1024) ? (64 * 1024) : fileSize)
+            , _files(files == 0 ? 1 : files)
+            , _descriptor(-1)
+            , _buffer(nullptr)
+            , _offset(0)
+            , _strings()
+            , _index()
+            , _truncated(0)
+            , _dropped(0)
+        {
+            Open();
+        }
+        virtual ~BinaryTraceOutput()
+        {
+            Close();
+        }
+
+    public:
+        inline bool IsValid() const
+        {
+            return (_buffer != nullptr);
+        }
+        // Traces that did not fit in a file of their own, their information was cut short.
+        inline uint32_t Truncated() const
+        {
+            return (_truncated);
+        }
+        // Traces of which the names alone did not fit in a file of their own.
+        inline uint32_t Dropped() const
+        {
+            return (_dropped);
+        }
+        virtual void Output(const char fileName[], const uint32_t lineNumber, const char className[], const Trace::ITrace* information)
+        {
+            // Only used if the source of the trace did not give us a timestamp, take the current one.
+            Output(Core::Time::Now().Ticks(), fileName, lineNumber, className, information);
+        }
+        void Output(const uint64_t timestamp, const char fileName[], const uint32_t lineNumber, const char className[], const Trace::ITrace* information)
+        {
+            if (_buffer != nullptr) {
+                const char* fileOnly = Core::FileNameOnly(fileName);
+                uint16_t length = information->Length();
+                uint16_t file, module, category, name;
+
+                // Strings are announced before the trace itself. If the file is full or the string table exhausted,
+                // the whole entry is written to a fresh file, so we need at most two attempts.
+                uint8_t attempts = 2;
+
+                while ((attempts != 0) && (_buffer != nullptr)) {
+                    if (((file = Intern(fileOnly)) != NoString) &&
+                        ((module = Intern(information->Module())) != NoString) &&
+                        ((category = Intern(information->Category())) != NoString) &&
+                        ((name = Intern(className)) != NoString) &&
+                        ((_offset + TraceFile::TraceHeaderSize + length) < _fileSize)) {
+
+                        uint8_t* entry = &(_buffer[_offset]);
+
+                        // The tag is written last, so a reader never sees a half written entry.
+                        ::memcpy(&entry[1], &timestamp, sizeof(timestamp));
+                        ::memcpy(&entry[9], &lineNumber, sizeof(lineNumber));
+                        ::memcpy(&entry[13], &file, sizeof(file));
+                        ::memcpy(&entry[15], &module, sizeof(module));
+                        ::memcpy(&entry[17], &category, sizeof(category));
+                        ::memcpy(&entry[19], &name, sizeof(name));
+                        ::memcpy(&entry[21], &length, sizeof(length));
+                        ::memcpy(&entry[TraceFile::TraceHeaderSize], information->Data(), length);
+                        entry[0] = TraceFile::TRACE;
+
+                        _offset += TraceFile::TraceHeaderSize + length;
+                        attempts = 0;
+                    } else if (Fit(fileOnly, information->Module(), information->Category(), className, length) == false) {
+                        // Not even a fresh file can take it, rotating would only throw away the current one.
+                        TRACE_L1("Binary trace of %s:%d dropped, its names do not fit in a file", fileOnly, lineNumber);
+                        _dropped++;
+                        attempts = 0;
+                    } else {
+                        Rotate();
+                        attempts--;
+                    }
+                }
+            }
+        }
+
+    private:
+        // Makes sure the entry fits in a fresh file, with all its strings announced. Information that is too long
+        // is cut short, returns false if the strings alone do not fit.
+        bool Fit(const char fileName[], const char module[], const char category[], const char className[], uint16_t& length)
+        {
+            uint64_t required = TraceFile::HeaderSize + TraceFile::TraceHeaderSize;
+
+            for (const char* text : { fileName, module, category, className }) {
+                const uint32_t size = static_cast<uint32_t>(::strlen(text));
+
+                required += TraceFile::StringHeaderSize + (size <= 0xFFFF ? size : _fileSize);
+            }
+
+            if ((required < _fileSize) && ((required + length) >= _fileSize)) {
+                length = static_cast<uint16_t>(_fileSize - required - 1);
+                _truncated++;
+            }
+
+            return (required < _fileSize);
+        }
+        uint16_t Intern(const char text[])
+        {
+            uint16_t result = NoString;
+            uint32_t length = static_cast<uint32_t>(::strlen(text));
+            uint32_t hash = Hash(text, length);
+
+            std::pair<Index::const_iterator, Index::const_iterator> range(_index.equal_range(hash));
+
+            while ((range.first != range.second) && (_strings[range.first->second] != text)) {
+                range.first++;
+            }
+
+            if (range.first != range.second) {
+                result = range.first->second;
+            } else if ((_strings.size() < NoString) && (length <= 0xFFFF) && ((_offset + TraceFile::StringHeaderSize + length) < _fileSize)) {
+                uint16_t id = static_cast<uint16_t>(_strings.size());
+                uint16_t size = static_cast<uint16_t>(length);
+                uint8_t* entry = &(_buffer[_offset]);
+
+                ::memcpy(&entry[1], &id, sizeof(id));
+                ::memcpy(&entry[3], &size, sizeof(size));
+                ::memcpy(&entry[TraceFile::StringHeaderSize], text, size);
+                entry[0] = TraceFile::STRING;
+
+                _offset += TraceFile::StringHeaderSize + size;
+                _strings.emplace_back(text, size);
+                _index.insert(Index::value_type(hash, id));
+
+                result = id;
+            }
+
+            return (result);
+        }
+        static uint32_t Hash(const char text[], const uint32_t length)
+        {
+            // FNV-1a, cheap and good enough for the handfull of names we see.
+            uint32_t hash = 2166136261u;
+
+            for (uint32_t index = 0; index < length; index++) {
+                hash = (hash ^ static_cast<uint8_t>(text[index])) * 16777619u;
+            }
+
+            return (hash);
+        }
+        string FileName(const uint8_t index) const
+        {
+            return (index == 0 ? _fileName : _fileName + '.' + Core::NumberType<uint8_t>(index).Text());
+        }
+        void Open()
+        {
+            ASSERT(_buffer == nullptr);
+
+            _descriptor = ::open(_fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+
+            if (_descriptor == -1) {
+                TRACE_L1("Could not open binary trace file %s, error: %d", _fileName.c_str(), errno);
+            } else if (::ftruncate(_descriptor, _fileSize) != 0) {
+                TRACE_L1("Could not size binary trace file %s, error: %d", _fileName.c_str(), errno);
+                ::close(_descriptor);
+                _descriptor = -1;
+            } else {
+                void* mapped = ::mmap(nullptr, _fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, _descriptor, 0);
+
+                if (mapped == MAP_FAILED) {
+                    TRACE_L1("Could not map binary trace file %s, error: %d", _fileName.c_str(), errno);
+                    ::close(_descriptor);
+                    _descriptor = -1;
+                } else {
+                    uint16_t version = TraceFile::Version;
+
+                    _buffer = static_cast<uint8_t*>(mapped);
+                    ::memcpy(_buffer, TraceFile::Magic, sizeof(TraceFile::Magic));
+                    ::memcpy(&_buffer[sizeof(TraceFile::Magic)], &version, sizeof(version));
+                    _offset = TraceFile::HeaderSize;
+                }
+            }
+        }
+        void Close()
+        {
+            if (_buffer != nullptr) {
+                ::munmap(_buffer, _fileSize);
+                _buffer = nullptr;
+
+                // Cut of the unused, preallocated part so the file on disk only holds what was written.
+                if (::ftruncate(_descriptor, _offset) != 0) {
+                    TRACE_L1("Could not trim binary trace file %s, error: %d", _fileName.c_str(), errno);
+                }
+            }
+            if (_descriptor != -1) {
+                ::close(_descriptor);
+                _descriptor = -1;
+            }
+
+            _strings.clear();
+            _index.clear();
+            _offset = 0;
+        }
+        void Rotate()
+        {
+            Close();
+
+            uint8_t index = _files - 1;
+
+            while (index != 0) {
+                // Oldest one drops off automatically, rename overwrites it.
+                ::rename(FileName(index - 1).c_str(), FileName(index).c_str());
+                index--;
+            }
+
+            Open();
+        }
+
+    private:
+        typedef std::unordered_multimap<uint32_t, uint16_t> Index;
+
+        const string _fileName;
+        const uint32_t _fileSize;
+        const uint8_t _files;
+        int _descriptor;
+        uint8_t* _buffer;
+        uint32_t _offset;
+        std::vector<string> _strings;
+        Index _index;
+        uint32_t _truncated;
+        uint32_t _dropped;
+    };
+}
+}
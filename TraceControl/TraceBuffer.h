@@ -0,0 +1,170 @@
+#pragma once
+
+#include <core/core.h>
+#include <tracing/tracing.h>
+
+namespace WPEFramework {
+
+namespace Plugin {
+
+    // Reads the traces a process writes into its cyclic trace buffer, one entry at a time.
+    // entry: length (2 bytes) - clock ticks (8 bytes) - line number (4 bytes) - file/module/category/className
+    //        (zero terminated) - information
+    class TraceBuffer : public Core::CyclicBuffer {
+    private:
+        TraceBuffer() = delete;
+        TraceBuffer(const TraceBuffer&) = delete;
+        TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+    public:
+        enum state {
+            EMPTY,
+            LOADED,
+            FAILURE
+        };
+
+    public:
+        TraceBuffer(const string& fileName)
+            : Core::CyclicBuffer(fileName, 0, true)
+            , _module(0)
+            , _category(0)
+            , _classname(0)
+            , _information(0)
+            , _length(0)
+            , _state(EMPTY)
+        {
+        }
+        ~TraceBuffer()
+        {
+        }
+
+    public:
+        state Load()
+        {
+            uint32_t length;
+
+            // Traces will be commited in one go, First reserve, then write. So if there is a length (2 bytes)
+            // The full trace has to be available as well.
+            if ((_state == EMPTY) && ((length = Read(_traceBuffer, sizeof(_traceBuffer))) != 0)) {
+
+                if (length < 2) {
+                    // Didn't even get enough data to read entry size. This is impossible, fallback to failure.
+                    TRACE_L1("Inconsistent trace dump. Need to flush. %d", length);
+                    _state = FAILURE;
+                } else {
+                    // TODO: This is platform dependend, needs to ba agnostic to the platform.
+                    uint16_t requiredLength = (_traceBuffer[1] << 8) | _traceBuffer[0];
+
+                    if (requiredLength != length) {
+                        // Something went wrong, didn't read a full entry.
+                        _state = FAILURE;
+                    } else {
+                        // length(2 bytes) - clock ticks (8 bytes) - line number (4 bytes) - file/module/category/className
+
+                        // Keep track of location in buffer.
+                        uint32_t offset = /* length */ 2 /* clock */ + 8 /* Skip line number */ + 4;
+
+                        // Skip file name.
+                        offset += static_cast<uint32_t>(strlen(reinterpret_cast<char*>(_traceBuffer + offset)) + 1);
+
+                        // Get module offset.
+                        _module = offset;
+                        offset += static_cast<uint32_t>(strlen(reinterpret_cast<char*>(_traceBuffer + _module)) + 1);
+
+                        // Get category offset.
+                        _category = offset;
+                        offset += static_cast<uint32_t>(strlen(reinterpret_cast<char*>(_traceBuffer + _category)) + 1);
+
+                        // Get class name offset.
+                        _classname = offset;
+                        offset += static_cast<uint32_t>(strlen(reinterpret_cast<char*>(_traceBuffer + _classname)) + 1);
+
+                        ASSERT(length >= offset);
+
+                        // Rest of entry is information.
+                        _information = offset;
+                        _length = requiredLength - offset;
+                        _traceBuffer[requiredLength] = '\0';
+
+                        // Entries are read in whole, so we are done.
+                        _state = LOADED;
+                    }
+                }
+            }
+            return _state;
+        }
+        inline state State() const
+        {
+            return (_state);
+        }
+        inline uint64_t Timestamp() const
+        {
+            uint64_t stamp;
+            ::memcpy(&stamp, &(_traceBuffer[2]), sizeof(uint64_t));
+            return (stamp);
+        }
+        inline uint32_t LineNumber() const
+        {
+            uint32_t linenumber;
+            ::memcpy(&linenumber, &(_traceBuffer[10]), sizeof(uint32_t));
+            return (linenumber);
+        }
+        inline const char* FileName() const
+        {
+            return reinterpret_cast<const char*>(&_traceBuffer[14]);
+        }
+        inline const char* Module() const
+        {
+            return reinterpret_cast<const char*>(&_traceBuffer[_module]);
+        }
+        inline const char* Category() const
+        {
+            return reinterpret_cast<const char*>(&_traceBuffer[_category]);
+        }
+        inline const char* ClassName() const
+        {
+            return reinterpret_cast<const char*>(&_traceBuffer[_classname]);
+        }
+        inline const char* Information() const
+        {
+            return reinterpret_cast<const char*>(&_traceBuffer[_information]);
+        }
+        inline uint16_t Length() const
+        {
+            return (_length);
+        }
+        // Size of the whole entry, as it was taken from the buffer.
+        inline uint16_t Size() const
+        {
+            return (_information + _length);
+        }
+        void Flush()
+        {
+            _state = EMPTY;
+            Core::CyclicBuffer::Flush();
+        }
+        void Clear()
+        {
+            _state = EMPTY;
+        }
+
+    private:
+        virtual uint32_t GetReadSize(Core::CyclicBuffer::Cursor& cursor) override
+        {
+            // Just read one entry.
+            uint16_t entrySize = 0;
+            cursor.Peek(entrySize);
+            return entrySize;
+        }
+
+    private:
+        uint16_t _module;
+        uint16_t _category;
+        uint16_t _classname;
+        uint16_t _information;
+        uint16_t _length;
+        state _state;
+        uint8_t _traceBuffer[Trace::CyclicBufferSize];
+    };
+}
+}
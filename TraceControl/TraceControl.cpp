@@ -1,6 +1,11 @@
 #include "TraceControl.h"
 #include "TraceOutput.h"
 
+#ifndef __WINDOWS__
+#include "BinaryTraceOutput.h"
+#include "TraceStreamer.h"
+#endif
+
 namespace WPEFramework {
 
 ENUM_CONVERSION_BEGIN(Plugin::TraceControl::state)
@@ -11,6 +16,14 @@ ENUM_CONVERSION_BEGIN(Plugin::TraceControl::state)
 
     ENUM_CONVERSION_END(Plugin::TraceControl::state);
 
+ENUM_CONVERSION_BEGIN(Plugin::TraceControl::costorder)
+
+    { Plugin::TraceControl::costorder::RECORDS, _TXT("records") },
+    { Plugin::TraceControl::costorder::BYTES, _TXT("bytes") },
+    { Plugin::TraceControl::costorder::TIME, _TXT("time") },
+
+    ENUM_CONVERSION_END(Plugin::TraceControl::costorder);
+
 namespace Plugin {
 
     SERVICE_REGISTRATION(TraceControl, 1, 0);
@@ -61,6 +74,30 @@ namespace Plugin {
 
             _outputs.push_back(new Trace::TraceMedia(logNode));
         }
+#ifndef __WINDOWS__
+        if (_config.Streaming.IsSet() == true) {
+            Core::NodeId streamNode(_config.Streaming.Binding.Value().c_str(), _config.Streaming.Port.Value());
+
+            _streamer = new Plugin::TraceStreamer(streamNode, _config.Streaming.MTU.Value(), _config.Streaming.Rate.Value(), _config.Streaming.Burst.Value());
+
+            if (_streamer->IsValid() == false) {
+                SYSLOG(Logging::Startup, (_T("Trace streaming could not be started [%s:%d]"), _config.Streaming.Binding.Value().c_str(), _config.Streaming.Port.Value()));
+                delete _streamer;
+                _streamer = nullptr;
+            }
+        }
+        if (_config.Binary.IsSet() == true) {
+            string fileName(_config.Binary.Path.IsSet() == true ? _config.Binary.Path.Value() : service->VolatilePath() + _T("traces.bin"));
+
+            _binary = new Plugin::BinaryTraceOutput(fileName, _config.Binary.Size.Value(), _config.Binary.Files.Value());
+
+            if (_binary->IsValid() == false) {
+                SYSLOG(Logging::Startup, (_T("Binary trace output could not be created [%s]"), fileName.c_str()));
+                delete _binary;
+                _binary = nullptr;
+            }
+        }
+#endif
 
         _service->Register(&_observer);
 
@@ -85,6 +122,17 @@ namespace Plugin {
 
             _outputs.pop_front();
         }
+
+#ifndef __WINDOWS__
+        if (_streamer != nullptr) {
+            delete _streamer;
+            _streamer = nullptr;
+        }
+        if (_binary != nullptr) {
+            delete _binary;
+            _binary = nullptr;
+        }
+#endif
     }
 
     /* virtual */ string TraceControl::Information() const
@@ -201,6 +249,25 @@ namespace Plugin {
             (*index)->Output(information.FileName(), information.LineNumber(), information.ClassName(), &wrapper);
             index++;
         }
+
+#ifndef __WINDOWS__
+        if (_streamer != nullptr) {
+            _streamer->Output(information.Timestamp(), information.FileName(), information.LineNumber(), information.ClassName(), &wrapper);
+        }
+        if (_binary != nullptr) {
+            // The binary output stores the original timestamp of the trace, no need to sample the clock.
+            _binary->Output(information.Timestamp(), information.FileName(), information.LineNumber(), information.ClassName(), &wrapper);
+        }
+#endif
+    }
+
+    void TraceControl::Flush()
+    {
+#ifndef __WINDOWS__
+        if (_streamer != nullptr) {
+            _streamer->Flush();
+        }
+#endif
     }
 }
 }
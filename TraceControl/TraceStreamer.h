@@ -0,0 +1,376 @@
+#pragma once
+
+#include "Module.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Streams traces over UDP, packing as many traces as fit in an MTU sized frame and handing a whole batch
+    // of frames to the kernel in one sendmmsg call. Every (module, category) pair is rate limited by its own
+    // token bucket, traces over the limit are dropped and counted, so a silent category can be told apart from
+    // a category that is being throttled.
+    //
+    // frame  : magic (2 bytes) - version (1 byte) - reserved (1 byte) - sequence (4 bytes) - count (2 bytes) - reserved (2 bytes)
+    // record : clock ticks (8 bytes) - line number (4 bytes) - length (2 bytes)
+    //          - file, module, category and class name (zero terminated) - information (length bytes)
+    //
+    // A gap in the sequence numbers at the receiving side means frames were lost on the way.
+    class TraceStreamer : public Trace::ITraceMedia {
+    private:
+        TraceStreamer() = delete;
+        TraceStreamer(const TraceStreamer&) = delete;
+        TraceStreamer& operator=(const TraceStreamer&) = delete;
+
+        static constexpr uint16_t FrameHeaderSize = 12;
+        static constexpr uint16_t RecordHeaderSize = 14;
+        static constexpr uint8_t MaxFrames = 16;
+        static constexpr uint64_t Token = 1000000;
+
+        class Bucket {
+        public:
+            Bucket() = delete;
+            Bucket& operator=(const Bucket&) = delete;
+
+            Bucket(const char module[], const char category[], const uint64_t tokens)
+                : Module(module)
+                , Name(category)
+                , Tokens(tokens)
+                , Stamp(0)
+                , Sent(0)
+                , Dropped(0)
+            {
+            }
+            Bucket(const Bucket& copy)
+                : Module(copy.Module)
+                , Name(copy.Name)
+                , Tokens(copy.Tokens)
+                , Stamp(copy.Stamp)
+                , Sent(copy.Sent)
+                , Dropped(copy.Dropped)
+            {
+            }
+            ~Bucket()
+            {
+            }
+
+        public:
+            const string Module;
+            const string Name;
+            uint64_t Tokens;
+            uint64_t Stamp;
+            uint32_t Sent;
+            uint32_t Dropped;
+        };
+
+        typedef std::unordered_multimap<uint32_t, Bucket> Buckets;
+
+    public:
+        class Statistics {
+        public:
+            Statistics()
+                : Module()
+                , Category()
+                , Sent(0)
+                , Dropped(0)
+            {
+            }
+            Statistics(const string& module, const string& category, const uint32_t sent, const uint32_t dropped)
+                : Module(module)
+                , Category(category)
+                , Sent(sent)
+                , Dropped(dropped)
+            {
+            }
+
+        public:
+            string Module;
+            string Category;
+            uint32_t Sent;
+            uint32_t Dropped;
+        };
+
+    public:
+        // rate (traces per second, per category) of 0 means no limit. A burst of 0 equals a burst of one second.
+        TraceStreamer(const Core::NodeId& destination, const uint16_t mtu, const uint32_t rate, const uint32_t burst)
+            : _adminLock()
+            , _socket(-1)
+            , _mtu(mtu < 256 ? 256 : mtu)
+            , _rate(rate)
+            , _capacity((burst == 0 ? rate : burst) * Token)
+            , _fillTime(rate == 0 ? 0 : ((_capacity / rate) + 1))
+            , _frames(MaxFrames * _mtu)
+            , _lengths()
+            , _current(0)
+            , _count(0)
+            , _sequence(0)
+            , _sentFrames(0)
+            , _lostFrames(0)
+            , _oversized(0)
+            , _categories()
+        {
+            _socket = ::socket(destination.Type(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+            if (_socket == -1) {
+                TRACE_L1("Could not create the trace streaming socket, error: %d", errno);
+            } else if (::connect(_socket, static_cast<const Core::NodeId&>(destination), destination.Size()) != 0) {
+                TRACE_L1("Could not connect the trace streaming socket, error: %d", errno);
+                ::close(_socket);
+                _socket = -1;
+            }
+
+            _lengths[0] = FrameHeaderSize;
+        }
+        virtual ~TraceStreamer()
+        {
+            Flush();
+
+            if (_socket != -1) {
+                ::close(_socket);
+                _socket = -1;
+            }
+        }
+
+    public:
+        inline bool IsValid() const
+        {
+            return (_socket != -1);
+        }
+        virtual void Output(const char fileName[], const uint32_t lineNumber, const char className[], const Trace::ITrace* information)
+        {
+            // Only used if the source of the trace did not give us a timestamp, take the current one.
+            Output(Core::Time::Now().Ticks(), fileName, lineNumber, className, information);
+        }
+        void Output(const uint64_t timestamp, const char fileName[], const uint32_t lineNumber, const char className[], const Trace::ITrace* information)
+        {
+            _adminLock.Lock();
+
+            Bucket& category(Find(information->Module(), information->Category()));
+
+            if (Admit(category, timestamp) == false) {
+                category.Dropped++;
+            } else {
+                Append(timestamp, Core::FileNameOnly(fileName), lineNumber, className, information);
+                category.Sent++;
+            }
+
+            _adminLock.Unlock();
+        }
+        // Hand all pending frames to the kernel. Called when a batch of frames is complete and whenever the
+        // trace observer has nothing left to dispatch, so traces never linger in a partial frame.
+        void Flush()
+        {
+            _adminLock.Lock();
+
+            if (_count != 0) {
+                Close();
+            }
+
+            if ((_current != 0) && (_socket != -1)) {
+                struct mmsghdr messages[MaxFrames];
+                struct iovec vectors[MaxFrames];
+
+                ::memset(messages, 0, sizeof(messages));
+
+                for (uint8_t index = 0; index < _current; index++) {
+                    vectors[index].iov_base = &(_frames[index * _mtu]);
+                    vectors[index].iov_len = _lengths[index];
+                    messages[index].msg_hdr.msg_iov = &(vectors[index]);
+                    messages[index].msg_hdr.msg_iovlen = 1;
+                }
+
+                uint8_t sent = 0;
+
+                while (sent < _current) {
+                    int result = ::sendmmsg(_socket, &(messages[sent]), _current - sent, 0);
+
+                    if (result > 0) {
+                        sent += static_cast<uint8_t>(result);
+                    } else if ((result == -1) && (errno == EINTR)) {
+                        continue;
+                    } else {
+                        // The socket is not keeping up (or the receiver is gone), do not wait for it, count the loss.
+                        _lostFrames += (_current - sent);
+                        break;
+                    }
+                }
+
+                _sentFrames += sent;
+            }
+
+            _current = 0;
+            _lengths[0] = FrameHeaderSize;
+
+            _adminLock.Unlock();
+        }
+        // Frames counts the frames the socket took, lost the frames the socket did not take and oversized the records that
+        // did not fit a frame at all.
+        void Snapshot(std::list<Statistics>& statistics, uint32_t& frames, uint32_t& lost, uint32_t& oversized) const
+        {
+            _adminLock.Lock();
+
+            frames = _sentFrames;
+            lost = _lostFrames;
+            oversized = _oversized;
+
+            Buckets::const_iterator index(_categories.begin());
+
+            while (index != _categories.end()) {
+                statistics.emplace_back(index->second.Module, index->second.Name, index->second.Sent, index->second.Dropped);
+                index++;
+            }
+
+            _adminLock.Unlock();
+        }
+
+    private:
+        static uint32_t Hash(const char module[], const char category[])
+        {
+            // FNV-1a over "<module>\0<category>"
+            uint32_t hash = 2166136261u;
+
+            while (*module != '\0') {
+                hash = (hash ^ static_cast<uint8_t>(*module++)) * 16777619u;
+            }
+
+            hash *= 16777619u;
+
+            while (*category != '\0') {
+                hash = (hash ^ static_cast<uint8_t>(*category++)) * 16777619u;
+            }
+
+            return (hash);
+        }
+        Bucket& Find(const char module[], const char category[])
+        {
+            uint32_t hash = Hash(module, category);
+            std::pair<Buckets::iterator, Buckets::iterator> range(_categories.equal_range(hash));
+
+            while ((range.first != range.second) && ((range.first->second.Module != module) || (range.first->second.Name != category))) {
+                range.first++;
+            }
+
+            if (range.first == range.second) {
+                // First time we see this one, it starts with a full bucket.
+                range.first = _categories.insert(Buckets::value_type(hash, Bucket(module, category, _capacity)));
+            }
+
+            return (range.first->second);
+        }
+        bool Admit(Bucket& category, const uint64_t timestamp)
+        {
+            bool result = true;
+
+            if (_rate != 0) {
+                if (timestamp > category.Stamp) {
+                    // Refill the bucket for the time passed, no need to go beyond the time it takes to fill it completely.
+                    uint64_t elapsed = std::min(timestamp - category.Stamp, _fillTime);
+
+                    category.Tokens = std::min(category.Tokens + (elapsed * _rate), _capacity);
+                    category.Stamp = timestamp;
+                }
+
+                if (category.Tokens >= Token) {
+                    category.Tokens -= Token;
+                } else {
+                    result = false;
+                }
+            }
+
+            return (result);
+        }
+        void Append(const uint64_t timestamp, const char fileName[], const uint32_t lineNumber, const char className[], const Trace::ITrace* information)
+        {
+            const char* strings[] = { fileName, information->Module(), information->Category(), className };
+            uint16_t lengths[4];
+            uint32_t required = RecordHeaderSize;
+
+            for (uint8_t index = 0; index < 4; index++) {
+                lengths[index] = static_cast<uint16_t>(::strlen(strings[index]) + 1);
+                required += lengths[index];
+            }
+
+            // Anything that does not fit a frame on its own, gets its information truncated.
+            uint16_t length = information->Length();
+            uint32_t available = _mtu - FrameHeaderSize;
+
+            if (required >= available) {
+                // Can not even fit the names, no way to send this..
+                _oversized++;
+            } else {
+                if ((required + length) > available) {
+                    length = static_cast<uint16_t>(available - required);
+                }
+                required += length;
+
+                if ((_lengths[_current] + required) > _mtu) {
+                    Close();
+
+                    if (_current == MaxFrames) {
+                        Flush();
+                    }
+                }
+
+                uint8_t* entry = &(_frames[(_current * _mtu) + _lengths[_current]]);
+
+                ::memcpy(&entry[0], &timestamp, sizeof(timestamp));
+                ::memcpy(&entry[8], &lineNumber, sizeof(lineNumber));
+                ::memcpy(&entry[12], &length, sizeof(length));
+                entry += RecordHeaderSize;
+
+                for (uint8_t index = 0; index < 4; index++) {
+                    ::memcpy(entry, strings[index], lengths[index]);
+                    entry += lengths[index];
+                }
+
+                ::memcpy(entry, information->Data(), length);
+
+                _lengths[_current] += required;
+                _count++;
+            }
+        }
+        void Close()
+        {
+            // Finalize the header of the current frame and move on to the next one.
+            uint8_t* frame = &(_frames[_current * _mtu]);
+
+            frame[0] = 'W';
+            frame[1] = 'T';
+            frame[2] = 1;
+            frame[3] = 0;
+            ::memcpy(&frame[4], &_sequence, sizeof(_sequence));
+            ::memcpy(&frame[8], &_count, sizeof(_count));
+            frame[10] = 0;
+            frame[11] = 0;
+
+            _sequence++;
+            _count = 0;
+            _current++;
+
+            if (_current < MaxFrames) {
+                _lengths[_current] = FrameHeaderSize;
+            }
+        }
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        int _socket;
+        const uint16_t _mtu;
+        const uint32_t _rate;
+        const uint64_t _capacity;
+        const uint64_t _fillTime;
+        std::vector<uint8_t> _frames;
+        uint16_t _lengths[MaxFrames];
+        uint8_t _current;
+        uint16_t _count;
+        uint32_t _sequence;
+        uint32_t _sentFrames;
+        uint32_t _lostFrames;
+        uint32_t _oversized;
+        Buckets _categories;
+    };
+}
+}
@@ -0,0 +1,253 @@
+// Measures how the TraceControl Observer merges the process trace buffers into one ordered stream. The traces
+// are written into real cyclic trace buffers, in the format the trace unit of a process uses, and read back with
+// the TraceBuffer and merged by the TraceMergeType the Observer uses. As a reference, the same buffers are
+// merged the way the Observer did it before: take the lock per trace and look at the head of every buffer for
+// the oldest one.
+// Dispatching a trace is modelled as a store of its timestamp, so the numbers leave out the cost of the actual
+// output, which is the same for both.
+
+#ifndef MODULE_NAME
+#define MODULE_NAME TraceMergeBenchmark
+#endif
+
+#include <core/core.h>
+#include <tracing/tracing.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "../TraceBuffer.h"
+#include "../TraceMerge.h"
+
+#undef EXTERNAL
+
+using namespace WPEFramework;
+
+namespace {
+
+    static constexpr uint32_t MaxBatchSize = 256; // as TraceControl::Observer::MaxBatchSize
+
+    static const char FileName[] = "MergeBenchmark.cpp";
+    static const char Module[] = "Benchmark";
+    static const char Category[] = "Information";
+    static const char ClassName[] = "Producer";
+    static const char Information[] = "A trace of 32 characters, or so.";
+
+    static constexpr uint16_t EntrySize = 2 + 8 + 4 + sizeof(FileName) + sizeof(Module) + sizeof(Category) + sizeof(ClassName) + (sizeof(Information) - 1);
+
+    // The writing end of a trace buffer, as the trace unit of a process has it.
+    class Producer : public Core::CyclicBuffer {
+    private:
+        Producer() = delete;
+        Producer(const Producer&) = delete;
+        Producer& operator=(const Producer&) = delete;
+
+    public:
+        Producer(const string& fileName, const uint32_t size)
+            : Core::CyclicBuffer(fileName, size, false)
+        {
+        }
+        ~Producer()
+        {
+        }
+
+    public:
+        bool Trace(const uint64_t timestamp, const uint32_t line)
+        {
+            uint8_t entry[EntrySize];
+            uint32_t offset = 0;
+            const uint16_t length = EntrySize;
+
+            ::memcpy(&(entry[offset]), &length, sizeof(length));
+            offset += sizeof(length);
+            ::memcpy(&(entry[offset]), &timestamp, sizeof(timestamp));
+            offset += sizeof(timestamp);
+            ::memcpy(&(entry[offset]), &line, sizeof(line));
+            offset += sizeof(line);
+            ::memcpy(&(entry[offset]), FileName, sizeof(FileName));
+            offset += sizeof(FileName);
+            ::memcpy(&(entry[offset]), Module, sizeof(Module));
+            offset += sizeof(Module);
+            ::memcpy(&(entry[offset]), Category, sizeof(Category));
+            offset += sizeof(Category);
+            ::memcpy(&(entry[offset]), ClassName, sizeof(ClassName));
+            offset += sizeof(ClassName);
+            ::memcpy(&(entry[offset]), Information, sizeof(Information) - 1);
+
+            // As the trace unit does, reserve first, so the reader never sees half an entry.
+            return ((Reserve(EntrySize) == EntrySize) && (Write(entry, EntrySize) == EntrySize));
+        }
+    };
+
+    volatile uint64_t sink;
+
+    inline void Dispatch(const Plugin::TraceBuffer& source)
+    {
+        sink = source.Timestamp();
+    }
+
+    // As the Observer does, a corrupt buffer is flushed.
+    inline bool Load(Plugin::TraceBuffer& source)
+    {
+        Plugin::TraceBuffer::state state(source.Load());
+
+        if (state == Plugin::TraceBuffer::FAILURE) {
+            source.Flush();
+        }
+
+        return (state == Plugin::TraceBuffer::LOADED);
+    }
+
+    void Scan(std::vector<Plugin::TraceBuffer*>& sources, Core::CriticalSection& lock)
+    {
+        bool found;
+
+        do {
+            Plugin::TraceBuffer* selected = nullptr;
+
+            lock.Lock();
+
+            for (Plugin::TraceBuffer* source : sources) {
+                if ((Load(*source) == true) && ((selected == nullptr) || (source->Timestamp() < selected->Timestamp()))) {
+                    selected = source;
+                }
+            }
+
+            found = (selected != nullptr);
+
+            if (found == true) {
+                Dispatch(*selected);
+                selected->Clear();
+            }
+
+            lock.Unlock();
+
+        } while (found == true);
+    }
+
+    void Heap(std::vector<Plugin::TraceBuffer*>& sources, Core::CriticalSection& lock)
+    {
+        Plugin::TraceMergeType<Plugin::TraceBuffer> merge;
+        bool pending;
+
+        do {
+            lock.Lock();
+
+            for (Plugin::TraceBuffer* source : sources) {
+                if (Load(*source) == true) {
+                    merge.Add(*source);
+                }
+            }
+
+            pending = merge.Merge(MaxBatchSize, Dispatch, Load);
+
+            lock.Unlock();
+
+        } while (pending == true);
+    }
+
+    // Spreads the traces over the buffers, every buffer in timestamp order, interleaved at random. Every buffer
+    // is large enough to hold all traces it gets, so nothing is overwritten before it is merged.
+    bool Fill(std::vector<Producer*>& producers, const uint32_t traces)
+    {
+        std::vector<uint32_t> counts(producers.size(), 0);
+        std::vector<uint8_t> targets(traces);
+        bool result = true;
+
+        for (uint32_t index = 0; index < traces; index++) {
+            targets[index] = static_cast<uint8_t>(std::rand() % producers.size());
+            counts[targets[index]]++;
+        }
+
+        for (size_t index = 0; index < producers.size(); index++) {
+            const string name(Core::Directory::Normalize(P_tmpdir) + "tracemerge." + Core::NumberType<uint32_t>(::getpid()).Text() + '.' + Core::NumberType<uint32_t>(static_cast<uint32_t>(index)).Text());
+
+            producers[index] = new Producer(name, (counts[index] + 1) * EntrySize * 2);
+        }
+
+        uint64_t timestamp = 0;
+
+        for (uint32_t index = 0; (index < traces) && (result == true); index++) {
+            timestamp += 1 + (std::rand() % 4);
+            result = producers[targets[index]]->Trace(timestamp, index);
+        }
+
+        return (result);
+    }
+
+    // The best of a few runs, so a busy machine does not skew the comparison.
+    template <typename MERGE>
+    double Measure(MERGE merge, const uint32_t buffers, const uint32_t traces)
+    {
+        static constexpr uint8_t Runs = 5;
+        double result = 0.0;
+
+        for (uint8_t run = 0; (run < Runs) && (result >= 0.0); run++) {
+            std::vector<Producer*> producers(buffers, nullptr);
+            std::vector<Plugin::TraceBuffer*> sources;
+            Core::CriticalSection lock;
+
+            std::srand(buffers);
+
+            if (Fill(producers, traces) == false) {
+                fprintf(stderr, "Could not write the traces\n");
+                result = -1.0;
+            } else {
+                for (Producer* producer : producers) {
+                    sources.push_back(new Plugin::TraceBuffer(producer->Name()));
+                }
+
+                const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+                merge(sources, lock);
+
+                const std::chrono::steady_clock::time_point end(std::chrono::steady_clock::now());
+                const double duration = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) / traces;
+
+                if ((run == 0) || (duration < result)) {
+                    result = duration;
+                }
+            }
+
+            for (Plugin::TraceBuffer* source : sources) {
+                delete source;
+            }
+            for (Producer* producer : producers) {
+                if (producer != nullptr) {
+                    const string name(producer->Name());
+
+                    delete producer;
+                    ::unlink(name.c_str());
+                }
+            }
+        }
+
+        return (result);
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    const uint32_t traces = (argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : (1024 * 1024));
+    const uint32_t buffers[] = { 2, 4, 8, 16, 32, 128 };
+
+    printf("%d traces of %d bytes\n", traces, EntrySize);
+    printf("   buffers   scan ns/trace   heap+batch ns/trace\n");
+
+    for (const uint32_t count : buffers) {
+        const double scan = Measure(Scan, count, traces);
+        const double heap = Measure(Heap, count, traces);
+
+        if ((scan < 0.0) || (heap < 0.0)) {
+            break;
+        }
+
+        printf("%10d %15.1f %21.1f   (%.2fx)\n", count, scan, heap, scan / heap);
+    }
+
+    Core::Singleton::Dispose();
+
+    return (0);
+}
@@ -0,0 +1,164 @@
+#ifndef MODULE_NAME
+#define MODULE_NAME TraceDecoder
+#endif
+
+#include <core/core.h>
+#include <fstream>
+#include <iostream>
+
+#include "../BinaryTraceFormat.h"
+
+#undef EXTERNAL
+
+using namespace WPEFramework;
+
+namespace WPEFramework {
+
+    class TraceDecoder {
+    private:
+        TraceDecoder(const TraceDecoder&) = delete;
+        TraceDecoder& operator=(const TraceDecoder&) = delete;
+
+    public:
+        TraceDecoder(FILE* output)
+            : _output(output)
+            , _strings()
+            , _traces(0)
+        {
+        }
+        ~TraceDecoder()
+        {
+        }
+
+    public:
+        inline uint32_t Traces() const
+        {
+            return (_traces);
+        }
+        // Decodes one file of a rotation set and writes it out in the same format as the console output of the
+        // TraceControl plugin. Returns false if the file is not a binary trace file or is corrupt.
+        bool Decode(const string& fileName)
+        {
+            std::ifstream file(fileName, std::ios::binary);
+            std::vector<uint8_t> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            bool result = false;
+
+            // Every file starts with its own string table.
+            _strings.clear();
+
+            if ((content.size() >= TraceFile::HeaderSize) && (::memcmp(content.data(), TraceFile::Magic, sizeof(TraceFile::Magic)) == 0)) {
+                uint16_t version;
+                ::memcpy(&version, &content[sizeof(TraceFile::Magic)], sizeof(version));
+
+                if (version != TraceFile::Version) {
+                    fprintf(stderr, "%s: unsupported version %d.\n", fileName.c_str(), version);
+                } else {
+                    uint32_t offset = TraceFile::HeaderSize;
+
+                    result = true;
+
+                    while ((result == true) && (offset < content.size()) && (content[offset] != TraceFile::END)) {
+                        uint32_t size = 0;
+
+                        if (content[offset] == TraceFile::STRING) {
+                            size = DecodeString(&content[offset], static_cast<uint32_t>(content.size()) - offset);
+                        } else if (content[offset] == TraceFile::TRACE) {
+                            size = DecodeTrace(&content[offset], static_cast<uint32_t>(content.size()) - offset);
+                        }
+
+                        if (size == 0) {
+                            fprintf(stderr, "%s: corrupt entry at offset %d.\n", fileName.c_str(), offset);
+                            result = false;
+                        } else {
+                            offset += size;
+                        }
+                    }
+                }
+            } else {
+                fprintf(stderr, "%s: not a binary trace file.\n", fileName.c_str());
+            }
+
+            return (result);
+        }
+
+    private:
+        uint32_t DecodeString(const uint8_t entry[], const uint32_t available)
+        {
+            uint32_t result = 0;
+
+            if (available >= TraceFile::StringHeaderSize) {
+                uint16_t id, length;
+                ::memcpy(&id, &entry[1], sizeof(id));
+                ::memcpy(&length, &entry[3], sizeof(length));
+
+                if (((TraceFile::StringHeaderSize + length) <= available) && (id == _strings.size())) {
+                    _strings.emplace_back(reinterpret_cast<const char*>(&entry[TraceFile::StringHeaderSize]), length);
+                    result = TraceFile::StringHeaderSize + length;
+                }
+            }
+
+            return (result);
+        }
+        uint32_t DecodeTrace(const uint8_t entry[], const uint32_t available)
+        {
+            uint32_t result = 0;
+
+            if (available >= TraceFile::TraceHeaderSize) {
+                uint64_t timestamp;
+                uint32_t lineNumber;
+                uint16_t file, module, category, className, length;
+
+                ::memcpy(&timestamp, &entry[1], sizeof(timestamp));
+                ::memcpy(&lineNumber, &entry[9], sizeof(lineNumber));
+                ::memcpy(&file, &entry[13], sizeof(file));
+                ::memcpy(&module, &entry[15], sizeof(module));
+                ::memcpy(&category, &entry[17], sizeof(category));
+                ::memcpy(&className, &entry[19], sizeof(className));
+                ::memcpy(&length, &entry[21], sizeof(length));
+
+                if (((TraceFile::TraceHeaderSize + length) <= available) && (file < _strings.size()) && (module < _strings.size()) && (category < _strings.size()) && (className < _strings.size())) {
+                    string time(Core::Time(timestamp).ToRFC1123(true));
+                    string information(reinterpret_cast<const char*>(&entry[TraceFile::TraceHeaderSize]), length);
+
+                    fprintf(_output, "[%s]:[%s:%d] %s: %s\n", time.c_str(), _strings[file].c_str(), lineNumber, _strings[category].c_str(), information.c_str());
+
+                    _traces++;
+                    result = TraceFile::TraceHeaderSize + length;
+                }
+            }
+
+            return (result);
+        }
+
+    private:
+        FILE* _output;
+        std::vector<string> _strings;
+        uint32_t _traces;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    int result = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <binary trace file> [<binary trace file> ...]\n", argv[0]);
+        fprintf(stderr, "Pass the files of a rotation set oldest first, e.g.:\n");
+        fprintf(stderr, "   %s traces.bin.2 traces.bin.1 traces.bin\n", argv[0]);
+        result = 1;
+    } else {
+        TraceDecoder decoder(stdout);
+
+        for (int index = 1; index < argc; index++) {
+            if (decoder.Decode(argv[index]) == false) {
+                result = 1;
+            }
+        }
+
+        fprintf(stderr, "Decoded %d traces.\n", decoder.Traces());
+    }
+
+    Core::Singleton::Dispose();
+
+    return (result);
+}
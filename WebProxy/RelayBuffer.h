@@ -0,0 +1,183 @@
+#ifndef __PLUGINWEBPROXY_RELAYBUFFER_H
+#define __PLUGINWEBPROXY_RELAYBUFFER_H
+
+#include "Module.h"
+
+#include <atomic>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Carries the data of one direction of a relay, from one thread writing to one thread reading, without
+    // a lock. It is a chain of blocks: the writer adds a block when the last one is full, as long as less than
+    // the maximum is pending, and the reader drops a block once it read all of it. So it grows with a burst
+    // and shrinks again after, instead of stalling on a fixed window. A read gathers from as many blocks as
+    // needed, straight into the frame to send.
+    class RelayBuffer {
+    private:
+        RelayBuffer() = delete;
+        RelayBuffer(const RelayBuffer&) = delete;
+        RelayBuffer& operator=(const RelayBuffer&) = delete;
+
+        class Block {
+        private:
+            Block() = delete;
+            Block(const Block&) = delete;
+            Block& operator=(const Block&) = delete;
+
+        public:
+            Block(const uint32_t size)
+                : Next(nullptr)
+                , Written(0)
+                , Size(size)
+                , Data(new uint8_t[size])
+            {
+            }
+            ~Block()
+            {
+                delete[] Data;
+            }
+
+        public:
+            std::atomic<Block*> Next;
+            std::atomic<uint32_t> Written;
+            const uint32_t Size;
+            uint8_t* Data;
+        };
+
+    public:
+        RelayBuffer(const uint32_t blockSize, const uint32_t maximum)
+            : _blockSize(blockSize)
+            , _maximum(maximum)
+            , _head(new Block(blockSize))
+            , _tail(_head)
+            , _read(0)
+            , _written(0)
+            , _consumed(0)
+            , _spare(nullptr)
+        {
+            ASSERT((blockSize != 0) && (maximum != 0));
+        }
+        ~RelayBuffer()
+        {
+            while (_head != nullptr) {
+                Block* next = _head->Next.load();
+                delete _head;
+                _head = next;
+            }
+
+            delete _spare.load();
+        }
+
+    public:
+        inline bool IsEmpty() const
+        {
+            return (Pending() == 0);
+        }
+        inline uint32_t Pending() const
+        {
+            // The reader may already have consumed what the writer is still to account for.
+            const uint64_t consumed = _consumed.load(std::memory_order_acquire);
+            const uint64_t written = _written.load(std::memory_order_acquire);
+
+            return (written > consumed ? static_cast<uint32_t>(written - consumed) : 0);
+        }
+
+        // Only to be called by the writer. Returns how much was taken, which is less than offered if the maximum
+        // is reached. wasEmpty tells if there was nothing pending for the reader before.
+        uint32_t Write(const uint8_t data[], const uint32_t length, bool& wasEmpty)
+        {
+            uint32_t written = 0;
+
+            wasEmpty = false;
+
+            while (written < length) {
+                const uint64_t total = _written.load(std::memory_order_relaxed);
+                const uint64_t consumed = _consumed.load(std::memory_order_acquire);
+                const uint32_t pending = static_cast<uint32_t>(total - consumed);
+                const uint32_t used = _tail->Written.load(std::memory_order_relaxed);
+
+                if (pending >= _maximum) {
+                    break;
+                } else if (used == _tail->Size) {
+                    // Full, chain a block, reuse the one the reader dropped last if there is one.
+                    Block* next = _spare.exchange(nullptr, std::memory_order_acquire);
+
+                    if (next == nullptr) {
+                        next = new Block(_blockSize);
+                    } else {
+                        next->Next.store(nullptr, std::memory_order_relaxed);
+                        next->Written.store(0, std::memory_order_relaxed);
+                    }
+
+                    _tail->Next.store(next);
+                    _tail = next;
+                } else {
+                    const uint32_t chunk = std::min(std::min(length - written, _tail->Size - used), _maximum - pending);
+
+                    ::memcpy(&(_tail->Data[used]), &(data[written]), chunk);
+                    _tail->Written.store(used + chunk);
+                    _written.store(total + chunk, std::memory_order_release);
+
+                    // If the reader had everything before this, it might not be looking anymore. Publishing first
+                    // and then checking (the reader does the opposite) makes sure one of us sees the other.
+                    if (_consumed.load() >= total) {
+                        wasEmpty = true;
+                    }
+
+                    written += chunk;
+                }
+            }
+
+            return (written);
+        }
+
+        // Only to be called by the reader. Returns how much was copied into data.
+        uint32_t Read(uint8_t data[], const uint32_t length)
+        {
+            uint32_t read = 0;
+
+            while (read < length) {
+                const uint32_t available = _head->Written.load() - _read;
+
+                if (available != 0) {
+                    const uint32_t chunk = std::min(available, length - read);
+
+                    ::memcpy(&(data[read]), &(_head->Data[_read]), chunk);
+                    _read += chunk;
+                    read += chunk;
+
+                    _consumed.fetch_add(chunk);
+                } else if (_read == _head->Size) {
+                    // All of this block is read, continue with the next one, if the writer chained one.
+                    Block* next = _head->Next.load();
+
+                    if (next == nullptr) {
+                        break;
+                    }
+
+                    delete _spare.exchange(_head, std::memory_order_acq_rel);
+                    _head = next;
+                    _read = 0;
+                } else {
+                    break;
+                }
+            }
+
+            return (read);
+        }
+
+    private:
+        const uint32_t _blockSize;
+        const uint32_t _maximum;
+        Block* _head; // reader
+        Block* _tail; // writer
+        uint32_t _read; // reader, in the head block
+        std::atomic<uint64_t> _written; // writer, in total
+        std::atomic<uint64_t> _consumed; // reader, in total
+        std::atomic<Block*> _spare;
+    };
+}
+}
+
+#endif // __PLUGINWEBPROXY_RELAYBUFFER_H
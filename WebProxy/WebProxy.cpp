@@ -158,18 +158,15 @@ namespace Plugin {
 #ifdef __WINDOWS__
 #pragma warning(disable : 4355)
 #endif
-        inline ConnectorWrapper(PluginHost::Channel& channel, const uint32_t bufferSize)
-            : WebProxy::Connector(channel, &_streamType)
-            , _streamType(*this, bufferSize)
-        {
-        }
-        inline ConnectorWrapper(PluginHost::Channel& channel, const uint32_t bufferSize, const Core::NodeId& remoteId)
-            : WebProxy::Connector(channel, &_streamType)
+        inline ConnectorWrapper(PluginHost::Channel& channel, const uint32_t relaySize, const uint32_t maxRelaySize, const uint32_t bufferSize, const Core::NodeId& remoteId)
+            : WebProxy::Connector(channel, &_streamType, relaySize, maxRelaySize)
             , _streamType(*this, bufferSize, remoteId)
         {
         }
         inline ConnectorWrapper(
             PluginHost::Channel& channel,
+            const uint32_t relaySize,
+            const uint32_t maxRelaySize,
             const uint32_t bufferSize,
             const string& deviceName,
             const Core::SerialPort::BaudRate baudrate,
@@ -177,7 +174,7 @@ namespace Plugin {
             const Core::SerialPort::DataBits dataBits,
             const Core::SerialPort::StopBits stopBits,
             const Core::SerialPort::FlowControl flowControl)
-            : WebProxy::Connector(channel, &_streamType)
+            : WebProxy::Connector(channel, &_streamType, relaySize, maxRelaySize)
             , _streamType(*this, bufferSize, deviceName, baudrate, parityE, dataBits, stopBits, flowControl)
         {
         }
@@ -206,6 +203,8 @@ namespace Plugin {
         config.FromString(service->ConfigLine());
 
         _maxConnections = config.Connections.Value();
+        _bufferSize = std::max(config.BufferSize.Value(), static_cast<uint32_t>(1024));
+        _maxBufferSize = std::max(config.MaxBufferSize.Value(), _bufferSize);
 
         // Copy all predefined links...
         if ((config.Links.IsSet() == true) && (config.Links.Length() != 0)) {
@@ -376,12 +375,12 @@ namespace Plugin {
             Core::NodeId remote(host.Text().c_str());
 
             if (datagram == true) {
-                result = new ConnectorWrapper<DatagramChannel>(channel, 1024, remote);
+                result = new ConnectorWrapper<DatagramChannel>(channel, _bufferSize, _maxBufferSize, 1024, remote);
             } else {
-                result = new ConnectorWrapper<StreamChannel>(channel, 1024, remote);
+                result = new ConnectorWrapper<StreamChannel>(channel, _bufferSize, _maxBufferSize, 1024, remote);
             }
         } else if ((device.Length() > 0) && (host.Length() == 0)) {
-            result = new ConnectorWrapper<DeviceChannel>(channel, 1024, device.Text(), baudRate, parity, dataBits, stopBits, flowControl);
+            result = new ConnectorWrapper<DeviceChannel>(channel, _bufferSize, _maxBufferSize, 1024, device.Text(), baudRate, parity, dataBits, stopBits, flowControl);
         }
 
         if ((result != nullptr) && (text == true)) {
@@ -2,6 +2,7 @@
 #define __PLUGINWEBPROXY_H
 
 #include "Module.h"
+#include "RelayBuffer.h"
 
 namespace WPEFramework {
 namespace Plugin {
@@ -18,12 +19,14 @@ namespace Plugin {
             Connector& operator=(const Connector&) = delete;
 
         public:
-            Connector(PluginHost::Channel& channel, Core::IStream* link)
+            // The data path between the link and the channel takes no lock, every direction has one writer and
+            // one reader. The lock only guards the channel, when one side has to wake up the other.
+            Connector(PluginHost::Channel& channel, Core::IStream* link, const uint32_t bufferSize, const uint32_t maxBufferSize)
                 : _link(link)
                 , _channel(&channel)
                 , _adminLock()
-                , _channelBuffer()
-                , _socketBuffer()
+                , _channelBuffer(bufferSize, maxBufferSize)
+                , _socketBuffer(bufferSize, maxBufferSize)
             {
             }
             virtual ~Connector()
@@ -55,59 +58,45 @@ namespace Plugin {
             // Methods to extract and insert data into the socket buffers
             uint16_t SendData(uint8_t* dataFrame, const uint16_t maxSendSize)
             {
-                _adminLock.Lock();
-
-                uint16_t result = _socketBuffer.Read(dataFrame, maxSendSize);
-
-                _adminLock.Unlock();
-
-                return (result);
+                return (static_cast<uint16_t>(_socketBuffer.Read(dataFrame, maxSendSize)));
             }
 
             uint16_t ReceiveData(uint8_t* dataFrame, const uint16_t receivedSize)
             {
-                _adminLock.Lock();
-
-                bool wasEmpty = _channelBuffer.IsEmpty();
+                bool wasEmpty;
 
-                uint16_t result = _channelBuffer.Write(dataFrame, receivedSize);
+                uint16_t result = static_cast<uint16_t>(_channelBuffer.Write(dataFrame, receivedSize, wasEmpty));
 
                 if (wasEmpty == true) {
                     // This is new data, there was nothing pending, trigger a request for a frambuffer.
-                    _channel->RequestOutbound();
-                }
+                    _adminLock.Lock();
 
-                _adminLock.Unlock();
+                    if (_channel != nullptr) {
+                        _channel->RequestOutbound();
+                    }
+
+                    _adminLock.Unlock();
+                }
 
                 return (result);
             }
 
             uint16_t ChannelSend(uint8_t* dataFrame, const uint16_t maxSendSize) const
             {
-                _adminLock.Lock();
-
-                uint16_t result = _channelBuffer.Read(dataFrame, maxSendSize);
-
-                _adminLock.Unlock();
-
-                return (result);
+                return (static_cast<uint16_t>(_channelBuffer.Read(dataFrame, maxSendSize)));
             }
 
             uint16_t ChannelReceive(const uint8_t* dataFrame, const uint16_t receivedSize)
             {
-                _adminLock.Lock();
-
-                bool wasEmpty = _socketBuffer.IsEmpty();
+                bool wasEmpty;
 
-                uint16_t result = _socketBuffer.Write(dataFrame, receivedSize);
+                uint16_t result = static_cast<uint16_t>(_socketBuffer.Write(dataFrame, receivedSize, wasEmpty));
 
                 if (wasEmpty == true) {
                     // This is new data, there was nothing pending, trigger a request for a frambuffer.
                     _link->Trigger();
                 }
 
-                _adminLock.Unlock();
-
                 return (result);
             }
 
@@ -142,8 +131,8 @@ namespace Plugin {
             Core::IStream* _link;
             PluginHost::Channel* _channel;
             mutable Core::CriticalSection _adminLock;
-            Core::CyclicDataBuffer<Core::ScopedStorage<8192>> _channelBuffer;
-            Core::CyclicDataBuffer<Core::ScopedStorage<8192>> _socketBuffer;
+            mutable RelayBuffer _channelBuffer; // link to channel
+            RelayBuffer _socketBuffer; // channel to link
         };
         class Config : public Core::JSON::Container {
         public:
@@ -299,8 +288,12 @@ namespace Plugin {
             Config()
                 : Core::JSON::Container()
                 , Connections(10)
+                , BufferSize(8 * 1024)
+                , MaxBufferSize(1024 * 1024)
             {
                 Add(_T("connections"), &Connections);
+                Add(_T("buffersize"), &BufferSize);
+                Add(_T("maxbuffersize"), &MaxBufferSize);
                 Add(_T("links"), &Links);
             }
             ~Config()
@@ -309,12 +302,17 @@ namespace Plugin {
 
         public:
             Core::JSON::DecUInt16 Connections;
+            Core::JSON::DecUInt32 BufferSize; // the relay buffers grow by this
+            Core::JSON::DecUInt32 MaxBufferSize; // per direction
             Core::JSON::ArrayType<Link> Links;
         };
 
     public:
         WebProxy()
-            : _connectionMap()
+            : _maxConnections(0)
+            , _bufferSize(0)
+            , _maxBufferSize(0)
+            , _connectionMap()
         {
         }
         virtual ~WebProxy()
@@ -370,6 +368,8 @@ namespace Plugin {
     private:
         string _prefix;
         uint32_t _maxConnections;
+        uint32_t _bufferSize;
+        uint32_t _maxBufferSize;
         std::map<const uint32_t, Connector*> _connectionMap;
         std::map<const string, Config::Link> _linkInfo;
     };
@@ -0,0 +1,320 @@
+// Measures the relay path of a WebProxy connector at buffer level: one thread writes a stream into the buffer as
+// the link (or the channel) does, another one reads it out in frames as the other side does. The RelayBuffer the
+// connector uses is compared with the fixed 8 KiB window guarded by a lock it used before.
+// The reader waits when there is nothing to read, and is woken by the writer when it reports the buffer was empty,
+// as RequestOutbound()/Trigger() do in the connector. A wait that times out while data is pending is a lost
+// wake-up. Every write carries the time it was made, so the reader can tell how long the data was underway, and a
+// byte pattern, so it can tell the stream arrived intact.
+// No socket is involved, the numbers leave out the network stack and the websocket framing.
+
+#include "../Module.h"
+#include "../RelayBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+using namespace WPEFramework;
+
+namespace {
+
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr uint32_t BlockSize = 8 * 1024; // WebProxy "buffersize" default
+    static constexpr uint32_t MaxBufferSize = 1024 * 1024; // WebProxy "maxbuffersize" default
+    static constexpr uint32_t WriteSize = 1024;
+    static constexpr uint32_t FrameSize = 1448; // What a TCP segment typically carries.
+
+    // The connector as it was: a fixed window, every access under one lock.
+    class Window {
+    private:
+        Window(const Window&) = delete;
+        Window& operator=(const Window&) = delete;
+
+    public:
+        Window()
+            : _adminLock()
+            , _buffer()
+        {
+        }
+        ~Window()
+        {
+        }
+
+    public:
+        uint32_t Write(const uint8_t data[], const uint32_t length, bool& wasEmpty)
+        {
+            _adminLock.Lock();
+
+            wasEmpty = _buffer.IsEmpty();
+
+            uint32_t result = _buffer.Write(data, length);
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        uint32_t Read(uint8_t data[], const uint32_t length)
+        {
+            _adminLock.Lock();
+
+            uint32_t result = _buffer.Read(data, length);
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
+    private:
+        Core::CriticalSection _adminLock;
+        Core::CyclicDataBuffer<Core::ScopedStorage<8192>> _buffer;
+    };
+
+    class Scenario {
+    public:
+        const char* Name;
+        uint64_t Total; // bytes
+        uint32_t Rate; // bytes per second the writer offers, 0 is as fast as it can
+        uint32_t PauseEvery; // bytes the reader reads before it pauses, 0 is never
+        uint32_t Pause; // milliseconds
+    };
+
+    class Result {
+    public:
+        Result()
+            : Throughput(0.0)
+            , Median(0)
+            , Tail(0)
+            , Stalled(0)
+            , LostWakeUps(0)
+            , Corrupt(false)
+        {
+        }
+
+    public:
+        double Throughput; // MiB/s
+        uint64_t Median; // us
+        uint64_t Tail; // us, 99th percentile
+        uint64_t Stalled; // ms the writer waited for room
+        uint32_t LostWakeUps;
+        bool Corrupt;
+    };
+
+    // Wakes the reader, like the connector asks the other side for a frame to fill.
+    class Signal {
+    private:
+        Signal(const Signal&) = delete;
+        Signal& operator=(const Signal&) = delete;
+
+    public:
+        Signal()
+            : _lock()
+            , _condition()
+            , _set(false)
+        {
+        }
+        ~Signal()
+        {
+        }
+
+    public:
+        void Set()
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _set = true;
+            _condition.notify_one();
+        }
+        // Returns false if nobody signalled within the time given.
+        bool Wait(const uint32_t milliseconds)
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            bool result = _condition.wait_for(guard, std::chrono::milliseconds(milliseconds), [this]() { return (_set); });
+            _set = false;
+            return (result);
+        }
+
+    private:
+        std::mutex _lock;
+        std::condition_variable _condition;
+        bool _set;
+    };
+
+    inline uint64_t Now()
+    {
+        return (static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count()));
+    }
+
+    // Every write: the time it was made (8 bytes), followed by the low byte of the stream position of every byte.
+    void Fill(uint8_t data[], const uint64_t position, const uint64_t stamp)
+    {
+        ::memcpy(data, &stamp, sizeof(stamp));
+
+        for (uint32_t index = sizeof(stamp); index < WriteSize; index++) {
+            data[index] = static_cast<uint8_t>(position + index);
+        }
+    }
+
+    template <typename BUFFER>
+    void Writer(BUFFER& buffer, Signal& signal, const Scenario& scenario, Result& result)
+    {
+        uint8_t data[WriteSize];
+        uint64_t position = 0;
+        const Clock::time_point start(Clock::now());
+
+        while (position < scenario.Total) {
+            if (scenario.Rate != 0) {
+                // Offer the data no faster than the rate asked for.
+                const Clock::time_point due(start + std::chrono::microseconds((position * 1000000) / scenario.Rate));
+
+                if (Clock::now() < due) {
+                    std::this_thread::sleep_until(due);
+                }
+            }
+
+            Fill(data, position, Now());
+
+            uint32_t offset = 0;
+
+            while (offset < WriteSize) {
+                bool wasEmpty;
+                const uint32_t written = buffer.Write(&(data[offset]), WriteSize - offset, wasEmpty);
+
+                if (wasEmpty == true) {
+                    signal.Set();
+                }
+
+                offset += written;
+
+                if (offset < WriteSize) {
+                    // No room left, wait for the reader to make some.
+                    const Clock::time_point stalled(Clock::now());
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    result.Stalled += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - stalled).count());
+                }
+            }
+
+            position += WriteSize;
+        }
+
+        result.Stalled /= 1000;
+    }
+
+    template <typename BUFFER>
+    void Reader(BUFFER& buffer, Signal& signal, const Scenario& scenario, Result& result, std::vector<uint32_t>& latencies)
+    {
+        uint8_t frame[FrameSize];
+        uint8_t write[WriteSize];
+        uint64_t position = 0;
+        uint64_t paused = 0;
+        bool timedOut = false;
+
+        while (position < scenario.Total) {
+            const uint32_t length = buffer.Read(frame, sizeof(frame));
+
+            if (length == 0) {
+                // Nothing pending, wait to be woken. The writer never idles for a second, so if the wait times out
+                // and there is data after all, the wake-up got lost.
+                timedOut = (signal.Wait(1000) == false);
+            } else {
+                if (timedOut == true) {
+                    result.LostWakeUps++;
+                    timedOut = false;
+                }
+
+                for (uint32_t index = 0; index < length; index++, position++) {
+                    const uint32_t offset = static_cast<uint32_t>(position % WriteSize);
+
+                    write[offset] = frame[index];
+
+                    if (offset >= sizeof(uint64_t)) {
+                        if (frame[index] != static_cast<uint8_t>(position)) {
+                            result.Corrupt = true;
+                        }
+                    } else if (offset == (sizeof(uint64_t) - 1)) {
+                        uint64_t stamp;
+                        ::memcpy(&stamp, write, sizeof(stamp));
+                        latencies.push_back(static_cast<uint32_t>(Now() - stamp));
+                    }
+                }
+
+                if ((scenario.PauseEvery != 0) && ((position - paused) >= scenario.PauseEvery)) {
+                    // A consumer that falls behind now and then, like a busy websocket peer.
+                    paused = position;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(scenario.Pause));
+                }
+            }
+        }
+    }
+
+    template <typename BUFFER>
+    Result Measure(BUFFER& buffer, const Scenario& scenario)
+    {
+        Result result;
+        Signal signal;
+        std::vector<uint32_t> latencies;
+
+        latencies.reserve(static_cast<size_t>(scenario.Total / WriteSize));
+
+        const Clock::time_point start(Clock::now());
+
+        std::thread reader([&]() { Reader(buffer, signal, scenario, result, latencies); });
+        Writer(buffer, signal, scenario, result);
+        reader.join();
+
+        const double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start).count();
+
+        result.Throughput = (static_cast<double>(scenario.Total) / (1024 * 1024)) / seconds;
+
+        if (latencies.empty() == false) {
+            std::sort(latencies.begin(), latencies.end());
+            result.Median = latencies[latencies.size() / 2];
+            result.Tail = latencies[(latencies.size() * 99) / 100];
+        }
+
+        return (result);
+    }
+
+    void Report(const char name[], const Result& result)
+    {
+        printf("  %-8s %10.1f %10llu %10llu %12llu %8d %s\n", name, result.Throughput,
+            static_cast<unsigned long long>(result.Median), static_cast<unsigned long long>(result.Tail),
+            static_cast<unsigned long long>(result.Stalled), result.LostWakeUps, (result.Corrupt == true ? "CORRUPT" : "ok"));
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    const uint64_t total = static_cast<uint64_t>(argc > 1 ? std::atoi(argv[1]) : 256) * 1024 * 1024;
+
+    const Scenario scenarios[] = {
+        { "unpaced", total, 0, 0, 0 },
+        { "50 MiB/s, reader pausing 2 ms every 4 MiB", total / 4, 50 * 1024 * 1024, 4 * 1024 * 1024, 2 }
+    };
+
+    bool intact = true;
+
+    printf("%d byte writes, %d byte reads\n", WriteSize, FrameSize);
+
+    for (const Scenario& scenario : scenarios) {
+        printf("\n%s, %llu MiB\n", scenario.Name, static_cast<unsigned long long>(scenario.Total / (1024 * 1024)));
+        printf("  %-8s %10s %10s %10s %12s %8s\n", "buffer", "MiB/s", "p50 us", "p99 us", "stalled ms", "lost");
+
+        Window window;
+        const Result old = Measure(window, scenario);
+        Report("window", old);
+
+        Plugin::RelayBuffer relay(BlockSize, MaxBufferSize);
+        const Result current = Measure(relay, scenario);
+        Report("relay", current);
+
+        intact = intact && (old.Corrupt == false) && (current.Corrupt == false);
+    }
+
+    Core::Singleton::Dispose();
+
+    return (intact == true ? 0 : 1);
+}
@@ -0,0 +1,562 @@
+#pragma once
+
+#include "Module.h"
+
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Sends (a range of) file content held by the FileCache. The body shares the cached buffer, so a hit does
+    // not copy the file and an eviction while the response is being sent does not pull the data away.
+    class CachedBody : public Web::IBody {
+    private:
+        CachedBody() = delete;
+        CachedBody(const CachedBody&) = delete;
+        CachedBody& operator=(const CachedBody&) = delete;
+
+    public:
+        CachedBody(const std::shared_ptr<const string>& content, const uint32_t offset, const uint32_t length)
+            : _content(content)
+            , _offset(offset)
+            , _length(length)
+            , _sent(0)
+        {
+            ASSERT(_content);
+            ASSERT((static_cast<uint64_t>(offset) + length) <= _content->length());
+        }
+        virtual ~CachedBody()
+        {
+        }
+
+    public:
+        virtual uint32_t Serialize() const override
+        {
+            _sent = 0;
+
+            return (_length);
+        }
+        virtual uint16_t Serialize(uint8_t stream[], const uint16_t maxLength) const override
+        {
+            uint16_t result = static_cast<uint16_t>(std::min(static_cast<uint32_t>(maxLength), _length - _sent));
+
+            if (result != 0) {
+                ::memcpy(stream, &((*_content)[_offset + _sent]), result);
+                _sent += result;
+            }
+
+            return (result);
+        }
+        virtual uint32_t Deserialize() override
+        {
+            return (0);
+        }
+        virtual uint16_t Deserialize(const uint8_t[], const uint16_t) override
+        {
+            return (0);
+        }
+        virtual void End() const override
+        {
+        }
+
+    private:
+        const std::shared_ptr<const string> _content;
+        const uint32_t _offset;
+        const uint32_t _length;
+        mutable uint32_t _sent;
+    };
+
+    // Sends one byte range of a file. The file is read ahead in blocks, so the socket, that takes small pieces
+    // at a time, does not cost a system call per piece.
+    // Once the headers are out, the length can not be taken back. If the file can no longer deliver it, because
+    // it shrunk or a read fails, the abort handler is called, it should close the connection so the client
+    // knows the response is incomplete.
+    class RangeBody : public Web::IBody {
+    private:
+        RangeBody() = delete;
+        RangeBody(const RangeBody&) = delete;
+        RangeBody& operator=(const RangeBody&) = delete;
+
+        static constexpr uint32_t BlockSize = 64 * 1024;
+
+    public:
+        enum range {
+            NONE,
+            SATISFIABLE,
+            UNSATISFIABLE
+        };
+
+    public:
+        RangeBody(const string& fileName, const uint64_t offset, const uint32_t length, const std::function<void()>& abort)
+            : _descriptor(::open(fileName.c_str(), O_RDONLY | O_CLOEXEC))
+            , _abort(abort)
+            , _offset(offset)
+            , _length(length)
+            , _block(std::min(length, static_cast<uint32_t>(BlockSize)))
+            , _read(0)
+            , _filled(0)
+            , _consumed(0)
+        {
+            if (_descriptor == -1) {
+                TRACE_L1("Could not open %s for a range request, error: %d", fileName.c_str(), errno);
+            }
+        }
+        virtual ~RangeBody()
+        {
+            if (_descriptor != -1) {
+                ::close(_descriptor);
+            }
+        }
+
+    public:
+        inline bool IsValid() const
+        {
+            return (_descriptor != -1);
+        }
+
+        // Parses a "bytes=" Range header against a file of the given size. Multiple ranges are answered with the
+        // single range spanning all of them, the framework has no multipart/byteranges content type to offer.
+        // A header that can not be parsed is ignored, as RFC 7233 requires, so the whole file is sent.
+        static range Parse(const string& header, const uint64_t size, uint64_t& offset, uint64_t& length)
+        {
+            static const TCHAR unit[] = _T("bytes=");
+
+            range result = NONE;
+
+            if (header.compare(0, sizeof(unit) - 1, unit) == 0) {
+                const string specs(header.substr(sizeof(unit) - 1));
+                Core::TextSegmentIterator index(Core::TextFragment(specs), false, ',');
+                uint64_t first = ~static_cast<uint64_t>(0);
+                uint64_t last = 0;
+                bool valid = true;
+
+                while ((valid == true) && (index.Next() == true)) {
+                    string spec(Core::TextFragment(index.Current()).Text());
+                    size_t begin = spec.find_first_not_of(_T(" \t"));
+                    size_t dash = spec.find('-');
+                    uint64_t start, end;
+
+                    if ((begin == string::npos) || (dash == string::npos) || (dash < begin)) {
+                        valid = false;
+                    } else if (dash == begin) {
+                        // Suffix range, the last n bytes.
+                        uint64_t suffix;
+
+                        if ((valid = Number(spec.substr(dash + 1), suffix)) == true) {
+                            if ((suffix != 0) && (size != 0)) {
+                                start = size - std::min(suffix, size);
+                                first = std::min(first, start);
+                                last = std::max(last, size - 1);
+                                result = SATISFIABLE;
+                            }
+                        }
+                    } else if ((valid = Number(spec.substr(begin, dash - begin), start)) == true) {
+                        string tail(spec.substr(dash + 1));
+
+                        if (tail.find_first_not_of(_T(" \t")) == string::npos) {
+                            end = ~static_cast<uint64_t>(0);
+                        } else if ((valid = Number(tail, end)) == true) {
+                            valid = (end >= start);
+                        }
+
+                        if ((valid == true) && (start < size)) {
+                            first = std::min(first, start);
+                            last = std::max(last, std::min(end, size - 1));
+                            result = SATISFIABLE;
+                        }
+                    }
+                }
+
+                if (valid == false) {
+                    result = NONE;
+                } else if (result == NONE) {
+                    result = UNSATISFIABLE;
+                } else {
+                    // A body can hold at most 4GB, send what fits, Content-Range tells the client what it got.
+                    offset = first;
+                    length = std::min(last - first + 1, static_cast<uint64_t>(~static_cast<uint32_t>(0)));
+                }
+            }
+
+            return (result);
+        }
+
+        virtual uint32_t Serialize() const override
+        {
+            _read = 0;
+            _filled = 0;
+            _consumed = 0;
+
+            return (_length);
+        }
+        virtual uint16_t Serialize(uint8_t stream[], const uint16_t maxLength) const override
+        {
+            if ((_consumed == _filled) && (_read < _length) && (_descriptor != -1)) {
+                ssize_t size;
+
+                do {
+                    size = ::pread(_descriptor, _block.data(), std::min(static_cast<uint32_t>(_block.size()), _length - _read), _offset + _read);
+                } while ((size == -1) && (errno == EINTR));
+
+                if (size > 0) {
+                    _read += static_cast<uint32_t>(size);
+                    _filled = static_cast<uint32_t>(size);
+                    _consumed = 0;
+                } else {
+                    TRACE_L1("Range ends %u bytes short, error: %d", _length - _read, (size == 0 ? 0 : errno));
+
+                    ::close(_descriptor);
+                    _descriptor = -1;
+
+                    if (_abort) {
+                        _abort();
+                    }
+                }
+            }
+
+            uint16_t result = static_cast<uint16_t>(std::min(static_cast<uint32_t>(maxLength), _filled - _consumed));
+
+            if (result != 0) {
+                ::memcpy(stream, &(_block[_consumed]), result);
+                _consumed += result;
+            }
+
+            return (result);
+        }
+        virtual uint32_t Deserialize() override
+        {
+            return (0);
+        }
+        virtual uint16_t Deserialize(const uint8_t[], const uint16_t) override
+        {
+            return (0);
+        }
+        virtual void End() const override
+        {
+        }
+
+    private:
+        static bool Number(const string& text, uint64_t& value)
+        {
+            size_t start = text.find_first_not_of(_T(" \t"));
+            size_t end = text.find_last_not_of(_T(" \t"));
+            bool result = ((start != string::npos) && (text.find_first_not_of(_T("0123456789"), start) > end));
+
+            if (result == true) {
+                value = ::strtoull(text.c_str() + start, nullptr, 10);
+            }
+
+            return (result);
+        }
+
+    private:
+        mutable int _descriptor;
+        const std::function<void()> _abort;
+        const uint64_t _offset;
+        const uint32_t _length;
+        mutable std::vector<uint8_t> _block;
+        mutable uint32_t _read;
+        mutable uint32_t _filled;
+        mutable uint32_t _consumed;
+    };
+
+    // Receives a PUT/POST body straight into a file. The body is collected in blocks that are written as soon as
+    // they are full, so the memory used does not depend on the size of the upload. The data goes into a
+    // temporary file of its own (<file>.XXXXXX) first, only a complete upload replaces the file itself. Concurrent
+    // uploads to the same file do not share anything, the last one to complete wins.
+    class UploadBody : public Web::IBody {
+    private:
+        UploadBody() = delete;
+        UploadBody(const UploadBody&) = delete;
+        UploadBody& operator=(const UploadBody&) = delete;
+
+        static constexpr uint32_t BlockSize = 64 * 1024;
+
+    public:
+        enum state {
+            RECEIVING,
+            COMPLETED,
+            TOO_LARGE,
+            FAILED
+        };
+
+    public:
+        // limit: maximum size of the upload in bytes, 0 means unlimited.
+        UploadBody(const string& fileName, const uint64_t limit)
+            : _fileName(fileName)
+            , _partName()
+            , _limit(limit)
+            , _descriptor(-1)
+            , _block(BlockSize)
+            , _filled(0)
+            , _written(0)
+            , _state(FAILED)
+        {
+        }
+        virtual ~UploadBody()
+        {
+            if (_descriptor != -1) {
+                // Never completed, do not leave the partial file behind.
+                ::close(_descriptor);
+                ::unlink(_partName.c_str());
+            }
+        }
+
+    public:
+        inline state State() const
+        {
+            return (_state);
+        }
+        inline uint64_t Size() const
+        {
+            return (_written);
+        }
+
+        virtual uint32_t Serialize() const override
+        {
+            return (0);
+        }
+        virtual uint16_t Serialize(uint8_t[], const uint16_t) const override
+        {
+            return (0);
+        }
+        virtual uint32_t Deserialize() override
+        {
+            string directory(Core::File::PathName(_fileName));
+
+            _filled = 0;
+            _written = 0;
+
+            if ((directory.empty() == false) && (Core::Directory(directory.c_str()).CreatePath() == false)) {
+                TRACE_L1("Could not create the upload directory %s", directory.c_str());
+                _state = FAILED;
+            } else {
+                std::vector<char> name(_fileName.begin(), _fileName.end());
+                static const char suffix[] = ".XXXXXX";
+
+                name.insert(name.end(), suffix, suffix + sizeof(suffix));
+
+                if ((_descriptor = ::mkostemp(name.data(), O_CLOEXEC)) == -1) {
+                    TRACE_L1("Could not create upload file for %s, error: %d", _fileName.c_str(), errno);
+                    _state = FAILED;
+                } else {
+                    _partName = name.data();
+
+                    // mkostemp only grants access to the owner, the file is served once complete.
+                    ::fchmod(_descriptor, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+                    _state = RECEIVING;
+                }
+            }
+
+            return (0);
+        }
+        virtual uint16_t Deserialize(const uint8_t stream[], const uint16_t maxLength) override
+        {
+            if (_state == RECEIVING) {
+                if ((_limit != 0) && ((_written + _filled + maxLength) > _limit)) {
+                    _state = TOO_LARGE;
+                } else {
+                    uint16_t handled = 0;
+
+                    while ((handled < maxLength) && (_state == RECEIVING)) {
+                        uint32_t size = std::min(static_cast<uint32_t>(maxLength - handled), BlockSize - _filled);
+
+                        ::memcpy(&(_block[_filled]), &(stream[handled]), size);
+                        _filled += size;
+                        handled += static_cast<uint16_t>(size);
+
+                        if (_filled == BlockSize) {
+                            Flush();
+                        }
+                    }
+                }
+            }
+
+            // Whatever happens, the body is taken, the request has to be read completely before we can answer it.
+            return (maxLength);
+        }
+        virtual void End() const override
+        {
+            if (_descriptor != -1) {
+                if (_state == RECEIVING) {
+                    Flush();
+                }
+
+                bool stored = ((_state == RECEIVING) && (::fdatasync(_descriptor) == 0));
+
+                ::close(_descriptor);
+                _descriptor = -1;
+
+                if ((stored == true) && (::rename(_partName.c_str(), _fileName.c_str()) == 0)) {
+                    _state = COMPLETED;
+                } else {
+                    if (_state == RECEIVING) {
+                        TRACE_L1("Could not store upload %s, error: %d", _fileName.c_str(), errno);
+                        _state = FAILED;
+                    }
+                    ::unlink(_partName.c_str());
+                }
+            }
+        }
+
+    private:
+        void Flush() const
+        {
+            uint32_t offset = 0;
+
+            while ((offset < _filled) && (_state == RECEIVING)) {
+                ssize_t size = ::write(_descriptor, &(_block[offset]), _filled - offset);
+
+                if (size > 0) {
+                    offset += static_cast<uint32_t>(size);
+                } else if ((size == 0) || (errno != EINTR)) {
+                    TRACE_L1("Could not write upload %s, error: %d", _partName.c_str(), errno);
+                    _state = FAILED;
+                }
+            }
+
+            _written += offset;
+            _filled = 0;
+        }
+
+    private:
+        const string _fileName;
+        string _partName;
+        const uint64_t _limit;
+        mutable int _descriptor;
+        mutable std::vector<uint8_t> _block;
+        mutable uint32_t _filled;
+        mutable uint64_t _written;
+        mutable state _state;
+    };
+
+    // Passes the body of a proxied response on while it is still coming in. The upstream connection fills it and
+    // the client connection drains it, so the response goes out as soon as its headers are in, and what was sent
+    // is released right away. When the client connection found nothing to send, it stops asking, so wake is
+    // called once new data arrives. If the upstream connection is lost before the body is complete, the abort
+    // handler is called once everything received is sent, it should close the client connection so the client
+    // knows the response is incomplete.
+    class ProxyBody : public Web::IBody {
+    private:
+        ProxyBody() = delete;
+        ProxyBody(const ProxyBody&) = delete;
+        ProxyBody& operator=(const ProxyBody&) = delete;
+
+    public:
+        ProxyBody(const uint32_t length, const std::function<void()>& wake, const std::function<void()>& abort)
+            : _lock()
+            , _wake(wake)
+            , _abort(abort)
+            , _length(length)
+            , _data()
+            , _read(0)
+            , _received(0)
+            , _waiting(false)
+            , _cut(false)
+        {
+        }
+        virtual ~ProxyBody()
+        {
+        }
+
+    public:
+        // The upstream connection is gone, whatever did not arrive yet never will.
+        void Cut()
+        {
+            bool wake = false;
+
+            _lock.Lock();
+
+            if (_received < _length) {
+                _cut = true;
+                wake = _waiting;
+                _waiting = false;
+            }
+
+            _lock.Unlock();
+
+            if ((wake == true) && (_wake)) {
+                _wake();
+            }
+        }
+
+        virtual uint32_t Serialize() const override
+        {
+            return (_length);
+        }
+        virtual uint16_t Serialize(uint8_t stream[], const uint16_t maxLength) const override
+        {
+            bool aborted = false;
+
+            _lock.Lock();
+
+            uint16_t result = static_cast<uint16_t>(std::min(static_cast<size_t>(maxLength), _data.length() - _read));
+
+            if (result != 0) {
+                ::memcpy(stream, &(_data[_read]), result);
+                _read += result;
+
+                if (_read == _data.length()) {
+                    _data.clear();
+                    _read = 0;
+                }
+            } else if (_cut == true) {
+                _cut = false;
+                aborted = true;
+            } else {
+                _waiting = true;
+            }
+
+            _lock.Unlock();
+
+            if ((aborted == true) && (_abort)) {
+                _abort();
+            }
+
+            return (result);
+        }
+        virtual uint32_t Deserialize() override
+        {
+            return (0);
+        }
+        virtual uint16_t Deserialize(const uint8_t stream[], const uint16_t maxLength) override
+        {
+            bool wake;
+
+            _lock.Lock();
+
+            _data.append(reinterpret_cast<const char*>(stream), maxLength);
+            _received += maxLength;
+            wake = _waiting;
+            _waiting = false;
+
+            _lock.Unlock();
+
+            if ((wake == true) && (_wake)) {
+                _wake();
+            }
+
+            return (maxLength);
+        }
+        virtual void End() const override
+        {
+        }
+
+    private:
+        mutable Core::CriticalSection _lock;
+        const std::function<void()> _wake;
+        const std::function<void()> _abort;
+        const uint32_t _length;
+        mutable string _data;
+        mutable size_t _read;
+        uint32_t _received;
+        mutable bool _waiting;
+        mutable bool _cut;
+    };
+}
+}
@@ -0,0 +1,564 @@
+#pragma once
+
+#include "Module.h"
+
+#include <fcntl.h>
+#include <memory>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef __WINDOWS__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Keeps the content of small, frequently requested files in memory. Once the memory budget is exceeded, the
+    // least recently used files are evicted. Files bigger than the limit are never loaded, for those only the
+    // validators (ETag, modification time) are kept so conditional requests can still be answered.
+    // Every directory that holds a cached file is watched through inotify, a change to a file drops its entry.
+    // Files found missing in a watched directory are remembered as such, so probing for precompressed siblings
+    // (<file>.br, <file>.gz) does not cost a stat per request.
+    // Without inotify (Windows) nothing is cached, every file is left to the FileBody.
+#ifdef __WINDOWS__
+    class FileCache {
+#else
+    class FileCache : public Core::IResource {
+#endif
+    public:
+        class Entry {
+        public:
+            Entry()
+                : ETag()
+                , Modified()
+                , Size(0)
+                , Content()
+            {
+            }
+            Entry(const Entry& copy)
+                : ETag(copy.ETag)
+                , Modified(copy.Modified)
+                , Size(copy.Size)
+                , Content(copy.Content)
+            {
+            }
+            ~Entry()
+            {
+            }
+
+            Entry& operator=(const Entry& rhs)
+            {
+                ETag = rhs.ETag;
+                Modified = rhs.Modified;
+                Size = rhs.Size;
+                Content = rhs.Content;
+
+                return (*this);
+            }
+
+        public:
+            string ETag;
+            Core::Time Modified;
+            uint64_t Size;
+            // Empty if the file is too big to be cached, it should be streamed from disk.
+            std::shared_ptr<const string> Content;
+        };
+
+    private:
+        FileCache(const FileCache&) = delete;
+        FileCache& operator=(const FileCache&) = delete;
+
+        class Node {
+        public:
+            Node(const string& fileName, const Entry& entry)
+                : FileName(fileName)
+                , Info(entry)
+            {
+            }
+
+        public:
+            const string FileName;
+            const Entry Info;
+        };
+
+        typedef std::list<Node> LRUList;
+        typedef std::unordered_map<string, LRUList::iterator> Index;
+        typedef std::unordered_map<int, string> Watches;
+        typedef std::unordered_set<string> Absent;
+
+        // Bounds the number of missing files we remember.
+        static constexpr uint16_t MaxAbsent = 1024;
+        // What an entry without content is charged against the budget, about what its node takes.
+        static constexpr uint32_t ValidatorsSize = 256;
+
+    public:
+        FileCache()
+            : _adminLock()
+            , _descriptor(-1)
+            , _budget(0)
+            , _limit(0)
+            , _used(0)
+            , _entries()
+            , _index()
+            , _watches()
+            , _absent()
+            , _generation(0)
+            , _hits(0)
+            , _misses(0)
+            , _compressed(0)
+            , _uncompressed(0)
+        {
+        }
+        virtual ~FileCache()
+        {
+#ifndef __WINDOWS__
+            if (_descriptor != -1) {
+                Core::ResourceMonitor::Instance().Unregister(*this);
+                ::close(_descriptor);
+                _descriptor = -1;
+            }
+#endif
+        }
+
+    public:
+        // budget: total amount of file content kept in memory, 0 disables caching
+        // limit: files bigger than this are served from disk
+        void Configure(const uint32_t budget, const uint32_t limit)
+        {
+            _budget = budget;
+            _limit = std::min(limit, budget);
+
+#ifdef __WINDOWS__
+            // No invalidation, so nothing can be cached safely.
+            _budget = 0;
+#else
+            if ((_budget != 0) && (_descriptor == -1)) {
+                _descriptor = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+                if (_descriptor == -1) {
+                    // Without invalidation we can not cache anything safely.
+                    TRACE_L1("Could not initialize inotify for the file cache, error: %d", errno);
+                    _budget = 0;
+                } else {
+                    Core::ResourceMonitor::Instance().Register(*this);
+                }
+            }
+#endif
+        }
+        // Returns false if there is no regular file with this name. The disk is read without holding the lock, a
+        // slow or big file must not hold up the lookups of other requests.
+        bool Find(const string& fileName, Entry& entry)
+        {
+#ifdef __WINDOWS__
+            return (false);
+#else
+            bool result = false;
+            bool known = false;
+            bool watched = false;
+            uint32_t generation = 0;
+
+            _adminLock.Lock();
+
+            Index::iterator index(_index.find(fileName));
+
+            if (index != _index.end()) {
+                // Move to the front, it is the most recently used one now.
+                _entries.splice(_entries.begin(), _entries, index->second);
+                entry = index->second->Info;
+                _hits++;
+                known = true;
+                result = true;
+            } else if (_absent.find(fileName) != _absent.end()) {
+                _hits++;
+                known = true;
+            } else {
+                _misses++;
+
+                // Watch the directory before the file is looked at, any change from here on drops what we load.
+                watched = ((_budget != 0) && (Watch(fileName) == true));
+                generation = _generation;
+            }
+
+            _adminLock.Unlock();
+
+            if (known == false) {
+                struct stat properties;
+                std::shared_ptr<string> content;
+                bool absent = false;
+                bool keep = false;
+                int descriptor = ::open(fileName.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+                if (descriptor == -1) {
+                    // Only a name that does not exist stays missing until the directory changes, running out of
+                    // descriptors or an interrupted call does not.
+                    absent = ((errno == ENOENT) || (errno == ENOTDIR));
+                } else if (::fstat(descriptor, &properties) == 0) {
+                    if (S_ISREG(properties.st_mode) == false) {
+                        absent = true;
+                    } else {
+                        result = true;
+
+                        if (watched == true) {
+                            if (static_cast<uint64_t>(properties.st_size) > _limit) {
+                                // Too big to hold, the validators still answer conditional requests.
+                                keep = true;
+                            } else {
+                                content.reset(new string());
+                                keep = Load(descriptor, properties, *content);
+
+                                if (keep == false) {
+                                    content.reset();
+                                }
+                            }
+                        }
+
+                        // The validators come from the same descriptor the content was read from.
+                        Validators(properties, entry);
+
+                        entry.Content = content;
+                    }
+                }
+
+                if (descriptor != -1) {
+                    ::close(descriptor);
+                }
+
+                if ((watched == true) && ((absent == true) || (keep == true))) {
+                    _adminLock.Lock();
+
+                    // A change seen since the directory got watched may be about this file, then it is not kept.
+                    // Another request may have loaded the same file in the mean time.
+                    if (generation == _generation) {
+                        if (absent == true) {
+                            if (_absent.size() >= MaxAbsent) {
+                                _absent.clear();
+                            }
+                            _absent.insert(fileName);
+                        } else if (_index.find(fileName) == _index.end()) {
+                            Insert(fileName, entry);
+                        }
+                    }
+
+                    _adminLock.Unlock();
+                }
+            }
+
+            return (result);
+#endif
+        }
+        // Looks for precompressed siblings of a file. If the client accepts the encoding of one, the file name and
+        // entry are replaced by those of the sibling and the encoding to report is returned. The return value tells
+        // if there are variants at all, if so the response depends on the Accept-Encoding of the request.
+        bool Variant(string& fileName, const string& accepted, Entry& entry, string& encoding)
+        {
+            static const TCHAR* const encodings[][2] = {
+                { _T("br"), _T(".br") },
+                { _T("gzip"), _T(".gz") }
+            };
+
+            const string original(fileName);
+            bool variants = false;
+            bool acceptsAny = false;
+
+            encoding.clear();
+
+            for (uint8_t index = 0; index < (sizeof(encodings) / sizeof(encodings[0])); index++) {
+                Entry candidate;
+
+                if (Find(original + encodings[index][1], candidate) == true) {
+                    variants = true;
+
+                    if (Accepts(accepted, encodings[index][0]) == true) {
+                        acceptsAny = true;
+
+                        if (encoding.empty() == true) {
+                            fileName = original + encodings[index][1];
+                            entry = candidate;
+                            encoding = encodings[index][0];
+                        }
+                    }
+                } else if ((acceptsAny == false) && (Accepts(accepted, encodings[index][0]) == true)) {
+                    acceptsAny = true;
+                }
+            }
+
+            _adminLock.Lock();
+            if (encoding.empty() == false) {
+                _compressed++;
+            } else if (acceptsAny == true) {
+                _uncompressed++;
+            }
+            _adminLock.Unlock();
+
+            return (variants);
+        }
+        // hits: lookups answered from memory, cached content or a file known to be absent
+        // misses: lookups that had to go to the disk
+        // compressed: requests served with a precompressed file
+        // uncompressed: requests that accepted compression, but no precompressed file was available
+        // used: bytes of file content held in memory, plus a fixed amount for every file held without content
+        void Statistics(uint32_t& hits, uint32_t& misses, uint32_t& compressed, uint32_t& uncompressed, uint32_t& used) const
+        {
+            _adminLock.Lock();
+
+            hits = _hits;
+            misses = _misses;
+            compressed = _compressed;
+            uncompressed = _uncompressed;
+            used = _used;
+
+            _adminLock.Unlock();
+        }
+        // If-None-Match holds a list of (possibly weak) tags or a '*'.
+        static bool Matches(const string& tags, const string& tag)
+        {
+            bool result = false;
+            Core::TextSegmentIterator index(Core::TextFragment(tags), false, ',');
+
+            while ((result == false) && (index.Next() == true)) {
+                string current(Core::TextFragment(index.Current()).Text());
+                size_t start = current.find_first_not_of(_T(" \t"));
+                size_t end = current.find_last_not_of(_T(" \t"));
+
+                if (start != string::npos) {
+                    current = current.substr(start, end - start + 1);
+
+                    // Weak comparison is allowed for If-None-Match, so drop the weak indicator.
+                    if (current.compare(0, 2, _T("W/")) == 0) {
+                        current = current.substr(2);
+                    }
+
+                    result = ((current == _T("*")) || (current == tag));
+                }
+            }
+
+            return (result);
+        }
+
+    private:
+        // Accept-Encoding is a list of encodings, each optionally weighted with a "q" parameter, q=0 means refused.
+        // An encoding listed by name takes precedence over the "*" entry, whatever their order.
+        static bool Accepts(const string& accepted, const TCHAR encoding[])
+        {
+            enum { UNLISTED, ACCEPTED, REFUSED } named(UNLISTED), any(UNLISTED);
+            Core::TextSegmentIterator index(Core::TextFragment(accepted), false, ',');
+
+            while ((named == UNLISTED) && (index.Next() == true)) {
+                string current(Core::TextFragment(index.Current()).Text());
+                size_t start = current.find_first_not_of(_T(" \t"));
+                size_t end = current.find_first_of(_T(" \t;"), start);
+
+                if (start != string::npos) {
+                    size_t quality = current.find(_T("q="), end);
+                    const bool acceptable((quality == string::npos) || (::atof(current.c_str() + quality + 2) > 0.0));
+
+                    if (current.compare(start, end - start, encoding) == 0) {
+                        named = (acceptable == true ? ACCEPTED : REFUSED);
+                    } else if ((any == UNLISTED) && (current.compare(start, end - start, _T("*")) == 0)) {
+                        any = (acceptable == true ? ACCEPTED : REFUSED);
+                    }
+                }
+            }
+
+            return (named != UNLISTED ? (named == ACCEPTED) : (any == ACCEPTED));
+        }
+#ifndef __WINDOWS__
+        virtual Core::IResource::handle Descriptor() const override
+        {
+            return (_descriptor);
+        }
+        virtual uint16_t Events() override
+        {
+            return (POLLIN);
+        }
+        virtual void Handle(const uint16_t events) override
+        {
+            if ((events & POLLIN) != 0) {
+                uint8_t buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+                ssize_t length;
+
+                while ((length = ::read(_descriptor, buffer, sizeof(buffer))) > 0) {
+                    ssize_t offset = 0;
+
+                    _adminLock.Lock();
+
+                    while (offset < length) {
+                        const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(&buffer[offset]);
+
+                        Changed(*event);
+
+                        offset += sizeof(struct inotify_event) + event->len;
+                    }
+
+                    _adminLock.Unlock();
+                }
+            }
+        }
+        void Changed(const struct inotify_event& event)
+        {
+            // Tells the lookups that are reading from disk right now that what they read may be outdated.
+            _generation++;
+
+            if ((event.mask & IN_Q_OVERFLOW) != 0) {
+                // Events were lost, nothing we hold can be trusted anymore.
+                Flush();
+            } else {
+                Watches::iterator watch(_watches.find(event.wd));
+
+                if (watch != _watches.end()) {
+                    if ((event.len != 0) && ((event.mask & IN_ISDIR) == 0)) {
+                        Remove(watch->second + event.name);
+                    } else {
+                        _absent.clear();
+
+                        // The directory itself changed, drop everything we have from it.
+                        LRUList::iterator index(_entries.begin());
+
+                        while (index != _entries.end()) {
+                            if (index->FileName.compare(0, watch->second.length(), watch->second) == 0) {
+                                _used -= Footprint(index->Info);
+                                _index.erase(index->FileName);
+                                index = _entries.erase(index);
+                            } else {
+                                index++;
+                            }
+                        }
+                    }
+
+                    if ((event.mask & (IN_MOVE_SELF | IN_DELETE_SELF)) != 0) {
+                        // The watch follows the directory, not its path. Whatever shows up at the path next
+                        // (e.g. a swapped in document root) must get a watch of its own.
+                        ::inotify_rm_watch(_descriptor, event.wd);
+                        _watches.erase(watch);
+                    } else if ((event.mask & IN_IGNORED) != 0) {
+                        // The kernel removed the watch, the directory is gone.
+                        _watches.erase(watch);
+                    }
+                }
+            }
+        }
+        bool Watch(const string& fileName)
+        {
+            string directory(fileName.substr(0, fileName.find_last_of('/') + 1));
+            Watches::const_iterator index(_watches.begin());
+
+            while ((index != _watches.end()) && (index->second != directory)) {
+                index++;
+            }
+
+            if (index == _watches.end()) {
+                int watch = ::inotify_add_watch(_descriptor, directory.c_str(), IN_CREATE | IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+
+                if (watch != -1) {
+                    _watches[watch] = directory;
+                    index = _watches.find(watch);
+                }
+            }
+
+            return (index != _watches.end());
+        }
+        void Insert(const string& fileName, const Entry& entry)
+        {
+            _entries.emplace_front(fileName, entry);
+            _index[fileName] = _entries.begin();
+            _used += Footprint(entry);
+
+            while (_used > _budget) {
+                _used -= Footprint(_entries.back().Info);
+                _index.erase(_entries.back().FileName);
+                _entries.pop_back();
+            }
+        }
+        void Flush()
+        {
+            _entries.clear();
+            _index.clear();
+            _absent.clear();
+            _used = 0;
+        }
+        void Remove(const string& fileName)
+        {
+            Index::iterator index(_index.find(fileName));
+
+            _absent.erase(fileName);
+
+            if (index != _index.end()) {
+                _used -= Footprint(index->second->Info);
+                _entries.erase(index->second);
+                _index.erase(index);
+            }
+        }
+        static uint32_t Footprint(const Entry& entry)
+        {
+            return (entry.Content ? static_cast<uint32_t>(entry.Content->length()) : ValidatorsSize);
+        }
+        static void Validators(const struct stat& properties, Entry& entry)
+        {
+            // Strong validator, changes with the inode, the size or the modification time of the file.
+            TCHAR buffer[64];
+            ::snprintf(buffer, sizeof(buffer), _T("\"%lx-%llx-%llx\""),
+                static_cast<unsigned long>(properties.st_ino),
+                static_cast<unsigned long long>(properties.st_size),
+                static_cast<unsigned long long>((static_cast<uint64_t>(properties.st_mtim.tv_sec) * 1000000000ULL) + properties.st_mtim.tv_nsec));
+
+            entry.ETag = buffer;
+            entry.Modified = Core::Time(static_cast<uint64_t>(properties.st_mtim.tv_sec) * 1000000ULL);
+            entry.Size = static_cast<uint64_t>(properties.st_size);
+            entry.Content.reset();
+        }
+        // Reads the whole file. If it changed while being read, the content is dropped and the properties are
+        // updated, so the caller hands out validators that match what is on disk.
+        static bool Load(const int descriptor, struct stat& properties, string& content)
+        {
+            const uint32_t size = static_cast<uint32_t>(properties.st_size);
+            uint32_t offset = 0;
+            bool result = true;
+
+            content.resize(size);
+
+            while ((offset < size) && (result == true)) {
+                ssize_t length = ::pread(descriptor, &content[offset], size - offset, offset);
+
+                if (length > 0) {
+                    offset += static_cast<uint32_t>(length);
+                } else if ((length == 0) || (errno != EINTR)) {
+                    result = false;
+                }
+            }
+
+            if (result == true) {
+                struct stat after;
+
+                if (::fstat(descriptor, &after) != 0) {
+                    result = false;
+                } else if ((after.st_size != properties.st_size) || (after.st_mtim.tv_sec != properties.st_mtim.tv_sec) || (after.st_mtim.tv_nsec != properties.st_mtim.tv_nsec)) {
+                    properties = after;
+                    result = false;
+                }
+            }
+
+            return (result);
+        }
+#endif
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        int _descriptor;
+        uint32_t _budget;
+        uint32_t _limit;
+        uint32_t _used;
+        LRUList _entries;
+        Index _index;
+        Watches _watches;
+        Absent _absent;
+        uint32_t _generation;
+        uint32_t _hits;
+        uint32_t _misses;
+        uint32_t _compressed;
+        uint32_t _uncompressed;
+    };
+}
+}
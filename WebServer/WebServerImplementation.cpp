@@ -1,11 +1,47 @@
 #include "Module.h"
+#include "FileBodies.h"
+#include "FileCache.h"
 #include <interfaces/IMemory.h>
 #include <interfaces/IWebServer.h>
 
 namespace WPEFramework {
 namespace Plugin {
 
+    // Counters of the file cache, returned on a GET of the configured cache status path.
+    class CacheStatistics : public Core::JSON::Container {
+    private:
+        CacheStatistics(const CacheStatistics&) = delete;
+        CacheStatistics& operator=(const CacheStatistics&) = delete;
+
+    public:
+        CacheStatistics()
+            : Core::JSON::Container()
+            , Hits(0)
+            , Misses(0)
+            , Compressed(0)
+            , Uncompressed(0)
+            , Used(0)
+        {
+            Add(_T("hits"), &Hits);
+            Add(_T("misses"), &Misses);
+            Add(_T("precompressed"), &Compressed);
+            Add(_T("uncompressed"), &Uncompressed);
+            Add(_T("used"), &Used);
+        }
+        ~CacheStatistics()
+        {
+        }
+
+    public:
+        Core::JSON::DecUInt32 Hits;
+        Core::JSON::DecUInt32 Misses;
+        Core::JSON::DecUInt32 Compressed;
+        Core::JSON::DecUInt32 Uncompressed;
+        Core::JSON::DecUInt32 Used;
+    };
+
     static Core::ProxyPoolType<Web::TextBody> _textBodies(5);
+    static Core::ProxyPoolType<Web::JSONBodyType<CacheStatistics>> _statisticsBodies(2);
 
     class WebServerImplementation : public Exchange::IWebServer, public PluginHost::IStateControl {
     private:
@@ -82,20 +118,32 @@ namespace Plugin {
                     , Path()
                     , Subst()
                     , Server()
+                    , Connections(2)
+                    , Pipeline(1)
+                    , Timeout(10000)
                 {
                     Add(_T("path"), &Path);
                     Add(_T("subst"), &Subst);
                     Add(_T("server"), &Server);
+                    Add(_T("connections"), &Connections);
+                    Add(_T("pipeline"), &Pipeline);
+                    Add(_T("timeout"), &Timeout);
                 }
                 Proxy(const Proxy& copy)
                     : Core::JSON::Container()
                     , Path(copy.Path)
                     , Subst(copy.Subst)
                     , Server(copy.Server)
+                    , Connections(copy.Connections)
+                    , Pipeline(copy.Pipeline)
+                    , Timeout(copy.Timeout)
                 {
                     Add(_T("path"), &Path);
                     Add(_T("subst"), &Subst);
                     Add(_T("server"), &Server);
+                    Add(_T("connections"), &Connections);
+                    Add(_T("pipeline"), &Pipeline);
+                    Add(_T("timeout"), &Timeout);
                 }
                 virtual ~Proxy()
                 {
@@ -105,6 +153,58 @@ namespace Plugin {
                 Core::JSON::String Path;
                 Core::JSON::String Subst;
                 Core::JSON::String Server;
+                Core::JSON::DecUInt8 Connections; // Keep-alive connections kept to the server
+                Core::JSON::DecUInt8 Pipeline; // Requests in flight per connection, only GET and HEAD are pipelined
+                Core::JSON::DecUInt32 Timeout; // Milliseconds a request may take before it is answered with a 504, 0 is forever
+            };
+
+            class Cache : public Core::JSON::Container {
+            private:
+                Cache(const Cache&) = delete;
+                Cache& operator=(const Cache&) = delete;
+
+            public:
+                Cache()
+                    : Core::JSON::Container()
+                    , Budget(2 * 1024 * 1024)
+                    , Limit(256 * 1024)
+                    , Status()
+                {
+                    Add(_T("budget"), &Budget);
+                    Add(_T("limit"), &Limit);
+                    Add(_T("status"), &Status);
+                }
+                ~Cache()
+                {
+                }
+
+            public:
+                Core::JSON::DecUInt32 Budget; // Bytes of file content kept in memory, 0 disables the cache
+                Core::JSON::DecUInt32 Limit; // Files bigger than this are always served from disk
+                Core::JSON::String Status; // URL path on which a GET returns the cache counters, empty disables it
+            };
+
+            class Upload : public Core::JSON::Container {
+            private:
+                Upload(const Upload&) = delete;
+                Upload& operator=(const Upload&) = delete;
+
+            public:
+                Upload()
+                    : Core::JSON::Container()
+                    , Path()
+                    , Limit(0)
+                {
+                    Add(_T("path"), &Path);
+                    Add(_T("limit"), &Limit);
+                }
+                ~Upload()
+                {
+                }
+
+            public:
+                Core::JSON::String Path; // URL path under which PUT/POST stores files, empty disables uploads
+                Core::JSON::DecUInt64 Limit; // Maximum size of an upload in bytes, 0 is unlimited
             };
 
         public:
@@ -115,6 +215,8 @@ namespace Plugin {
                 , Interface()
                 , Path(_T("www"))
                 , IdleTime(180)
+                , Caching()
+                , Uploads()
             {
                 Add(_T("port"), &Port);
                 Add(_T("binding"), &Binding);
@@ -122,6 +224,8 @@ namespace Plugin {
                 Add(_T("path"), &Path);
                 Add(_T("idletime"), &IdleTime);
                 Add(_T("proxies"), &Proxies);
+                Add(_T("cache"), &Caching);
+                Add(_T("upload"), &Uploads);
             }
             ~Config()
             {
@@ -134,6 +238,8 @@ namespace Plugin {
             Core::JSON::String Path;
             Core::JSON::DecUInt16 IdleTime;
             Core::JSON::ArrayType<Proxy> Proxies;
+            Cache Caching;
+            Upload Uploads;
         };
 
         class RequestFactory {
@@ -179,58 +285,115 @@ namespace Plugin {
         };
 
         // IMPORTANT NOTE:
-        // There is no need to lock/unlock usage on this server as all action->response senarious take place on
-        // the communication thread from the SoketPortMonitor. There is only 1 such thread per process.
-        // Given this, make sure that all actions done by the ProxyMap are deterministic and short <100ms as it
-        // upholds all other network traffic.
+        // Requests are relayed and responses are received on the communication thread from the SocketPortMonitor.
+        // Only the detection of requests that take too long runs on a timer thread, so the ProxyMap does lock its
+        // administration, but it never calls into the incoming channels with that lock taken.
+        // Make sure that all actions done by the ProxyMap are deterministic and short <100ms as it upholds all
+        // other network traffic.
         class ProxyMap {
         private:
+            class Route;
+
+            static constexpr uint64_t NoDeadline = ~static_cast<uint64_t>(0);
+
+            // Once the headers of the response are in, the body is passed on to the client while it comes in, Body
+            // is what it is passed on through.
+            struct OutstandingMessage {
+                Core::ProxyType<Web::Request> Request;
+                uint32_t Id;
+                uint64_t Deadline;
+                bool Submitted;
+                bool Idempotent;
+                Core::ProxyType<ProxyBody> Body;
+            };
+
             class OutgoingChannel : public Web::WebLinkType<Core::SocketStream, Web::Response, Web::Request, ResponseFactory> {
             private:
                 OutgoingChannel() = delete;
                 OutgoingChannel(const OutgoingChannel&) = delete;
                 OutgoingChannel& operator=(const OutgoingChannel&) = delete;
 
-                struct OutstandingMessage {
-                    Core::ProxyType<Web::Request> Request;
-                    uint32_t Id;
-                };
-
             public:
-                OutgoingChannel(const string& path, const string& replacement, ProxyMap& proxyMap, const Core::NodeId& remoteId)
+                OutgoingChannel(Route& route, const Core::NodeId& remoteId)
                     : Web::WebLinkType<Core::SocketStream, Web::Response, Web::Request, ResponseFactory>(2, false, remoteId.AnyInterface(), remoteId, 1024, 1024)
-                    , _path(path)
-                    , _replacement(replacement)
+                    , _route(route)
                     , _outstandingMessages()
-                    , _proxyMap(proxyMap)
+                    , _opening(false)
+                    , _opened(false)
+                    , _closing(false)
+                {
+                }
+                virtual ~OutgoingChannel()
                 {
+                    Close(Core::infinite);
                 }
 
-                void ProxyRequest(Core::ProxyType<Web::Request>& request, uint32_t id)
+            public:
+                inline uint16_t Outstanding() const
                 {
+                    return (static_cast<uint16_t>(_outstandingMessages.size()));
+                }
+                // A response that is being passed on is answered already, its deadline is lifted.
+                inline uint64_t Deadline() const
+                {
+                    uint64_t result = NoDeadline;
 
-                    OutstandingMessage message = { request, id };
+                    for (const OutstandingMessage& message : _outstandingMessages) {
+                        result = std::min(result, message.Deadline);
+                    }
 
+                    return (result);
+                }
+                // Responses come back in the order the requests were sent, so only requests that can safely be
+                // repeated are pipelined. Anything else waits for an idle connection and keeps it for itself.
+                // A connection that is being closed takes nothing until it reports it is closed.
+                inline bool Accepts(const OutstandingMessage& message, const uint8_t depth) const
+                {
+                    return ((_closing == false) && ((_outstandingMessages.empty() == true) || ((message.Idempotent == true) && (_outstandingMessages.back().Idempotent == true) && (_outstandingMessages.size() < depth))));
+                }
+                // If the connection can not even be started, no state change will follow, so the clients waiting for
+                // it are reported in failed right away.
+                void ProxyRequest(const OutstandingMessage& message, std::list<uint32_t>& failed)
+                {
                     _outstandingMessages.push_back(message);
 
-                    if (_outstandingMessages.size() == 1) {
-                        if (IsOpen() == false) {
-                            Open(0);
-                        } else {
-                            Submit(request);
+                    if (IsOpen() == true) {
+                        _outstandingMessages.back().Submitted = true;
+                        Submit(_outstandingMessages.back().Request);
+                    } else if (_opening == false) {
+                        _opening = true;
+
+                        uint32_t result = Open(0);
+
+                        if ((result != Core::ERROR_NONE) && (result != Core::ERROR_INPROGRESS)) {
+                            TRACE_L1("Could not connect to the proxy server, error: %d", result);
+
+                            _opening = false;
+                            Abort(failed);
                         }
                     }
                 }
-
-            public:
-                inline const string& Path() const
+                // Drops everything that is outstanding, the clients waiting for it are reported in ids. A client that
+                // is receiving its response already can not be answered anymore, its response is cut short.
+                void Abort(std::list<uint32_t>& ids)
                 {
-                    return (_path);
+                    while (_outstandingMessages.empty() == false) {
+                        if (_outstandingMessages.front().Body.IsValid() == true) {
+                            _route.Broken(_outstandingMessages.front().Body);
+                        } else {
+                            ids.push_back(_outstandingMessages.front().Id);
+                        }
+                        _outstandingMessages.pop_front();
+                    }
                 }
-                virtual void LinkBody(Core::ProxyType<Web::Response>& response)
+                // As Abort, but the connection is about to be closed, so it should not be handed new requests.
+                void Discard(std::list<uint32_t>& ids)
                 {
-                    response->Body(_textBodies.Element());
+                    Abort(ids);
+
+                    _closing = true;
                 }
+                virtual void LinkBody(Core::ProxyType<Web::Response>& response);
                 virtual void Send(const Core::ProxyType<Web::Request>& request)
                 {
                     std::list<OutstandingMessage>::iterator index(_outstandingMessages.begin());
@@ -242,28 +405,219 @@ namespace Plugin {
                     ASSERT(index != _outstandingMessages.end());
                     ASSERT(index->Request == request);
 
-                    index->Request.Release();
+                    if (index != _outstandingMessages.end()) {
+                        index->Request.Release();
+                    }
                 }
                 // Whenever there is a state change on the link, it is reported here.
-                virtual void StateChange()
+                virtual void StateChange();
+                virtual void Received(Core::ProxyType<Web::Response>& response);
+
+            private:
+                Route& _route;
+                std::list<OutstandingMessage> _outstandingMessages;
+                bool _opening;
+                bool _opened;
+                bool _closing;
+            };
+
+            // A route owns a pool of keep-alive connections to one upstream server. Requests go to the connection
+            // with the least outstanding requests. If none of the connections can take it, the request waits in
+            // the backlog of the route until one of them completes a request.
+            class Route {
+            private:
+                Route() = delete;
+                Route(const Route&) = delete;
+                Route& operator=(const Route&) = delete;
+
+            public:
+                Route(ProxyMap& parent, const string& path, const string& replacement, const Core::NodeId& remoteId, const uint8_t connections, const uint8_t depth, const uint32_t timeout)
+                    : _parent(parent)
+                    , _path(path)
+                    , _replacement(replacement)
+                    , _depth(depth == 0 ? 1 : depth)
+                    , _timeout(timeout)
+                    , _channels()
+                    , _backlog()
                 {
-                    if (IsOpen() == true) {
+                    for (uint8_t index = 0; index < (connections == 0 ? 1 : connections); index++) {
+                        _channels.push_back(new OutgoingChannel(*this, remoteId));
+                    }
+                }
+                ~Route()
+                {
+                    for (OutgoingChannel* channel : _channels) {
+                        delete channel;
+                    }
+                }
+
+            public:
+                inline const string& Path() const
+                {
+                    return (_path);
+                }
+                void Relay(Core::ProxyType<Web::Request>& request, const uint32_t id, std::list<uint32_t>& failed)
+                {
+                    if (_replacement.empty() == false) {
+                        request->Path = _replacement + request->Path.substr(_path.length());
+                    }
 
-                        if (!_outstandingMessages.empty()) {
-                            Submit(_outstandingMessages.front().Request);
+                    OutstandingMessage message = {
+                        request,
+                        id,
+                        (_timeout == 0 ? NoDeadline : Core::Time::Now().Add(_timeout).Ticks()),
+                        false,
+                        ((request->Verb == Web::Request::HTTP_GET) || (request->Verb == Web::Request::HTTP_HEAD)),
+                        Core::ProxyType<ProxyBody>()
+                    };
+
+                    if ((_backlog.empty() == false) || (Dispatch(message, failed) == false)) {
+                        _backlog.push_back(message);
+                    }
+                }
+                // The responses themselves are handed to the clients by Submit and Fail, that are called without the
+                // lock taken.
+                void Completed(std::list<uint32_t>& failed)
+                {
+                    Drain(failed);
+                }
+                inline void Submit(const uint32_t id, Core::ProxyType<Web::Response>& response)
+                {
+                    _parent.Submit(id, response);
+                }
+                inline void Fail(const std::list<uint32_t>& ids)
+                {
+                    _parent.Fail(ids, Web::STATUS_BAD_GATEWAY);
+                }
+                inline Core::ProxyType<ProxyBody> Stream(const uint32_t id, const uint32_t length)
+                {
+                    return (_parent.Stream(id, length));
+                }
+                inline void Broken(const Core::ProxyType<ProxyBody>& body)
+                {
+                    _parent.Broken(body);
+                }
+                void Requeue(const OutstandingMessage& message)
+                {
+                    _backlog.push_front(message);
+                }
+                void Drain(std::list<uint32_t>& failed)
+                {
+                    while ((_backlog.empty() == false) && (Dispatch(_backlog.front(), failed) == true)) {
+                        _backlog.pop_front();
+                    }
+                }
+                // Collects the clients of all requests that passed their deadline. A pipelined response can not
+                // be skipped, so a connection that is stuck is to be closed, failing everything that was sent on it.
+                void Expired(const uint64_t now, std::list<uint32_t>& ids, std::list<OutgoingChannel*>& stuck)
+                {
+                    while ((_backlog.empty() == false) && (_backlog.front().Deadline <= now)) {
+                        ids.push_back(_backlog.front().Id);
+                        _backlog.pop_front();
+                    }
+
+                    for (OutgoingChannel* channel : _channels) {
+                        if (channel->Deadline() <= now) {
+                            channel->Discard(ids);
+                            stuck.push_back(channel);
                         }
                     }
                 }
-                virtual void Received(Core::ProxyType<Web::Response>& response);
+                void Abort(std::list<uint32_t>& ids)
+                {
+                    while (_backlog.empty() == false) {
+                        ids.push_back(_backlog.front().Id);
+                        _backlog.pop_front();
+                    }
+                    for (OutgoingChannel* channel : _channels) {
+                        channel->Abort(ids);
+                    }
+                }
+                inline void Lock()
+                {
+                    _parent.Lock();
+                }
+                inline void Unlock()
+                {
+                    _parent.Unlock();
+                }
+
+            private:
+                bool Dispatch(const OutstandingMessage& message, std::list<uint32_t>& failed)
+                {
+                    OutgoingChannel* selected = nullptr;
+
+                    for (OutgoingChannel* channel : _channels) {
+                        if ((channel->Accepts(message, _depth) == true) && ((selected == nullptr) || (channel->Outstanding() < selected->Outstanding()) || ((channel->Outstanding() == selected->Outstanding()) && (channel->IsOpen() == true) && (selected->IsOpen() == false)))) {
+                            selected = channel;
+                        }
+                    }
+
+                    if (selected != nullptr) {
+                        selected->ProxyRequest(message, failed);
+                    }
+
+                    return (selected != nullptr);
+                }
 
             private:
+                ProxyMap& _parent;
                 const string _path;
                 const string _replacement;
+                const uint8_t _depth;
+                const uint32_t _timeout;
+                std::vector<OutgoingChannel*> _channels;
+                std::list<OutstandingMessage> _backlog;
+            };
 
-                std::list<OutstandingMessage> _outstandingMessages;
-                ProxyMap& _proxyMap;
+            class TimeoutHandler {
+            public:
+                TimeoutHandler()
+                    : _parent(nullptr)
+                {
+                }
+                TimeoutHandler(ProxyMap& parent)
+                    : _parent(&parent)
+                {
+                }
+                TimeoutHandler(const TimeoutHandler& copy)
+                    : _parent(copy._parent)
+                {
+                }
+                ~TimeoutHandler()
+                {
+                }
+
+                TimeoutHandler& operator=(const TimeoutHandler& RHS)
+                {
+                    _parent = RHS._parent;
+                    return (*this);
+                }
+                bool operator==(const TimeoutHandler& RHS) const
+                {
+                    return (_parent == RHS._parent);
+                }
+
+            public:
+                uint64_t Timed(const uint64_t scheduledTime)
+                {
+                    ASSERT(_parent != nullptr);
+
+                    return (_parent->Timed(scheduledTime));
+                }
+
+            private:
+                ProxyMap* _parent;
             };
 
+            // Routes are looked up by the exact prefix, so they live in a hash table.
+            typedef std::unordered_map<string, Route*> Routes;
+
+            static constexpr uint8_t DefaultConnections = 2;
+            static constexpr uint8_t DefaultPipeline = 1;
+            static constexpr uint32_t DefaultTimeout = 10000;
+            static constexpr uint32_t TimeoutCheck = 1000;
+
         private:
             ProxyMap() = delete;
             ProxyMap(const ProxyMap&) = delete;
@@ -271,117 +625,257 @@ namespace Plugin {
 
         public:
             ProxyMap(ChannelMap& server)
-                : _server(server)
-                , _proxies()
+                : _adminLock()
+                , _routeLock()
+                , _server(server)
+                , _routes()
+                , _broken()
+                , _timer(Core::Thread::DefaultStackSize(), _T("ProxyTimeouts"))
+                , _scheduled(false)
             {
             }
             ~ProxyMap()
             {
-                // Clean up channels in map.
-                while (_proxies.size() > 0) {
-                    delete _proxies.front();
-                    _proxies.pop_front();
-                }
+                _timer.Revoke(TimeoutHandler(*this));
+
+                Destroy();
             }
 
         public:
             void Create(Core::JSON::ArrayType<Config::Proxy>::ConstIterator& index)
             {
-
                 index.Reset();
 
                 while (index.Next() == true) {
+                    const Config::Proxy& proxy(index.Current());
 
-                    const string& path(index.Current().Path.Value());
-                    const string& subst(index.Current().Subst.Value());
-                    const Core::NodeId address(index.Current().Server.Value().c_str());
-
-                    if (address.IsValid() == true) {
-
-                        _proxies.push_back(new OutgoingChannel(path, subst, *this, address));
-                    }
+                    Add(proxy.Path.Value(), proxy.Subst.Value(), proxy.Server.Value(), proxy.Connections.Value(), proxy.Pipeline.Value(), proxy.Timeout.Value());
                 }
             }
 
             void Destroy()
             {
+                std::list<uint32_t> ids;
+                std::list<Route*> routes;
+
+                _routeLock.Lock();
+                _adminLock.Lock();
 
-                std::list<OutgoingChannel*>::iterator index(_proxies.begin());
+                for (std::pair<const string, Route*>& route : _routes) {
+                    route.second->Abort(ids);
+                    routes.push_back(route.second);
+                }
+                _routes.clear();
 
-                while (index != _proxies.end()) {
+                _adminLock.Unlock();
 
-                    delete (*index);
+                Delete(routes);
 
-                    index++;
-                }
-                _proxies.clear();
+                _routeLock.Unlock();
+
+                Fail(ids, Web::STATUS_BAD_GATEWAY);
             }
 
             bool Relay(Core::ProxyType<Web::Request>& request, uint32_t channelId)
             {
+                std::list<uint32_t> ids;
 
-                bool found = false;
-                const string& originalPath = request->Path;
-                std::list<OutgoingChannel*>::iterator index(_proxies.begin());
-                string proxyPath;
+                _adminLock.Lock();
 
-                while ((found == false) && (index != _proxies.end())) {
+                Route* route = Find(request->Path);
 
-                    proxyPath = (*index)->Path();
+                // If we didn't find relay instructions for this path, return false.
+                if (route != nullptr) {
+                    route->Relay(request, channelId, ids);
+                }
 
-                    uint32_t checkSize(static_cast<uint32_t>(proxyPath.length()));
+                _adminLock.Unlock();
 
-                    // If path starts with mapped string, we should relay.
-                    if (((originalPath.length() == checkSize) || ((originalPath.length() > checkSize) && (originalPath[checkSize] == '/'))) && (originalPath.compare(0, checkSize, proxyPath) == 0)) {
-                        found = true;
-                    } else {
-                        index++;
-                    }
+                if (ids.empty() == false) {
+                    Fail(ids, Web::STATUS_BAD_GATEWAY);
                 }
 
-                // If we didn't find relay instructions for this path, return false.
-                if (found == true) {
+                return (route != nullptr);
+            }
+
+            inline void AddProxy(const string& path, const string& subst, const string& address)
+            {
+                Add(path, subst, address, DefaultConnections, DefaultPipeline, DefaultTimeout);
+            }
+            inline void RemoveProxy(const string& path)
+            {
+                std::list<uint32_t> ids;
+                std::list<Route*> routes;
 
-                    request->Path = (proxyPath + request->Path.substr(proxyPath.length()));
+                _routeLock.Lock();
+                _adminLock.Lock();
 
-                    (*index)->ProxyRequest(request, channelId);
-                }
+                Detach(path, ids, routes);
 
-                return (found);
+                _adminLock.Unlock();
+
+                Delete(routes);
+
+                _routeLock.Unlock();
+
+                Fail(ids, Web::STATUS_BAD_GATEWAY);
+            }
+            inline void Submit(uint32_t channelId, Core::ProxyType<Web::Response>& response)
+            {
+                _server.Submit(channelId, response);
+            }
+            Core::ProxyType<ProxyBody> Stream(const uint32_t channelId, const uint32_t length)
+            {
+                return (Core::ProxyType<ProxyBody>::Create(length, [this, channelId]() { _server.Resume(channelId); }, [this, channelId]() { _server.Disconnect(channelId); }));
             }
 
-            inline void AddProxy(const string& path, const string& subst, const string& address)
+        private:
+            inline void Lock()
+            {
+                _adminLock.Lock();
+            }
+            inline void Unlock()
+            {
+                _adminLock.Unlock();
+            }
+            // Called with the lock taken, the bodies are cut by Fail, once the lock is released.
+            inline void Broken(const Core::ProxyType<ProxyBody>& body)
+            {
+                _broken.push_back(body);
+            }
+            void Add(const string& path, const string& subst, const string& address, const uint8_t connections, const uint8_t pipeline, const uint32_t timeout)
             {
                 const Core::NodeId node(address.c_str());
 
                 if (node.IsValid() == true) {
+                    std::list<uint32_t> ids;
+                    std::list<Route*> routes;
 
-                    _proxies.push_back(new OutgoingChannel(path, subst, *this, node));
+                    _routeLock.Lock();
+                    _adminLock.Lock();
+
+                    // Same path again, the new definition replaces the old one.
+                    Detach(path, ids, routes);
+
+                    _routes.emplace(path, new Route(*this, path, subst, node, connections, pipeline, timeout));
+
+                    if (_scheduled == false) {
+                        _scheduled = true;
+                        _timer.Schedule(Core::Time::Now().Add(TimeoutCheck).Ticks(), TimeoutHandler(*this));
+                    }
+
+                    _adminLock.Unlock();
+
+                    Delete(routes);
+
+                    _routeLock.Unlock();
+
+                    Fail(ids, Web::STATUS_BAD_GATEWAY);
                 }
             }
-            inline void RemoveProxy(const string& path)
+            void Detach(const string& path, std::list<uint32_t>& ids, std::list<Route*>& routes)
             {
-                std::list<OutgoingChannel*>::iterator index(_proxies.begin());
+                Routes::iterator index(_routes.find(path));
 
-                while ((index != _proxies.end()) && ((*index)->Path() != path)) {
-
-                    index++;
+                if (index != _routes.end()) {
+                    index->second->Abort(ids);
+                    routes.push_back(index->second);
+                    _routes.erase(index);
                 }
+            }
+            // Closing the connections of a route waits for the communication thread, which might be waiting for
+            // the administration lock, so routes are deleted once they are no longer reachable, outside that lock.
+            void Delete(std::list<Route*>& routes)
+            {
+                while (routes.empty() == false) {
+                    delete routes.front();
+                    routes.pop_front();
+                }
+            }
+            // Longest prefix match: the path itself and every part of it that ends before a '/' is a candidate.
+            Route* Find(const string& path) const
+            {
+                Route* result = nullptr;
+                size_t length = path.length();
 
-                if (index != _proxies.end()) {
+                while ((result == nullptr) && (length != string::npos)) {
+                    Routes::const_iterator index(_routes.find(path.substr(0, length)));
 
-                    delete (*index);
-                    _proxies.erase(index);
+                    if (index != _routes.end()) {
+                        result = index->second;
+                    } else {
+                        length = (length == 0 ? string::npos : path.rfind('/', length - 1));
+                    }
                 }
+
+                return (result);
             }
-            inline void Submit(uint32_t channelId, Core::ProxyType<Web::Response>& response)
+            void Fail(const uint32_t channelId, const Web::WebStatus status)
             {
+                Core::ProxyType<Web::Response> response(PluginHost::Factories::Instance().Response());
+
+                response->ErrorCode = status;
+                response->Message = (status == Web::STATUS_GATEWAY_TIMEOUT ? _T("Gateway Timeout") : _T("Bad Gateway"));
+
                 _server.Submit(channelId, response);
             }
+            void Fail(const std::list<uint32_t>& ids, const Web::WebStatus status)
+            {
+                std::list<Core::ProxyType<ProxyBody>> broken;
+
+                _adminLock.Lock();
+                broken.swap(_broken);
+                _adminLock.Unlock();
+
+                for (Core::ProxyType<ProxyBody>& body : broken) {
+                    body->Cut();
+                }
+                for (const uint32_t id : ids) {
+                    Fail(id, status);
+                }
+            }
+            uint64_t Timed(const uint64_t scheduledTime)
+            {
+                std::list<uint32_t> ids;
+                std::list<OutgoingChannel*> stuck;
+                uint64_t result = 0;
+
+                // The route lock keeps the routes, and so the stuck channels, alive until they are closed.
+                _routeLock.Lock();
+                _adminLock.Lock();
+
+                for (std::pair<const string, Route*>& route : _routes) {
+                    route.second->Expired(scheduledTime, ids, stuck);
+                }
+
+                if (_routes.empty() == true) {
+                    _scheduled = false;
+                } else {
+                    result = Core::Time(scheduledTime).Add(TimeoutCheck).Ticks();
+                }
+
+                _adminLock.Unlock();
+
+                for (OutgoingChannel* channel : stuck) {
+                    channel->Close(0);
+                }
+
+                _routeLock.Unlock();
+
+                // Respond outside of the lock, the incoming channels take their own locks.
+                Fail(ids, Web::STATUS_GATEWAY_TIMEOUT);
+
+                return (result);
+            }
 
         private:
+            Core::CriticalSection _adminLock;
+            Core::CriticalSection _routeLock;
             ChannelMap& _server;
-            std::list<OutgoingChannel*> _proxies;
+            Routes _routes;
+            std::list<Core::ProxyType<ProxyBody>> _broken;
+            Core::TimerType<TimeoutHandler> _timer;
+            bool _scheduled;
         };
 
         class IncomingChannel : public Web::WebLinkType<Core::SocketStream, Web::Request, Web::Response, RequestFactory> {
@@ -401,6 +895,13 @@ namespace Plugin {
             {
             }
 
+        public:
+            // Sending stopped because the body of the response had nothing more yet, it has now.
+            inline void Resume()
+            {
+                Link().Trigger();
+            }
+
         private:
             inline uint32_t Id() const
             {
@@ -411,7 +912,11 @@ namespace Plugin {
             // [OUTBOUND] Completed send responses are triggering the Send.
             virtual void LinkBody(Core::ProxyType<Web::Request>& request)
             {
-                if (request->Verb == Web::Request::HTTP_POST) {
+                string fileName;
+
+                if (_parent.Upload(*request, fileName) == true) {
+                    request->Body(Core::proxy_cast<Web::IBody>(Core::ProxyType<UploadBody>::Create(fileName, _parent.UploadLimit())));
+                } else if (request->Verb == Web::Request::HTTP_POST) {
                     request->Body(_textBodies.Element());
                 }
             }
@@ -424,6 +929,9 @@ namespace Plugin {
             }
             virtual void Received(Core::ProxyType<Web::Request>& request);
 
+            void Stored(const Web::Request& request, Web::Response& response);
+            void Serve(const Web::Request& request, Core::ProxyType<Web::Response>& response);
+
         private:
             friend class Core::SocketServerType<IncomingChannel>;
 
@@ -491,6 +999,10 @@ namespace Plugin {
                 , _connectionCheckTimer(0)
                 , _cleanupTimer(Core::Thread::DefaultStackSize(), _T("ConnectionChecker"))
                 , _proxyMap(*this)
+                , _fileCache()
+                , _statusPath()
+                , _uploadPath()
+                , _uploadLimit(0)
             {
             }
 #ifdef __WINDOWS__
@@ -530,6 +1042,28 @@ namespace Plugin {
 
                 _proxyMap.Create(index);
 
+                _fileCache.Configure(configuration.Caching.Budget.Value(), configuration.Caching.Limit.Value());
+
+                if (configuration.Caching.Status.Value().empty() == false) {
+                    _statusPath = configuration.Caching.Status.Value();
+
+                    if (_statusPath[0] != '/') {
+                        _statusPath = '/' + _statusPath;
+                    }
+                }
+
+                if (configuration.Uploads.Path.Value().empty() == false) {
+                    _uploadPath = configuration.Uploads.Path.Value();
+
+                    if (_uploadPath[0] != '/') {
+                        _uploadPath = '/' + _uploadPath;
+                    }
+                    if (_uploadPath[_uploadPath.length() - 1] == '/') {
+                        _uploadPath.erase(_uploadPath.length() - 1);
+                    }
+                    _uploadLimit = configuration.Uploads.Limit.Value();
+                }
+
                 if (configuration.Interface.Value().empty() == false) {
                     Core::NodeId selectedNode = Plugin::Config::IPV4UnicastNode(configuration.Interface.Value());
 
@@ -586,10 +1120,64 @@ namespace Plugin {
             {
                 return (_prefixPath);
             }
+            inline FileCache& Files()
+            {
+                return (_fileCache);
+            }
+            // Tells if the request stores a file, if so, fileName is where it goes.
+            bool Upload(const Web::Request& request, string& fileName) const
+            {
+                const string& path(request.Path);
+                const uint32_t length(static_cast<uint32_t>(_uploadPath.length()));
+
+                bool result = ((_uploadPath.empty() == false) && ((request.Verb == Web::Request::HTTP_PUT) || (request.Verb == Web::Request::HTTP_POST)) && (path.length() > (length + 1)) && (path[length] == '/') && (path.compare(0, length, _uploadPath) == 0) && (path[path.length() - 1] != '/') && (path.find(_T("..")) == string::npos));
+
+                if (result == true) {
+                    fileName = _prefixPath + path.substr(1);
+                }
+
+                return (result);
+            }
+            inline uint64_t UploadLimit() const
+            {
+                return (_uploadLimit);
+            }
+            inline bool Status(const Web::Request& request) const
+            {
+                return ((_statusPath.empty() == false) && (request.Verb == Web::Request::HTTP_GET) && (request.Path == _statusPath));
+            }
+            void Statistics(CacheStatistics& statistics) const
+            {
+                uint32_t hits, misses, compressed, uncompressed, used;
+
+                _fileCache.Statistics(hits, misses, compressed, uncompressed, used);
+
+                statistics.Hits = hits;
+                statistics.Misses = misses;
+                statistics.Compressed = compressed;
+                statistics.Uncompressed = uncompressed;
+                statistics.Used = used;
+            }
             inline bool Relay(Core::ProxyType<Web::Request>& request, const uint32_t id)
             {
                 return (_proxyMap.Relay(request, id));
             }
+            void Resume(const uint32_t id)
+            {
+                Core::ProxyType<IncomingChannel> channel(BaseClass::Client(id));
+
+                if (channel.IsValid() == true) {
+                    channel->Resume();
+                }
+            }
+            void Disconnect(const uint32_t id)
+            {
+                Core::ProxyType<IncomingChannel> channel(BaseClass::Client(id));
+
+                if (channel.IsValid() == true) {
+                    channel->Close(0);
+                }
+            }
             inline string Accessor() const
             {
                 return (_accessor);
@@ -639,6 +1227,10 @@ namespace Plugin {
             uint32_t _connectionCheckTimer;
             Core::TimerType<TimeHandler> _cleanupTimer;
             ProxyMap _proxyMap;
+            FileCache _fileCache;
+            string _statusPath;
+            string _uploadPath;
+            uint64_t _uploadLimit;
         };
 
     private:
@@ -740,47 +1332,255 @@ namespace Plugin {
         // Check if the channel server will relay this message.
         if (_parent.Relay(request, Id()) == false) {
 
+            // If so, don't deal with it ourselves.
             Core::ProxyType<Web::Response> response(PluginHost::Factories::Instance().Response());
-            Core::ProxyType<Web::FileBody> fileBody(PluginHost::Factories::Instance().FileBody());
+            string fileName;
+
+            if (_parent.Upload(*request, fileName) == true) {
+                if (request->HasBody() == true) {
+                    Stored(*request, *response);
+                } else if (request->ContentLength.IsSet() == false) {
+                    response->ErrorCode = Web::STATUS_LENGTH_REQUIRED;
+                    response->Message = _T("Length Required");
+                } else {
+                    response->ErrorCode = Web::STATUS_BAD_REQUEST;
+                    response->Message = _T("Upload has no content");
+                }
+            } else if (_parent.Status(*request) == true) {
+                Core::ProxyType<Web::JSONBodyType<CacheStatistics>> statistics(_statisticsBodies.Element());
 
-            // If so, don't deal with it ourselves.
-            Web::MIMETypes result;
-            string fileToService = _parent.PrefixPath();
+                _parent.Statistics(*statistics);
 
-            if (Web::MIMETypeForFile(request->Path, fileToService, result) == false) {
+                response->ContentType = Web::MIMETypes::MIME_JSON;
+                response->Body<Web::JSONBodyType<CacheStatistics>>(statistics);
+            } else {
+                Serve(*request, response);
+            }
+
+            Submit(response);
+        }
+    }
+
+    void WebServerImplementation::IncomingChannel::Stored(const Web::Request& request, Web::Response& response)
+    {
+        const UploadBody& upload(*(request.Body<const UploadBody>()));
+
+        switch (upload.State()) {
+        case UploadBody::COMPLETED:
+            response.ErrorCode = Web::STATUS_CREATED;
+            response.Message = _T("Stored ") + Core::NumberType<uint64_t>(upload.Size()).Text() + _T(" bytes");
+            break;
+        case UploadBody::TOO_LARGE:
+            response.ErrorCode = Web::STATUS_REQUEST_ENTITY_TOO_LARGE;
+            response.Message = _T("Upload exceeds ") + Core::NumberType<uint64_t>(_parent.UploadLimit()).Text() + _T(" bytes");
+            break;
+        default:
+            response.ErrorCode = Web::STATUS_INTERNAL_SERVER_ERROR;
+            response.Message = _T("Upload could not be stored");
+            break;
+        }
+    }
+
+    void WebServerImplementation::IncomingChannel::Serve(const Web::Request& request, Core::ProxyType<Web::Response>& response)
+    {
+        Web::MIMETypes result;
+        string fileToService = _parent.PrefixPath();
 
-                string fullPath = fileToService + _T("index.html");
+        if (Web::MIMETypeForFile(request.Path, fileToService, result) == false) {
+            // No filename gives, be default, we go for the index.html page..
+            fileToService += _T("index.html");
+            result = Web::MIME_HTML;
+        }
+
+        FileCache::Entry entry;
+
+        response->ContentType = result;
 
-                // No filename gives, be default, we go for the index.html page..
-                *fileBody = fileToService + _T("index.html");
-                response->ContentType = Web::MIME_HTML;
-                response->Body<Web::FileBody>(fileBody);
+        if (_parent.Files().Find(fileToService, entry) == false) {
+            // Not a file we know of, let the FileBody sort it out.
+            Core::ProxyType<Web::FileBody> fileBody(PluginHost::Factories::Instance().FileBody());
+            *fileBody = fileToService;
+            response->Body<Web::FileBody>(fileBody);
+        } else {
+            string encoding;
+            string accepted(request.AcceptEncoding.IsSet() == true ? request.AcceptEncoding.Value() : string());
+
+            if (_parent.Files().Variant(fileToService, accepted, entry, encoding) == true) {
+                // There are precompressed versions of this file, what we send depends on what the client accepts.
+                response->Vary = _T("Accept-Encoding");
+
+                if (encoding.empty() == false) {
+                    response->ContentEncoding = encoding;
+                }
+            }
+
+            response->ETag = entry.ETag;
+            response->Modified = entry.Modified;
+            response->AcceptRanges = _T("bytes");
+
+            if ((request.IfNoneMatch.IsSet() == true) && (FileCache::Matches(request.IfNoneMatch.Value(), entry.ETag) == true)) {
+                // The client has it already, no body required.
+                response->ErrorCode = Web::STATUS_NOT_MODIFIED;
+                response->Message = _T("Not Modified");
             } else {
-                *fileBody = fileToService;
-                response->ContentType = result;
-                response->Body<Web::FileBody>(fileBody);
+                RangeBody::range range = RangeBody::NONE;
+                uint64_t offset = 0;
+                uint64_t length = entry.Size;
+                const string size(Core::NumberType<uint64_t>(entry.Size).Text());
+
+                // A range only makes sense if the client still has the same version of the file, If-Range tells.
+                if ((request.Range.IsSet() == true) && ((request.IfRange.IsSet() == false) || (request.IfRange.Value() == entry.ETag))) {
+                    range = RangeBody::Parse(request.Range.Value(), entry.Size, offset, length);
+                }
+
+                if (range == RangeBody::UNSATISFIABLE) {
+                    response->ErrorCode = Web::STATUS_REQUESTED_RANGE_NOT_SATISFIABLE;
+                    response->Message = _T("Range Not Satisfiable");
+                    response->ContentRange = _T("bytes */") + size;
+                } else {
+                    if (range == RangeBody::SATISFIABLE) {
+                        response->ErrorCode = Web::STATUS_PARTIAL_CONTENT;
+                        response->Message = _T("Partial Content");
+                        response->ContentRange = _T("bytes ") + Core::NumberType<uint64_t>(offset).Text() + '-' + Core::NumberType<uint64_t>(offset + length - 1).Text() + '/' + size;
+                    }
+
+                    if (entry.Content) {
+                        Core::ProxyType<CachedBody> cachedBody(Core::ProxyType<CachedBody>::Create(entry.Content, static_cast<uint32_t>(offset), static_cast<uint32_t>(length)));
+                        response->Body(Core::proxy_cast<Web::IBody>(cachedBody));
+                    } else if (range == RangeBody::SATISFIABLE) {
+                        // Only the requested part of a file that is too big for the cache.
+                        Core::ProxyType<RangeBody> rangeBody(Core::ProxyType<RangeBody>::Create(fileToService, offset, static_cast<uint32_t>(length), [this]() { Close(0); }));
+
+                        if (rangeBody->IsValid() == true) {
+                            response->Body(Core::proxy_cast<Web::IBody>(rangeBody));
+                        } else {
+                            // Gone since we looked it up.
+                            response->ErrorCode = Web::STATUS_NOT_FOUND;
+                            response->Message = _T("Not Found");
+                            response->ContentRange.Clear();
+                        }
+                    } else {
+                        // Too big for the cache, stream it from disk.
+                        Core::ProxyType<Web::FileBody> fileBody(PluginHost::Factories::Instance().FileBody());
+                        *fileBody = fileToService;
+                        response->Body<Web::FileBody>(fileBody);
+                    }
+                }
             }
-            Submit(response);
+        }
+    }
+
+    /* virtual */ void WebServerImplementation::ProxyMap::OutgoingChannel::StateChange()
+    {
+        std::list<uint32_t> failed;
+
+        _route.Lock();
+
+        _opening = false;
+
+        if (IsOpen() == true) {
+            _opened = true;
+
+            // Everything that queued up while we were connecting can go now.
+            for (OutstandingMessage& message : _outstandingMessages) {
+                if (message.Submitted == false) {
+                    message.Submitted = true;
+                    Submit(message.Request);
+                }
+            }
+        } else {
+            // What was sent is lost, we can not tell if the server handled it. What was not sent yet goes back to the
+            // route if this was a connection the server closed, if we never got connected the server is unreachable.
+            std::list<OutstandingMessage> pending;
+            pending.swap(_outstandingMessages);
+
+            while (pending.empty() == false) {
+                if (pending.back().Body.IsValid() == true) {
+                    _route.Broken(pending.back().Body);
+                } else if ((pending.back().Submitted == false) && (_opened == true)) {
+                    _route.Requeue(pending.back());
+                } else {
+                    failed.push_front(pending.back().Id);
+                }
+                pending.pop_back();
+            }
+
+            _opened = false;
+            _closing = false;
+
+            _route.Drain(failed);
+        }
+
+        _route.Unlock();
+
+        // Respond outside of the lock, the incoming channels take their own locks. This also cuts a response that
+        // was being passed on.
+        _route.Fail(failed);
+    }
+
+    /* virtual */ void WebServerImplementation::ProxyMap::OutgoingChannel::LinkBody(Core::ProxyType<Web::Response>& response)
+    {
+        Core::ProxyType<ProxyBody> body;
+        uint32_t id = 0;
+
+        // Only a body of which the length is known up front can be passed on while it comes in, anything else is
+        // collected completely before it is handed to the client.
+        if ((response->ContentLength.IsSet() == true) && (response->ContentLength.Value() != 0)) {
+            _route.Lock();
+
+            if (_outstandingMessages.empty() == false) {
+                OutstandingMessage& message(_outstandingMessages.front());
+
+                id = message.Id;
+                body = _route.Stream(id, response->ContentLength.Value());
+                message.Body = body;
+                message.Deadline = NoDeadline;
+            }
+
+            _route.Unlock();
+        }
+
+        if (body.IsValid() == false) {
+            response->Body(_textBodies.Element());
+        } else {
+            response->Body(Core::proxy_cast<Web::IBody>(body));
+
+            // The headers are complete, the client can have them, the body follows as it comes in.
+            _route.Submit(id, response);
         }
     }
 
     /* virtual */ void WebServerImplementation::ProxyMap::OutgoingChannel::Received(Core::ProxyType<Web::Response>& response)
     {
-        // Is response to our front of the list
-        ASSERT(_outstandingMessages.empty() == false);
-        ASSERT(_outstandingMessages.front().Request.IsValid() == false);
+        std::list<uint32_t> failed;
+        bool answered = false;
+        uint32_t id = 0;
+
+        _route.Lock();
+
+        // Is response to our front of the list. If the list is empty, the request timed out and was answered already.
+        ASSERT((_outstandingMessages.empty() == true) || (_outstandingMessages.front().Request.IsValid() == false));
 
         if (_outstandingMessages.empty() == false) {
-            _proxyMap.Submit(_outstandingMessages.front().Id, response);
+            id = _outstandingMessages.front().Id;
+
+            // A response that was passed on while it came in is with the client already.
+            answered = (_outstandingMessages.front().Body.IsValid() == false);
+
             _outstandingMessages.pop_front();
 
-            // See if ther is a next one to send.
-            if (_outstandingMessages.size() > 0) {
+            _route.Completed(failed);
+        }
 
-                ASSERT(_outstandingMessages.front().Request.IsValid() == true);
+        _route.Unlock();
 
-                Submit(_outstandingMessages.front().Request);
-            }
+        // Respond outside of the lock, the incoming channels take their own locks. The route can not go away while
+        // we are in here, deleting it closes this channel, which waits for this callback to return.
+        if (answered == true) {
+            _route.Submit(id, response);
+        }
+        if (failed.empty() == false) {
+            _route.Fail(failed);
         }
     }
 
@@ -3,8 +3,13 @@
 #endif
 
 #include <core/core.h>
+#include <algorithm>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <map>
+
+#include "../../FileTransfer/Frame.h"
 
 #undef EXTERNAL
 
@@ -12,6 +17,232 @@ using namespace WPEFramework;
 
 namespace WPEFramework {
 
+    // Puts the frames of the framed mode of the FileTransfer plugin back in order and writes the file pieces
+    // they hold. Frames that do not show up in time are reported lost, and late if they do show up after all:
+    // the file is written in order, so what they hold stays missing. Pieces that were already written (a
+    // plugin that restarted sends the last bit again) are dropped.
+    class Reassembler {
+    private:
+        Reassembler() = delete;
+        Reassembler(const Reassembler&) = delete;
+        Reassembler& operator=(const Reassembler&) = delete;
+
+        // The number of frames that may overtake a missing one, before it is taken as lost.
+        static constexpr uint16_t WINDOW = 64;
+        // The number of lost frames remembered, to tell a late one from a duplicate.
+        static constexpr uint16_t HISTORY = 1024;
+
+        struct Piece {
+            uint64_t Inode;
+            uint64_t Offset;
+            string Data;
+        };
+
+    public:
+        struct Statistics {
+            uint32_t Frames;
+            uint32_t Invalid;
+            uint32_t Reordered;
+            uint32_t Lost;
+            uint32_t Late; // taken for lost, arrived after all
+            uint32_t Duplicates;
+            uint64_t Received; // bytes on the wire
+            uint64_t Written; // bytes of the file
+            uint64_t Missing; // bytes of the file
+        };
+
+    public:
+        Reassembler(std::ofstream& storeFile)
+            : _adminLock()
+            , _storeFile(storeFile)
+            , _session(0)
+            , _expected(0)
+            , _started(false)
+            , _pending()
+            , _lost()
+            , _inode(0)
+            , _end(0)
+            , _buffer(0xFFFF)
+            , _statistics()
+        {
+        }
+        ~Reassembler()
+        {
+        }
+
+    public:
+        void Process(const uint8_t data[], const uint16_t length)
+        {
+            Transfer::Frame frame;
+            Piece piece;
+
+            _adminLock.Lock();
+
+            _statistics.Frames++;
+            _statistics.Received += length;
+
+            if (frame.Deserialize(data, length) == false) {
+                _statistics.Invalid++;
+            } else if ((frame.Flags & Transfer::Frame::COMPRESSED) != 0) {
+                if (Transfer::Frame::Decompress(&(data[Transfer::Frame::HEADER_SIZE]), length - Transfer::Frame::HEADER_SIZE, _buffer.data(), frame.Length) == false) {
+                    _statistics.Invalid++;
+                } else {
+                    piece = { frame.Inode, frame.Offset, string(reinterpret_cast<const char*>(_buffer.data()), frame.Length) };
+                    Arrived(frame, piece);
+                }
+            } else if ((length - Transfer::Frame::HEADER_SIZE) != frame.Length) {
+                _statistics.Invalid++;
+            } else {
+                piece = { frame.Inode, frame.Offset, string(reinterpret_cast<const char*>(&(data[Transfer::Frame::HEADER_SIZE])), frame.Length) };
+                Arrived(frame, piece);
+            }
+
+            _adminLock.Unlock();
+        }
+        Statistics Report() const
+        {
+            _adminLock.Lock();
+
+            Statistics result(_statistics);
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
+    private:
+        void Arrived(const Transfer::Frame& frame, Piece& piece)
+        {
+            if ((_started == false) || (frame.Session != _session)) {
+                // The sender (re)started, whatever is still pending of the previous session comes first.
+                Flush();
+                _lost.clear();
+
+                _started = true;
+                _session = frame.Session;
+                _expected = frame.Sequence;
+            }
+
+            const int32_t distance = static_cast<int32_t>(frame.Sequence - _expected);
+
+            if (distance < 0) {
+                std::deque<uint32_t>::iterator index(std::find(_lost.begin(), _lost.end(), frame.Sequence));
+
+                if (index == _lost.end()) {
+                    // A duplicate.
+                    Write(piece);
+                } else {
+                    // Too late, what came after it is written already.
+                    _lost.erase(index);
+                    _statistics.Lost--;
+                    _statistics.Late++;
+                    printf("Late frame %u, %u byte(s) at offset %llu stay missing\n", frame.Sequence, static_cast<uint32_t>(piece.Data.length()), static_cast<unsigned long long>(piece.Offset));
+                }
+            } else if (distance == 0) {
+                Write(piece);
+                _expected++;
+                Drain();
+            } else {
+                _statistics.Reordered++;
+                _pending[frame.Sequence] = std::move(piece);
+
+                if (_pending.size() > WINDOW) {
+                    // Stop waiting for what is missing, till the first one we do have.
+                    const uint32_t first = Next();
+
+                    Skip(first);
+                    printf("Lost %u frame(s), %u till %u\n", first - _expected, _expected, first - 1);
+                    _expected = first;
+                    Drain();
+                }
+            }
+        }
+        // The sequence number of the first pending frame, counting from the expected one.
+        uint32_t Next() const
+        {
+            std::map<uint32_t, Piece>::const_iterator index(_pending.lower_bound(_expected));
+
+            return (index != _pending.end() ? index->first : _pending.begin()->first);
+        }
+        // Takes the frames from the expected one up to the given one for lost.
+        void Skip(const uint32_t first)
+        {
+            const uint32_t count = first - _expected;
+
+            for (uint32_t sequence = first - std::min(count, static_cast<uint32_t>(HISTORY)); sequence != first; sequence++) {
+                _lost.push_back(sequence);
+            }
+            while (_lost.size() > HISTORY) {
+                _lost.pop_front();
+            }
+
+            _statistics.Lost += count;
+        }
+        void Drain()
+        {
+            std::map<uint32_t, Piece>::iterator index;
+
+            while ((index = _pending.find(_expected)) != _pending.end()) {
+                Write(index->second);
+                _pending.erase(index);
+                _expected++;
+            }
+        }
+        void Flush()
+        {
+            while (_pending.empty() == false) {
+                const uint32_t first = Next();
+
+                _statistics.Lost += (first - _expected);
+                _expected = first;
+                Drain();
+            }
+        }
+        void Write(const Piece& piece)
+        {
+            uint64_t start = piece.Offset;
+            const uint64_t end = piece.Offset + piece.Data.length();
+
+            if (piece.Inode != _inode) {
+                if (_inode != 0) {
+                    printf("File rotated\n");
+                    _end = 0;
+                } else {
+                    _end = piece.Offset;
+                }
+                _inode = piece.Inode;
+            }
+
+            if (end <= _end) {
+                _statistics.Duplicates++;
+            } else {
+                if (start < _end) {
+                    start = _end;
+                } else if (start > _end) {
+                    _statistics.Missing += (start - _end);
+                    printf("Missing %llu byte(s) at offset %llu\n", static_cast<unsigned long long>(start - _end), static_cast<unsigned long long>(_end));
+                }
+
+                _storeFile.write(&(piece.Data[static_cast<size_t>(start - piece.Offset)]), static_cast<std::streamsize>(end - start));
+                _statistics.Written += (end - start);
+                _end = end;
+            }
+        }
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        std::ofstream& _storeFile;
+        uint32_t _session;
+        uint32_t _expected;
+        bool _started;
+        std::map<uint32_t, Piece> _pending;
+        std::deque<uint32_t> _lost; // sequence numbers, oldest first
+        uint64_t _inode;
+        uint64_t _end; // of what is written of the file
+        std::vector<uint8_t> _buffer;
+        Statistics _statistics;
+    };
+
     class TextConnector : public Core::SocketDatagram {
 
         private:
@@ -23,10 +254,12 @@ namespace WPEFramework {
                 FileUpdate(const FileUpdate&) = delete;
                 FileUpdate& operator=(const FileUpdate&) = delete;
 
-                FileUpdate(EventsQueue& queue, const std::string& path)
+                FileUpdate(EventsQueue& queue, const std::string& path, const bool framed)
                     : Core::Thread(Core::Thread::DefaultStackSize(), _T("FileUpdate"))
                     , _lineQueue(queue)
-                    , _storeFile(path, std::ios_base::app)
+                    , _storeFile(path, std::ios_base::app | std::ios_base::binary)
+                    , _framed(framed)
+                    , _reassembler(_storeFile)
                 {
                     Run();
                 }
@@ -37,17 +270,32 @@ namespace WPEFramework {
                     Wait(Core::Thread::STOPPED, Core::infinite);
                 }
 
+            public:
+                Reassembler::Statistics Report() const
+                {
+                    return (_reassembler.Report());
+                }
+
             private:
                 virtual uint32_t Worker()
                 {
                     string line;
-                        while (_lineQueue.Extract(line, Core::infinite) == true) { _storeFile << line; }
+                    while (_lineQueue.Extract(line, Core::infinite) == true) {
+                        if (_framed == false) {
+                            _storeFile << line;
+                        } else {
+                            _reassembler.Process(reinterpret_cast<const uint8_t*>(line.data()), static_cast<uint16_t>(line.length()));
+                            _storeFile.flush();
+                        }
+                    }
                     return (Core::infinite);
                 }
 
             private:
                 EventsQueue& _lineQueue;
                 std::ofstream _storeFile;
+                bool _framed;
+                Reassembler _reassembler;
         };
 
         private:     
@@ -58,10 +306,10 @@ namespace WPEFramework {
             TextConnector(const TextConnector& copy) = delete;
             TextConnector& operator=(const TextConnector&) = delete;
 
-            TextConnector(const uint16_t port, const std::string& path)
+            TextConnector(const uint16_t port, const std::string& path, const bool framed)
                 : Core::SocketDatagram(false, Core::NodeId("0.0.0.0", port), Core::NodeId(), 0, MAX_BUFFER_LENGHT)
                 , _newLineQueue(256)
-                , _update(_newLineQueue, path)                 
+                , _update(_newLineQueue, path, framed)                 
             {
                 Open(0);
             }
@@ -84,6 +332,11 @@ namespace WPEFramework {
                 return 0;
             }
 
+            Reassembler::Statistics Report() const
+            {
+                return (_update.Report());
+            }
+
             void StateChange() override
             {
                 if (IsOpen()) {
@@ -135,15 +388,17 @@ namespace WPEFramework {
 
         public:
             Config()
-                : FilePath(_T(EMPTY_STRING)), Source()
+                : FilePath(_T(EMPTY_STRING)), Framed(false), Source()
             {
                 Add(_T("filepath"), &FilePath);
+                Add(_T("framed"), &Framed);
                 Add(_T("destination"), &Source);
             }
             ~Config() override {}
 
         public:
             Core::JSON::String FilePath;
+            Core::JSON::Boolean Framed;
             NetworkNode Source;
     };
 
@@ -153,7 +408,9 @@ namespace WPEFramework {
             "\t-interface : Interface to listen [obligatory]\n"
             "\t-port : UDP port [obligatory]\n"
             "\t-path : where the logs are stored [obligatory]\n"
+            "\t-framed : the plugin sends frames (framed mode)\n"
             "\t-h : Help\n"
+            "\t-s : Statistics of the framed mode\n"
             "\t-q : Quit\n");
     }
 
@@ -173,6 +430,8 @@ namespace WPEFramework {
                 std::string path(argv[index + 1]);
                 config.FilePath = path;
                 index++;
+            } else if (strcmp(argv[index], "-framed") == 0) {
+                config.Framed = true;
             } else if (strcmp(argv[index], "-h") == 0) {
                 ShowMenu();
             }
@@ -205,11 +464,12 @@ int main(int argc, char** argv)
     printf(_T("Interface IP   : %s\n"), config.Source.Binding.Value().c_str());
     printf(_T("Port           : %d\n"), config.Source.Port.Value());
     printf(_T("Path           : %s\n"), config.FilePath.Value().c_str());
+    printf(_T("Framed         : %s\n"), config.Framed.Value() ? _T("yes") : _T("no"));
 
     if (config.Source.Port.IsSet() &&
         config.FilePath.IsSet()) {
 
-        TextConnector connector(config.Source.Port.Value(), config.FilePath.Value());
+        TextConnector connector(config.Source.Port.Value(), config.FilePath.Value(), config.Framed.Value());
 
         int element;
         do {
@@ -220,6 +480,13 @@ int main(int argc, char** argv)
             case '?':
             case 'H':
                 ShowMenu();
+                break;
+            case 'S': {
+                Reassembler::Statistics statistics(connector.Report());
+                printf("Frames     : %u (invalid %u, reordered %u, lost %u, late %u, duplicates %u)\n", statistics.Frames, statistics.Invalid, statistics.Reordered, statistics.Lost, statistics.Late, statistics.Duplicates);
+                printf("Bytes      : %llu received, %llu written, %llu missing\n", static_cast<unsigned long long>(statistics.Received), static_cast<unsigned long long>(statistics.Written), static_cast<unsigned long long>(statistics.Missing));
+                break;
+            }
             }
 
             SleepMs(200);
@@ -0,0 +1,281 @@
+#pragma once
+
+// Include after the Module.h of the plugin, it brings in the core and the logging this log reports to.
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Append only log of checksummed records, the mechanics shared by the journals of the plugins: a journal
+    // encodes its records and decodes them on replay, this keeps them in a file. Records are written as they come
+    // in, forcing them to disk is left to Sync(), so a batch of records costs a single fdatasync. A record that was
+    // not written completely (power loss) is detected by its checksum, it and anything after it is dropped when the
+    // log is replayed. Compact() replaces the records up to an offset by a snapshot.
+    //
+    // record : length (4 bytes) - checksum (4 bytes) - data
+    //
+    // The length and the checksum (FNV-1a) cover the data.
+    class RecordLog {
+    private:
+        RecordLog() = delete;
+        RecordLog(const RecordLog&) = delete;
+        RecordLog& operator=(const RecordLog&) = delete;
+
+    protected:
+        static constexpr uint32_t HeaderSize = 8;
+
+    public:
+        // The name is what the log is called in messages, e.g. "lease journal".
+        RecordLog(const TCHAR name[])
+            : _adminLock()
+            , _name(name)
+            , _fileName()
+            , _descriptor(-1)
+            , _size(0)
+            , _compacted(0)
+            , _pending(false)
+        {
+        }
+        ~RecordLog()
+        {
+            Close();
+        }
+
+    public:
+        inline bool IsOpen() const
+        {
+            return (_descriptor != -1);
+        }
+        inline uint64_t Size() const
+        {
+            return (_size);
+        }
+        // Size of the log right after the last compaction.
+        inline uint64_t Compacted() const
+        {
+            return (_compacted);
+        }
+        bool Open(const string& fileName)
+        {
+            _adminLock.Lock();
+
+            ASSERT(_descriptor == -1);
+
+            _fileName = fileName;
+            _descriptor = ::open(_fileName.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+
+            if (_descriptor == -1) {
+                TRACE_L1("Could not open the %s %s, error: %d", _name.c_str(), _fileName.c_str(), errno);
+            } else {
+                struct stat properties;
+                _size = (::fstat(_descriptor, &properties) == 0 ? properties.st_size : 0);
+            }
+
+            _adminLock.Unlock();
+
+            return (_descriptor != -1);
+        }
+        void Close()
+        {
+            _adminLock.Lock();
+
+            if (_descriptor != -1) {
+                if (_pending == true) {
+                    ::fdatasync(_descriptor);
+                    _pending = false;
+                }
+                ::close(_descriptor);
+                _descriptor = -1;
+            }
+
+            _adminLock.Unlock();
+        }
+        // Forces everything appended so far to disk. The log is not locked while waiting for the disk, so new
+        // records can be appended in the mean time.
+        void Sync()
+        {
+            int descriptor = -1;
+
+            _adminLock.Lock();
+
+            if ((_pending == true) && (_descriptor != -1)) {
+                descriptor = ::dup(_descriptor);
+                _pending = false;
+            }
+
+            _adminLock.Unlock();
+
+            if (descriptor != -1) {
+                ::fdatasync(descriptor);
+                ::close(descriptor);
+            }
+        }
+        // The snapshot holds sealed records with everything up to offset, it replaces the log up to there. The
+        // records appended after it are kept.
+        bool Compact(const std::vector<uint8_t>& snapshot, const uint64_t offset)
+        {
+            bool result = false;
+
+            _adminLock.Lock();
+
+            if ((_descriptor != -1) && (offset <= _size)) {
+                const string tempName(_fileName + _T(".tmp"));
+                std::vector<uint8_t> tail(static_cast<size_t>(_size - offset));
+                int descriptor = ::open(tempName.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+
+                if (descriptor == -1) {
+                    TRACE_L1("Could not create %s, error: %d", tempName.c_str(), errno);
+                } else if (((tail.empty() == false) && (::pread(_descriptor, tail.data(), tail.size(), offset) != static_cast<ssize_t>(tail.size()))) || (Write(descriptor, snapshot.data(), static_cast<uint32_t>(snapshot.size())) == false) || (Write(descriptor, tail.data(), static_cast<uint32_t>(tail.size())) == false) || (::fdatasync(descriptor) != 0) || (::rename(tempName.c_str(), _fileName.c_str()) != 0)) {
+                    TRACE_L1("Could not compact the %s %s, error: %d", _name.c_str(), _fileName.c_str(), errno);
+                    ::close(descriptor);
+                    ::unlink(tempName.c_str());
+                } else {
+                    ::close(_descriptor);
+                    _descriptor = descriptor;
+                    _size = snapshot.size() + tail.size();
+                    _compacted = _size;
+                    _pending = false;
+                    result = true;
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
+    protected:
+        // Starts a record at the end of the buffer, returns where it starts. The data goes after the header.
+        static size_t Begin(std::vector<uint8_t>& buffer)
+        {
+            const size_t offset = buffer.size();
+
+            buffer.resize(offset + HeaderSize);
+
+            return (offset);
+        }
+        // Fills in the header of the record that starts at offset, with all data up to the end of the buffer.
+        static void Seal(std::vector<uint8_t>& buffer, const size_t offset)
+        {
+            const uint32_t length = static_cast<uint32_t>(buffer.size() - offset - HeaderSize);
+            const uint32_t checksum = Checksum(&buffer[offset + HeaderSize], length);
+
+            ::memcpy(&buffer[offset], &length, sizeof(length));
+            ::memcpy(&buffer[offset + 4], &checksum, sizeof(checksum));
+        }
+        // Calls action(data, length) for every complete record, in the order they were written. The action returns
+        // false if it can not decode the record, it is dropped together with everything after it.
+        template <typename ACTION>
+        void Replay(ACTION&& action)
+        {
+            _adminLock.Lock();
+
+            if (_descriptor != -1) {
+                std::vector<uint8_t> content(static_cast<size_t>(_size));
+                uint64_t offset = 0;
+
+                if ((_size != 0) && (::pread(_descriptor, content.data(), content.size(), 0) != static_cast<ssize_t>(content.size()))) {
+                    TRACE_L1("Could not read the %s %s, error: %d", _name.c_str(), _fileName.c_str(), errno);
+                    content.clear();
+                }
+
+                while ((offset + HeaderSize) <= content.size()) {
+                    const uint8_t* record = &(content[static_cast<size_t>(offset)]);
+                    uint32_t length, checksum;
+
+                    ::memcpy(&length, &record[0], sizeof(length));
+                    ::memcpy(&checksum, &record[4], sizeof(checksum));
+
+                    if (((offset + HeaderSize + length) > content.size()) || (Checksum(&record[HeaderSize], length) != checksum) || (action(&record[HeaderSize], length) == false)) {
+                        break;
+                    }
+
+                    offset += HeaderSize + length;
+                }
+
+                if (offset != _size) {
+                    // The tail is incomplete, it was never acknowledged to be on disk, drop it.
+                    SYSLOG(Logging::Startup, (_T("The %s is truncated at %d of %d bytes"), _name.c_str(), static_cast<uint32_t>(offset), static_cast<uint32_t>(_size)));
+
+                    if (::ftruncate(_descriptor, offset) == 0) {
+                        _size = offset;
+                    }
+                }
+            }
+
+            _adminLock.Unlock();
+        }
+        // Appends sealed records.
+        bool Append(const std::vector<uint8_t>& records)
+        {
+            bool result = false;
+
+            _adminLock.Lock();
+
+            if (_descriptor != -1) {
+                result = Write(_descriptor, records.data(), static_cast<uint32_t>(records.size()));
+
+                if (result == true) {
+                    _size += records.size();
+                    _pending = true;
+                } else {
+                    TRACE_L1("Could not append to the %s %s, error: %d", _name.c_str(), _fileName.c_str(), errno);
+
+                    // A partial record would fail its checksum on replay and take all later records with it, cut
+                    // it off. If that is not possible, stop appending, the log can no longer be trusted.
+                    if (::ftruncate(_descriptor, _size) != 0) {
+                        SYSLOG(Logging::Notification, (_T("The %s %s is torn and closed, error: %d"), _name.c_str(), _fileName.c_str(), errno));
+                        ::close(_descriptor);
+                        _descriptor = -1;
+                        _pending = false;
+                    }
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
+    private:
+        static bool Write(const int descriptor, const uint8_t data[], const uint32_t length)
+        {
+            uint32_t written = 0;
+
+            while (written < length) {
+                ssize_t size = ::write(descriptor, &(data[written]), length - written);
+
+                if (size > 0) {
+                    written += static_cast<uint32_t>(size);
+                } else if ((size == 0) || (errno != EINTR)) {
+                    break;
+                }
+            }
+
+            return (written == length);
+        }
+        static uint32_t Checksum(const uint8_t data[], const uint32_t length)
+        {
+            uint32_t hash = 2166136261u;
+
+            for (uint32_t index = 0; index < length; index++) {
+                hash = (hash ^ data[index]) * 16777619u;
+            }
+
+            return (hash);
+        }
+
+    private:
+        Core::CriticalSection _adminLock;
+        const string _name;
+        string _fileName;
+        int _descriptor;
+        uint64_t _size;
+        uint64_t _compacted;
+        bool _pending;
+    };
+}
+}